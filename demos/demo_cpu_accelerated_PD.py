@@ -0,0 +1,53 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+Accelerated primal-dual scheme of the PD-TV and TGV CPU regularisers: the steps and the
+extrapolation are updated every iteration from the strong convexity of the fidelity.
+The iterations needed to come within a given RMSE of the solution (a long accelerated
+run) are counted for both schemes, on the Lena image and on a 3D phantom of ellipsoids
+
+Run from the demos folder, the Lena image is used
+"""
+
+import matplotlib.pyplot as plt
+import numpy as np
+import os
+import timeit
+from ccpi.filters.regularisers import PD_TV, TGV
+
+filename = os.path.join( "data" ,"lena_gray_512.tif")
+
+# read image
+Im = plt.imread(filename)
+Im = np.asarray(Im, dtype='float32')
+Im = Im/255
+u0 = Im + np.random.normal(loc = 0 , scale = 0.05 , size = np.shape(Im))
+u0 = u0.astype('float32')
+
+# a phantom of nested ellipsoids
+N = 64
+z, y, x = np.mgrid[-1:1:N*1j, -1:1:N*1j, -1:1:N*1j]
+phantom = np.zeros((N, N, N), dtype='float32')
+for (a, b, c, x0, y0, value) in ((0.9, 0.8, 0.7, 0.0, 0.0, 0.6), (0.3, 0.4, 0.5, -0.3, 0.1, 0.3), (0.2, 0.2, 0.3, 0.4, -0.2, -0.2)):
+    phantom[((x - x0)/a)**2 + ((y - y0)/b)**2 + (z/c)**2 <= 1.0] += value
+v0 = phantom + np.random.normal(loc = 0 , scale = 0.05 , size = np.shape(phantom))
+v0 = v0.astype('float32')
+
+iterations = (10, 20, 30, 50, 75, 100, 150, 200, 300, 500, 750, 1000, 1500)
+
+def iterations_to(run, solution, target):
+    for it in iterations:
+        if np.sqrt(np.mean((run(it) - solution)**2)) < target:
+            return it
+    return None
+
+for (name, data) in (('Lena', u0), ('phantom', v0)):
+    for (method, run, target) in (('PD_TV', lambda it, acc: PD_TV(data, 0.1, it, 0.0, 0, 0, 8, 'cpu', accelerated=acc)[0], 1e-4),
+                                  ('TGV', lambda it, acc: TGV(data, 0.1, 1.0, 2.0, it, 12, 0.0, 'cpu', accelerated=acc)[0], 1e-3)):
+        solution = run(5000, True)
+        for accelerated in (False, True):
+            start_time = timeit.default_timer()
+            count = iterations_to(lambda it: run(it, accelerated), solution, target)
+            print ("{} {}, accelerated {}: RMSE {} after {} iterations ({:.2f} s to search)".format(name, method,
+                accelerated, target, count if count else "> {}".format(iterations[-1]),
+                timeit.default_timer() - start_time))
@@ -0,0 +1,51 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+Regularisation parameter from the noise level on the CPU: the noise standard deviation
+is estimated from the image (median absolute deviation of the diagonal Haar wavelet
+coefficients), then ROF-TV, FGP-TV and NDF pick their regularisation parameter by the
+discrepancy principle in two solves, compared with a sweep of the parameter
+
+Run from the demos folder, the Lena image is used
+"""
+
+import matplotlib.pyplot as plt
+import numpy as np
+import os
+import timeit
+from ccpi.filters.regularisers import FGP_TV, noise_level, auto_lambda
+
+filename = os.path.join( "data" ,"lena_gray_512.tif")
+
+# read image
+Im = plt.imread(filename)
+Im = np.asarray(Im, dtype='float32')
+Im = Im/255
+sigma = 0.05
+u0 = Im + np.random.normal(loc = 0 , scale = sigma , size = np.shape(Im))
+u0 = u0.astype('float32')
+
+start_time = timeit.default_timer()
+estimate = noise_level(u0)
+print ("noise {}, estimated {:.4f} in {:.4f} s".format(sigma, estimate, timeit.default_timer() - start_time))
+
+for (method, iterations) in (('ROF_TV', 1000), ('FGP_TV', 300), ('NDF', 300)):
+    start_time = timeit.default_timer()
+    (output, info, lam) = auto_lambda(method, u0, iterations)
+    print ("{}: lambda {:.4f} in {:.3f} s, removed {:.4f}, RMSE {:.4f}".format(method, lam,
+        timeit.default_timer() - start_time, np.sqrt(np.mean((output - u0)**2)),
+        np.sqrt(np.mean((output - Im)**2))))
+
+print ("#############FGP-TV sweep of lambda####################")
+start_time = timeit.default_timer()
+for lam in np.geomspace(0.01, 0.2, 10):
+    (output, info) = FGP_TV(u0, lam, 300, 0.0, 0, 0, 'cpu')
+    print ("lambda {:.4f}: removed {:.4f}, RMSE {:.4f}".format(lam,
+        np.sqrt(np.mean((output - u0)**2)), np.sqrt(np.mean((output - Im)**2))))
+print ("sweep in {:.3f} s".format(timeit.default_timer() - start_time))
+
+# a volume with a different noise level in every slice
+vol = np.stack([Im + np.random.normal(0, s, np.shape(Im)) for s in (0.02, 0.05, 0.1)]).astype('float32')
+print ("per slice noise", noise_level(vol, per_slice=True))
+(output, info, lam) = auto_lambda('ROF_TV', vol, 500, per_slice=True)
+print ("per slice lambda", lam)
@@ -0,0 +1,63 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+Checkpoint and resume of the 3D TGV CPU regulariser: the run is stopped half way
+(as a preempted job would be), resumed from the checkpoint file and compared with
+an uninterrupted run; the time of the run with and without checkpoints is reported
+
+Run from the demos folder, the Lena image is used to build the volume
+"""
+
+import matplotlib.pyplot as plt
+import numpy as np
+import os
+import tempfile
+import timeit
+from ccpi.filters.regularisers import TGV, checkpoint_iterations
+
+filename = os.path.join( "data" ,"lena_gray_512.tif")
+
+# read image
+Im = plt.imread(filename)
+Im = np.asarray(Im, dtype='float32')
+Im = Im/255
+perc = 0.05
+slices = 16
+vol = np.repeat(Im[np.newaxis,:,:], slices, axis=0)
+noisyVol = vol + np.random.normal(loc = 0 , scale = perc * vol , size = np.shape(vol))
+noisyVol = noisyVol.astype('float32')
+
+pars = {'regularisation_parameter':0.02,
+        'alpha1':1.0,
+        'alpha0':2.0,
+        'number_of_iterations': 200,
+        'LipshitzConstant' :12,
+        'tolerance_constant':0.0}
+interval = 50
+
+def run(iterations, **checkpoint):
+    return TGV(noisyVol,
+               pars['regularisation_parameter'],
+               pars['alpha1'],
+               pars['alpha0'],
+               iterations,
+               pars['LipshitzConstant'],
+               pars['tolerance_constant'], 'cpu', **checkpoint)
+
+print ("#############TGV CPU {}x{}x{}, {} iterations####################".format(
+    slices, Im.shape[0], Im.shape[1], pars['number_of_iterations']))
+start_time = timeit.default_timer()
+(tgv_ref, info_ref) = run(pars['number_of_iterations'])
+print ("no checkpoints: {:.3f} s".format(timeit.default_timer() - start_time))
+
+ckpt = os.path.join(tempfile.mkdtemp(), 'tgv3d.ckpt')
+start_time = timeit.default_timer()
+run(pars['number_of_iterations']//2, checkpoint=ckpt, checkpoint_interval=interval)
+first = timeit.default_timer() - start_time
+print ("stopped after {} iterations".format(checkpoint_iterations(ckpt)))
+start_time = timeit.default_timer()
+(tgv_res, info_res) = run(pars['number_of_iterations'], checkpoint=ckpt, checkpoint_interval=interval, resume=True)
+print ("checkpoint every {} iterations, interrupted and resumed: {:.3f} s".format(
+    interval, first + timeit.default_timer() - start_time))
+print ("resumed run identical to the uninterrupted one: {}".format(np.array_equal(tgv_ref, tgv_res)))
+os.remove(ckpt)
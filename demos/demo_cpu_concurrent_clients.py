@@ -0,0 +1,70 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+Multi-client benchmark of the CPU regularisers: several threads call ROF-TV
+concurrently, then a mix of ROF-TV, FGP-TV, PD-TV, TGV and NDF on volumes and
+images, with the kernels on OpenMP (every call starts its own team) and on the
+shared work-stealing pool of the library
+
+Throughput is reported as regularisations per second for 1, 2, 4 and 8 clients
+"""
+
+import numpy as np
+import threading
+import timeit
+from ccpi.filters.regularisers import ROF_TV, FGP_TV, PD_TV, TGV, NDF, thread_pool
+
+slices = 8
+N = 256
+calls_per_client = 2
+
+pars = {'regularisation_parameter':0.02,
+        'number_of_iterations': 100,
+        'time_marching_parameter': 0.001,
+        'tolerance_constant':0.0}
+
+# the mixed load, every client starts at another regulariser
+mixed = [lambda u: ROF_TV(u, 0.02, 100, 0.001, 0.0, 'cpu'),
+         lambda u: FGP_TV(u, 0.02, 100, 0.0, 0, 0, 'cpu'),
+         lambda u: PD_TV(u, 0.02, 100, 0.0, 0, 0, 8, 'cpu'),
+         lambda u: TGV(u, 0.02, 1.0, 2.0, 100, 12, 0.0, 'cpu'),
+         lambda u: NDF(u, 0.02, 0.015, 100, 0.025, 1, 0.0, 'cpu')]
+
+def client(vol, calls):
+    for c in range(calls):
+        ROF_TV(vol,
+               pars['regularisation_parameter'],
+               pars['number_of_iterations'],
+               pars['time_marching_parameter'],
+               pars['tolerance_constant'], 'cpu')
+
+def client_mixed(vol, calls, first):
+    for c in range(calls):
+        mixed[(first + c) % len(mixed)](vol)
+
+def throughput(clients, load):
+    if load == 'mixed':
+        # odd clients work on images, the 2D solvers keep their iterations in one parallel region
+        vols = [np.random.rand(slices,N,N).astype('float32') if c % 2 == 0 else np.random.rand(2*N,2*N).astype('float32') for c in range(clients)]
+        threads = [threading.Thread(target=client_mixed, args=(vols[c], calls_per_client, c)) for c in range(clients)]
+    else:
+        vols = [np.random.rand(slices,N,N).astype('float32') for c in range(clients)]
+        threads = [threading.Thread(target=client, args=(vols[c], calls_per_client)) for c in range(clients)]
+    start_time = timeit.default_timer()
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    return clients*calls_per_client/(timeit.default_timer() - start_time)
+
+for load in ('ROF-TV', 'mixed'):
+    if load == 'mixed':
+        print ("%%%%%%%%%%%%%%mixed {}x{}x{} and {}x{}, 100 iterations%%%%%%%%%%%%%%".format(slices, N, N, 2*N, 2*N))
+    else:
+        print ("%%%%%%%%%%%%%%ROF-TV {}x{}x{}, {} iterations%%%%%%%%%%%%%%".format(slices, N, N, pars['number_of_iterations']))
+    for mode in ('OpenMP', 'pool'):
+        if mode == 'pool':
+            print ("pool workers: {}".format(thread_pool(-1)))
+        for clients in (1, 2, 4, 8):
+            print ("{:6s} {} clients: {:.2f} regularisations/s".format(mode, clients, throughput(clients, load)))
+        thread_pool(0)
@@ -0,0 +1,46 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+Calibrated runtime model of the CPU regularisers: the cores are timed on this machine
+(a few shapes, two iteration counts, one and all threads) and the fitted model is
+written to a calibration file. The predicted wall times of a few runs on the Lena image
+are compared to the measured ones, then the time of large jobs as a scheduler would ask
+for them (3D FGP-TV with 400 iterations on 1024^3 voxels with 32 threads) is predicted
+
+Run from the demos folder, the Lena image is used
+"""
+
+import matplotlib.pyplot as plt
+import numpy as np
+import os
+import timeit
+from ccpi.filters.regularisers import ROF_TV, FGP_TV, TGV, calibrate_cost_model, predict_runtime
+
+filename = os.path.join( "data" ,"lena_gray_512.tif")
+
+# read image
+Im = plt.imread(filename)
+Im = np.asarray(Im, dtype='float32')
+Im = Im/255
+perc = 0.05
+u0 = Im + np.random.normal(loc = 0 , scale = perc * Im , size = np.shape(Im))
+u0 = u0.astype('float32')
+
+calibration = "cost_model.txt"
+start_time = timeit.default_timer()
+calibrate_cost_model(calibration, methods=['ROF_TV', 'FGP_TV', 'TGV'])
+print ("calibration: {:.1f} s, written to {}".format(timeit.default_timer() - start_time, calibration))
+
+runs = [('ROF_TV', 500, lambda: ROF_TV(u0, 0.02, 500, 0.001, 0.0, 'cpu')),
+        ('FGP_TV', 300, lambda: FGP_TV(u0, 0.02, 300, 0.0, 0, 0, 'cpu')),
+        ('TGV', 200, lambda: TGV(u0, 0.02, 1.0, 2.0, 200, 12, 0.0, 'cpu'))]
+# on an otherwise idle machine the predictions are within a few times of the measured times
+for (method, iterations, run) in runs:
+    measured = min(timeit.timeit(run, number=1) for r in range(3))
+    predicted = predict_runtime(calibration, method, u0.shape, iterations)
+    print ("{} {} iterations on {}: measured {:.3f} s, predicted {:.3f} s (x{:.2f})".format(method, iterations, u0.shape,
+           measured, predicted, predicted/measured))
+
+for threads in (1, 8, 32):
+    print ("FGP_TV 400 iterations on 1024^3 with {} threads: predicted {:.0f} s".format(threads,
+           predict_runtime(calibration, 'FGP_TV', (1024, 1024, 1024), 400, threads)))
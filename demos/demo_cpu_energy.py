@@ -0,0 +1,63 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+Energy per solve of the CPU regularisers from the Linux powercap/RAPL counters of the
+processor packages: the time and the joules of the plain and the accelerated PD-TV, of a
+chain of regularisers run as separate calls and as one pipeline (with the joules of its
+stages), and of a PatchSelect + NLTV region measured with energy_counter. Without readable
+counters (no RAPL, readable by root only) the joules are printed as n/a
+
+Run from the demos folder, the Lena image is used
+"""
+
+import matplotlib.pyplot as plt
+import numpy as np
+import os
+import timeit
+from ccpi.filters.regularisers import PD_TV, NDF, FGP_TV, pipeline, PatchSelect, NLTV, energy_counter
+
+filename = os.path.join( "data" ,"lena_gray_512.tif")
+
+# read image
+Im = plt.imread(filename)
+Im = np.asarray(Im, dtype='float32')
+Im = Im/255
+perc = 0.05
+u0 = Im + np.random.normal(loc = 0 , scale = perc * Im , size = np.shape(Im))
+u0 = u0.astype('float32')
+
+def joules(value):
+    return "n/a" if value is None or np.isnan(value) else "{:.2f} J".format(value)
+
+def report(name, seconds, energy):
+    watts = "" if energy is None or np.isnan(energy) else ", {:.1f} W".format(energy/seconds)
+    print ("{}: {:.3f} s, {}{}".format(name, seconds, joules(energy), watts))
+
+for accelerated in (False, True):
+    start_time = timeit.default_timer()
+    (output, info) = PD_TV(u0, 0.02, 1000, 1e-06, 0, 0, 8, 'cpu', accelerated=accelerated, energy=True)
+    report("PD-TV {} ({} iterations)".format("accelerated" if accelerated else "plain", int(info[0])),
+           timeit.default_timer() - start_time, info[-1])
+
+stages = [('NDF', 0.02, 0.015, 100, 0.025, 1, 0.0),
+          ('FGP_TV', 0.02, 100, 0.0, 0, 0),
+          ('clamp', 0.0, None),
+          ('scale', 255.0, 0.0)]
+start_time = timeit.default_timer()
+(output, info) = NDF(u0, 0.02, 0.015, 100, 0.025, 1, 0.0, 'cpu', energy=True)
+energy = info[-1]
+(output, info) = FGP_TV(output, 0.02, 100, 0.0, 0, 0, 'cpu', energy=True)
+output = 255.0*np.maximum(output, 0.0)
+report("separate calls", timeit.default_timer() - start_time, energy + info[-1])
+start_time = timeit.default_timer()
+(output, info) = pipeline(u0, stages, energy=True)
+report("pipeline", timeit.default_timer() - start_time, info[-1])
+print ("  stages: " + ", ".join("{} {}".format(stage[0], joules(value))
+                                for (stage, value) in zip(stages, info[-len(stages)-1:-1])))
+
+start_time = timeit.default_timer()
+start = energy_counter()
+H_i, H_j, Weights = PatchSelect(u0, 3, 1, 9, 0.02, 'cpu')
+output = NLTV(u0, H_i, H_j, H_i, Weights, 0.05, 5)
+report("PatchSelect + NLTV", timeit.default_timer() - start_time,
+       None if start is None else energy_counter() - start)
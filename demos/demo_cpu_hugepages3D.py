@@ -0,0 +1,82 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+Benchmark of 3D CPU regularisers with and without transparent huge pages
+for the volume-sized work arrays (FGP-TV and ROF-TV)
+
+Run from the demos folder, the volume is built from the Lena image
+"""
+
+import matplotlib.pyplot as plt
+import numpy as np
+import os
+import timeit
+import concurrent.futures
+from ccpi.filters.regularisers import ROF_TV, FGP_TV, huge_pages, submit
+
+filename = os.path.join( "data" ,"lena_gray_512.tif")
+
+# read image
+Im = plt.imread(filename)
+Im = np.asarray(Im, dtype='float32')
+Im = Im/255
+perc = 0.05
+(N,M) = np.shape(Im)
+
+slices = 64
+noisyVol = np.zeros((slices,N,M),dtype='float32')
+for i in range (slices):
+    noisyVol[i,:,:] = Im + np.random.normal(loc = 0 , scale = perc * Im , size = np.shape(Im))
+print ("Volume of {} bytes".format(noisyVol.nbytes))
+
+pars_fgp = {'regularisation_parameter':0.02,
+            'number_of_iterations' :100,
+            'tolerance_constant':0.0,
+            'methodTV': 0 ,
+            'nonneg': 0}
+pars_rof = {'regularisation_parameter':0.02,
+            'number_of_iterations' :100,
+            'time_marching_parameter': 0.001,
+            'tolerance_constant':0.0}
+
+def run_fgp(run=lambda f, *args: f(*args)):
+    return run(FGP_TV, noisyVol,
+               pars_fgp['regularisation_parameter'],
+               pars_fgp['number_of_iterations'],
+               pars_fgp['tolerance_constant'],
+               pars_fgp['methodTV'],
+               pars_fgp['nonneg'], 'cpu')
+
+def run_rof(run=lambda f, *args: f(*args)):
+    return run(ROF_TV, noisyVol,
+               pars_rof['regularisation_parameter'],
+               pars_rof['number_of_iterations'],
+               pars_rof['time_marching_parameter'],
+               pars_rof['tolerance_constant'], 'cpu')
+
+repeats = 3
+for name, method in (('FGP-TV', run_fgp), ('ROF-TV', run_rof)):
+    print ("#############{} CPU####################".format(name))
+    for enable in (False, True):
+        huge_pages(enable)
+        times = []
+        for r in range(repeats):
+            start_time = timeit.default_timer()
+            method()
+            times.append(timeit.default_timer() - start_time)
+        print ("huge pages {}: best {:.3f} s, mean {:.3f} s".format(
+            'on ' if enable else 'off', min(times), np.mean(times)))
+        if enable:
+            # bytes requested on the huge page path and backed by huge pages, asked while a run
+            # holds its work arrays
+            huge_pages()
+            future = method(submit)
+            while (future.progress()[0] < 1) and not future.done():
+                concurrent.futures.wait([future], timeout=0.01)
+            (requested, obtained) = huge_pages()
+            future.result()
+            if obtained < 0:
+                print ("  {} bytes requested, AnonHugePages not reported by the kernel".format(requested))
+            else:
+                print ("  {} of {} bytes backed by huge pages".format(obtained, requested))
+huge_pages(True)
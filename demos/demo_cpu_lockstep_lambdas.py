@@ -0,0 +1,46 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+Selection of the regularisation parameter with the lockstep CPU solvers: ROF-TV,
+FGP-TV and NDF are run for K lambdas one after the other and in one lockstep
+call (a list of lambdas), the lambda with the lowest RMSE is reported
+
+Run from the demos folder, the Lena image is used
+"""
+
+import matplotlib.pyplot as plt
+import numpy as np
+import os
+import timeit
+from ccpi.filters.regularisers import ROF_TV, FGP_TV, NDF
+
+filename = os.path.join( "data" ,"lena_gray_512.tif")
+
+# read image
+Im = plt.imread(filename)
+Im = np.asarray(Im, dtype='float32')
+Im = Im/255
+perc = 0.05
+u0 = Im + np.random.normal(loc = 0 , scale = perc * Im , size = np.shape(Im))
+u0 = u0.astype('float32')
+
+lambdas = [0.005, 0.01, 0.02, 0.03, 0.04, 0.06, 0.08, 0.1]
+iterations = 300
+
+methods = (('ROF-TV', lambda lam: ROF_TV(u0, lam, iterations, 0.001, 0.0, 'cpu')),
+           ('FGP-TV', lambda lam: FGP_TV(u0, lam, iterations, 0.0, 0, 0, 'cpu')),
+           ('NDF', lambda lam: NDF(u0, lam, 0.02, iterations, 0.007, 1, 0.0, 'cpu')))
+
+for name, run in methods:
+    print ("#############{} CPU, {} lambdas####################".format(name, len(lambdas)))
+    start_time = timeit.default_timer()
+    separate = [run(lam)[0] for lam in lambdas]
+    txtime = timeit.default_timer() - start_time
+    start_time = timeit.default_timer()
+    (lockstep, info) = run(lambdas)
+    txtime_lockstep = timeit.default_timer() - start_time
+    print ("separate calls: {:.3f} s, lockstep: {:.3f} s".format(txtime, txtime_lockstep))
+    rmse = [np.sqrt(np.mean((out - Im)**2)) for out in lockstep]
+    print ("best lambda {} with RMSE {:.5f}, largest difference to the separate calls {:.2e}".format(
+        lambdas[int(np.argmin(rmse))], min(rmse),
+        max(np.max(np.abs(a - b)) for a, b in zip(lockstep, separate))))
@@ -0,0 +1,52 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+Multigrid solver of the linear subproblems on the CPU: the steady state of linear
+diffusion with a fidelity term is computed by explicit time steps (NDF with sigma = 0)
+and by multigrid V-cycles (LinearDiff), then a masked region is inpainted with
+fidelity weights; SB-TV is run with Gauss-Seidel sweeps and with a V-cycle for its
+u-subproblem
+
+Run from the demos folder, the Lena image is used
+"""
+
+import matplotlib.pyplot as plt
+import numpy as np
+import os
+import timeit
+from ccpi.filters.regularisers import NDF, LinearDiff, SB_TV
+
+filename = os.path.join( "data" ,"lena_gray_512.tif")
+
+# read image
+Im = plt.imread(filename)
+Im = np.asarray(Im, dtype='float32')
+Im = Im/255
+perc = 0.05
+u0 = Im + np.random.normal(loc = 0 , scale = perc * Im , size = np.shape(Im))
+u0 = u0.astype('float32')
+lam = 2.0
+
+print ("#############Linear diffusion steady state, lambda {}####################".format(lam))
+start_time = timeit.default_timer()
+(explicit, info) = NDF(u0, lam, 0.0, 2000, 0.1, 1, 0.0, 'cpu')
+print ("explicit steps: {} in {:.3f} s".format(int(info[0]), timeit.default_timer() - start_time))
+start_time = timeit.default_timer()
+(mg, info) = LinearDiff(u0, lam, 50, 1e-5)
+print ("multigrid: {} V-cycles in {:.3f} s, relative residual {:.2e}".format(
+    int(info[0]), timeit.default_timer() - start_time, info[1]))
+print ("largest difference {:.2e}".format(np.max(np.abs(explicit - mg))))
+
+# no data in a square: the fidelity weight is 0 there
+W = np.ones_like(u0)
+W[200:300,200:300] = 0.0
+(inpainted, info) = LinearDiff(u0, 0.5, 100, 1e-5, weights=W)
+print ("inpainting: {} V-cycles, RMSE in the masked square {:.4f}".format(
+    int(info[0]), np.sqrt(np.mean((inpainted - Im)[200:300,200:300]**2))))
+
+print ("#############SB-TV CPU####################")
+for multigrid in (False, True):
+    start_time = timeit.default_timer()
+    (sb, info) = SB_TV(u0, 0.02, 100, 0.0, 0, 'cpu', multigrid=multigrid)
+    print ("{}: {:.3f} s, RMSE {:.4f}".format('V-cycle' if multigrid else 'Gauss-Seidel',
+        timeit.default_timer() - start_time, np.sqrt(np.mean((sb - Im)**2))))
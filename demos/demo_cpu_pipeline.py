@@ -0,0 +1,49 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+Chained CPU regularisers: NDF for the noise, then FGP-TV, a nonnegativity clamp and a
+rescaling, run as one pipeline (one workspace of work arrays, two output arrays, the
+pointwise stages fused into one pass) and as separate calls. The times, the workspace, the
+predicted peak memory and the difference of the results are printed
+
+Run from the demos folder, the Lena image is used
+"""
+
+import matplotlib.pyplot as plt
+import numpy as np
+import os
+import timeit
+from ccpi.filters.regularisers import NDF, FGP_TV, pipeline, peak_memory
+
+filename = os.path.join( "data" ,"lena_gray_512.tif")
+
+# read image
+Im = plt.imread(filename)
+Im = np.asarray(Im, dtype='float32')
+Im = Im/255
+perc = 0.05
+u0 = Im + np.random.normal(loc = 0 , scale = perc * Im , size = np.shape(Im))
+u0 = u0.astype('float32')
+# and a volume of shifted copies
+v0 = np.stack([np.roll(u0, k, axis=1) for k in range(16)])
+
+stages = [('NDF', 0.02, 0.015, 100, 0.025, 1, 0.0),
+          ('FGP_TV', 0.02, 100, 0.0, 0, 0),
+          ('clamp', 0.0, None),
+          ('scale', 255.0, 0.0)]
+
+for data in (u0, v0):
+    start_time = timeit.default_timer()
+    (output, info) = pipeline(data, stages)
+    pipeline_time = timeit.default_timer() - start_time
+
+    start_time = timeit.default_timer()
+    separate = NDF(data, 0.02, 0.015, 100, 0.025, 1, 0.0, 'cpu')[0]
+    separate = FGP_TV(separate, 0.02, 100, 0.0, 0, 0, 'cpu')[0]
+    separate = 255.0*np.maximum(separate, 0.0)
+    separate_time = timeit.default_timer() - start_time
+
+    print ("{}: pipeline {:.3f} s (workspace {:.1f} MB, peak {:.1f} MB), separate calls {:.3f} s, max difference {}".format(
+           data.shape, pipeline_time, info[-2]/2**20, peak_memory('pipeline', data.shape, stages=stages)/2**20,
+           separate_time,
+           np.abs(output - separate).max()))
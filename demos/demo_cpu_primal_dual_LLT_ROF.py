@@ -0,0 +1,67 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+Primal-dual solver of the LLT-ROF CPU regulariser: the energy
+1/2||u - f||^2 + lambdaROF*TV(u) + lambdaLLT*sum_i |u_ii| is minimised with the accelerated
+primal-dual scheme instead of explicit time marching. The energy reached and the time
+taken are printed for both solvers; the primal-dual one is stopped as soon as it gets
+below the energy of the explicit run
+
+Run from the demos folder, the Lena image is used
+"""
+
+import matplotlib.pyplot as plt
+import numpy as np
+import os
+import timeit
+from ccpi.filters.regularisers import LLT_ROF
+
+filename = os.path.join( "data" ,"lena_gray_512.tif")
+
+# read image
+Im = plt.imread(filename)
+Im = np.asarray(Im, dtype='float32')
+Im = Im/255
+perc = 0.05
+u0 = Im + np.random.normal(loc = 0 , scale = perc * Im , size = np.shape(Im))
+u0 = u0.astype('float32')
+
+pars = {'regularisation_parameterROF':0.01,
+        'regularisation_parameterLLT':0.0085,
+        'number_of_iterations' :3000,
+        'time_marching_parameter':0.0001,
+        'tolerance_constant':0.0}
+
+def energy(u):
+    # the discretisation of the primal-dual solver: forward differences for TV and second
+    # differences with Neumann boundaries for LLT
+    u = u.astype('float64')
+    grad2 = np.zeros(u.shape)
+    second = 0.0
+    for axis in range(u.ndim):
+        d = np.diff(u, axis=axis)
+        zero = np.zeros_like(np.take(d, [0], axis=axis))
+        grad2 += np.concatenate((d, zero), axis=axis)**2
+        second += np.sum(np.abs(np.diff(np.concatenate((zero, d, zero), axis=axis), axis=axis)))
+    return (0.5*np.sum((u - u0)**2) + pars['regularisation_parameterROF']*np.sum(np.sqrt(grad2)) +
+            pars['regularisation_parameterLLT']*second)
+
+start_time = timeit.default_timer()
+(output, info) = LLT_ROF(u0, pars['regularisation_parameterROF'], pars['regularisation_parameterLLT'],
+                         pars['number_of_iterations'], pars['time_marching_parameter'],
+                         pars['tolerance_constant'], 'cpu')
+explicit_time = timeit.default_timer() - start_time
+target = energy(output)
+print ("explicit: energy {:.4f} after {} iterations in {:.3f} s".format(target,
+       pars['number_of_iterations'], explicit_time))
+
+for iterations in (10, 20, 50, 100, 200, 500, 1000):
+    start_time = timeit.default_timer()
+    (output, info) = LLT_ROF(u0, pars['regularisation_parameterROF'], pars['regularisation_parameterLLT'],
+                             iterations, pars['time_marching_parameter'], pars['tolerance_constant'], 'cpu',
+                             primal_dual=True)
+    pd_time = timeit.default_timer() - start_time
+    print ("primal-dual: energy {:.4f} after {} iterations in {:.3f} s".format(energy(output), iterations, pd_time))
+    if energy(output) <= target:
+        print ("the energy of the explicit run is reached {:.1f}x faster".format(explicit_time/pd_time))
+        break
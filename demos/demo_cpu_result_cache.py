@@ -0,0 +1,40 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+Result cache of the CPU regularisers: with result_cache switched on a call with the same
+input data and parameters returns the stored output instead of iterating again, as in an
+interactive session re-running a parameter sweep. The memory bound is set to two outputs
+here, older results go to a spill directory and are read back from there. The times of
+the first and the repeated sweep and the cache counters are printed
+
+Run from the demos folder, the Lena image is used
+"""
+
+import matplotlib.pyplot as plt
+import numpy as np
+import os
+import tempfile
+import timeit
+from ccpi.filters.regularisers import FGP_TV, result_cache
+
+filename = os.path.join( "data" ,"lena_gray_512.tif")
+
+# read image
+Im = plt.imread(filename)
+Im = np.asarray(Im, dtype='float32')
+Im = Im/255
+perc = 0.05
+u0 = Im + np.random.normal(loc = 0 , scale = perc * Im , size = np.shape(Im))
+u0 = u0.astype('float32')
+
+lambdas = (0.01, 0.02, 0.04, 0.08)
+with tempfile.TemporaryDirectory() as spill:
+    result_cache(2*u0.nbytes + 1024, spill=spill)
+    for sweep in ('first', 'repeated'):
+        start_time = timeit.default_timer()
+        outputs = [FGP_TV(u0, regularisation_parameter, 300, 0.0, 0, 0, 'cpu')[0]
+                   for regularisation_parameter in lambdas]
+        (hits, misses, in_memory, spilled) = result_cache()
+        print ("{} sweep: {:.3f} s, {} hits, {} misses, {:.1f} MB in memory, {:.1f} MB spilled".format(sweep,
+               timeit.default_timer() - start_time, hits, misses, in_memory/2**20, spilled/2**20))
+    result_cache(0)
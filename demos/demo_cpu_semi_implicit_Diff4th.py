@@ -0,0 +1,56 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+Semi-implicit scheme of the fourth-order diffusion (Diff4th) CPU regulariser: the
+biharmonic term is taken implicitly with banded solves along every axis, so time steps
+orders of magnitude above the stability limit of the explicit scheme can be used. The
+explicit run of the CPU demo sets the quality (RMSE to the clean image), the time the
+semi-implicit scheme needs to reach it is reported for a few time steps
+
+Run from the demos folder, the Lena image is used
+"""
+
+import matplotlib.pyplot as plt
+import numpy as np
+import os
+import timeit
+from ccpi.filters.regularisers import Diff4th
+
+filename = os.path.join( "data" ,"lena_gray_512.tif")
+
+# read image
+Im = plt.imread(filename)
+Im = np.asarray(Im, dtype='float32')
+Im = Im/255
+perc = 0.05
+u0 = Im + np.random.normal(loc = 0 , scale = perc * Im , size = np.shape(Im))
+u0 = u0.astype('float32')
+
+pars = {'regularisation_parameter':0.8,
+        'edge_parameter':0.02,
+        'number_of_iterations' :5500,
+        'time_marching_parameter':0.001,
+        'tolerance_constant':0.0}
+
+def rmse(output):
+    return np.sqrt(np.mean((output - Im)**2))
+
+start_time = timeit.default_timer()
+(output, info) = Diff4th(u0, pars['regularisation_parameter'], pars['edge_parameter'],
+                         pars['number_of_iterations'], pars['time_marching_parameter'],
+                         pars['tolerance_constant'], 'cpu')
+explicit_time = timeit.default_timer() - start_time
+target = rmse(output)
+print ("explicit, tau {}: RMSE {:.4f} after {} iterations in {:.3f} s".format(pars['time_marching_parameter'],
+       target, pars['number_of_iterations'], explicit_time))
+
+for tau in (0.01, 0.1, 0.5):
+    for iterations in (5, 10, 20, 50, 100, 200, 500, 1000):
+        start_time = timeit.default_timer()
+        (output, info) = Diff4th(u0, pars['regularisation_parameter'], pars['edge_parameter'],
+                                 iterations, tau, pars['tolerance_constant'], 'cpu', semi_implicit=True)
+        semi_time = timeit.default_timer() - start_time
+        if rmse(output) <= 1.01*target:
+            break
+    print ("semi-implicit, tau {}: RMSE {:.4f} after {} iterations in {:.3f} s ({:.1f}x faster)".format(tau,
+           rmse(output), iterations, semi_time, explicit_time/semi_time))
@@ -0,0 +1,53 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+Benchmark of 3D CPU regularisers with and without non-temporal (streaming) stores
+for the write-once arrays: the copies into Output_prev and P_prev, the initial
+output, the ROF differences D1/D2/D3 and the first touch of the work arrays
+
+Run from the demos folder, the volume is built from the Lena image
+"""
+
+import matplotlib.pyplot as plt
+import numpy as np
+import os
+import timeit
+from ccpi.filters.regularisers import ROF_TV, FGP_TV, streaming_stores
+
+filename = os.path.join( "data" ,"lena_gray_512.tif")
+
+# read image
+Im = plt.imread(filename)
+Im = np.asarray(Im, dtype='float32')
+Im = Im/255
+perc = 0.05
+(N,M) = np.shape(Im)
+
+slices = 64
+noisyVol = np.zeros((slices,N,M),dtype='float32')
+for i in range (slices):
+    noisyVol[i,:,:] = Im + np.random.normal(loc = 0 , scale = perc * Im , size = np.shape(Im))
+default = streaming_stores()
+print ("Volume of {} bytes, streaming stores by default from {} bytes".format(noisyVol.nbytes, default))
+
+# a small tolerance keeps the Output_prev copies in the loop
+iterations = 50
+tolerance = 1e-8
+methods = (('ROF-TV', lambda: ROF_TV(noisyVol, 0.02, iterations, 0.001, tolerance, 'cpu')),
+           ('ROF-TV bricked', lambda: ROF_TV(noisyVol, 0.02, iterations, 0.001, tolerance, 'cpu', layout=2)),
+           ('FGP-TV', lambda: FGP_TV(noisyVol, 0.02, iterations, tolerance, 0, 0, 'cpu')))
+
+repeats = 3
+for name, method in methods:
+    print ("#############{} CPU####################".format(name))
+    # every volume-sized array streamed against none
+    for threshold in (0, noisyVol.nbytes):
+        streaming_stores(threshold)
+        times = []
+        for r in range(repeats):
+            start_time = timeit.default_timer()
+            method()
+            times.append(timeit.default_timer() - start_time)
+        print ("streaming stores {}: best {:.3f} s, mean {:.3f} s".format(
+            'on ' if threshold else 'off', min(times), np.mean(times)))
+streaming_stores(-1)
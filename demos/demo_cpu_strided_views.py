@@ -0,0 +1,48 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+Regularisation of a region of a larger array on the CPU: the input is a view of a
+sub-volume and the output a view of a padded buffer (or the input itself), which the
+cores read and write without contiguous copies, compared with copying the region out
+and back
+
+Run from the demos folder, the Lena image is used
+"""
+
+import matplotlib.pyplot as plt
+import numpy as np
+import os
+import timeit
+from ccpi.filters.regularisers import ROF_TV, FGP_TV, peak_memory
+
+filename = os.path.join( "data" ,"lena_gray_512.tif")
+
+# read image
+Im = plt.imread(filename)
+Im = np.asarray(Im, dtype='float32')
+Im = Im/255
+vol = np.stack([Im]*16) + np.random.normal(loc = 0 , scale = 0.05 , size = (16,) + np.shape(Im))
+vol = vol.astype('float32')
+region = (slice(2, 14), slice(64, 448), slice(64, 448))
+
+start_time = timeit.default_timer()
+result = vol.copy()
+(output, info) = FGP_TV(np.ascontiguousarray(vol[region]), 0.04, 100, 0.0, 0, 0, 'cpu')
+result[region] = output
+print ("copied out and back: {:.3f} s, {} MB".format(timeit.default_timer() - start_time,
+    peak_memory('FGP_TV', output.shape) >> 20))
+
+start_time = timeit.default_timer()
+inplace = vol.copy()
+FGP_TV(inplace[region], 0.04, 100, 0.0, 0, 0, 'cpu', out=inplace[region])
+print ("views, in place: {:.3f} s, {} MB, same result {}".format(timeit.default_timer() - start_time,
+    peak_memory('FGP_TV', output.shape, views=(True, True)) >> 20, np.array_equal(inplace, result)))
+
+# the padded buffer of a transform, regularised region by region
+padded = np.zeros((16,) + tuple(n + 128 for n in np.shape(Im)), dtype='float32')
+padded[:, 64:-64, 64:-64] = vol
+start_time = timeit.default_timer()
+for k in range(0, 16, 4):
+    view = padded[k:k+4, 64:-64, 64:-64]
+    ROF_TV(view, 0.04, 100, 0.0025, 0.0, 'cpu', out=view)
+print ("padded buffer in 4 blocks: {:.3f} s".format(timeit.default_timer() - start_time))
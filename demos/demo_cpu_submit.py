@@ -0,0 +1,58 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+Non-blocking CPU regularisers: submit starts a regulariser in the background and returns a
+future at once, the caller keeps running (the core releases the GIL) and polls the progress
+(iterations done, last relative change) as a front-end would. A second, long run is
+stopped part way (stop()) and the time it takes to stop is printed
+
+Run from the demos folder, the Lena image is used
+"""
+
+import matplotlib.pyplot as plt
+import numpy as np
+import os
+import timeit
+import concurrent.futures
+from ccpi.filters.regularisers import FGP_TV, TGV, submit
+
+filename = os.path.join( "data" ,"lena_gray_512.tif")
+
+# read image
+Im = plt.imread(filename)
+Im = np.asarray(Im, dtype='float32')
+Im = Im/255
+perc = 0.05
+u0 = Im + np.random.normal(loc = 0 , scale = perc * Im , size = np.shape(Im))
+u0 = u0.astype('float32')
+
+pars = {'regularisation_parameter':0.02,
+        'number_of_iterations' :1000,
+        'tolerance_constant':1e-06,
+        'methodTV': 0 ,
+        'nonneg': 0}
+
+start_time = timeit.default_timer()
+future = submit(FGP_TV, u0, pars['regularisation_parameter'], pars['number_of_iterations'],
+                pars['tolerance_constant'], pars['methodTV'], pars['nonneg'], 'cpu')
+polls = 0
+while not future.done():
+    (iterations, residual) = future.progress()
+    print ("\rFGP-TV: {:4d}/{} iterations, relative change {:.2e}".format(iterations,
+           pars['number_of_iterations'], residual), end='')
+    polls += 1
+    concurrent.futures.wait([future], timeout=0.05)
+(output, info) = future.result()
+print ("\nFGP-TV: {} iterations in {:.3f} s, {} progress polls while it ran".format(int(info[0]),
+       timeit.default_timer() - start_time, polls))
+
+future = submit(TGV, u0, 0.02, 1.0, 2.0, 100000, 12, 0.0, 'cpu')
+while future.progress()[0] < 100:
+    concurrent.futures.wait([future], timeout=0.01)
+start_time = timeit.default_timer()
+future.stop()
+try:
+    future.result()
+except concurrent.futures.CancelledError:
+    print ("TGV stopped after {} iterations, in {:.4f} s".format(future.progress()[0],
+           timeit.default_timer() - start_time))
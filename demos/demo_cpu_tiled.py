@@ -0,0 +1,43 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+Tiled 2D regularisation on the CPU: a large image (the Lena image repeated) is
+processed on cache-sized tiles with halo exchanges every few iterations, compared
+with the untiled solvers for the exact (accuracy 1) and narrower halos
+
+Run from the demos folder, the Lena image is used
+"""
+
+import matplotlib.pyplot as plt
+import numpy as np
+import os
+import timeit
+from ccpi.filters.regularisers import ROF_TV, FGP_TV, NDF, Diff4th, peak_memory
+
+filename = os.path.join( "data" ,"lena_gray_512.tif")
+
+# read image
+Im = plt.imread(filename)
+Im = np.asarray(Im, dtype='float32')
+Im = Im/255
+Im = np.tile(Im, (4, 4))
+u0 = Im + np.random.normal(loc = 0 , scale = 0.05 , size = np.shape(Im))
+u0 = u0.astype('float32')
+
+runs = {'ROF_TV': lambda **kw: ROF_TV(u0, 0.04, 200, 0.0025, 0.0, 'cpu', **kw),
+        'FGP_TV': lambda **kw: FGP_TV(u0, 0.04, 100, 0.0, 0, 0, 'cpu', **kw),
+        'NDF': lambda **kw: NDF(u0, 0.02, 0.015, 100, 0.01, 1, 0.0, 'cpu', **kw),
+        'Diff4th': lambda **kw: Diff4th(u0, 0.8, 0.02, 100, 0.001, 0.0, 'cpu', **kw)}
+
+for method, run in runs.items():
+    start_time = timeit.default_timer()
+    (ref, info) = run()
+    print ("{} untiled: {:.3f} s, {} MB".format(method, timeit.default_timer() - start_time,
+        peak_memory(method, u0.shape) >> 20))
+    for accuracy in (1.0, 0.5):
+        start_time = timeit.default_timer()
+        (output, info) = run(tile=256, tile_sync=8, tile_accuracy=accuracy)
+        print ("   tiled, accuracy {}: {:.3f} s, {} MB, max difference {:.2e}".format(accuracy,
+            timeit.default_timer() - start_time,
+            peak_memory(method, u0.shape, tile=256, tile_sync=8, tile_accuracy=accuracy) >> 20,
+            np.abs(output - ref).max()))
@@ -21,17 +21,21 @@
 #include "utils.h"
 
 #define EPS 1.0e-7
+#define MIN(x, y) (((x) < (y)) ? (x) : (y))
 
 /* C-OMP implementation of fourth-order diffusion scheme [1] for piecewise-smooth recovery (2D/3D case)
- * The minimisation is performed using explicit scheme.
+ * The minimisation is performed using explicit or semi-implicit scheme.
  *
  * Input Parameters:
  * 1. Noisy image/volume
  * 2. lambda - regularization parameter
  * 3. Edge-preserving parameter (sigma)
  * 4. Number of iterations, for explicit scheme >= 150 is recommended
- * 5. tau - time-marching step for the explicit scheme
+ * 5. tau - time-marching step
  * 6. eplsilon: tolerance constant
+ * 7. scheme: explicit (0) or semi-implicit (1), see Diffus4th_order_core.h
+ * 8. layout: storage of the 3D volume during the iterations, planar (0) or 8x8x8 bricks (2),
+ *    the semi-implicit scheme runs planar
  *
  * Output:
  * [1] Regularized image/volume
@@ -41,62 +45,174 @@
  * [1] Hajiaboli, M.R., 2011. An anisotropic fourth-order diffusion filter for image noise removal. International Journal of Computer Vision, 92(2), pp.177-191.
  */
 
-float Diffus4th_CPU_main(float *Input, float *Output, float *infovector, float lambdaPar, float sigmaPar, int iterationsNumb, float tau, float epsil, int dimX, int dimY, int dimZ)
+static float Diffus4th_CPU_run(float *Input, long inPitchY, long inPitchZ, float *Output, long outPitchY, long outPitchZ, float *infovector, float lambdaPar, float sigmaPar, int iterationsNumb, float tau, float epsil, int scheme, int layout, int dimX, int dimY, int dimZ)
 {
-    int i,DimTotal,j,count;
-    float sigmaPar2, re, re1;
+    int i,DimTotal,j,count,bricked,semi;
+    float sigmaPar2, re = 0.0f, re1;
     re = 0.0f; re1 = 0.0f;
     count = 0;
-    float *W_Lapl=NULL, *Output_prev=NULL;
+    float *W_Lapl=NULL, *Output_prev=NULL, *U=NULL, *A=NULL, *F=NULL;
     sigmaPar2 = sigmaPar*sigmaPar;
     DimTotal =  dimX*dimY*dimZ;
+    semi = (scheme == DIFF4TH_SEMI_IMPLICIT);
+    bricked = ((dimZ > 1) && (layout == LAYOUT_BRICKED) && !semi);
+    if (bricked) DimTotal = (int)Bricked_size((long)(dimX), (long)(dimY), (long)(dimZ));
     
-    W_Lapl = calloc(DimTotal, sizeof(float));
+    W_Lapl = Vol_calloc(DimTotal);
     
-    if (epsil != 0.0f) Output_prev = calloc(DimTotal, sizeof(float));
+    /* the semi-implicit step keeps the previous iterate, which the tolerance check then uses */
+    if ((epsil != 0.0f) || semi) Output_prev = Vol_calloc(DimTotal);
+    if (semi) {
+        F = (float*) malloc(5*(dimX + dimY + dimZ)*sizeof(float));
+        Biharm_factor(tau, lambdaPar, (dimZ > 1) ? 3 : 2, F, (long)(dimX), (long)(dimY), (long)(dimZ));
+    }
     
-    /* copy into output */
-    copyIm(Input, Output, (long)(dimX), (long)(dimY), (long)(dimZ));
+    if (bricked) {
+        /* the input and the initial output are bricked in one sweep */
+        A = Vol_calloc(DimTotal);
+        U = Vol_calloc(DimTotal);
+        Planar_to_bricked(Input, A, U, (long)(dimX), (long)(dimY), (long)(dimZ));
+    }
+    else if (STRIDED_DENSE(inPitchY, inPitchZ, dimX, dimY, dimZ) && STRIDED_DENSE(outPitchY, outPitchZ, dimX, dimY, dimZ) && (Input != Output)) {
+        /* copy into output */
+        copyIm(Input, Output, (long)(dimX), (long)(dimY), (long)(dimZ));
+        A = Input; U = Output;
+    }
+    else {
+        /* strided views or in place, the input and the initial output are gathered in one sweep (Strided_to_planar) */
+        A = (STRIDED_DENSE(inPitchY, inPitchZ, dimX, dimY, dimZ) && (Input != Output)) ? Input : (float*)calloc(DimTotal, sizeof(float));
+        U = STRIDED_DENSE(outPitchY, outPitchZ, dimX, dimY, dimZ) ? Output : (float*)calloc(DimTotal, sizeof(float));
+        Strided_to_planar(Input, inPitchY, inPitchZ, (A != Input) ? A : NULL, U, (long)(dimX), (long)(dimY), (long)(dimZ));
+    }
     
     for(i=0; i < iterationsNumb; i++) {
-        if ((epsil != 0.0f) && (i % 5 == 0)) copyIm(Output, Output_prev, (long)(dimX), (long)(dimY), (long)(dimZ));
+        if (((epsil != 0.0f) && (i % 5 == 0)) || semi) copyIm(U, Output_prev, (long)(DimTotal), 1l, 1l);
         
         if (dimZ == 1) {
             /* running 2D diffusion iterations */
             /* Calculating weighted Laplacian */
-            Weighted_Laplc2D(W_Lapl, Output, sigmaPar2, dimX, dimY);
+            Weighted_Laplc2D(W_Lapl, U, sigmaPar2, dimX, dimY);
             /* Perform iteration step */
-            Diffusion_update_step2D(Output, Input, W_Lapl, lambdaPar, sigmaPar2, tau, (long)(dimX), (long)(dimY));
+            Diffusion_update_step2D(U, A, W_Lapl, lambdaPar, sigmaPar2, tau, (long)(dimX), (long)(dimY));
+        }
+        else if (bricked) {
+            /* running 3D diffusion iterations on bricks */
+            Weighted_Laplc3D_br(W_Lapl, U, sigmaPar2, dimX, dimY, dimZ);
+            /* the last iteration also writes the planar output */
+            Diffusion_update_step3D_br(U, A, (i == iterationsNumb-1) ? Output : NULL, W_Lapl, lambdaPar, sigmaPar2, tau, (long)(dimX), (long)(dimY), (long)(dimZ));
         }
         else {
             /* running 3D diffusion iterations */
             /* Calculating weighted Laplacian */
-            Weighted_Laplc3D(W_Lapl, Output, sigmaPar2, dimX, dimY, dimZ);
+            Weighted_Laplc3D(W_Lapl, U, sigmaPar2, dimX, dimY, dimZ);
             /* Perform iteration step */
-            Diffusion_update_step3D(Output, Input, W_Lapl, lambdaPar, sigmaPar2, tau, (long)(dimX), (long)(dimY), (long)(dimZ));
+            Diffusion_update_step3D(U, A, W_Lapl, lambdaPar, sigmaPar2, tau, (long)(dimX), (long)(dimY), (long)(dimZ));
         }
+        /* the explicit increment through the implicit biharmonic operator */
+        if (semi) Biharm_step(U, Output_prev, F, tau, (long)(dimX), (long)(dimY), (long)(dimZ));
         
         /* check early stopping criteria */
         if ((epsil != 0.0f) && (i % 5 == 0)) {
             re = 0.0f; re1 = 0.0f;
             for(j=0; j<DimTotal; j++)
             {
-                re += powf(Output[j] - Output_prev[j],2);
-                re1 += powf(Output[j],2);
+                re += POW2(U[j] - Output_prev[j]);
+                re1 += POW2(U[j]);
             }
             re = sqrtf(re)/sqrtf(re1);
             if (re < epsil)  count++;
             if (count > 3) break;
         }
+        if (Progress_step(i+1, re)) break;
     }
-    free(W_Lapl);
+    if (bricked) {
+        /* the planar output is still to be written if the iterations stopped earlier */
+        if ((iterationsNumb == 0) || (i < iterationsNumb)) Bricked_to_planar(U, Output, (long)(dimX), (long)(dimY), (long)(dimZ));
+        Vol_free(A); Vol_free(U);
+    }
+    else {
+        if (U != Output) {
+            Planar_to_strided(U, Output, outPitchY, outPitchZ, (long)(dimX), (long)(dimY), (long)(dimZ));
+            free(U);
+        }
+        if (A != Input) free(A);
+    }
+    Vol_free(W_Lapl);
     
-    if (epsil != 0.0f) free(Output_prev);
+    if (Output_prev != NULL) Vol_free(Output_prev);
+    if (F != NULL) free(F);
     /*adding info into info_vector */
     infovector[0] = (float)(i);  /*iterations number (if stopped earlier based on tolerance)*/
     infovector[1] = re;  /* reached tolerance */
     return 0;
 }
+
+float Diffus4th_CPU_main(float *Input, float *Output, float *infovector, float lambdaPar, float sigmaPar, int iterationsNumb, float tau, float epsil, int scheme, int layout, int dimX, int dimY, int dimZ)
+{
+    return Diffus4th_CPU_run(Input, (long)(dimX), (long)(dimX)*dimY, Output, (long)(dimX), (long)(dimX)*dimY, infovector, lambdaPar, sigmaPar, iterationsNumb, tau, epsil, scheme, layout, dimX, dimY, dimZ);
+}
+
+float Diffus4th_CPU_strided(float *Input, long inPitchY, long inPitchZ, float *Output, long outPitchY, long outPitchZ, float *infovector, float lambdaPar, float sigmaPar, int iterationsNumb, float tau, float epsil, int scheme, int dimX, int dimY, int dimZ)
+{
+    return Diffus4th_CPU_run(Input, inPitchY, inPitchZ, Output, outPitchY, outPitchZ, infovector, lambdaPar, sigmaPar, iterationsNumb, tau, epsil, scheme, LAYOUT_PLANAR, dimX, dimY, dimZ);
+}
+
+/* Peak size in bytes of the work arrays allocated by Diffus4th_CPU_main */
+long Diffus4th_CPU_mem(float epsil, int scheme, int layout, int dimX, int dimY, int dimZ)
+{
+    long DimTotal;
+    if (scheme == DIFF4TH_SEMI_IMPLICIT) {
+        /* W_Lapl, the previous iterate and the factors of the banded solves */
+        DimTotal = (long)(dimX)*(long)(dimY)*(long)(dimZ);
+        return (2l*DimTotal + 5l*(dimX + dimY + dimZ))*sizeof(float);
+    }
+    if ((dimZ > 1) && (layout == LAYOUT_BRICKED)) {
+        /* W_Lapl and the bricked input and output */
+        DimTotal = Bricked_size((long)(dimX), (long)(dimY), (long)(dimZ));
+        return (3l + (epsil != 0.0f))*DimTotal*sizeof(float);
+    }
+    DimTotal = (long)(dimX)*(long)(dimY)*(long)(dimZ);
+    return (1l + (epsil != 0.0f))*DimTotal*sizeof(float);
+}
+
+/* Peak size in bytes of the work arrays allocated by Diffus4th_CPU_strided: the planar copies of
+ * the strided (or in place) input and output */
+long Diffus4th_CPU_strided_mem(float epsil, int scheme, int in_strided, int out_strided, int dimX, int dimY, int dimZ)
+{
+    return Diffus4th_CPU_mem(epsil, scheme, LAYOUT_PLANAR, dimX, dimY, dimZ) + (long)(in_strided + out_strided)*dimX*dimY*dimZ*sizeof(float);
+}
+/* the iterations of a tile, the state is the output and W_Lapl a tile work array; an
+ * iteration reaches two pixels */
+typedef struct {
+    float lambda, sigma2, tau;
+} diff4th_tile_args;
+
+static void Diffus4th_tile(void *arg, float *A, float **S, float **W, long nx, long ny, int it0, int iterations)
+{
+    diff4th_tile_args *p = (diff4th_tile_args*)arg;
+    int i;
+    for(i=0; i<iterations; i++) {
+        Weighted_Laplc2D(W[0], S[0], p->sigma2, nx, ny);
+        Diffusion_update_step2D(S[0], A, W[0], p->lambda, p->sigma2, p->tau, nx, ny);
+    }
+}
+
+float Diffus4th_CPU_tiled(float *Input, float *Output, float *infovector, float lambdaPar, float sigmaPar, int iterationsNumb, float tau, int tile, int sync, float accuracy, int dimX, int dimY)
+{
+    diff4th_tile_args p;
+    p.lambda = lambdaPar; p.sigma2 = sigmaPar*sigmaPar; p.tau = tau;
+    copyIm(Input, Output, (long)(dimX), (long)(dimY), 1l);
+    Tile_run(Diffus4th_tile, &p, 1, 1, 2, Input, &Output, iterationsNumb, tile, sync, accuracy, (long)(dimX), (long)(dimY));
+    infovector[0] = (float)(iterationsNumb);
+    infovector[1] = 0.0f;
+    return 0;
+}
+
+/* Peak size in bytes of the work arrays allocated by Diffus4th_CPU_tiled */
+long Diffus4th_CPU_tiled_mem(int tile, int sync, float accuracy, int dimX, int dimY)
+{
+    return Tile_mem(1, 1, 2, tile, sync, accuracy, (long)(dimX), (long)(dimY));
+}
 /********************************************************************/
 /***************************2D Functions*****************************/
 /********************************************************************/
@@ -117,10 +233,10 @@ float Weighted_Laplc2D(float *W_Lapl, float *U0, float sigma, long dimX, long di
             index = j*dimX+i;
             
             gradX = 0.5f*(U0[j*dimX+i2] - U0[j*dimX+i1]);
-            gradX_sq = pow(gradX,2);
+            gradX_sq = POW2(gradX);
             
             gradY = 0.5f*(U0[j2*dimX+i] - U0[j1*dimX+i]);
-            gradY_sq = pow(gradY,2);
+            gradY_sq = POW2(gradY);
             
             gradXX = U0[j*dimX+i2] + U0[j*dimX+i1] - 2*U0[index];
             gradYY = U0[j2*dimX+i] + U0[j1*dimX+i] - 2*U0[index];
@@ -195,13 +311,13 @@ float Weighted_Laplc3D(float *W_Lapl, float *U0, float sigma, long dimX, long di
                 index = (dimX*dimY)*k + j*dimX+i;
                 
                 gradX = 0.5f*(U0[(dimX*dimY)*k + j*dimX+i2] - U0[(dimX*dimY)*k + j*dimX+i1]);
-                gradX_sq = pow(gradX,2);
+                gradX_sq = POW2(gradX);
                 
                 gradY = 0.5f*(U0[(dimX*dimY)*k + j2*dimX+i] - U0[(dimX*dimY)*k + j1*dimX+i]);
-                gradY_sq = pow(gradY,2);
+                gradY_sq = POW2(gradY);
                 
                 gradZ = 0.5f*(U0[(dimX*dimY)*k2 + j*dimX+i] - U0[(dimX*dimY)*k1 + j*dimX+i]);
-                gradZ_sq = pow(gradZ,2);
+                gradZ_sq = POW2(gradZ);
                 
                 gradXX = U0[(dimX*dimY)*k + j*dimX+i2] + U0[(dimX*dimY)*k + j*dimX+i1] - 2*U0[index];
                 gradYY = U0[(dimX*dimY)*k + j2*dimX+i] + U0[(dimX*dimY)*k + j1*dimX+i] - 2*U0[index];
@@ -263,3 +379,219 @@ float Diffusion_update_step3D(float *Output, float *Input, float *W_Lapl, float
             }}}
     return *Output;
 }
+/********************************************************************/
+/**************3D Functions for the bricked layout*******************/
+/********************************************************************/
+/* the kernels run brick by brick, neighbours are addressed with BIDX (see utils.h) */
+float Weighted_Laplc3D_br(float *W_Lapl, float *U0, float sigma, long dimX, long dimY, long dimZ)
+{
+    long b,i,j,k,i0,j0,k0,i1,i2,j1,j2,k1,k2,index,nbX,nbY,nbZ;
+    float gradX, gradX_sq, gradY, gradY_sq, gradXX, gradYY, gradXY, xy_2, denom, V_norm, V_orth, c, c_sq, gradZ, gradZ_sq, gradZZ, gradXZ, gradYZ, xyz_1, xyz_2;
+    nbX = (dimX+BRICK-1)/BRICK; nbY = (dimY+BRICK-1)/BRICK; nbZ = (dimZ+BRICK-1)/BRICK;
+    
+#pragma omp parallel for shared(W_Lapl) private(b,i,j,k,i0,j0,k0,i1,i2,j1,j2,k1,k2,index,gradX, gradX_sq, gradY, gradY_sq, gradXX, gradYY, gradXY, xy_2, denom, V_norm, V_orth, c, c_sq, gradZ, gradZ_sq, gradZZ, gradXZ, gradYZ, xyz_1, xyz_2)
+    for(b=0; b<nbX*nbY*nbZ; b++) {
+        i0 = (b % nbX)*BRICK; j0 = ((b/nbX) % nbY)*BRICK; k0 = (b/(nbX*nbY))*BRICK;
+        for(k=k0; k<MIN(k0+BRICK,dimZ); k++) {
+            /* symmetric boundary conditions */
+            k1 = k+1; if (k1 == dimZ) k1 = k-1;
+            k2 = k-1; if (k2 < 0) k2 = k+1;
+            for(j=j0; j<MIN(j0+BRICK,dimY); j++) {
+                /* symmetric boundary conditions */
+                j1 = j+1; if (j1 == dimY) j1 = j-1;
+                j2 = j-1; if (j2 < 0) j2 = j+1;
+                for(i=i0; i<MIN(i0+BRICK,dimX); i++) {
+                    /* symmetric boundary conditions */
+                    i1 = i+1; if (i1 == dimX) i1 = i-1;
+                    i2 = i-1; if (i2 < 0) i2 = i+1;
+                    
+                    index = BIDX(i,j,k,nbX,nbY);
+                    
+                    gradX = 0.5f*(U0[BIDX(i2,j,k,nbX,nbY)] - U0[BIDX(i1,j,k,nbX,nbY)]);
+                    gradX_sq = POW2(gradX);
+                    
+                    gradY = 0.5f*(U0[BIDX(i,j2,k,nbX,nbY)] - U0[BIDX(i,j1,k,nbX,nbY)]);
+                    gradY_sq = POW2(gradY);
+                    
+                    gradZ = 0.5f*(U0[BIDX(i,j,k2,nbX,nbY)] - U0[BIDX(i,j,k1,nbX,nbY)]);
+                    gradZ_sq = POW2(gradZ);
+                    
+                    gradXX = U0[BIDX(i2,j,k,nbX,nbY)] + U0[BIDX(i1,j,k,nbX,nbY)] - 2*U0[index];
+                    gradYY = U0[BIDX(i,j2,k,nbX,nbY)] + U0[BIDX(i,j1,k,nbX,nbY)] - 2*U0[index];
+                    gradZZ = U0[BIDX(i,j,k2,nbX,nbY)] + U0[BIDX(i,j,k1,nbX,nbY)] - 2*U0[index];
+                    
+                    gradXY = 0.25f*(U0[BIDX(i2,j2,k,nbX,nbY)] + U0[BIDX(i1,j1,k,nbX,nbY)] - U0[BIDX(i2,j1,k,nbX,nbY)] - U0[BIDX(i1,j2,k,nbX,nbY)]);
+                    gradXZ = 0.25f*(U0[BIDX(i2,j,k2,nbX,nbY)] - U0[BIDX(i1,j,k2,nbX,nbY)] - U0[BIDX(i2,j,k1,nbX,nbY)] + U0[BIDX(i1,j,k1,nbX,nbY)]);
+                    gradYZ = 0.25f*(U0[BIDX(i,j2,k2,nbX,nbY)] - U0[BIDX(i,j1,k2,nbX,nbY)] - U0[BIDX(i,j2,k1,nbX,nbY)] + U0[BIDX(i,j1,k1,nbX,nbY)]);
+                    
+                    xy_2  = 2.0f*gradX*gradY*gradXY;
+                    xyz_1 = 2.0f*gradX*gradZ*gradXZ;
+                    xyz_2 = 2.0f*gradY*gradZ*gradYZ;
+                    
+                    denom =  gradX_sq + gradY_sq + gradZ_sq;
+                    
+                    if (denom <= EPS) {
+                        V_norm = (gradXX*gradX_sq + gradYY*gradY_sq + gradZZ*gradZ_sq + xy_2 + xyz_1 + xyz_2)/EPS;
+                        V_orth = ((gradY_sq + gradZ_sq)*gradXX + (gradX_sq + gradZ_sq)*gradYY + (gradX_sq + gradY_sq)*gradZZ - xy_2 - xyz_1 - xyz_2)/EPS;
+                    }
+                    else  {
+                        V_norm = (gradXX*gradX_sq + gradYY*gradY_sq + gradZZ*gradZ_sq + xy_2 + xyz_1 + xyz_2)/denom;
+                        V_orth = ((gradY_sq + gradZ_sq)*gradXX + (gradX_sq + gradZ_sq)*gradYY + (gradX_sq + gradY_sq)*gradZZ - xy_2 - xyz_1 - xyz_2)/denom;
+                    }
+                    
+                    c = 1.0f/(1.0f + denom/sigma);
+                    c_sq = c*c;
+                    
+                    W_Lapl[index] = c_sq*V_norm + c*V_orth;
+                }}}}
+    return *W_Lapl;
+}
+
+/* if Out is not NULL the updated volume is also stored in planar order */
+float Diffusion_update_step3D_br(float *Output, float *Input, float *Out, float *W_Lapl, float lambdaPar, float sigmaPar2, float tau, long dimX, long dimY, long dimZ)
+{
+    long b,i,j,k,i0,j0,k0,i1,i2,j1,j2,k1,k2,index,nbX,nbY,nbZ;
+    float gradXXc, gradYYc, gradZZc;
+    nbX = (dimX+BRICK-1)/BRICK; nbY = (dimY+BRICK-1)/BRICK; nbZ = (dimZ+BRICK-1)/BRICK;
+    
+#pragma omp parallel for shared(Output, Input, Out, W_Lapl) private(b,i,j,k,i0,j0,k0,i1,i2,j1,j2,k1,k2,index,gradXXc,gradYYc,gradZZc)
+    for(b=0; b<nbX*nbY*nbZ; b++) {
+        i0 = (b % nbX)*BRICK; j0 = ((b/nbX) % nbY)*BRICK; k0 = (b/(nbX*nbY))*BRICK;
+        for(k=k0; k<MIN(k0+BRICK,dimZ); k++) {
+            /* symmetric boundary conditions */
+            k1 = k+1; if (k1 == dimZ) k1 = k-1;
+            k2 = k-1; if (k2 < 0) k2 = k+1;
+            for(j=j0; j<MIN(j0+BRICK,dimY); j++) {
+                /* symmetric boundary conditions */
+                j1 = j+1; if (j1 == dimY) j1 = j-1;
+                j2 = j-1; if (j2 < 0) j2 = j+1;
+                for(i=i0; i<MIN(i0+BRICK,dimX); i++) {
+                    /* symmetric boundary conditions */
+                    i1 = i+1; if (i1 == dimX) i1 = i-1;
+                    i2 = i-1; if (i2 < 0) i2 = i+1;
+                    
+                    index = BIDX(i,j,k,nbX,nbY);
+                    
+                    gradXXc = W_Lapl[BIDX(i2,j,k,nbX,nbY)] + W_Lapl[BIDX(i1,j,k,nbX,nbY)] - 2*W_Lapl[index];
+                    gradYYc = W_Lapl[BIDX(i,j2,k,nbX,nbY)] + W_Lapl[BIDX(i,j1,k,nbX,nbY)] - 2*W_Lapl[index];
+                    gradZZc = W_Lapl[BIDX(i,j,k2,nbX,nbY)] + W_Lapl[BIDX(i,j,k1,nbX,nbY)] - 2*W_Lapl[index];
+                    
+                    Output[index] += tau*(-lambdaPar*(gradXXc + gradYYc + gradZZc) - (Output[index] - Input[index]));
+                    if (Out != NULL) Out[(dimX*dimY)*k + j*dimX+i] = Output[index];
+                }}}}
+    return *Output;
+}
+/********************************************************************/
+/*********************Semi-implicit scheme***************************/
+/********************************************************************/
+/* The second difference D along an axis with the symmetric boundary conditions of the kernels
+ * above is tridiagonal, D^2 pentadiagonal. The step is
+ *
+ *     U = U_old + M^-1 (U_explicit - U_old)/(1 + tau),  M = (I + a*Dx^2)(I + a*Dy^2)(I + a*Dz^2)
+ *
+ * with a = ndims*tau*lambda/4, it has the fixed points of the explicit scheme. The linearised
+ * term lambda*Laplacian^2 is bounded by ndims*lambda*(Dx^2 + Dy^2 (+ Dz^2)); a is half of what
+ * the sum of the axis terms of M alone needs for stability, the mixed terms a^2*Dx^2*Dy^2 of the
+ * product make up for it at the high frequencies, and the edge weights of the weighted
+ * Laplacian (below 1) slow the diffusion further. M is applied as banded solves along every
+ * axis. */
+
+/* sub- and superdiagonal of D in row i (the diagonal is -2) */
+static double Biharm_sub(long i, long n) {return (i <= 0 || i >= n) ? 0.0 : ((i == n-1) ? 2.0 : 1.0);}
+static double Biharm_sup(long i, long n) {return (i < 0 || i >= n-1) ? 0.0 : ((i == 0) ? 2.0 : 1.0);}
+
+/* LU factors (no pivoting, I + a*D^2 is similar to a symmetric positive definite matrix) of
+ * I + a*D^2 of length n: F holds the two subdiagonals of L, the inverted diagonal of U and its
+ * two superdiagonals, n floats each */
+static void Biharm_factor_axis(float a, long n, float *F)
+{
+    long i;
+    double e, c, d, b, g, l1, l2;
+    double d_1 = 1.0, d_2 = 1.0, u1_1 = 0.0, u1_2 = 0.0, u2_1 = 0.0, u2_2 = 0.0;
+    float *L2 = F, *L1 = F + n, *Dinv = F + 2*n, *U1 = F + 3*n, *U2 = F + 4*n;
+    for(i=0; i<n; i++) {
+        /* row i of I + a*D^2 */
+        e = a*Biharm_sub(i, n)*Biharm_sub(i-1, n);
+        c = -4.0*a*Biharm_sub(i, n);
+        d = 1.0 + a*(Biharm_sub(i, n)*Biharm_sup(i-1, n) + ((n > 1) ? 4.0 : 0.0) + Biharm_sup(i, n)*Biharm_sub(i+1, n));
+        b = -4.0*a*Biharm_sup(i, n);
+        g = a*Biharm_sup(i, n)*Biharm_sup(i+1, n);
+        /* row i of L and U */
+        l2 = e/d_2;
+        l1 = (c - l2*u1_2)/d_1;
+        d = d - l2*u2_2 - l1*u1_1;
+        b = b - l1*u2_1;
+        L2[i] = (float)l2; L1[i] = (float)l1; Dinv[i] = (float)(1.0/d); U1[i] = (float)b; U2[i] = (float)g;
+        d_2 = d_1; d_1 = d;
+        u1_2 = u1_1; u1_1 = b;
+        u2_2 = u2_1; u2_1 = g;
+    }
+}
+
+float Biharm_factor(float tau, float lambdaPar, int ndims, float *F, long dimX, long dimY, long dimZ)
+{
+    float a = 0.25f*(float)ndims*tau*lambdaPar;
+    Biharm_factor_axis(a, dimX, F);
+    Biharm_factor_axis(a, dimY, F + 5*dimX);
+    Biharm_factor_axis(a, dimZ, F + 5*(dimX + dimY));
+    return 1;
+}
+
+/* solves along X, a row at a time */
+static void Biharm_solve_X(float *G, float *F, long n, long rows)
+{
+    long r, i;
+    float *L2 = F, *L1 = F + n, *Dinv = F + 2*n, *U1 = F + 3*n, *U2 = F + 4*n, *x;
+#pragma omp parallel for shared(G, F) private(r, i, x)
+    for(r=0; r<rows; r++) {
+        x = G + r*n;
+        for(i=1; i<n; i++) x[i] -= L1[i]*x[i-1] + ((i >= 2) ? L2[i]*x[i-2] : 0.0f);
+        x[n-1] *= Dinv[n-1];
+        if (n >= 2) x[n-2] = (x[n-2] - U1[n-2]*x[n-1])*Dinv[n-2];
+        for(i=n-3; i>=0; i--) x[i] = (x[i] - U1[i]*x[i+1] - U2[i]*x[i+2])*Dinv[i];
+    }
+}
+
+/* solves along Y or Z: the lines are 'stride' floats apart, lanes of 'width' neighbouring lines
+ * run together (whole rows of a slice), 'blocks' groups of lines are 'bstride' floats apart */
+#define BIHARM_LANES 64
+static void Biharm_solve_lines(float *G, float *F, long n, long stride, long width, long blocks, long bstride)
+{
+    long t, chunks, i, l, l0, l1;
+    float *L2 = F, *L1 = F + n, *Dinv = F + 2*n, *U1 = F + 3*n, *U2 = F + 4*n, *x;
+    if (n == 1) return;
+    chunks = (width + BIHARM_LANES - 1)/BIHARM_LANES;
+#pragma omp parallel for shared(G, F) private(t, i, l, l0, l1, x)
+    for(t=0; t<blocks*chunks; t++) {
+        x = G + (t/chunks)*bstride;
+        l0 = (t%chunks)*BIHARM_LANES;
+        l1 = (l0 + BIHARM_LANES < width) ? (l0 + BIHARM_LANES) : width;
+        for(l=l0; l<l1; l++) x[stride + l] -= L1[1]*x[l];
+        for(i=2; i<n; i++) {
+            for(l=l0; l<l1; l++) x[i*stride + l] -= L1[i]*x[(i-1)*stride + l] + L2[i]*x[(i-2)*stride + l];
+        }
+        for(l=l0; l<l1; l++) {
+            x[(n-1)*stride + l] *= Dinv[n-1];
+            x[(n-2)*stride + l] = (x[(n-2)*stride + l] - U1[n-2]*x[(n-1)*stride + l])*Dinv[n-2];
+        }
+        for(i=n-3; i>=0; i--) {
+            for(l=l0; l<l1; l++) x[i*stride + l] = (x[i*stride + l] - U1[i]*x[(i+1)*stride + l] - U2[i]*x[(i+2)*stride + l])*Dinv[i];
+        }
+    }
+}
+
+/* U holds the explicit step from U_old: U = U_old + M^-1 (U - U_old)/(1 + tau) */
+float Biharm_step(float *U, float *U_old, float *F, float tau, long dimX, long dimY, long dimZ)
+{
+    long j, DimTotal;
+    float scale = 1.0f/(1.0f + tau);
+    DimTotal = dimX*dimY*dimZ;
+#pragma omp parallel for shared(U, U_old) private(j)
+    for(j=0; j<DimTotal; j++) U[j] = (U[j] - U_old[j])*scale;
+    Biharm_solve_X(U, F, dimX, dimY*dimZ);
+    Biharm_solve_lines(U, F + 5*dimX, dimY, dimX, dimX, dimZ, dimX*dimY);
+    Biharm_solve_lines(U, F + 5*(dimX + dimY), dimZ, dimX*dimY, dimX*dimY, 1, 0);
+#pragma omp parallel for shared(U, U_old) private(j)
+    for(j=0; j<DimTotal; j++) U[j] += U_old[j];
+    return *U;
+}
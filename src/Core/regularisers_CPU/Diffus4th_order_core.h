@@ -23,18 +23,23 @@ limitations under the License.
 #include <stdio.h>
 #include "omp.h"
 #include "utils.h"
+#include "vec_math.h"
+#include "tile.h"
 #include "CCPiDefines.h"
 
 /* C-OMP implementation of fourth-order diffusion scheme [1] for piecewise-smooth recovery (2D/3D case)
- * The minimisation is performed using explicit scheme.
+ * The minimisation is performed using explicit or semi-implicit scheme.
  *
  * Input Parameters:
  * 1. Noisy image/volume
  * 2. lambda - regularization parameter
  * 3. Edge-preserving parameter (sigma)
  * 4. Number of iterations, for explicit scheme >= 150 is recommended
- * 5. tau - time-marching step for explicit scheme
+ * 5. tau - time-marching step
  * 6. eplsilon: tolerance constant
+ * 7. scheme: explicit (0) or semi-implicit (1)
+ * 8. layout: storage of the 3D volume during the iterations, planar (0) or 8x8x8 bricks (2),
+ *    the semi-implicit scheme runs planar
  *
  * Output:
  * [1] Regularized image/volume
@@ -42,16 +47,44 @@ limitations under the License.
  *
  * This function is based on the paper by
  * [1] Hajiaboli, M.R., 2011. An anisotropic fourth-order diffusion filter for image noise removal. International Journal of Computer Vision, 92(2), pp.177-191.
+ *
+ * The explicit scheme is stable for tau below about 2/(1 + 64*lambda) in 2D (144 in 3D) where
+ * the edge weights do not slow the diffusion: the stability limit of a fourth-order equation
+ * falls with h^4. The semi-implicit scheme takes the explicit step through the inverse of
+ * (I + a*Dx^2)(I + a*Dy^2)(I + a*Dz^2), a = ndims*tau*lambda/4 and D the second difference
+ * along an axis, which bounds the linearised biharmonic term; these are banded (pentadiagonal)
+ * solves along every axis. Time steps orders of magnitude above the explicit limit are stable
+ * (tau ~ 0.1 - 1), the fixed points are those of the explicit scheme.
+ *
+ * Diffus4th_CPU_tiled runs the 2D iterations on cache-sized tiles (tile.h): tile - tile edge,
+ * sync - iterations between halo exchanges, accuracy - 1 for the result of Diffus4th_CPU_main,
+ * smaller for narrower halos (a fixed number of iterations, no tolerance)
+ *
+ * Diffus4th_CPU_strided takes Input and Output as strided views (utils.h), rows pitchY and
+ * slices pitchZ floats apart, which the core gathers and scatters (planar storage); Output
+ * may be Input (in place), other overlaps are not allowed
  */
 
+#define DIFF4TH_EXPLICIT 0
+#define DIFF4TH_SEMI_IMPLICIT 1
+
 #ifdef __cplusplus
 extern "C" {
 #endif
-CCPI_EXPORT float Diffus4th_CPU_main(float *Input, float *Output, float *infovector, float lambdaPar, float sigmaPar, int iterationsNumb, float tau, float epsil, int dimX, int dimY, int dimZ);
+CCPI_EXPORT float Diffus4th_CPU_main(float *Input, float *Output, float *infovector, float lambdaPar, float sigmaPar, int iterationsNumb, float tau, float epsil, int scheme, int layout, int dimX, int dimY, int dimZ);
+CCPI_EXPORT float Diffus4th_CPU_tiled(float *Input, float *Output, float *infovector, float lambdaPar, float sigmaPar, int iterationsNumb, float tau, int tile, int sync, float accuracy, int dimX, int dimY);
+CCPI_EXPORT long Diffus4th_CPU_tiled_mem(int tile, int sync, float accuracy, int dimX, int dimY);
+CCPI_EXPORT long Diffus4th_CPU_mem(float epsil, int scheme, int layout, int dimX, int dimY, int dimZ);
+CCPI_EXPORT float Diffus4th_CPU_strided(float *Input, long inPitchY, long inPitchZ, float *Output, long outPitchY, long outPitchZ, float *infovector, float lambdaPar, float sigmaPar, int iterationsNumb, float tau, float epsil, int scheme, int dimX, int dimY, int dimZ);
+CCPI_EXPORT long Diffus4th_CPU_strided_mem(float epsil, int scheme, int in_strided, int out_strided, int dimX, int dimY, int dimZ);
 CCPI_EXPORT float Weighted_Laplc2D(float *W_Lapl, float *U0, float sigma, long dimX, long dimY);
 CCPI_EXPORT float Diffusion_update_step2D(float *Output, float *Input, float *W_Lapl, float lambdaPar, float sigmaPar2, float tau, long dimX, long dimY);
 CCPI_EXPORT float Weighted_Laplc3D(float *W_Lapl, float *U0, float sigma, long dimX, long dimY, long dimZ);
 CCPI_EXPORT float Diffusion_update_step3D(float *Output, float *Input, float *W_Lapl, float lambdaPar, float sigmaPar2, float tau, long dimX, long dimY, long dimZ);
+CCPI_EXPORT float Weighted_Laplc3D_br(float *W_Lapl, float *U0, float sigma, long dimX, long dimY, long dimZ);
+CCPI_EXPORT float Diffusion_update_step3D_br(float *Output, float *Input, float *Out, float *W_Lapl, float lambdaPar, float sigmaPar2, float tau, long dimX, long dimY, long dimZ);
+CCPI_EXPORT float Biharm_factor(float tau, float lambdaPar, int ndims, float *F, long dimX, long dimY, long dimZ);
+CCPI_EXPORT float Biharm_step(float *U, float *U_old, float *F, float tau, long dimX, long dimY, long dimZ);
 #ifdef __cplusplus
 }
 #endif
@@ -40,6 +40,7 @@ int signNDFc(float x) {
  * 5. tau - time-marching step for explicit scheme
  * 6. Penalty type: 1 - Huber, 2 - Perona-Malik, 3 - Tukey Biweight, 4 - Threshold-constrained Linear, , 5 - modified Huber with a dead stop on edge
  * 7. eplsilon - tolerance constant
+ * 8. layout: storage of the 3D volume during the iterations, planar (0) or 8x8x8 bricks (2)
  *
  * Output:
  * [1] Filtered/regularized image/volume
@@ -50,68 +51,225 @@ int signNDFc(float x) {
  * [2] Black, M.J., Sapiro, G., Marimont, D.H. and Heeger, D., 1998. Robust anisotropic diffusion. IEEE Transactions on image processing, 7(3), pp.421-432.
  */
 
-float Diffusion_CPU_main(float *Input, float *Output, float *infovector, float lambdaPar, float sigmaPar, int iterationsNumb, float tau, int penaltytype, float epsil, int dimX, int dimY, int dimZ)
+static float Diffusion_CPU_run(float *Input, long inPitchY, long inPitchZ, float *Output, long outPitchY, long outPitchZ, float *infovector, float lambdaPar, float sigmaPar, int iterationsNumb, float tau, int penaltytype, float epsil, int layout, int dimX, int dimY, int dimZ)
 {
-    int i;
-    float sigmaPar2, *Output_prev=NULL;
+    int i, bricked, last;
+    float sigmaPar2, *U=NULL, *A=NULL, *Out=NULL, *V=NULL, *Ucur, *Unext, *T;
+    output_pass *pass = NULL;
     sigmaPar2 = sigmaPar/sqrt(2.0f);
     long j, DimTotal;
-    float re, re1;
+    float re = 0.0f, re1;
     re = 0.0f; re1 = 0.0f;
     int count = 0;
     DimTotal = (long)(dimX*dimY*dimZ);
-
-    if (epsil != 0.0f) Output_prev = calloc(DimTotal, sizeof(float));
-
-    /* copy into output */
-    copyIm(Input, Output, (long)(dimX), (long)(dimY), (long)(dimZ));
+    bricked = ((dimZ > 1) && (layout == LAYOUT_BRICKED));
+    if (bricked) DimTotal = Bricked_size((long)(dimX), (long)(dimY), (long)(dimZ));
+
+    /* the iterations alternate between U and V, the previous iterate is also the one the
+     * early stopping check compares with */
+    V = Vol_calloc(DimTotal);
+
+    if (bricked) {
+        /* the input and the initial output are bricked in one sweep */
+        A = Vol_calloc(DimTotal);
+        U = Vol_calloc(DimTotal);
+        Planar_to_bricked(Input, A, U, (long)(dimX), (long)(dimY), (long)(dimZ));
+    }
+    else if (STRIDED_DENSE(inPitchY, inPitchZ, dimX, dimY, dimZ) && STRIDED_DENSE(outPitchY, outPitchZ, dimX, dimY, dimZ) && (Input != Output)) {
+        /* copy into output */
+        copyIm(Input, Output, (long)(dimX), (long)(dimY), (long)(dimZ));
+        A = Input; U = Output;
+    }
+    else {
+        /* strided views or in place, the input and the initial output are gathered in one sweep (Strided_to_planar) */
+        A = (STRIDED_DENSE(inPitchY, inPitchZ, dimX, dimY, dimZ) && (Input != Output)) ? Input : (float*)calloc(DimTotal, sizeof(float));
+        U = STRIDED_DENSE(outPitchY, outPitchZ, dimX, dimY, dimZ) ? Output : (float*)calloc(DimTotal, sizeof(float));
+        Strided_to_planar(Input, inPitchY, inPitchZ, (A != Input) ? A : NULL, U, (long)(dimX), (long)(dimY), (long)(dimZ));
+    }
+    /* an output pass (Output_bind) is applied by the planar kernels of the last iteration to the
+     * rows they wrote, unless the early stopping check reads them after it */
+    if (!bricked) pass = Output_take(DimTotal, 1);
+    last = ((pass != NULL) && (pass->nops > 0) && (epsil != 0.0f) && ((iterationsNumb-1) % 5 == 0)) ? -1 : iterationsNumb-1;
+    Ucur = U; Unext = V;
 
     for(i=0; i < iterationsNumb; i++) {
 
-        if ((epsil != 0.0f)  && (i % 5 == 0)) copyIm(Output, Output_prev, (long)(dimX), (long)(dimY), (long)(dimZ));
         if (dimZ == 1) {
             /* running 2D diffusion iterations */
-            if (sigmaPar == 0.0f) LinearDiff2D(Input, Output, lambdaPar, tau, (long)(dimX), (long)(dimY)); /* linear diffusion (heat equation) */
-            else NonLinearDiff2D(Input, Output, lambdaPar, sigmaPar2, tau, penaltytype, (long)(dimX), (long)(dimY)); /* nonlinear diffusion */
+            if (sigmaPar == 0.0f) LinearDiff2D(A, Ucur, Unext, lambdaPar, tau, (i == last) ? pass : NULL, (long)(dimX), (long)(dimY)); /* linear diffusion (heat equation) */
+            else NonLinearDiff2D(A, Ucur, Unext, lambdaPar, sigmaPar2, tau, penaltytype, (i == last) ? pass : NULL, (long)(dimX), (long)(dimY)); /* nonlinear diffusion */
+        }
+        else if (bricked) {
+            /* running 3D diffusion iterations on bricks, the last iteration also writes the planar output */
+            Out = (i == iterationsNumb-1) ? Output : NULL;
+            if (sigmaPar == 0.0f) LinearDiff3D_br(A, Ucur, Unext, Out, lambdaPar, tau, (long)(dimX), (long)(dimY), (long)(dimZ));
+            else NonLinearDiff3D_br(A, Ucur, Unext, Out, lambdaPar, sigmaPar2, tau, penaltytype, (long)(dimX), (long)(dimY), (long)(dimZ));
         }
         else {
             /* running 3D diffusion iterations */
-            if (sigmaPar == 0.0f) LinearDiff3D(Input, Output, lambdaPar, tau, (long)(dimX), (long)(dimY), (long)(dimZ));
-            else NonLinearDiff3D(Input, Output, lambdaPar, sigmaPar2, tau, penaltytype, (long)(dimX), (long)(dimY), (long)(dimZ));
+            if (sigmaPar == 0.0f) LinearDiff3D(A, Ucur, Unext, lambdaPar, tau, (i == last) ? pass : NULL, (long)(dimX), (long)(dimY), (long)(dimZ));
+            else NonLinearDiff3D(A, Ucur, Unext, lambdaPar, sigmaPar2, tau, penaltytype, (i == last) ? pass : NULL, (long)(dimX), (long)(dimY), (long)(dimZ));
         }
+        T = Ucur; Ucur = Unext; Unext = T;
+        if ((i == last) && (pass != NULL)) Output_done(pass, Ucur);
         /* check early stopping criteria if epsilon not equal zero */
         if ((epsil != 0.0f)  && (i % 5 == 0)) {
             re = 0.0f; re1 = 0.0f;
             for(j=0; j<DimTotal; j++)
             {
-                re += powf(Output[j] - Output_prev[j],2);
-                re1 += powf(Output[j],2);
+                re += POW2(Ucur[j] - Unext[j]);
+                re1 += POW2(Ucur[j]);
             }
             re = sqrtf(re)/sqrtf(re1);
             /* stop if the norm residual is less than the tolerance EPS */
             if (re < epsil)  count++;
             if (count > 3) break;
         }
+        if (Progress_step(i+1, re)) break;
+    }
+    if (bricked) {
+        /* the planar output is still to be written if the iterations stopped earlier */
+        if ((iterationsNumb == 0) || (i < iterationsNumb)) Bricked_to_planar(Ucur, Output, (long)(dimX), (long)(dimY), (long)(dimZ));
+        Vol_free(A); Vol_free(U);
+    }
+    else {
+        if (Ucur != U) copyIm(Ucur, U, DimTotal, 1l, 1l);
+        if (U != Output) {
+            Planar_to_strided(U, Output, outPitchY, outPitchZ, (long)(dimX), (long)(dimY), (long)(dimZ));
+            free(U);
+        }
+        if (A != Input) free(A);
     }
 
-    free(Output_prev);
+    Vol_free(V);
     /*adding info into info_vector */
     infovector[0] = (float)(i);  /*iterations number (if stopped earlier based on tolerance)*/
     infovector[1] = re;  /* reached tolerance */
     return 0;
 }
 
+float Diffusion_CPU_main(float *Input, float *Output, float *infovector, float lambdaPar, float sigmaPar, int iterationsNumb, float tau, int penaltytype, float epsil, int layout, int dimX, int dimY, int dimZ)
+{
+    return Diffusion_CPU_run(Input, (long)(dimX), (long)(dimX)*dimY, Output, (long)(dimX), (long)(dimX)*dimY, infovector, lambdaPar, sigmaPar, iterationsNumb, tau, penaltytype, epsil, layout, dimX, dimY, dimZ);
+}
+
+float Diffusion_CPU_strided(float *Input, long inPitchY, long inPitchZ, float *Output, long outPitchY, long outPitchZ, float *infovector, float lambdaPar, float sigmaPar, int iterationsNumb, float tau, int penaltytype, float epsil, int dimX, int dimY, int dimZ)
+{
+    return Diffusion_CPU_run(Input, inPitchY, inPitchZ, Output, outPitchY, outPitchZ, infovector, lambdaPar, sigmaPar, iterationsNumb, tau, penaltytype, epsil, LAYOUT_PLANAR, dimX, dimY, dimZ);
+}
+
+/* Peak size in bytes of the work arrays allocated by Diffusion_CPU_main */
+long Diffusion_CPU_mem(float epsil, int layout, int dimX, int dimY, int dimZ)
+{
+    long DimTotal;
+    if ((dimZ > 1) && (layout == LAYOUT_BRICKED)) {
+        /* the bricked input and the two iterates */
+        DimTotal = Bricked_size((long)(dimX), (long)(dimY), (long)(dimZ));
+        return 3l*DimTotal*sizeof(float);
+    }
+    /* the second iterate */
+    DimTotal = (long)(dimX)*(long)(dimY)*(long)(dimZ);
+    return DimTotal*sizeof(float);
+}
+
+/* Peak size in bytes of the work arrays allocated by Diffusion_CPU_strided: the planar copies of
+ * the strided (or in place) input and output */
+long Diffusion_CPU_strided_mem(float epsil, int in_strided, int out_strided, int dimX, int dimY, int dimZ)
+{
+    return Diffusion_CPU_mem(epsil, LAYOUT_PLANAR, dimX, dimY, dimZ) + (long)(in_strided + out_strided)*dimX*dimY*dimZ*sizeof(float);
+}
+
+/* the iterations of a tile, the state is the output and the work array the other iterate */
+typedef struct {
+    float lambda, sigma, tau;
+    int penaltytype;
+} diff_tile_args;
+
+static void Diffusion_tile(void *arg, float *A, float **S, float **W, long nx, long ny, int it0, int iterations)
+{
+    diff_tile_args *p = (diff_tile_args*)arg;
+    float *U = S[0], *V = W[0], *T;
+    int i;
+    for(i=0; i<iterations; i++) {
+        if (p->sigma == 0.0f) LinearDiff2D(A, U, V, p->lambda, p->tau, NULL, nx, ny);
+        else NonLinearDiff2D(A, U, V, p->lambda, p->sigma, p->tau, p->penaltytype, NULL, nx, ny);
+        T = U; U = V; V = T;
+    }
+    if (U != S[0]) memcpy(S[0], U, nx*ny*sizeof(float));
+}
+
+float Diffusion_CPU_tiled(float *Input, float *Output, float *infovector, float lambdaPar, float sigmaPar, int iterationsNumb, float tau, int penaltytype, int tile, int sync, float accuracy, int dimX, int dimY)
+{
+    diff_tile_args p;
+    p.lambda = lambdaPar; p.sigma = sigmaPar/sqrt(2.0f); p.tau = tau; p.penaltytype = penaltytype;
+    copyIm(Input, Output, (long)(dimX), (long)(dimY), 1l);
+    Tile_run(Diffusion_tile, &p, 1, 1, 1, Input, &Output, iterationsNumb, tile, sync, accuracy, (long)(dimX), (long)(dimY));
+    infovector[0] = (float)(iterationsNumb);
+    infovector[1] = 0.0f;
+    return 0;
+}
+
+/* Peak size in bytes of the work arrays allocated by Diffusion_CPU_tiled */
+long Diffusion_CPU_tiled_mem(int tile, int sync, float accuracy, int dimX, int dimY)
+{
+    return Tile_mem(1, 1, 1, tile, sync, accuracy, (long)(dimX), (long)(dimY));
+}
+
+/* steady state of linear diffusion with fidelity weights, solved with multigrid */
+float LinearDiff_MG_CPU_main(float *Input, float *Output, float *infovector, float *Weights, float lambdaPar, int cycles, float epsil, int dimX, int dimY, int dimZ)
+{
+    long j, DimTotal;
+    float *F = Input;
+    MG *mg;
+
+    DimTotal = (long)(dimX)*(long)(dimY)*(long)(dimZ);
+    copyIm(Input, Output, (long)(dimX), (long)(dimY), (long)(dimZ));
+    if (Weights != NULL) {
+        F = Vol_calloc(DimTotal);
+#pragma omp parallel for shared(F, Input, Weights) private(j)
+        for(j=0; j<DimTotal; j++) F[j] = Weights[j]*Input[j];
+    }
+    mg = MG_create(Weights, 1.0f, lambdaPar, (long)(dimX), (long)(dimY), (long)(dimZ));
+    MG_solve(mg, Output, F, cycles, epsil, infovector);
+    MG_free(mg);
+    if (Weights != NULL) Vol_free(F);
+    return 0;
+}
+
+/* Peak size in bytes of the work arrays allocated by LinearDiff_MG_CPU_main (weights - W is given) */
+long LinearDiff_MG_CPU_mem(int weights, int dimX, int dimY, int dimZ)
+{
+    long DimTotal;
+    DimTotal = (long)(dimX)*(long)(dimY)*(long)(dimZ);
+    return (weights != 0)*DimTotal*sizeof(float) + MG_mem(weights, (long)(dimX), (long)(dimY), (long)(dimZ));
+}
+
+/* The planar kernels are bodies over rows, (k,j) in 3D and j in 2D, started by Run_rows on the
+ * shared pool or on OpenMP (pool.h). An iteration reads the previous iterate U and writes Output
+ * (Jacobi), so the result does not depend on the split of the rows over the threads. */
+typedef struct {
+    float *Input, *U, *Output;
+    float lambda, sigma, tau;
+    int penaltytype;
+    long dimX, dimY, dimZ;
+    output_pass *pass;  /* statistics of the rows of Output (Output_rows), NULL - none */
+} ndf_args;
+
 /********************************************************************/
 /***************************2D Functions*****************************/
 /********************************************************************/
 /* linear diffusion (heat equation) */
-float LinearDiff2D(float *Input, float *Output, float lambdaPar, float tau, long dimX, long dimY)
+static void LinearDiff2D_rows(void *arg, long r0, long r1)
 {
+    ndf_args *a = (ndf_args*)arg;
+    output_acc acc;
+    float *Input = a->Input, *U = a->U, *Output = a->Output, lambdaPar = a->lambda, tau = a->tau;
+    long dimX = a->dimX, dimY = a->dimY;
     long i,j,i1,i2,j1,j2,index;
     float e,w,n,s,e1,w1,n1,s1;
 
-#pragma omp parallel for shared(Input) private(index,i,j,i1,i2,j1,j2,e,w,n,s,e1,w1,n1,s1)
-    for(j=0; j<dimY; j++) {
+    if (a->pass != NULL) Output_open(a->pass, &acc);
+    for(j=r0; j<r1; j++) {
         /* symmetric boundary conditions (Neuman) */
         j1 = j+1; if (j1 == dimY) j1 = j-1;
         j2 = j-1; if (j2 < 0) j2 = j+1;
@@ -121,29 +279,43 @@ float LinearDiff2D(float *Input, float *Output, float lambdaPar, float tau, long
             i2 = i-1; if (i2 < 0) i2 = i+1;
             index = j*dimX+i;
 
-            e = Output[j*dimX+i1];
-            w = Output[j*dimX+i2];
-            n = Output[j1*dimX+i];
-            s = Output[j2*dimX+i];
+            e = U[j*dimX+i1];
+            w = U[j*dimX+i2];
+            n = U[j1*dimX+i];
+            s = U[j2*dimX+i];
 
-            e1 = e - Output[index];
-            w1 = w - Output[index];
-            n1 = n - Output[index];
-            s1 = s - Output[index];
+            e1 = e - U[index];
+            w1 = w - U[index];
+            n1 = n - U[index];
+            s1 = s - U[index];
 
-            Output[index] += tau*(lambdaPar*(e1 + w1 + n1 + s1) - (Output[index] - Input[index]));
-        }}
+            Output[index] = U[index] + tau*(lambdaPar*(e1 + w1 + n1 + s1) - (U[index] - Input[index]));
+        }
+        if (a->pass != NULL) Output_rows(a->pass, &acc, Output + j*dimX, dimX);
+    }
+    if (a->pass != NULL) Output_close(a->pass, &acc);
+}
+float LinearDiff2D(float *Input, float *U, float *Output, float lambdaPar, float tau, output_pass *pass, long dimX, long dimY)
+{
+    ndf_args a = {Input, U, Output, lambdaPar, 0.0f, tau, 0, dimX, dimY, 1l, pass};
+    Run_rows(dimY, LinearDiff2D_rows, &a);
     return *Output;
 }
 
 /* nonlinear diffusion */
-float NonLinearDiff2D(float *Input, float *Output, float lambdaPar, float sigmaPar, float tau, int penaltytype, long dimX, long dimY)
+static void NonLinearDiff2D_rows(void *arg, long r0, long r1)
 {
+    ndf_args *a = (ndf_args*)arg;
+    output_acc acc;
+    float *Input = a->Input, *U = a->U, *Output = a->Output, lambdaPar = a->lambda, tau = a->tau;
+    float sigmaPar = a->sigma;
+    int penaltytype = a->penaltytype;
+    long dimX = a->dimX, dimY = a->dimY;
     long i,j,i1,i2,j1,j2,index;
     float e,w,n,s,e1,w1,n1,s1;
 
-#pragma omp parallel for shared(Input) private(index,i,j,i1,i2,j1,j2,e,w,n,s,e1,w1,n1,s1)
-    for(j=0; j<dimY; j++) {
+    if (a->pass != NULL) Output_open(a->pass, &acc);
+    for(j=r0; j<r1; j++) {
         /* symmetric boundary conditions (Neuman) */
         j1 = j+1; if (j1 == dimY) j1 = j-1;
         j2 = j-1; if (j2 < 0) j2 = j+1;
@@ -153,15 +325,15 @@ float NonLinearDiff2D(float *Input, float *Output, float lambdaPar, float sigmaP
             i2 = i-1; if (i2 < 0) i2 = i+1;
             index = j*dimX+i;
 
-            e = Output[j*dimX+i1];
-            w = Output[j*dimX+i2];
-            n = Output[j1*dimX+i];
-            s = Output[j2*dimX+i];
+            e = U[j*dimX+i1];
+            w = U[j*dimX+i2];
+            n = U[j1*dimX+i];
+            s = U[j2*dimX+i];
 
-            e1 = e - Output[index];
-            w1 = w - Output[index];
-            n1 = n - Output[index];
-            s1 = s - Output[index];
+            e1 = e - U[index];
+            w1 = w - U[index];
+            n1 = n - U[index];
+            s1 = s - U[index];
 
             if (penaltytype == 1){
                 /* Huber penalty */
@@ -179,20 +351,20 @@ float NonLinearDiff2D(float *Input, float *Output, float lambdaPar, float sigmaP
             }
             else if (penaltytype == 2) {
                 /* Perona-Malik */
-                e1 /= (1.0f + powf((e1/sigmaPar),2));
-                w1 /= (1.0f + powf((w1/sigmaPar),2));
-                n1 /= (1.0f + powf((n1/sigmaPar),2));
-                s1 /= (1.0f + powf((s1/sigmaPar),2));
+                e1 /= (1.0f + POW2((e1/sigmaPar)));
+                w1 /= (1.0f + POW2((w1/sigmaPar)));
+                n1 /= (1.0f + POW2((n1/sigmaPar)));
+                s1 /= (1.0f + POW2((s1/sigmaPar)));
             }
             else if (penaltytype == 3) {
                 /* Tukey Biweight */
-                if (fabs(e1) <= sigmaPar) e1 =  e1*powf((1.0f - powf((e1/sigmaPar),2)), 2);
+                if (fabs(e1) <= sigmaPar) e1 =  e1*POW2((1.0f - POW2((e1/sigmaPar))));
                 else e1 = 0.0f;
-                if (fabs(w1) <= sigmaPar) w1 =  w1*powf((1.0f - powf((w1/sigmaPar),2)), 2);
+                if (fabs(w1) <= sigmaPar) w1 =  w1*POW2((1.0f - POW2((w1/sigmaPar))));
                 else w1 = 0.0f;
-                if (fabs(n1) <= sigmaPar) n1 =  n1*powf((1.0f - powf((n1/sigmaPar),2)), 2);
+                if (fabs(n1) <= sigmaPar) n1 =  n1*POW2((1.0f - POW2((n1/sigmaPar))));
                 else n1 = 0.0f;
-                if (fabs(s1) <= sigmaPar) s1 =  s1*powf((1.0f - powf((s1/sigmaPar),2)), 2);
+                if (fabs(s1) <= sigmaPar) s1 =  s1*POW2((1.0f - POW2((s1/sigmaPar))));
                 else s1 = 0.0f;
             }
             else if (penaltytype == 4) {
@@ -233,84 +405,110 @@ float NonLinearDiff2D(float *Input, float *Output, float lambdaPar, float sigmaP
                 printf("%s \n", "No penalty function selected! Use 1,2,3,4 or 5.");
                 break;
             }
-            Output[index] += tau*(lambdaPar*(e1 + w1 + n1 + s1) - (Output[index] - Input[index]));
-        }}
+            Output[index] = U[index] + tau*(lambdaPar*(e1 + w1 + n1 + s1) - (U[index] - Input[index]));
+        }
+        if (a->pass != NULL) Output_rows(a->pass, &acc, Output + j*dimX, dimX);
+    }
+    if (a->pass != NULL) Output_close(a->pass, &acc);
+}
+float NonLinearDiff2D(float *Input, float *U, float *Output, float lambdaPar, float sigmaPar, float tau, int penaltytype, output_pass *pass, long dimX, long dimY)
+{
+    ndf_args a = {Input, U, Output, lambdaPar, sigmaPar, tau, penaltytype, dimX, dimY, 1l, pass};
+    Run_rows(dimY, NonLinearDiff2D_rows, &a);
     return *Output;
 }
 /********************************************************************/
 /***************************3D Functions*****************************/
 /********************************************************************/
 /* linear diffusion (heat equation) */
-float LinearDiff3D(float *Input, float *Output, float lambdaPar, float tau, long dimX, long dimY, long dimZ)
+static void LinearDiff3D_rows(void *arg, long r0, long r1)
 {
-    long i,j,k,i1,i2,j1,j2,k1,k2,index;
+    ndf_args *a = (ndf_args*)arg;
+    output_acc acc;
+    float *Input = a->Input, *U = a->U, *Output = a->Output, lambdaPar = a->lambda, tau = a->tau;
+    long dimX = a->dimX, dimY = a->dimY, dimZ = a->dimZ;
+    long r,i,j,k,i1,i2,j1,j2,k1,k2,index;
     float e,w,n,s,u,d,e1,w1,n1,s1,u1,d1;
 
-#pragma omp parallel for shared(Input) private(index,i,j,i1,i2,j1,j2,e,w,n,s,e1,w1,n1,s1,k,k1,k2,u1,d1,u,d)
-    for(k=0; k<dimZ; k++) {
+    if (a->pass != NULL) Output_open(a->pass, &acc);
+    for(r=r0; r<r1; r++) {
+        k = r/dimY; j = r - k*dimY;
         k1 = k+1; if (k1 == dimZ) k1 = k-1;
         k2 = k-1; if (k2 < 0) k2 = k+1;
-        for(j=0; j<dimY; j++) {
-            /* symmetric boundary conditions (Neuman) */
-            j1 = j+1; if (j1 == dimY) j1 = j-1;
-            j2 = j-1; if (j2 < 0) j2 = j+1;
+        /* symmetric boundary conditions (Neuman) */
+        j1 = j+1; if (j1 == dimY) j1 = j-1;
+        j2 = j-1; if (j2 < 0) j2 = j+1;
             for(i=0; i<dimX; i++) {
                 /* symmetric boundary conditions (Neuman) */
                 i1 = i+1; if (i1 == dimX) i1 = i-1;
                 i2 = i-1; if (i2 < 0) i2 = i+1;
                 index = (dimX*dimY)*k + j*dimX+i;
 
-                e = Output[(dimX*dimY)*k + j*dimX+i1];
-                w = Output[(dimX*dimY)*k + j*dimX+i2];
-                n = Output[(dimX*dimY)*k + j1*dimX+i];
-                s = Output[(dimX*dimY)*k + j2*dimX+i];
-                u = Output[(dimX*dimY)*k1 + j*dimX+i];
-                d = Output[(dimX*dimY)*k2 + j*dimX+i];
-
-                e1 = e - Output[index];
-                w1 = w - Output[index];
-                n1 = n - Output[index];
-                s1 = s - Output[index];
-                u1 = u - Output[index];
-                d1 = d - Output[index];
-
-                Output[index] += tau*(lambdaPar*(e1 + w1 + n1 + s1 + u1 + d1) - (Output[index] - Input[index]));
-            }}}
+                e = U[(dimX*dimY)*k + j*dimX+i1];
+                w = U[(dimX*dimY)*k + j*dimX+i2];
+                n = U[(dimX*dimY)*k + j1*dimX+i];
+                s = U[(dimX*dimY)*k + j2*dimX+i];
+                u = U[(dimX*dimY)*k1 + j*dimX+i];
+                d = U[(dimX*dimY)*k2 + j*dimX+i];
+
+                e1 = e - U[index];
+                w1 = w - U[index];
+                n1 = n - U[index];
+                s1 = s - U[index];
+                u1 = u - U[index];
+                d1 = d - U[index];
+
+                Output[index] = U[index] + tau*(lambdaPar*(e1 + w1 + n1 + s1 + u1 + d1) - (U[index] - Input[index]));
+            }
+        if (a->pass != NULL) Output_rows(a->pass, &acc, Output + (dimX*dimY)*k + j*dimX, dimX);
+    }
+    if (a->pass != NULL) Output_close(a->pass, &acc);
+}
+float LinearDiff3D(float *Input, float *U, float *Output, float lambdaPar, float tau, output_pass *pass, long dimX, long dimY, long dimZ)
+{
+    ndf_args a = {Input, U, Output, lambdaPar, 0.0f, tau, 0, dimX, dimY, dimZ, pass};
+    Run_rows(dimZ*dimY, LinearDiff3D_rows, &a);
     return *Output;
 }
 
-float NonLinearDiff3D(float *Input, float *Output, float lambdaPar, float sigmaPar, float tau, int penaltytype, long dimX, long dimY, long dimZ)
+static void NonLinearDiff3D_rows(void *arg, long r0, long r1)
 {
-    long i,j,k,i1,i2,j1,j2,k1,k2,index;
+    ndf_args *a = (ndf_args*)arg;
+    output_acc acc;
+    float *Input = a->Input, *U = a->U, *Output = a->Output, lambdaPar = a->lambda, tau = a->tau;
+    float sigmaPar = a->sigma;
+    int penaltytype = a->penaltytype;
+    long dimX = a->dimX, dimY = a->dimY, dimZ = a->dimZ;
+    long r,i,j,k,i1,i2,j1,j2,k1,k2,index;
     float e,w,n,s,u,d,e1,w1,n1,s1,u1,d1;
 
-#pragma omp parallel for shared(Input) private(index,i,j,i1,i2,j1,j2,e,w,n,s,e1,w1,n1,s1,k,k1,k2,u1,d1,u,d)
-    for(k=0; k<dimZ; k++) {
+    if (a->pass != NULL) Output_open(a->pass, &acc);
+    for(r=r0; r<r1; r++) {
+        k = r/dimY; j = r - k*dimY;
         k1 = k+1; if (k1 == dimZ) k1 = k-1;
         k2 = k-1; if (k2 < 0) k2 = k+1;
-        for(j=0; j<dimY; j++) {
-            /* symmetric boundary conditions (Neuman) */
-            j1 = j+1; if (j1 == dimY) j1 = j-1;
-            j2 = j-1; if (j2 < 0) j2 = j+1;
+        /* symmetric boundary conditions (Neuman) */
+        j1 = j+1; if (j1 == dimY) j1 = j-1;
+        j2 = j-1; if (j2 < 0) j2 = j+1;
             for(i=0; i<dimX; i++) {
                 /* symmetric boundary conditions (Neuman) */
                 i1 = i+1; if (i1 == dimX) i1 = i-1;
                 i2 = i-1; if (i2 < 0) i2 = i+1;
                 index = (dimX*dimY)*k + j*dimX+i;
 
-                e = Output[(dimX*dimY)*k + j*dimX+i1];
-                w = Output[(dimX*dimY)*k + j*dimX+i2];
-                n = Output[(dimX*dimY)*k + j1*dimX+i];
-                s = Output[(dimX*dimY)*k + j2*dimX+i];
-                u = Output[(dimX*dimY)*k1 + j*dimX+i];
-                d = Output[(dimX*dimY)*k2 + j*dimX+i];
+                e = U[(dimX*dimY)*k + j*dimX+i1];
+                w = U[(dimX*dimY)*k + j*dimX+i2];
+                n = U[(dimX*dimY)*k + j1*dimX+i];
+                s = U[(dimX*dimY)*k + j2*dimX+i];
+                u = U[(dimX*dimY)*k1 + j*dimX+i];
+                d = U[(dimX*dimY)*k2 + j*dimX+i];
 
-                e1 = e - Output[index];
-                w1 = w - Output[index];
-                n1 = n - Output[index];
-                s1 = s - Output[index];
-                u1 = u - Output[index];
-                d1 = d - Output[index];
+                e1 = e - U[index];
+                w1 = w - U[index];
+                n1 = n - U[index];
+                s1 = s - U[index];
+                u1 = u - U[index];
+                d1 = d - U[index];
 
                 if (penaltytype == 1){
                     /* Huber penalty */
@@ -334,26 +532,26 @@ float NonLinearDiff3D(float *Input, float *Output, float lambdaPar, float sigmaP
                 }
                 else if (penaltytype == 2) {
                     /* Perona-Malik */
-                    e1 = (e1)/(1.0f + powf((e1/sigmaPar),2));
-                    w1 = (w1)/(1.0f + powf((w1/sigmaPar),2));
-                    n1 = (n1)/(1.0f + powf((n1/sigmaPar),2));
-                    s1 = (s1)/(1.0f + powf((s1/sigmaPar),2));
-                    u1 = (u1)/(1.0f + powf((u1/sigmaPar),2));
-                    d1 = (d1)/(1.0f + powf((d1/sigmaPar),2));
+                    e1 = (e1)/(1.0f + POW2((e1/sigmaPar)));
+                    w1 = (w1)/(1.0f + POW2((w1/sigmaPar)));
+                    n1 = (n1)/(1.0f + POW2((n1/sigmaPar)));
+                    s1 = (s1)/(1.0f + POW2((s1/sigmaPar)));
+                    u1 = (u1)/(1.0f + POW2((u1/sigmaPar)));
+                    d1 = (d1)/(1.0f + POW2((d1/sigmaPar)));
                 }
                 else if (penaltytype == 3) {
                     /* Tukey Biweight */
-                    if (fabs(e1) <= sigmaPar) e1 =  e1*powf((1.0f - powf((e1/sigmaPar),2)), 2);
+                    if (fabs(e1) <= sigmaPar) e1 =  e1*POW2((1.0f - POW2((e1/sigmaPar))));
                     else e1 = 0.0f;
-                    if (fabs(w1) <= sigmaPar) w1 =  w1*powf((1.0f - powf((w1/sigmaPar),2)), 2);
+                    if (fabs(w1) <= sigmaPar) w1 =  w1*POW2((1.0f - POW2((w1/sigmaPar))));
                     else w1 = 0.0f;
-                    if (fabs(n1) <= sigmaPar) n1 =  n1*powf((1.0f - powf((n1/sigmaPar),2)), 2);
+                    if (fabs(n1) <= sigmaPar) n1 =  n1*POW2((1.0f - POW2((n1/sigmaPar))));
                     else n1 = 0.0f;
-                    if (fabs(s1) <= sigmaPar) s1 =  s1*powf((1.0f - powf((s1/sigmaPar),2)), 2);
+                    if (fabs(s1) <= sigmaPar) s1 =  s1*POW2((1.0f - POW2((s1/sigmaPar))));
                     else s1 = 0.0f;
-                    if (fabs(u1) <= sigmaPar) u1 =  u1*powf((1.0f - powf((u1/sigmaPar),2)), 2);
+                    if (fabs(u1) <= sigmaPar) u1 =  u1*POW2((1.0f - POW2((u1/sigmaPar))));
                     else u1 = 0.0f;
-                    if (fabs(d1) <= sigmaPar) d1 =  d1*powf((1.0f - powf((d1/sigmaPar),2)), 2);
+                    if (fabs(d1) <= sigmaPar) d1 =  d1*POW2((1.0f - POW2((d1/sigmaPar))));
                     else d1 = 0.0f;
                 }
                 else if (penaltytype == 4) {
@@ -407,7 +605,250 @@ float NonLinearDiff3D(float *Input, float *Output, float lambdaPar, float sigmaP
                     break;
                 }
 
-                Output[index] += tau*(lambdaPar*(e1 + w1 + n1 + s1 + u1 + d1) - (Output[index] - Input[index]));
-            }}}
+                Output[index] = U[index] + tau*(lambdaPar*(e1 + w1 + n1 + s1 + u1 + d1) - (U[index] - Input[index]));
+            }
+        if (a->pass != NULL) Output_rows(a->pass, &acc, Output + (dimX*dimY)*k + j*dimX, dimX);
+    }
+    if (a->pass != NULL) Output_close(a->pass, &acc);
+}
+float NonLinearDiff3D(float *Input, float *U, float *Output, float lambdaPar, float sigmaPar, float tau, int penaltytype, output_pass *pass, long dimX, long dimY, long dimZ)
+{
+    ndf_args a = {Input, U, Output, lambdaPar, sigmaPar, tau, penaltytype, dimX, dimY, dimZ, pass};
+    Run_rows(dimZ*dimY, NonLinearDiff3D_rows, &a);
     return *Output;
 }
+/********************************************************************/
+/**************3D Functions for the bricked layout*******************/
+/********************************************************************/
+/* edge-stopping function of the penalties above applied to a single difference, with a vector
+ * variant for the lane loops of the lockstep solver */
+#if defined(_OPENMP) && (_OPENMP >= 201307)
+#pragma omp declare simd uniform(sigmaPar, penaltytype)
+#endif
+float penaltyNDFc(float x, float sigmaPar, int penaltytype)
+{
+    if (penaltytype == 1) {
+        /* Huber penalty */
+        if (fabs(x) > sigmaPar) x = signNDFc(x);
+        else x = x/sigmaPar;
+    }
+    else if (penaltytype == 2) {
+        /* Perona-Malik */
+        x = x/(1.0f + POW2((x/sigmaPar)));
+    }
+    else if (penaltytype == 3) {
+        /* Tukey Biweight */
+        if (fabs(x) <= sigmaPar) x = x*POW2((1.0f - POW2((x/sigmaPar))));
+        else x = 0.0f;
+    }
+    else if (penaltytype == 4) {
+        /* Threshold-constrained linear diffusion */
+        if (fabs(x) > sigmaPar) x = 0.0f;
+    }
+    else {
+        /* Threshold constrained Huber diffusion */
+        if (fabs(x) <= 2.0f*sigmaPar) {
+        if (fabs(x) > sigmaPar) x = signNDFc(x);
+        else x = x/sigmaPar; }
+        else x = 0.0f;
+    }
+    return x;
+}
+
+/* the bricked volumes are updated brick by brick (see BIDX in utils.h) from the previous iterate U, if Out is not NULL the
+ * result is also stored in planar order */
+float LinearDiff3D_br(float *Input, float *U, float *Output, float *Out, float lambdaPar, float tau, long dimX, long dimY, long dimZ)
+{
+    long b,i,j,k,i0,j0,k0,i1,i2,j1,j2,k1,k2,index,nbX,nbY,nbZ;
+    float e1,w1,n1,s1,u1,d1;
+    nbX = (dimX+BRICK-1)/BRICK; nbY = (dimY+BRICK-1)/BRICK; nbZ = (dimZ+BRICK-1)/BRICK;
+
+#pragma omp parallel for shared(Input, U, Output, Out) private(b,index,i,j,k,i0,j0,k0,i1,i2,j1,j2,k1,k2,e1,w1,n1,s1,u1,d1)
+    for(b=0; b<nbX*nbY*nbZ; b++) {
+        i0 = (b % nbX)*BRICK; j0 = ((b/nbX) % nbY)*BRICK; k0 = (b/(nbX*nbY))*BRICK;
+        for(k=k0; k<MIN(k0+BRICK,dimZ); k++) {
+            k1 = k+1; if (k1 == dimZ) k1 = k-1;
+            k2 = k-1; if (k2 < 0) k2 = k+1;
+            for(j=j0; j<MIN(j0+BRICK,dimY); j++) {
+                /* symmetric boundary conditions (Neuman) */
+                j1 = j+1; if (j1 == dimY) j1 = j-1;
+                j2 = j-1; if (j2 < 0) j2 = j+1;
+                for(i=i0; i<MIN(i0+BRICK,dimX); i++) {
+                    /* symmetric boundary conditions (Neuman) */
+                    i1 = i+1; if (i1 == dimX) i1 = i-1;
+                    i2 = i-1; if (i2 < 0) i2 = i+1;
+                    index = BIDX(i,j,k,nbX,nbY);
+
+                    e1 = U[BIDX(i1,j,k,nbX,nbY)] - U[index];
+                    w1 = U[BIDX(i2,j,k,nbX,nbY)] - U[index];
+                    n1 = U[BIDX(i,j1,k,nbX,nbY)] - U[index];
+                    s1 = U[BIDX(i,j2,k,nbX,nbY)] - U[index];
+                    u1 = U[BIDX(i,j,k1,nbX,nbY)] - U[index];
+                    d1 = U[BIDX(i,j,k2,nbX,nbY)] - U[index];
+
+                    Output[index] = U[index] + tau*(lambdaPar*(e1 + w1 + n1 + s1 + u1 + d1) - (U[index] - Input[index]));
+                    if (Out != NULL) Out[(dimX*dimY)*k + j*dimX+i] = Output[index];
+                }}}}
+    return *Output;
+}
+
+float NonLinearDiff3D_br(float *Input, float *U, float *Output, float *Out, float lambdaPar, float sigmaPar, float tau, int penaltytype, long dimX, long dimY, long dimZ)
+{
+    long b,i,j,k,i0,j0,k0,i1,i2,j1,j2,k1,k2,index,nbX,nbY,nbZ;
+    float e1,w1,n1,s1,u1,d1;
+    nbX = (dimX+BRICK-1)/BRICK; nbY = (dimY+BRICK-1)/BRICK; nbZ = (dimZ+BRICK-1)/BRICK;
+
+    if ((penaltytype < 1) || (penaltytype > 5)) {
+        printf("%s \n", "No penalty function selected! Use 1,2,3,4 or 5.");
+        return *Output;
+    }
+
+#pragma omp parallel for shared(Input, U, Output, Out) private(b,index,i,j,k,i0,j0,k0,i1,i2,j1,j2,k1,k2,e1,w1,n1,s1,u1,d1)
+    for(b=0; b<nbX*nbY*nbZ; b++) {
+        i0 = (b % nbX)*BRICK; j0 = ((b/nbX) % nbY)*BRICK; k0 = (b/(nbX*nbY))*BRICK;
+        for(k=k0; k<MIN(k0+BRICK,dimZ); k++) {
+            k1 = k+1; if (k1 == dimZ) k1 = k-1;
+            k2 = k-1; if (k2 < 0) k2 = k+1;
+            for(j=j0; j<MIN(j0+BRICK,dimY); j++) {
+                /* symmetric boundary conditions (Neuman) */
+                j1 = j+1; if (j1 == dimY) j1 = j-1;
+                j2 = j-1; if (j2 < 0) j2 = j+1;
+                for(i=i0; i<MIN(i0+BRICK,dimX); i++) {
+                    /* symmetric boundary conditions (Neuman) */
+                    i1 = i+1; if (i1 == dimX) i1 = i-1;
+                    i2 = i-1; if (i2 < 0) i2 = i+1;
+                    index = BIDX(i,j,k,nbX,nbY);
+
+                    e1 = penaltyNDFc(U[BIDX(i1,j,k,nbX,nbY)] - U[index], sigmaPar, penaltytype);
+                    w1 = penaltyNDFc(U[BIDX(i2,j,k,nbX,nbY)] - U[index], sigmaPar, penaltytype);
+                    n1 = penaltyNDFc(U[BIDX(i,j1,k,nbX,nbY)] - U[index], sigmaPar, penaltytype);
+                    s1 = penaltyNDFc(U[BIDX(i,j2,k,nbX,nbY)] - U[index], sigmaPar, penaltytype);
+                    u1 = penaltyNDFc(U[BIDX(i,j,k1,nbX,nbY)] - U[index], sigmaPar, penaltytype);
+                    d1 = penaltyNDFc(U[BIDX(i,j,k2,nbX,nbY)] - U[index], sigmaPar, penaltytype);
+
+                    Output[index] = U[index] + tau*(lambdaPar*(e1 + w1 + n1 + s1 + u1 + d1) - (U[index] - Input[index]));
+                    if (Out != NULL) Out[(dimX*dimY)*k + j*dimX+i] = Output[index];
+                }}}}
+    return *Output;
+}
+
+/********************************************************************/
+/*******Lockstep solution of K problems with different lambdas*******/
+/********************************************************************/
+/* The K solutions of a voxel are interleaved (U[index*K + l]) so that one pass over the stencil
+ * computes the neighbour indices and reads the input once for all lanes, the lane loop is vectorised.
+ * As in the planar kernels the lanes of U are read and the update is written to V (Jacobi), by a
+ * body over rows started by Run_rows. In 2D the z neighbours are the voxel itself and the z terms
+ * vanish. */
+typedef struct {
+    float *Input, *U, *V, *lambdas;
+    int K;
+    float sigma, tau;
+    int penaltytype;
+    long dimX, dimY, dimZ;
+} ndfm_args;
+
+static void Diff_multi_rows(void *arg, long r0, long r1)
+{
+    ndfm_args *a = (ndfm_args*)arg;
+    float *Input = a->Input, *U = a->U, *V = a->V, *lambdas = a->lambdas, sigmaPar = a->sigma, tau = a->tau;
+    int penaltytype = a->penaltytype;
+    long K = a->K, dimX = a->dimX, dimY = a->dimY, dimZ = a->dimZ;
+    long i,j,k,l,r,index,ni1,ni2,nj1,nj2,nk1,nk2;
+    float a0;
+
+    for(r=r0; r<r1; r++) {
+        k = r/dimY; j = r - k*dimY;
+        for(i=0; i<dimX; i++) {
+            index = (dimX*dimY)*k + j*dimX+i;
+            a0 = Input[index];
+            /* symmetric boundary conditions (Neuman) */
+            ni1 = (i+1 == dimX) ? index-1 : index+1;
+            ni2 = (i-1 < 0) ? index+1 : index-1;
+            nj1 = (j+1 == dimY) ? index-dimX : index+dimX;
+            nj2 = (j-1 < 0) ? index+dimX : index-dimX;
+            if (dimZ > 1) {
+                nk1 = (k+1 == dimZ) ? index-dimX*dimY : index+dimX*dimY;
+                nk2 = (k-1 < 0) ? index+dimX*dimY : index-dimX*dimY;
+            }
+            else {nk1 = index; nk2 = index;}
+            index *= K; ni1 *= K; ni2 *= K; nj1 *= K; nj2 *= K; nk1 *= K; nk2 *= K;
+
+            if (sigmaPar == 0.0f) {
+                /* linear diffusion (heat equation) */
+                OMP_SIMD
+                for(l=0; l<K; l++) {
+                    float e1 = U[ni1+l] - U[index+l];
+                    float w1 = U[ni2+l] - U[index+l];
+                    float n1 = U[nj1+l] - U[index+l];
+                    float s1 = U[nj2+l] - U[index+l];
+                    float u1 = U[nk1+l] - U[index+l];
+                    float d1 = U[nk2+l] - U[index+l];
+                    V[index+l] = U[index+l] + tau*(lambdas[l]*(e1 + w1 + n1 + s1 + u1 + d1) - (U[index+l] - a0));
+                }
+            }
+            else {
+                /* nonlinear diffusion */
+                OMP_SIMD
+                for(l=0; l<K; l++) {
+                    float e1 = penaltyNDFc(U[ni1+l] - U[index+l], sigmaPar, penaltytype);
+                    float w1 = penaltyNDFc(U[ni2+l] - U[index+l], sigmaPar, penaltytype);
+                    float n1 = penaltyNDFc(U[nj1+l] - U[index+l], sigmaPar, penaltytype);
+                    float s1 = penaltyNDFc(U[nj2+l] - U[index+l], sigmaPar, penaltytype);
+                    float u1 = penaltyNDFc(U[nk1+l] - U[index+l], sigmaPar, penaltytype);
+                    float d1 = penaltyNDFc(U[nk2+l] - U[index+l], sigmaPar, penaltytype);
+                    V[index+l] = U[index+l] + tau*(lambdas[l]*(e1 + w1 + n1 + s1 + u1 + d1) - (U[index+l] - a0));
+                }
+            }
+        }}
+}
+float Diff_multi(float *Input, float *U, float *V, float *lambdas, int K, float sigmaPar, float tau, int penaltytype, long dimX, long dimY, long dimZ)
+{
+    ndfm_args a = {Input, U, V, lambdas, K, sigmaPar, tau, penaltytype, dimX, dimY, dimZ};
+    Run_rows(dimZ*dimY, Diff_multi_rows, &a);
+    return *V;
+}
+
+/* Runs iterationsNumb diffusion iterations for the K regularisation parameters lambdas[0..K-1] in
+ * lockstep. Output keeps the K planar results one after the other. The iterations are not stopped
+ * on a tolerance (all lanes run the same number), infovector is [iterations, 0]. */
+float Diffusion_CPU_multi(float *Input, float *Output, float *infovector, float *lambdas, int K, float sigmaPar, int iterationsNumb, float tau, int penaltytype, int dimX, int dimY, int dimZ)
+{
+    float *U=NULL, *V=NULL, *T;
+    long DimTotal, index, l;
+    int i;
+    DimTotal = (long)(dimX)*(long)(dimY)*(long)(dimZ);
+
+    if ((sigmaPar != 0.0f) && ((penaltytype < 1) || (penaltytype > 5))) {
+        printf("%s \n", "No penalty function selected! Use 1,2,3,4 or 5.");
+        return 0;
+    }
+    U = Vol_calloc(K*DimTotal);
+    V = Vol_calloc(K*DimTotal);
+#pragma omp parallel for shared(Input, U) private(index, l)
+    for(index=0; index<DimTotal; index++) {
+        for(l=0; l<K; l++) U[index*K+l] = Input[index];
+    }
+
+    for(i=0; i < iterationsNumb; i++) {
+        Diff_multi(Input, U, V, lambdas, K, sigmaPar/sqrt(2.0f), tau, penaltytype, (long)(dimX), (long)(dimY), (long)(dimZ));
+        T = U; U = V; V = T;
+    }
+
+    /* de-interleaving the lanes into the K outputs */
+#pragma omp parallel for shared(Output, U) private(index, l)
+    for(index=0; index<DimTotal; index++) {
+        for(l=0; l<K; l++) Output[l*DimTotal+index] = U[index*K+l];
+    }
+    Vol_free(U); Vol_free(V);
+
+    infovector[0] = (float)(iterationsNumb);
+    infovector[1] = 0.0f;
+    return 0;
+}
+
+/* Peak size in bytes of the work arrays allocated by Diffusion_CPU_multi */
+long Diffusion_CPU_multi_mem(int K, int dimX, int dimY, int dimZ)
+{
+    return 2l*(long)(K)*(long)(dimX)*(long)(dimY)*(long)(dimZ)*sizeof(float);
+}
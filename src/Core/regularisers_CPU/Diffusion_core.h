@@ -23,11 +23,16 @@ limitations under the License.
 #include <stdio.h>
 #include "omp.h"
 #include "utils.h"
+#include "vec_math.h"
+#include "multigrid.h"
+#include "pool.h"
+#include "tile.h"
 #include "CCPiDefines.h"
 
 
 /* C-OMP implementation of linear and nonlinear diffusion with the regularisation model [1,2] (2D/3D case)
- * The minimisation is performed using explicit scheme.
+ * The minimisation is performed using explicit scheme: every iteration reads the previous iterate
+ * (Jacobi), the result does not depend on the number of threads, the layout or the tiles.
  *
  * Input Parameters:
  * 1. Noisy image/volume
@@ -37,6 +42,7 @@ limitations under the License.
  * 5. tau - time-marching step for explicit scheme
  * 6. Penalty type: 1 - Huber, 2 - Perona-Malik, 3 - Tukey Biweight
  * 7. eplsilon - tolerance constant
+ * 8. layout: storage of the 3D volume during the iterations, planar (0) or 8x8x8 bricks (2)
 
  * Output:
  * [1] Filtered/regularized image/volume
@@ -45,17 +51,47 @@ limitations under the License.
  * This function is based on the paper by
  * [1] Perona, P. and Malik, J., 1990. Scale-space and edge detection using anisotropic diffusion. IEEE Transactions on pattern analysis and machine intelligence, 12(7), pp.629-639.
  * [2] Black, M.J., Sapiro, G., Marimont, D.H. and Heeger, D., 1998. Robust anisotropic diffusion. IEEE Transactions on image processing, 7(3), pp.421-432.
+ *
+ * Diffusion_CPU_multi solves the problem for K lambdas in lockstep (planar storage, fixed number
+ * of iterations) and returns the K results one after the other in Output
+ *
+ * LinearDiff_MG_CPU_main goes straight to the steady state of linear diffusion with a fidelity
+ * term: it solves (W - lambda*Laplacian) u = W*f with multigrid V-cycles (multigrid.h) instead
+ * of the explicit time steps. W - per-voxel fidelity weights (NULL - 1), which gives a spatially
+ * varying regularisation (lambda/W) and masks (W = 0 - no data, the voxel is inpainted). The
+ * iterations are V-cycles, the tolerance applies to the relative residual of the system.
+ *
+ * Diffusion_CPU_tiled runs the 2D iterations on cache-sized tiles (tile.h): tile - tile edge,
+ * sync - iterations between halo exchanges, accuracy - 1 for the result of Diffusion_CPU_main,
+ * smaller for narrower halos (a fixed number of iterations, no tolerance)
+ *
+ * Diffusion_CPU_strided takes Input and Output as strided views (utils.h), rows pitchY and
+ * slices pitchZ floats apart, which the core gathers and scatters (planar storage); Output
+ * may be Input (in place), other overlaps are not allowed
  */
 
 
 #ifdef __cplusplus
 extern "C" {
 #endif
-CCPI_EXPORT float Diffusion_CPU_main(float *Input, float *Output, float *infovector, float lambdaPar, float sigmaPar, int iterationsNumb, float tau, int penaltytype, float epsil, int dimX, int dimY, int dimZ);
-CCPI_EXPORT float LinearDiff2D(float *Input, float *Output, float lambdaPar, float tau, long dimX, long dimY);
-CCPI_EXPORT float NonLinearDiff2D(float *Input, float *Output, float lambdaPar, float sigmaPar, float tau, int penaltytype, long dimX, long dimY);
-CCPI_EXPORT float LinearDiff3D(float *Input, float *Output, float lambdaPar, float tau, long dimX, long dimY, long dimZ);
-CCPI_EXPORT float NonLinearDiff3D(float *Input, float *Output, float lambdaPar, float sigmaPar, float tau, int penaltytype, long dimX, long dimY, long dimZ);
+CCPI_EXPORT float Diffusion_CPU_main(float *Input, float *Output, float *infovector, float lambdaPar, float sigmaPar, int iterationsNumb, float tau, int penaltytype, float epsil, int layout, int dimX, int dimY, int dimZ);
+CCPI_EXPORT float Diffusion_CPU_tiled(float *Input, float *Output, float *infovector, float lambdaPar, float sigmaPar, int iterationsNumb, float tau, int penaltytype, int tile, int sync, float accuracy, int dimX, int dimY);
+CCPI_EXPORT long Diffusion_CPU_tiled_mem(int tile, int sync, float accuracy, int dimX, int dimY);
+CCPI_EXPORT long Diffusion_CPU_mem(float epsil, int layout, int dimX, int dimY, int dimZ);
+CCPI_EXPORT float Diffusion_CPU_strided(float *Input, long inPitchY, long inPitchZ, float *Output, long outPitchY, long outPitchZ, float *infovector, float lambdaPar, float sigmaPar, int iterationsNumb, float tau, int penaltytype, float epsil, int dimX, int dimY, int dimZ);
+CCPI_EXPORT long Diffusion_CPU_strided_mem(float epsil, int in_strided, int out_strided, int dimX, int dimY, int dimZ);
+CCPI_EXPORT float LinearDiff_MG_CPU_main(float *Input, float *Output, float *infovector, float *Weights, float lambdaPar, int cycles, float epsil, int dimX, int dimY, int dimZ);
+CCPI_EXPORT long LinearDiff_MG_CPU_mem(int weights, int dimX, int dimY, int dimZ);
+CCPI_EXPORT float Diffusion_CPU_multi(float *Input, float *Output, float *infovector, float *lambdas, int K, float sigmaPar, int iterationsNumb, float tau, int penaltytype, int dimX, int dimY, int dimZ);
+CCPI_EXPORT long Diffusion_CPU_multi_mem(int K, int dimX, int dimY, int dimZ);
+CCPI_EXPORT float Diff_multi(float *Input, float *U, float *V, float *lambdas, int K, float sigmaPar, float tau, int penaltytype, long dimX, long dimY, long dimZ);
+CCPI_EXPORT float LinearDiff2D(float *Input, float *U, float *Output, float lambdaPar, float tau, output_pass *pass, long dimX, long dimY);
+CCPI_EXPORT float NonLinearDiff2D(float *Input, float *U, float *Output, float lambdaPar, float sigmaPar, float tau, int penaltytype, output_pass *pass, long dimX, long dimY);
+CCPI_EXPORT float LinearDiff3D(float *Input, float *U, float *Output, float lambdaPar, float tau, output_pass *pass, long dimX, long dimY, long dimZ);
+CCPI_EXPORT float NonLinearDiff3D(float *Input, float *U, float *Output, float lambdaPar, float sigmaPar, float tau, int penaltytype, output_pass *pass, long dimX, long dimY, long dimZ);
+CCPI_EXPORT float penaltyNDFc(float x, float sigmaPar, int penaltytype);
+CCPI_EXPORT float LinearDiff3D_br(float *Input, float *U, float *Output, float *Out, float lambdaPar, float tau, long dimX, long dimY, long dimZ);
+CCPI_EXPORT float NonLinearDiff3D_br(float *Input, float *U, float *Output, float *Out, float lambdaPar, float sigmaPar, float tau, int penaltytype, long dimX, long dimY, long dimZ);
 #ifdef __cplusplus
 }
 #endif
@@ -19,6 +19,8 @@
 
 #include "FGP_TV_core.h"
 
+#define MIN(x, y) (((x) < (y)) ? (x) : (y))
+
 /* C-OMP implementation of FGP-TV [1] denoising/regularization model (2D/3D case)
  *
  * Input Parameters:
@@ -28,6 +30,8 @@
  * 4. eplsilon: tolerance constant
  * 5. TV-type: methodTV - 'iso' (0) or 'l1' (1)
  * 6. nonneg: 'nonnegativity (0 is OFF by default)
+ * 7. layout: storage of the 3D dual fields, planar P1/P2/P3 arrays (0), interleaved (x,y,z) triples (1)
+ *    or 8x8x8 bricks of all 3D work arrays (2)
  *
  * Output:
  * [1] Filtered/regularized image/volume
@@ -37,55 +41,122 @@
  * [1] Amir Beck and Marc Teboulle, "Fast Gradient-Based Algorithms for Constrained Total Variation Image Denoising and Deblurring Problems"
  */
 
-float TV_FGP_CPU_main(float *Input, float *Output, float *infovector, float lambdaPar, int iterationsNumb, float epsil, int methodTV, int nonneg, int dimX, int dimY, int dimZ)
+float TV_FGP_CPU_main(float *Input, float *Output, float *infovector, float lambdaPar, int iterationsNumb, float epsil, int methodTV, int nonneg, int layout, int dimX, int dimY, int dimZ)
 {
-    int ll;
+    int ll, last, fused = 0, progress, stop = 0;
+    output_pass *pass = NULL;
     long j, DimTotal;
     float re, re1;
     re = 0.0f; re1 = 0.0f;
     float tk = 1.0f;
     float tkp1 =1.0f;
     int count = 0;
+    /* the output pass (Output_bind) is applied by the planar Obj_func of the last iteration, which
+     * writes the final output, unless its operations change the output before the early stopping
+     * check reads it */
+    last = iterationsNumb-1;
 
     if (dimZ <= 1) {
         /*2D case */
         float *Output_prev=NULL, *P1=NULL, *P2=NULL, *P1_prev=NULL, *P2_prev=NULL, *R1=NULL, *R2=NULL;
         DimTotal = (long)(dimX*dimY);
 
-        if (epsil != 0.0f) Output_prev = calloc(DimTotal, sizeof(float));
-        P1 = calloc(DimTotal, sizeof(float));
-        P2 = calloc(DimTotal, sizeof(float));
-        P1_prev = calloc(DimTotal, sizeof(float));
-        P2_prev = calloc(DimTotal, sizeof(float));
-        R1 = calloc(DimTotal, sizeof(float));
-        R2 = calloc(DimTotal, sizeof(float));
+        if (epsil != 0.0f) Output_prev = Vol_calloc(DimTotal);
+        P1 = Vol_calloc(DimTotal);
+        P2 = Vol_calloc(DimTotal);
+        P1_prev = Vol_calloc(DimTotal);
+        P2_prev = Vol_calloc(DimTotal);
+        R1 = Vol_calloc(DimTotal);
+        R2 = Vol_calloc(DimTotal);
+        pass = Output_take(DimTotal, 1);
+        if ((pass != NULL) && (pass->nops > 0) && (epsil != 0.0f) && (last % 5 == 0)) last = -1;
+
+        /* the whole iteration loop runs in one parallel region, the kernels are split statically
+         * over its threads, so small images do not pay a fork/join per kernel; with the pool
+         * running the loop stays on the calling thread and the kernels go to the pool */
+        progress = Progress_active();
+#pragma omp parallel if(Pool_threads() == 0) firstprivate(tk, tkp1, count) private(j)
+        {
+        int it;
+        float rel = 0.0f;
+        for(it=0; it<iterationsNumb; it++) {
+
+            if ((epsil != 0.0f)  && (it % 5 == 0)) copyIm_ws(Output, Output_prev, DimTotal);
+            /* computing the gradient of the objective function, nonnegativity applied in the same pass */
+            Obj_func2D(Input, Output, R1, R2, lambdaPar, nonneg, (it == last) ? pass : NULL, (long)(dimX), (long)(dimY));
+
+            /*Taking a step towards minus of the gradient*/
+            Grad_func2D(P1, P2, Output, R1, R2, lambdaPar, (long)(dimX), (long)(dimY));
+
+            /* projection step */
+            Proj_func2D_ws(P1, P2, methodTV, DimTotal);
+
+            /*updating R and t (every thread keeps its own copy of t), storing old values*/
+            tkp1 = (1.0f + sqrtf(1.0f + 4.0f*tk*tk))*0.5f;
+            Rupd_func2D(P1, P1_prev, P2, P2_prev, R1, R2, tkp1, tk, DimTotal);
+            tk = tkp1;
+
+            /* check early stopping criteria */
+            if ((epsil != 0.0f)  && (it % 5 == 0)) {
+#pragma omp single
+                {re = 0.0f; re1 = 0.0f;}
+#pragma omp for reduction(+:re,re1)
+                for(j=0; j<DimTotal; j++)
+                {
+                    re += powf(Output[j] - Output_prev[j],2);
+                    re1 += powf(Output[j],2);
+                }
+                rel = sqrtf(re)/sqrtf(re1);
+                if (rel < epsil)  count++;
+                if (count > 3) break;
+            }
+            /* the thread that bound the progress record reports it, all threads stop together */
+            if (progress) {
+#pragma omp master
+                stop = Progress_step(it+1, rel);
+#pragma omp barrier
+                if (stop) break;
+            }
+        }
+#pragma omp barrier
+#pragma omp master
+        {ll = it; re = rel; fused = (it >= last) && (last >= 0);}
+        }
+        if (epsil != 0.0f) Vol_free(Output_prev);
+        Vol_free(P1); Vol_free(P2); Vol_free(P1_prev); Vol_free(P2_prev); Vol_free(R1); Vol_free(R2);
+    }
+    else if (layout == LAYOUT_INTERLEAVED) {
+        /*3D case, the dual fields are stored as interleaved (x,y,z) triples */
+        float *Output_prev=NULL, *P=NULL, *P_prev=NULL, *R=NULL;
+        DimTotal = (long)(dimX*dimY*dimZ);
+
+        if (epsil != 0.0f) Output_prev = Vol_calloc(DimTotal);
+        P = Vol_calloc(3*DimTotal);
+        P_prev = Vol_calloc(3*DimTotal);
+        R = Vol_calloc(3*DimTotal);
 
         /* begin iterations */
         for(ll=0; ll<iterationsNumb; ll++) {
 
-            if ((epsil != 0.0f)  && (ll % 5 == 0)) copyIm(Output, Output_prev, (long)(dimX), (long)(dimY), 1l);
+            if ((epsil != 0.0f)  && (ll % 5 == 0)) copyIm(Output, Output_prev, (long)(dimX), (long)(dimY), (long)(dimZ));
+
             /* computing the gradient of the objective function */
-            Obj_func2D(Input, Output, R1, R2, lambdaPar, (long)(dimX), (long)(dimY));
+            Obj_func3D_il(Input, Output, R, lambdaPar, (long)(dimX), (long)(dimY), (long)(dimZ));
 
             /* apply nonnegativity */
-            if (nonneg == 1) for(j=0; j<DimTotal; j++) {if (Output[j] < 0.0f) Output[j] = 0.0f;}
+            if (nonneg == 1) Nonneg_ws(Output, DimTotal);
 
             /*Taking a step towards minus of the gradient*/
-            Grad_func2D(P1, P2, Output, R1, R2, lambdaPar, (long)(dimX), (long)(dimY));
+            Grad_func3D_il(P, Output, R, lambdaPar, (long)(dimX), (long)(dimY), (long)(dimZ));
 
             /* projection step */
-            Proj_func2D(P1, P2, methodTV, DimTotal);
+            Proj_func3D_il(P, methodTV, DimTotal);
 
-            /*updating R and t*/
+            /*updating R and t, old values of P are stored in the same pass */
             tkp1 = (1.0f + sqrtf(1.0f + 4.0f*tk*tk))*0.5f;
-            Rupd_func2D(P1, P1_prev, P2, P2_prev, R1, R2, tkp1, tk, DimTotal);
-
-            /*storing old values*/
-            copyIm(P1, P1_prev, (long)(dimX), (long)(dimY), 1l);
-            copyIm(P2, P2_prev, (long)(dimX), (long)(dimY), 1l);
-            tk = tkp1;
+            Rupd_func3D_il(P, P_prev, R, tkp1, tk, DimTotal);
 
-            /* check early stopping criteria */
+            /* calculate norm - stopping rules*/
             if ((epsil != 0.0f)  && (ll % 5 == 0)) {
                 re = 0.0f; re1 = 0.0f;
                 for(j=0; j<DimTotal; j++)
@@ -94,39 +165,110 @@ float TV_FGP_CPU_main(float *Input, float *Output, float *infovector, float lamb
                     re1 += powf(Output[j],2);
                 }
                 re = sqrtf(re)/sqrtf(re1);
+                /* stop if the norm residual is less than the tolerance EPS */
+                if (re < epsil)  count++;
+                if (count > 3) break;
+            }
+            tk = tkp1;
+            if (Progress_step(ll+1, re)) break;
+        }
+
+        if (epsil != 0.0f) Vol_free(Output_prev);
+        Vol_free(P); Vol_free(P_prev); Vol_free(R);
+    }
+    else if (layout == LAYOUT_BRICKED) {
+        /*3D case, all work arrays are stored as 8x8x8 bricks */
+        float *Output_prev=NULL, *Input_b=NULL, *Output_b=NULL, *P1=NULL, *P2=NULL, *P3=NULL, *P1_prev=NULL, *P2_prev=NULL, *P3_prev=NULL, *R1=NULL, *R2=NULL, *R3=NULL;
+        DimTotal = Bricked_size((long)(dimX), (long)(dimY), (long)(dimZ));
+
+        if (epsil != 0.0f) Output_prev = Vol_calloc(DimTotal);
+        Input_b = Vol_calloc(DimTotal);
+        Output_b = Vol_calloc(DimTotal);
+        P1 = Vol_calloc(DimTotal);
+        P2 = Vol_calloc(DimTotal);
+        P3 = Vol_calloc(DimTotal);
+        P1_prev = Vol_calloc(DimTotal);
+        P2_prev = Vol_calloc(DimTotal);
+        P3_prev = Vol_calloc(DimTotal);
+        R1 = Vol_calloc(DimTotal);
+        R2 = Vol_calloc(DimTotal);
+        R3 = Vol_calloc(DimTotal);
+        Planar_to_bricked(Input, Input_b, NULL, (long)(dimX), (long)(dimY), (long)(dimZ));
+
+        /* begin iterations, the padding of the bricks stays zero in all arrays */
+        for(ll=0; ll<iterationsNumb; ll++) {
+
+            if ((epsil != 0.0f)  && (ll % 5 == 0)) copyIm(Output_b, Output_prev, DimTotal, 1l, 1l);
+
+            /* computing the gradient of the objective function */
+            Obj_func3D_br(Input_b, Output_b, R1, R2, R3, lambdaPar, (long)(dimX), (long)(dimY), (long)(dimZ));
+
+            /* apply nonnegativity */
+            if (nonneg == 1) Nonneg_ws(Output_b, DimTotal);
+
+            /*Taking a step towards minus of the gradient*/
+            Grad_func3D_br(P1, P2, P3, Output_b, R1, R2, R3, lambdaPar, (long)(dimX), (long)(dimY), (long)(dimZ));
+
+            /* projection and update steps are pointwise and run over the bricked arrays as they are */
+            Proj_func3D(P1, P2, P3, methodTV, DimTotal);
+
+            /*updating R and t*/
+            tkp1 = (1.0f + sqrtf(1.0f + 4.0f*tk*tk))*0.5f;
+            Rupd_func3D(P1, P1_prev, P2, P2_prev, P3, P3_prev, R1, R2, R3, tkp1, tk, DimTotal);
+
+            /* calculate norm - stopping rules*/
+            if ((epsil != 0.0f)  && (ll % 5 == 0)) {
+                re = 0.0f; re1 = 0.0f;
+                for(j=0; j<DimTotal; j++)
+                {
+                    re += powf(Output_b[j] - Output_prev[j],2);
+                    re1 += powf(Output_b[j],2);
+                }
+                re = sqrtf(re)/sqrtf(re1);
+                /* stop if the norm residual is less than the tolerance EPS */
                 if (re < epsil)  count++;
                 if (count > 3) break;
             }
+
+            /*storing old values*/
+            copyIm(P1, P1_prev, DimTotal, 1l, 1l);
+            copyIm(P2, P2_prev, DimTotal, 1l, 1l);
+            copyIm(P3, P3_prev, DimTotal, 1l, 1l);
+            tk = tkp1;
+            if (Progress_step(ll+1, re)) break;
         }
-        if (epsil != 0.0f) free(Output_prev);
-        free(P1); free(P2); free(P1_prev); free(P2_prev); free(R1); free(R2);
+        Bricked_to_planar(Output_b, Output, (long)(dimX), (long)(dimY), (long)(dimZ));
+
+        if (epsil != 0.0f) Vol_free(Output_prev);
+        Vol_free(Input_b); Vol_free(Output_b);
+        Vol_free(P1); Vol_free(P2); Vol_free(P3); Vol_free(P1_prev); Vol_free(P2_prev); Vol_free(P3_prev); Vol_free(R1); Vol_free(R2); Vol_free(R3);
     }
     else {
         /*3D case*/
         float *Output_prev=NULL, *P1=NULL, *P2=NULL, *P3=NULL, *P1_prev=NULL, *P2_prev=NULL, *P3_prev=NULL, *R1=NULL, *R2=NULL, *R3=NULL;
         DimTotal = (long)(dimX*dimY*dimZ);
 
-        if (epsil != 0.0f) Output_prev = calloc(DimTotal, sizeof(float));
-        P1 = calloc(DimTotal, sizeof(float));
-        P2 = calloc(DimTotal, sizeof(float));
-        P3 = calloc(DimTotal, sizeof(float));
-        P1_prev = calloc(DimTotal, sizeof(float));
-        P2_prev = calloc(DimTotal, sizeof(float));
-        P3_prev = calloc(DimTotal, sizeof(float));
-        R1 = calloc(DimTotal, sizeof(float));
-        R2 = calloc(DimTotal, sizeof(float));
-        R3 = calloc(DimTotal, sizeof(float));
+        if (epsil != 0.0f) Output_prev = Vol_calloc(DimTotal);
+        P1 = Vol_calloc(DimTotal);
+        P2 = Vol_calloc(DimTotal);
+        P3 = Vol_calloc(DimTotal);
+        P1_prev = Vol_calloc(DimTotal);
+        P2_prev = Vol_calloc(DimTotal);
+        P3_prev = Vol_calloc(DimTotal);
+        R1 = Vol_calloc(DimTotal);
+        R2 = Vol_calloc(DimTotal);
+        R3 = Vol_calloc(DimTotal);
+        pass = Output_take(DimTotal, 1);
+        if ((pass != NULL) && (pass->nops > 0) && (epsil != 0.0f) && (last % 5 == 0)) last = -1;
 
         /* begin iterations */
         for(ll=0; ll<iterationsNumb; ll++) {
 
             if ((epsil != 0.0f)  && (ll % 5 == 0)) copyIm(Output, Output_prev, (long)(dimX), (long)(dimY), (long)(dimZ));
 
-            /* computing the gradient of the objective function */
-            Obj_func3D(Input, Output, R1, R2, R3, lambdaPar, (long)(dimX), (long)(dimY), (long)(dimZ));
-
-            /* apply nonnegativity */
-            if (nonneg == 1) for(j=0; j<DimTotal; j++) {if (Output[j] < 0.0f) Output[j] = 0.0f;}
+            /* computing the gradient of the objective function, nonnegativity applied in the same pass */
+            Obj_func3D(Input, Output, R1, R2, R3, lambdaPar, nonneg, (ll == last) ? pass : NULL, (long)(dimX), (long)(dimY), (long)(dimZ));
+            fused = (ll == last);
 
             /*Taking a step towards minus of the gradient*/
             Grad_func3D(P1, P2, P3, Output, R1, R2, R3, lambdaPar, (long)(dimX), (long)(dimY), (long)(dimZ));
@@ -157,12 +299,15 @@ float TV_FGP_CPU_main(float *Input, float *Output, float *infovector, float lamb
             copyIm(P2, P2_prev, (long)(dimX), (long)(dimY), (long)(dimZ));
             copyIm(P3, P3_prev, (long)(dimX), (long)(dimY), (long)(dimZ));
             tk = tkp1;
+            if (Progress_step(ll+1, re)) break;
         }
 
-        if (epsil != 0.0f) free(Output_prev);
-        free(P1); free(P2); free(P3); free(P1_prev); free(P2_prev); free(P3_prev); free(R1); free(R2); free(R3);
+        if (epsil != 0.0f) Vol_free(Output_prev);
+        Vol_free(P1); Vol_free(P2); Vol_free(P3); Vol_free(P1_prev); Vol_free(P2_prev); Vol_free(P3_prev); Vol_free(R1); Vol_free(R2); Vol_free(R3);
     }
 
+    if (fused && (pass != NULL)) Output_done(pass, Output);
+
     /*adding info into info_vector */
     infovector[0] = (float)(ll);  /*iterations number (if stopped earlier based on tolerance)*/
     infovector[1] = re;  /* reached tolerance */
@@ -170,100 +315,477 @@ float TV_FGP_CPU_main(float *Input, float *Output, float *infovector, float lamb
     return 0;
 }
 
-float Obj_func2D(float *A, float *D, float *R1, float *R2, float lambda, long dimX, long dimY)
+/* Peak size in bytes of the work arrays allocated by TV_FGP_CPU_main */
+long TV_FGP_CPU_mem(float epsil, int layout, int dimX, int dimY, int dimZ)
 {
-    float val1, val2;
-    long i,j,index;
-#pragma omp parallel for shared(A,D,R1,R2) private(index,i,j,val1,val2)
-    for(j=0; j<dimY; j++) {
-        for(i=0; i<dimX; i++) {
-            index = j*dimX+i;
-            /* boundary conditions  */
-            if (i == 0) {val1 = 0.0f;} else {val1 = R1[j*dimX + (i-1)];}
-            if (j == 0) {val2 = 0.0f;} else {val2 = R2[(j-1)*dimX + i];}
-            D[index] = A[index] - lambda*(R1[index] + R2[index] - val1 - val2);
-        }}
+    long DimTotal;
+    DimTotal = (long)(dimX)*(long)(dimY)*(long)(dimZ);
+    /* P, P_prev and R per direction */
+    if (dimZ <= 1) return (6l + (epsil != 0.0f))*DimTotal*sizeof(float);
+    if (layout == LAYOUT_BRICKED) {
+        /* plus the bricked input and output */
+        DimTotal = Bricked_size((long)(dimX), (long)(dimY), (long)(dimZ));
+        return (11l + (epsil != 0.0f))*DimTotal*sizeof(float);
+    }
+    return (9l + (epsil != 0.0f))*DimTotal*sizeof(float);
+}
+
+/* strided views of the input and output (or in place): the input is gathered, the output
+ * scattered (Strided_to_planar), FGP does not start from a copy of the input */
+float TV_FGP_CPU_strided(float *Input, long inPitchY, long inPitchZ, float *Output, long outPitchY, long outPitchZ, float *infovector, float lambdaPar, int iterationsNumb, float epsil, int methodTV, int nonneg, int dimX, int dimY, int dimZ)
+{
+    float *A = Input, *U = Output;
+    long DimTotal = (long)(dimX)*(long)(dimY)*(long)(dimZ);
+    if (!STRIDED_DENSE(inPitchY, inPitchZ, dimX, dimY, dimZ) || (Input == Output)) {
+        A = (float*)calloc(DimTotal, sizeof(float));
+        Strided_to_planar(Input, inPitchY, inPitchZ, A, NULL, (long)(dimX), (long)(dimY), (long)(dimZ));
+    }
+    if (!STRIDED_DENSE(outPitchY, outPitchZ, dimX, dimY, dimZ)) U = (float*)calloc(DimTotal, sizeof(float));
+    TV_FGP_CPU_main(A, U, infovector, lambdaPar, iterationsNumb, epsil, methodTV, nonneg, LAYOUT_PLANAR, dimX, dimY, dimZ);
+    if (U != Output) {
+        Planar_to_strided(U, Output, outPitchY, outPitchZ, (long)(dimX), (long)(dimY), (long)(dimZ));
+        free(U);
+    }
+    if (A != Input) free(A);
+    return 0;
+}
+
+/* Peak size in bytes of the work arrays allocated by TV_FGP_CPU_strided: the planar copies of
+ * the strided (or in place) input and output */
+long TV_FGP_CPU_strided_mem(float epsil, int in_strided, int out_strided, int dimX, int dimY, int dimZ)
+{
+    return TV_FGP_CPU_mem(epsil, LAYOUT_PLANAR, dimX, dimY, dimZ) + (long)(in_strided + out_strided)*dimX*dimY*dimZ*sizeof(float);
+}
+
+/* the iterations of a tile, the state is the output, R1, R2, P1_prev and P2_prev, the work
+ * arrays P1 and P2; t is brought to iteration it0 */
+typedef struct {
+    float lambda;
+    int methodTV, nonneg;
+} fgp_tile_args;
+
+static void TV_FGP_tile(void *arg, float *A, float **S, float **W, long nx, long ny, int it0, int iterations)
+{
+    fgp_tile_args *p = (fgp_tile_args*)arg;
+    float tk = 1.0f, tkp1;
+    long DimTotal = nx*ny;
+    int i;
+    for(i=0; i<it0; i++) tk = (1.0f + sqrtf(1.0f + 4.0f*tk*tk))*0.5f;
+    for(i=0; i<iterations; i++) {
+        Obj_func2D(A, S[0], S[1], S[2], p->lambda, p->nonneg, NULL, nx, ny);
+        Grad_func2D(W[0], W[1], S[0], S[1], S[2], p->lambda, nx, ny);
+        Proj_func2D_ws(W[0], W[1], p->methodTV, DimTotal);
+        tkp1 = (1.0f + sqrtf(1.0f + 4.0f*tk*tk))*0.5f;
+        Rupd_func2D(W[0], S[3], W[1], S[4], S[1], S[2], tkp1, tk, DimTotal);
+        tk = tkp1;
+    }
+}
+
+float TV_FGP_CPU_tiled(float *Input, float *Output, float *infovector, float lambdaPar, int iterationsNumb, int methodTV, int nonneg, int tile, int sync, float accuracy, int dimX, int dimY)
+{
+    fgp_tile_args p = {lambdaPar, methodTV, nonneg};
+    float *State[5];
+    long DimTotal = (long)(dimX)*(long)(dimY);
+    int q;
+    State[0] = Output;
+    for(q=1; q<5; q++) State[q] = Vol_calloc(DimTotal);
+    Tile_run(TV_FGP_tile, &p, 5, 2, 1, Input, State, iterationsNumb, tile, sync, accuracy, (long)(dimX), (long)(dimY));
+    for(q=1; q<5; q++) Vol_free(State[q]);
+    infovector[0] = (float)(iterationsNumb);
+    infovector[1] = 0.0f;
+    return 0;
+}
+
+/* Peak size in bytes of the work arrays allocated by TV_FGP_CPU_tiled: R and P_prev per direction
+ * and those of the tiles */
+long TV_FGP_CPU_tiled_mem(int tile, int sync, float accuracy, int dimX, int dimY)
+{
+    return 4l*dimX*dimY*sizeof(float) + Tile_mem(5, 2, 1, tile, sync, accuracy, (long)(dimX), (long)(dimY));
+}
+
+/* The planar kernels are bodies over rows, (k,j) in 3D and j in 2D (elements for the update of R),
+ * started by Run_rows; the 2D kernels are called by every thread of the parallel region of the
+ * 2D solver and start them with Run_rows_team (pool.h). Rupd_func2D also stores P into P_old */
+typedef struct {
+    float *A, *D, *P1, *P2, *P3, *P1_old, *P2_old, *P3_old, *R1, *R2, *R3;
+    float lambda, multip;
+    long dimX, dimY, dimZ;
+    int nonneg;         /* Obj_func clamps D to >= 0 */
+    output_pass *pass;  /* applied by Obj_func to the rows of D (Output_rows), NULL - none */
+} fgp_args;
+
+static void Obj_func_rows(void *arg, long r0, long r1)
+{
+    fgp_args *a = (fgp_args*)arg;
+    float *A = a->A, *D = a->D, *R1 = a->R1, *R2 = a->R2, *R3 = a->R3, lambda = a->lambda;
+    long dimX = a->dimX, dimY = a->dimY, dimZ = a->dimZ;
+    float val1, val2, val3;
+    long i,j,k,r,index;
+    output_acc acc;
+    if (a->pass != NULL) Output_open(a->pass, &acc);
+    for(r=r0; r<r1; r++) {
+        k = r/dimY; j = r - k*dimY;
+        if (dimZ > 1) {
+            for(i=0; i<dimX; i++) {
+                index = (dimX*dimY)*k + j*dimX+i;
+                /* boundary conditions */
+                if (i == 0) {val1 = 0.0f;} else {val1 = R1[(dimX*dimY)*k + j*dimX + (i-1)];}
+                if (j == 0) {val2 = 0.0f;} else {val2 = R2[(dimX*dimY)*k + (j-1)*dimX + i];}
+                if (k == 0) {val3 = 0.0f;} else {val3 = R3[(dimX*dimY)*(k-1) + j*dimX + i];}
+                D[index] = A[index] - lambda*(R1[index] + R2[index] + R3[index] - val1 - val2 - val3);
+                if (a->nonneg && (D[index] < 0.0f)) D[index] = 0.0f;
+            }
+        }
+        else {
+            for(i=0; i<dimX; i++) {
+                index = j*dimX+i;
+                /* boundary conditions  */
+                if (i == 0) {val1 = 0.0f;} else {val1 = R1[j*dimX + (i-1)];}
+                if (j == 0) {val2 = 0.0f;} else {val2 = R2[(j-1)*dimX + i];}
+                D[index] = A[index] - lambda*(R1[index] + R2[index] - val1 - val2);
+                if (a->nonneg && (D[index] < 0.0f)) D[index] = 0.0f;
+            }
+        }
+        if (a->pass != NULL) Output_rows(a->pass, &acc, D + (dimX*dimY)*k + j*dimX, dimX);
+    }
+    if (a->pass != NULL) Output_close(a->pass, &acc);
+}
+static void Grad_func_rows(void *arg, long r0, long r1)
+{
+    fgp_args *a = (fgp_args*)arg;
+    float *P1 = a->P1, *P2 = a->P2, *P3 = a->P3, *D = a->D, *R1 = a->R1, *R2 = a->R2, *R3 = a->R3, multip = a->multip;
+    long dimX = a->dimX, dimY = a->dimY, dimZ = a->dimZ;
+    float val1, val2, val3;
+    long i,j,k,r,index;
+    for(r=r0; r<r1; r++) {
+        k = r/dimY; j = r - k*dimY;
+        if (dimZ > 1) {
+            for(i=0; i<dimX; i++) {
+                index = (dimX*dimY)*k + j*dimX+i;
+                /* boundary conditions */
+                if (i == dimX-1) val1 = 0.0f; else val1 = D[index] - D[(dimX*dimY)*k + j*dimX + (i+1)];
+                if (j == dimY-1) val2 = 0.0f; else val2 = D[index] - D[(dimX*dimY)*k + (j+1)*dimX + i];
+                if (k == dimZ-1) val3 = 0.0f; else val3 = D[index] - D[(dimX*dimY)*(k+1) + j*dimX + i];
+                P1[index] = R1[index] + multip*val1;
+                P2[index] = R2[index] + multip*val2;
+                P3[index] = R3[index] + multip*val3;
+            }
+        }
+        else {
+            for(i=0; i<dimX; i++) {
+                index = j*dimX+i;
+                /* boundary conditions */
+                if (i == dimX-1) val1 = 0.0f; else val1 = D[index] - D[j*dimX + (i+1)];
+                if (j == dimY-1) val2 = 0.0f; else val2 = D[index] - D[(j+1)*dimX + i];
+                P1[index] = R1[index] + multip*val1;
+                P2[index] = R2[index] + multip*val2;
+            }
+        }
+    }
+}
+/* over the elements, P_old is only stored in 2D (the 3D solvers copy it after the stopping check) */
+static void Rupd_func_rows(void *arg, long r0, long r1)
+{
+    fgp_args *a = (fgp_args*)arg;
+    float *P1 = a->P1, *P2 = a->P2, *P3 = a->P3, *P1_old = a->P1_old, *P2_old = a->P2_old, *P3_old = a->P3_old;
+    float *R1 = a->R1, *R2 = a->R2, *R3 = a->R3, multip = a->multip;
+    long i;
+    if (P3 != NULL) {
+        for(i=r0; i<r1; i++) {
+            R1[i] = P1[i] + multip*(P1[i] - P1_old[i]);
+            R2[i] = P2[i] + multip*(P2[i] - P2_old[i]);
+            R3[i] = P3[i] + multip*(P3[i] - P3_old[i]);
+        }
+    }
+    else {
+        for(i=r0; i<r1; i++) {
+            R1[i] = P1[i] + multip*(P1[i] - P1_old[i]);
+            R2[i] = P2[i] + multip*(P2[i] - P2_old[i]);
+            P1_old[i] = P1[i];
+            P2_old[i] = P2[i];
+        }
+    }
+}
+
+float Obj_func2D(float *A, float *D, float *R1, float *R2, float lambda, int nonneg, output_pass *pass, long dimX, long dimY)
+{
+    fgp_args a = {A, D, NULL, NULL, NULL, NULL, NULL, NULL, R1, R2, NULL, lambda, 0.0f, dimX, dimY, 1l, nonneg, pass};
+    Run_rows_team(dimY, Obj_func_rows, &a);
     return *D;
 }
 float Grad_func2D(float *P1, float *P2, float *D, float *R1, float *R2, float lambda,  long dimX, long dimY)
 {
-    float val1, val2, multip;
-    long i,j,index;
-    multip = (1.0f/(8.0f*lambda));
-#pragma omp parallel for shared(P1,P2,D,R1,R2,multip) private(index,i,j,val1,val2)
-    for(j=0; j<dimY; j++) {
-        for(i=0; i<dimX; i++) {
-            index = j*dimX+i;
-            /* boundary conditions */
-            if (i == dimX-1) val1 = 0.0f; else val1 = D[index] - D[j*dimX + (i+1)];
-            if (j == dimY-1) val2 = 0.0f; else val2 = D[index] - D[(j+1)*dimX + i];
-            P1[index] = R1[index] + multip*val1;
-            P2[index] = R2[index] + multip*val2;
-        }}
+    fgp_args a = {NULL, D, P1, P2, NULL, NULL, NULL, NULL, R1, R2, NULL, lambda, 1.0f/(8.0f*lambda), dimX, dimY, 1l};
+    Run_rows_team(dimY, Grad_func_rows, &a);
     return 1;
 }
 float Rupd_func2D(float *P1, float *P1_old, float *P2, float *P2_old, float *R1, float *R2, float tkp1, float tk, long DimTotal)
 {
-    long i;
-    float multip;
-    multip = ((tk-1.0f)/tkp1);
-#pragma omp parallel for shared(P1,P2,P1_old,P2_old,R1,R2,multip) private(i)
-    for(i=0; i<DimTotal; i++) {
-        R1[i] = P1[i] + multip*(P1[i] - P1_old[i]);
-        R2[i] = P2[i] + multip*(P2[i] - P2_old[i]);
-    }
+    fgp_args a = {NULL, NULL, P1, P2, NULL, P1_old, P2_old, NULL, R1, R2, NULL, 0.0f, (tk-1.0f)/tkp1, DimTotal, 1l, 1l};
+    Run_rows_team(DimTotal, Rupd_func_rows, &a);
     return 1;
 }
 
 /* 3D-case related Functions */
 /*****************************************************************/
-float Obj_func3D(float *A, float *D, float *R1, float *R2, float *R3, float lambda, long dimX, long dimY, long dimZ)
+float Obj_func3D(float *A, float *D, float *R1, float *R2, float *R3, float lambda, int nonneg, output_pass *pass, long dimX, long dimY, long dimZ)
+{
+    fgp_args a = {A, D, NULL, NULL, NULL, NULL, NULL, NULL, R1, R2, R3, lambda, 0.0f, dimX, dimY, dimZ, nonneg, pass};
+    Run_rows(dimZ*dimY, Obj_func_rows, &a);
+    return *D;
+}
+float Grad_func3D(float *P1, float *P2, float *P3, float *D, float *R1, float *R2, float *R3, float lambda, long dimX, long dimY, long dimZ)
+{
+    fgp_args a = {NULL, D, P1, P2, P3, NULL, NULL, NULL, R1, R2, R3, lambda, 1.0f/(26.0f*lambda), dimX, dimY, dimZ};
+    Run_rows(dimZ*dimY, Grad_func_rows, &a);
+    return 1;
+}
+float Rupd_func3D(float *P1, float *P1_old, float *P2, float *P2_old, float *P3, float *P3_old, float *R1, float *R2, float *R3, float tkp1, float tk, long DimTotal)
+{
+    fgp_args a = {NULL, NULL, P1, P2, P3, P1_old, P2_old, P3_old, R1, R2, R3, 0.0f, (tk-1.0f)/tkp1, DimTotal, 1l, 1l};
+    Run_rows(DimTotal, Rupd_func_rows, &a);
+    return 1;
+}
+
+/* 3D-case Functions for the interleaved layout, P[3*index + 0,1,2] keeps the (x,y,z) components */
+/*****************************************************************/
+float Obj_func3D_il(float *A, float *D, float *R, float lambda, long dimX, long dimY, long dimZ)
 {
     float val1, val2, val3;
     long i,j,k,index;
-#pragma omp parallel for shared(A,D,R1,R2,R3) private(index,i,j,k,val1,val2,val3)
+#pragma omp parallel for shared(A,D,R) private(index,i,j,k,val1,val2,val3)
     for(k=0; k<dimZ; k++) {
         for(j=0; j<dimY; j++) {
             for(i=0; i<dimX; i++) {
                 index = (dimX*dimY)*k + j*dimX+i;
                 /* boundary conditions */
-                if (i == 0) {val1 = 0.0f;} else {val1 = R1[(dimX*dimY)*k + j*dimX + (i-1)];}
-                if (j == 0) {val2 = 0.0f;} else {val2 = R2[(dimX*dimY)*k + (j-1)*dimX + i];}
-                if (k == 0) {val3 = 0.0f;} else {val3 = R3[(dimX*dimY)*(k-1) + j*dimX + i];}
-                D[index] = A[index] - lambda*(R1[index] + R2[index] + R3[index] - val1 - val2 - val3);
+                if (i == 0) {val1 = 0.0f;} else {val1 = R[3*(index-1)];}
+                if (j == 0) {val2 = 0.0f;} else {val2 = R[3*(index-dimX) + 1];}
+                if (k == 0) {val3 = 0.0f;} else {val3 = R[3*(index-dimX*dimY) + 2];}
+                D[index] = A[index] - lambda*(R[3*index] + R[3*index+1] + R[3*index+2] - val1 - val2 - val3);
             }}}
     return *D;
 }
-float Grad_func3D(float *P1, float *P2, float *P3, float *D, float *R1, float *R2, float *R3, float lambda, long dimX, long dimY, long dimZ)
+float Grad_func3D_il(float *P, float *D, float *R, float lambda, long dimX, long dimY, long dimZ)
 {
     float val1, val2, val3, multip;
     long i,j,k, index;
     multip = (1.0f/(26.0f*lambda));
-#pragma omp parallel for shared(P1,P2,P3,D,R1,R2,R3,multip) private(index,i,j,k,val1,val2,val3)
+#pragma omp parallel for shared(P,D,R,multip) private(index,i,j,k,val1,val2,val3)
     for(k=0; k<dimZ; k++) {
         for(j=0; j<dimY; j++) {
             for(i=0; i<dimX; i++) {
                 index = (dimX*dimY)*k + j*dimX+i;
                 /* boundary conditions */
-                if (i == dimX-1) val1 = 0.0f; else val1 = D[index] - D[(dimX*dimY)*k + j*dimX + (i+1)];
-                if (j == dimY-1) val2 = 0.0f; else val2 = D[index] - D[(dimX*dimY)*k + (j+1)*dimX + i];
-                if (k == dimZ-1) val3 = 0.0f; else val3 = D[index] - D[(dimX*dimY)*(k+1) + j*dimX + i];
-                P1[index] = R1[index] + multip*val1;
-                P2[index] = R2[index] + multip*val2;
-                P3[index] = R3[index] + multip*val3;
+                if (i == dimX-1) val1 = 0.0f; else val1 = D[index] - D[index+1];
+                if (j == dimY-1) val2 = 0.0f; else val2 = D[index] - D[index+dimX];
+                if (k == dimZ-1) val3 = 0.0f; else val3 = D[index] - D[index+dimX*dimY];
+                P[3*index] = R[3*index] + multip*val1;
+                P[3*index+1] = R[3*index+1] + multip*val2;
+                P[3*index+2] = R[3*index+2] + multip*val3;
             }}}
     return 1;
 }
-float Rupd_func3D(float *P1, float *P1_old, float *P2, float *P2_old, float *P3, float *P3_old, float *R1, float *R2, float *R3, float tkp1, float tk, long DimTotal)
+float Rupd_func3D_il(float *P, float *P_old, float *R, float tkp1, float tk, long DimTotal)
 {
     long i;
     float multip;
     multip = ((tk-1.0f)/tkp1);
-#pragma omp parallel for shared(P1,P2,P3,P1_old,P2_old,P3_old,R1,R2,R3,multip) private(i)
-    for(i=0; i<DimTotal; i++) {
-        R1[i] = P1[i] + multip*(P1[i] - P1_old[i]);
-        R2[i] = P2[i] + multip*(P2[i] - P2_old[i]);
-        R3[i] = P3[i] + multip*(P3[i] - P3_old[i]);
+#pragma omp parallel for shared(P,P_old,R,multip) private(i)
+    for(i=0; i<3*DimTotal; i++) {
+        R[i] = P[i] + multip*(P[i] - P_old[i]);
+        P_old[i] = P[i];
     }
     return 1;
 }
+
+/* 3D-case Functions for the bricked layout, see BIDX in utils.h */
+/*****************************************************************/
+float Obj_func3D_br(float *A, float *D, float *R1, float *R2, float *R3, float lambda, long dimX, long dimY, long dimZ)
+{
+    float val1, val2, val3;
+    long b,i,j,k,i0,j0,k0,index,nbX,nbY,nbZ;
+    nbX = (dimX+BRICK-1)/BRICK; nbY = (dimY+BRICK-1)/BRICK; nbZ = (dimZ+BRICK-1)/BRICK;
+#pragma omp parallel for shared(A,D,R1,R2,R3) private(b,index,i,j,k,i0,j0,k0,val1,val2,val3)
+    for(b=0; b<nbX*nbY*nbZ; b++) {
+        i0 = (b % nbX)*BRICK; j0 = ((b/nbX) % nbY)*BRICK; k0 = (b/(nbX*nbY))*BRICK;
+        for(k=k0; k<MIN(k0+BRICK,dimZ); k++) {
+            for(j=j0; j<MIN(j0+BRICK,dimY); j++) {
+                for(i=i0; i<MIN(i0+BRICK,dimX); i++) {
+                    index = BIDX(i,j,k,nbX,nbY);
+                    /* boundary conditions */
+                    if (i == 0) {val1 = 0.0f;} else {val1 = R1[BIDX(i-1,j,k,nbX,nbY)];}
+                    if (j == 0) {val2 = 0.0f;} else {val2 = R2[BIDX(i,j-1,k,nbX,nbY)];}
+                    if (k == 0) {val3 = 0.0f;} else {val3 = R3[BIDX(i,j,k-1,nbX,nbY)];}
+                    D[index] = A[index] - lambda*(R1[index] + R2[index] + R3[index] - val1 - val2 - val3);
+                }}}}
+    return *D;
+}
+float Grad_func3D_br(float *P1, float *P2, float *P3, float *D, float *R1, float *R2, float *R3, float lambda, long dimX, long dimY, long dimZ)
+{
+    float val1, val2, val3, multip;
+    long b,i,j,k,i0,j0,k0,index,nbX,nbY,nbZ;
+    multip = (1.0f/(26.0f*lambda));
+    nbX = (dimX+BRICK-1)/BRICK; nbY = (dimY+BRICK-1)/BRICK; nbZ = (dimZ+BRICK-1)/BRICK;
+#pragma omp parallel for shared(P1,P2,P3,D,R1,R2,R3,multip) private(b,index,i,j,k,i0,j0,k0,val1,val2,val3)
+    for(b=0; b<nbX*nbY*nbZ; b++) {
+        i0 = (b % nbX)*BRICK; j0 = ((b/nbX) % nbY)*BRICK; k0 = (b/(nbX*nbY))*BRICK;
+        for(k=k0; k<MIN(k0+BRICK,dimZ); k++) {
+            for(j=j0; j<MIN(j0+BRICK,dimY); j++) {
+                for(i=i0; i<MIN(i0+BRICK,dimX); i++) {
+                    index = BIDX(i,j,k,nbX,nbY);
+                    /* boundary conditions */
+                    if (i == dimX-1) val1 = 0.0f; else val1 = D[index] - D[BIDX(i+1,j,k,nbX,nbY)];
+                    if (j == dimY-1) val2 = 0.0f; else val2 = D[index] - D[BIDX(i,j+1,k,nbX,nbY)];
+                    if (k == dimZ-1) val3 = 0.0f; else val3 = D[index] - D[BIDX(i,j,k+1,nbX,nbY)];
+                    P1[index] = R1[index] + multip*val1;
+                    P2[index] = R2[index] + multip*val2;
+                    P3[index] = R3[index] + multip*val3;
+                }}}}
+    return 1;
+}
+
+/* Lockstep solution of K problems with different lambdas, the K lanes of a voxel are interleaved
+ * (D[index*K + l]) so that the stencil indices and the input are read once for all lanes.
+ * The kernels are work-shared loops called in the parallel region of TV_FGP_CPU_multi. */
+/*****************************************************************/
+static void Obj_func_multi(float *A, float *D, float *R1, float *R2, float *R3, float *lambdas, long K, long dimX, long dimY, long dimZ)
+{
+    float a0, m1, m2, m3;
+    long i,j,k,l,r,index,n1,n2,n3;
+#pragma omp for
+    for(r=0; r<dimY*dimZ; r++) {
+        k = r/dimY; j = r - k*dimY;
+        for(i=0; i<dimX; i++) {
+            index = (dimX*dimY)*k + j*dimX+i;
+            a0 = A[index];
+            /* boundary conditions, the missing backward neighbours are weighted by zero */
+            m1 = (float)(i > 0); n1 = ((i > 0) ? index-1 : index)*K;
+            m2 = (float)(j > 0); n2 = ((j > 0) ? index-dimX : index)*K;
+            m3 = (float)(k > 0); n3 = ((k > 0) ? index-dimX*dimY : index)*K;
+            index *= K;
+            if (dimZ > 1) {
+                OMP_SIMD
+                for(l=0; l<K; l++)
+                    D[index+l] = a0 - lambdas[l]*(R1[index+l] + R2[index+l] + R3[index+l] - m1*R1[n1+l] - m2*R2[n2+l] - m3*R3[n3+l]);
+            }
+            else {
+                OMP_SIMD
+                for(l=0; l<K; l++)
+                    D[index+l] = a0 - lambdas[l]*(R1[index+l] + R2[index+l] - m1*R1[n1+l] - m2*R2[n2+l]);
+            }
+        }}
+}
+static void Grad_func_multi(float *P1, float *P2, float *P3, float *D, float *R1, float *R2, float *R3, float *multip, long K, long dimX, long dimY, long dimZ)
+{
+    long i,j,k,l,r,index,n1,n2,n3;
+#pragma omp for
+    for(r=0; r<dimY*dimZ; r++) {
+        k = r/dimY; j = r - k*dimY;
+        for(i=0; i<dimX; i++) {
+            index = (dimX*dimY)*k + j*dimX+i;
+            /* boundary conditions, the voxel itself stands in for the missing forward neighbour */
+            n1 = ((i == dimX-1) ? index : index+1)*K;
+            n2 = ((j == dimY-1) ? index : index+dimX)*K;
+            n3 = ((k == dimZ-1) ? index : index+dimX*dimY)*K;
+            index *= K;
+            OMP_SIMD
+            for(l=0; l<K; l++) {
+                P1[index+l] = R1[index+l] + multip[l]*(D[index+l] - D[n1+l]);
+                P2[index+l] = R2[index+l] + multip[l]*(D[index+l] - D[n2+l]);
+            }
+            if (dimZ > 1) {
+                OMP_SIMD
+                for(l=0; l<K; l++)
+                    P3[index+l] = R3[index+l] + multip[l]*(D[index+l] - D[n3+l]);
+            }
+        }}
+}
+/* updating R of one component, storing P into P_old */
+static void Rupd_func_multi(float *P, float *P_old, float *R, float multip, long DimTotal)
+{
+    long i;
+#pragma omp for
+    for(i=0; i<DimTotal; i++) {
+        R[i] = P[i] + multip*(P[i] - P_old[i]);
+        P_old[i] = P[i];
+    }
+}
+
+/* Runs iterationsNumb FGP-TV iterations for the K regularisation parameters lambdas[0..K-1] in
+ * lockstep. Output keeps the K planar results one after the other. The iterations are not stopped
+ * on a tolerance (all lanes run the same number), infovector is [iterations, 0]. */
+float TV_FGP_CPU_multi(float *Input, float *Output, float *infovector, float *lambdas, int K, int iterationsNumb, int methodTV, int nonneg, int dimX, int dimY, int dimZ)
+{
+    float *D=NULL, *P1=NULL, *P2=NULL, *P3=NULL, *P1_prev=NULL, *P2_prev=NULL, *P3_prev=NULL, *R1=NULL, *R2=NULL, *R3=NULL, *multip=NULL;
+    long DimTotal, KTotal, j, l;
+    float tk = 1.0f;
+    float tkp1 = 1.0f;
+    DimTotal = (long)(dimX)*(long)(dimY)*(long)(dimZ);
+    KTotal = (long)(K)*DimTotal;
+
+    D = Vol_calloc(KTotal);
+    P1 = Vol_calloc(KTotal);
+    P2 = Vol_calloc(KTotal);
+    P1_prev = Vol_calloc(KTotal);
+    P2_prev = Vol_calloc(KTotal);
+    R1 = Vol_calloc(KTotal);
+    R2 = Vol_calloc(KTotal);
+    if (dimZ > 1) {
+        P3 = Vol_calloc(KTotal);
+        P3_prev = Vol_calloc(KTotal);
+        R3 = Vol_calloc(KTotal);
+    }
+    /* gradient step of every lane */
+    multip = (float*) malloc(K*sizeof(float));
+    for(l=0; l<K; l++) multip[l] = (dimZ > 1) ? 1.0f/(26.0f*lambdas[l]) : 1.0f/(8.0f*lambdas[l]);
+
+#pragma omp parallel firstprivate(tk, tkp1) private(j, l)
+    {
+    int it;
+    for(it=0; it<iterationsNumb; it++) {
+        /* computing the gradient of the objective function */
+        Obj_func_multi(Input, D, R1, R2, R3, lambdas, (long)(K), (long)(dimX), (long)(dimY), (long)(dimZ));
+
+        /* apply nonnegativity */
+        if (nonneg == 1) {
+#pragma omp for
+            for(j=0; j<KTotal; j++) {if (D[j] < 0.0f) D[j] = 0.0f;}
+        }
+
+        /*Taking a step towards minus of the gradient*/
+        Grad_func_multi(P1, P2, P3, D, R1, R2, R3, multip, (long)(K), (long)(dimX), (long)(dimY), (long)(dimZ));
+
+        /* projection step, pointwise over all lanes */
+        if (dimZ > 1) Proj_func3D_ws(P1, P2, P3, methodTV, KTotal);
+        else Proj_func2D_ws(P1, P2, methodTV, KTotal);
+
+        /*updating R and t (every thread keeps its own copy of t), storing old values*/
+        tkp1 = (1.0f + sqrtf(1.0f + 4.0f*tk*tk))*0.5f;
+        Rupd_func_multi(P1, P1_prev, R1, (tk-1.0f)/tkp1, KTotal);
+        Rupd_func_multi(P2, P2_prev, R2, (tk-1.0f)/tkp1, KTotal);
+        if (dimZ > 1) Rupd_func_multi(P3, P3_prev, R3, (tk-1.0f)/tkp1, KTotal);
+        tk = tkp1;
+    }
+    /* de-interleaving the lanes into the K outputs */
+#pragma omp for
+    for(j=0; j<DimTotal; j++) {
+        for(l=0; l<K; l++) Output[l*DimTotal+j] = D[j*K+l];
+    }
+    }
+    Vol_free(D); Vol_free(P1); Vol_free(P2); Vol_free(P1_prev); Vol_free(P2_prev); Vol_free(R1); Vol_free(R2); free(multip);
+    if (dimZ > 1) {Vol_free(P3); Vol_free(P3_prev); Vol_free(R3);}
+
+    infovector[0] = (float)(iterationsNumb);
+    infovector[1] = 0.0f;
+    return 0;
+}
+
+/* Peak size in bytes of the work arrays allocated by TV_FGP_CPU_multi */
+long TV_FGP_CPU_multi_mem(int K, int dimX, int dimY, int dimZ)
+{
+    long DimTotal;
+    DimTotal = (long)(dimX)*(long)(dimY)*(long)(dimZ);
+    /* the lanes of the output plus P, P_prev and R per direction */
+    return (long)(K)*((dimZ > 1) ? 10l : 7l)*DimTotal*sizeof(float) + K*sizeof(float);
+}
@@ -24,6 +24,8 @@ limitations under the License.
 #include <stdio.h>
 #include "omp.h"
 #include "utils.h"
+#include "pool.h"
+#include "tile.h"
 #include "CCPiDefines.h"
 
 /* C-OMP implementation of FGP-TV [1] denoising/regularization model (2D/3D case)
@@ -35,6 +37,8 @@ limitations under the License.
  * 4. eplsilon: tolerance constant
  * 5. TV-type: methodTV - 'iso' (0) or 'l1' (1)
  * 6. nonneg: 'nonnegativity (0 is OFF by default)
+ * 7. layout: storage of the 3D dual fields, planar P1/P2/P3 arrays (0), interleaved (x,y,z) triples (1)
+ *    or 8x8x8 bricks of all 3D work arrays (2)
  *
  * Output:
  * [1] Filtered/regularized image/volume
@@ -43,20 +47,44 @@ limitations under the License.
  *
  * This function is based on the Matlab's code and paper by
  * [1] Amir Beck and Marc Teboulle, "Fast Gradient-Based Algorithms for Constrained Total Variation Image Denoising and Deblurring Problems"
+ *
+ * TV_FGP_CPU_multi solves the problem for K lambdas in lockstep (planar storage, fixed number
+ * of iterations) and returns the K results one after the other in Output *
+ * TV_FGP_CPU_tiled runs the 2D iterations on cache-sized tiles (tile.h): tile - tile edge,
+ * sync - iterations between halo exchanges, accuracy - 1 for the result of TV_FGP_CPU_main,
+ * smaller for narrower halos (a fixed number of iterations, no tolerance)
+ *
+ * TV_FGP_CPU_strided takes Input and Output as strided views (utils.h), rows pitchY and slices
+ * pitchZ floats apart, which are gathered and scattered around TV_FGP_CPU_main (planar storage);
+ * Output may be Input (in place), other overlaps are not allowed
  */
 
 #ifdef __cplusplus
 extern "C" {
 #endif
-CCPI_EXPORT float TV_FGP_CPU_main(float *Input, float *Output, float *infovector, float lambdaPar, int iterationsNumb, float epsil, int methodTV, int nonneg, int dimX, int dimY, int dimZ);
+CCPI_EXPORT float TV_FGP_CPU_main(float *Input, float *Output, float *infovector, float lambdaPar, int iterationsNumb, float epsil, int methodTV, int nonneg, int layout, int dimX, int dimY, int dimZ);
+CCPI_EXPORT long TV_FGP_CPU_mem(float epsil, int layout, int dimX, int dimY, int dimZ);
+CCPI_EXPORT float TV_FGP_CPU_multi(float *Input, float *Output, float *infovector, float *lambdas, int K, int iterationsNumb, int methodTV, int nonneg, int dimX, int dimY, int dimZ);
+CCPI_EXPORT float TV_FGP_CPU_strided(float *Input, long inPitchY, long inPitchZ, float *Output, long outPitchY, long outPitchZ, float *infovector, float lambdaPar, int iterationsNumb, float epsil, int methodTV, int nonneg, int dimX, int dimY, int dimZ);
+CCPI_EXPORT long TV_FGP_CPU_strided_mem(float epsil, int in_strided, int out_strided, int dimX, int dimY, int dimZ);
+CCPI_EXPORT float TV_FGP_CPU_tiled(float *Input, float *Output, float *infovector, float lambdaPar, int iterationsNumb, int methodTV, int nonneg, int tile, int sync, float accuracy, int dimX, int dimY);
+CCPI_EXPORT long TV_FGP_CPU_tiled_mem(int tile, int sync, float accuracy, int dimX, int dimY);
+CCPI_EXPORT long TV_FGP_CPU_multi_mem(int K, int dimX, int dimY, int dimZ);
 
-CCPI_EXPORT float Obj_func2D(float *A, float *D, float *R1, float *R2, float lambda, long dimX, long dimY);
+CCPI_EXPORT float Obj_func2D(float *A, float *D, float *R1, float *R2, float lambda, int nonneg, output_pass *pass, long dimX, long dimY);
 CCPI_EXPORT float Grad_func2D(float *P1, float *P2, float *D, float *R1, float *R2, float lambda, long dimX, long dimY);
 CCPI_EXPORT float Rupd_func2D(float *P1, float *P1_old, float *P2, float *P2_old, float *R1, float *R2, float tkp1, float tk, long DimTotal);
 
-CCPI_EXPORT float Obj_func3D(float *A, float *D, float *R1, float *R2, float *R3, float lambda, long dimX, long dimY, long dimZ);
+CCPI_EXPORT float Obj_func3D(float *A, float *D, float *R1, float *R2, float *R3, float lambda, int nonneg, output_pass *pass, long dimX, long dimY, long dimZ);
 CCPI_EXPORT float Grad_func3D(float *P1, float *P2, float *P3, float *D, float *R1, float *R2, float *R3, float lambda, long dimX, long dimY, long dimZ);
 CCPI_EXPORT float Rupd_func3D(float *P1, float *P1_old, float *P2, float *P2_old, float *P3, float *P3_old, float *R1, float *R2, float *R3, float tkp1, float tk, long DimTotal);
+
+CCPI_EXPORT float Obj_func3D_il(float *A, float *D, float *R, float lambda, long dimX, long dimY, long dimZ);
+CCPI_EXPORT float Grad_func3D_il(float *P, float *D, float *R, float lambda, long dimX, long dimY, long dimZ);
+CCPI_EXPORT float Rupd_func3D_il(float *P, float *P_old, float *R, float tkp1, float tk, long DimTotal);
+
+CCPI_EXPORT float Obj_func3D_br(float *A, float *D, float *R1, float *R2, float *R3, float lambda, long dimX, long dimY, long dimZ);
+CCPI_EXPORT float Grad_func3D_br(float *P1, float *P2, float *P3, float *D, float *R1, float *R2, float *R3, float lambda, long dimX, long dimY, long dimZ);
 #ifdef __cplusplus
 }
 #endif
@@ -32,7 +32,7 @@
  * 6. eta: smoothing constant to calculate gradient of the reference [OPTIONAL] *
  * 7. TV-type: methodTV - 'iso' (0) or 'l1' (1) [OPTIONAL]
  * 8. nonneg: 'nonnegativity (0 is OFF by default) [OPTIONAL]
- * 9. print information: 0 (off) or 1 (on) [OPTIONAL]
+ * 9. layout: storage of the 3D dual fields, planar arrays (0) or interleaved (x,y,z) triples (1) [OPTIONAL]
  *
  * Output:
  * [1] Filtered/regularized image/volume
@@ -43,116 +43,57 @@
  * [2] M. J. Ehrhardt and M. M. Betcke, Multi-Contrast MRI Reconstruction with Structure-Guided Total Variation, SIAM Journal on Imaging Sciences 9(3), pp. 1084–1106
  */
 
-float dTV_FGP_CPU_main(float *Input, float *InputRef, float *Output, float *infovector, float lambdaPar, int iterationsNumb, float epsil, float eta, int methodTV, int nonneg, int dimX, int dimY, int dimZ)
+float dTV_FGP_CPU_main(float *Input, float *InputRef, float *Output, float *infovector, float lambdaPar, int iterationsNumb, float epsil, float eta, int methodTV, int nonneg, int layout, int dimX, int dimY, int dimZ)
 {
     int ll;
     long j, DimTotal;
-    float re, re1;
+    float re = 0.0f, re1;
     re = 0.0f; re1 = 0.0f;
     float tk = 1.0f;
     float tkp1=1.0f;
     int count = 0;
 
 
-    float *Output_prev=NULL, *P1=NULL, *P2=NULL, *P1_prev=NULL, *P2_prev=NULL, *R1=NULL, *R2=NULL, *InputRef_x=NULL, *InputRef_y=NULL;
+    float *Output_prev=NULL;
     DimTotal = (long)(dimX*dimY*dimZ);
 
-    if (epsil != 0.0f) Output_prev = calloc(DimTotal, sizeof(float));
-    P1 = calloc(DimTotal, sizeof(float));
-    P2 = calloc(DimTotal, sizeof(float));
-    P1_prev = calloc(DimTotal, sizeof(float));
-    P2_prev = calloc(DimTotal, sizeof(float));
-    R1 = calloc(DimTotal, sizeof(float));
-    R2 = calloc(DimTotal, sizeof(float));
-    InputRef_x = calloc(DimTotal, sizeof(float));
-    InputRef_y = calloc(DimTotal, sizeof(float));
-
-    if (dimZ <= 1) {
-        /*2D case */
-        /* calculate gradient field (smoothed) for the reference image */
-        GradNorm_func2D(InputRef, InputRef_x, InputRef_y, eta, (long)(dimX), (long)(dimY));
+    if (epsil != 0.0f) Output_prev = Vol_calloc(DimTotal);
 
-        /* begin iterations */
-        for(ll=0; ll<iterationsNumb; ll++) {
-
-            if ((epsil != 0.0f)  && (ll % 5 == 0)) copyIm(Output, Output_prev, (long)(dimX), (long)(dimY), 1l);
-            /*projects a 2D vector field R-1,2 onto the orthogonal complement of another 2D vector field InputRef_xy*/
-            ProjectVect_func2D(R1, R2, InputRef_x, InputRef_y, (long)(dimX), (long)(dimY));
-
-            /* computing the gradient of the objective function */
-            Obj_dfunc2D(Input, Output, R1, R2, lambdaPar, (long)(dimX), (long)(dimY));
-
-            /* apply nonnegativity */
-            if (nonneg == 1) for(j=0; j<DimTotal; j++) {if (Output[j] < 0.0f) Output[j] = 0.0f;}
-
-            /*Taking a step towards minus of the gradient*/
-            Grad_dfunc2D(P1, P2, Output, R1, R2, InputRef_x, InputRef_y, lambdaPar, (long)(dimX), (long)(dimY));
+    if ((dimZ > 1) && (layout == LAYOUT_INTERLEAVED)) {
+        /*3D case, the dual fields and the reference gradient are stored as interleaved (x,y,z) triples */
+        float *P=NULL, *P_prev=NULL, *R=NULL, *InputRef_xyz=NULL;
 
-            /* projection step */
-            Proj_func2D(P1, P2, methodTV, DimTotal);
-
-            /*updating R and t*/
-            tkp1 = (1.0f + sqrt(1.0f + 4.0f*tk*tk))*0.5f;
-            Rupd_dfunc2D(P1, P1_prev, P2, P2_prev, R1, R2, tkp1, tk, DimTotal);
-
-            copyIm(P1, P1_prev, (long)(dimX), (long)(dimY), 1l);
-            copyIm(P2, P2_prev, (long)(dimX), (long)(dimY), 1l);
-            tk = tkp1;
-
-            /* check early stopping criteria */
-            if ((epsil != 0.0f)  && (ll % 5 == 0)) {
-                re = 0.0f; re1 = 0.0f;
-                for(j=0; j<DimTotal; j++)
-                {
-                    re += powf(Output[j] - Output_prev[j],2);
-                    re1 += powf(Output[j],2);
-                }
-                re = sqrtf(re)/sqrtf(re1);
-                if (re < epsil)  count++;
-                if (count > 3) break;
-            }
-        }
-    }
-    else {
-        /*3D case*/
-        float *P3=NULL, *P3_prev=NULL, *R3=NULL, *InputRef_z=NULL;
-
-        P3 = calloc(DimTotal, sizeof(float));
-        P3_prev = calloc(DimTotal, sizeof(float));
-        R3 = calloc(DimTotal, sizeof(float));
-        InputRef_z = calloc(DimTotal, sizeof(float));
+        P = Vol_calloc(3*DimTotal);
+        P_prev = Vol_calloc(3*DimTotal);
+        R = Vol_calloc(3*DimTotal);
+        InputRef_xyz = Vol_calloc(3*DimTotal);
 
         /* calculate gradient field (smoothed) for the reference volume */
-        GradNorm_func3D(InputRef, InputRef_x, InputRef_y, InputRef_z, eta, (long)(dimX), (long)(dimY), (long)(dimZ));
+        GradNorm_func3D_il(InputRef, InputRef_xyz, eta, (long)(dimX), (long)(dimY), (long)(dimZ));
 
         /* begin iterations */
         for(ll=0; ll<iterationsNumb; ll++) {
 
             if ((epsil != 0.0f)  && (ll % 5 == 0)) copyIm(Output, Output_prev, (long)(dimX), (long)(dimY), (long)(dimZ));
 
-            /*projects a 3D vector field R-1,2,3 onto the orthogonal complement of another 3D vector field InputRef_xyz*/
-            ProjectVect_func3D(R1, R2, R3, InputRef_x, InputRef_y, InputRef_z, (long)(dimX), (long)(dimY), (long)(dimZ));
+            /*projects a 3D vector field R onto the orthogonal complement of another 3D vector field InputRef_xyz*/
+            ProjectVect_func3D_il(R, InputRef_xyz, DimTotal);
 
             /* computing the gradient of the objective function */
-            Obj_dfunc3D(Input, Output, R1, R2, R3, lambdaPar, (long)(dimX), (long)(dimY), (long)(dimZ));
+            Obj_dfunc3D_il(Input, Output, R, lambdaPar, (long)(dimX), (long)(dimY), (long)(dimZ));
 
             /* apply nonnegativity */
             if (nonneg == 1) for(j=0; j<DimTotal; j++) {if (Output[j] < 0.0f) Output[j] = 0.0f;}
 
             /*Taking a step towards minus of the gradient*/
-            Grad_dfunc3D(P1, P2, P3, Output, R1, R2, R3, InputRef_x, InputRef_y, InputRef_z, lambdaPar, (long)(dimX), (long)(dimY), (long)(dimZ));
+            Grad_dfunc3D_il(P, Output, R, InputRef_xyz, lambdaPar, (long)(dimX), (long)(dimY), (long)(dimZ));
 
             /* projection step */
-            Proj_func3D(P1, P2, P3, methodTV, DimTotal);
+            Proj_func3D_il(P, methodTV, DimTotal);
 
-            /*updating R and t*/
+            /*updating R and t, old values of P are stored in the same pass */
             tkp1 = (1.0f + sqrt(1.0f + 4.0f*tk*tk))*0.5f;
-            Rupd_dfunc3D(P1, P1_prev, P2, P2_prev, P3, P3_prev, R1, R2, R3, tkp1, tk, DimTotal);
-
-            /*storing old values*/
-            copyIm(P1, P1_prev, (long)(dimX), (long)(dimY), (long)(dimZ));
-            copyIm(P2, P2_prev, (long)(dimX), (long)(dimY), (long)(dimZ));
-            copyIm(P3, P3_prev, (long)(dimX), (long)(dimY), (long)(dimZ));
+            Rupd_dfunc3D_il(P, P_prev, R, tkp1, tk, DimTotal);
             tk = tkp1;
 
             /* check early stopping criteria */
@@ -167,12 +108,130 @@ float dTV_FGP_CPU_main(float *Input, float *InputRef, float *Output, float *info
                 if (re < epsil)  count++;
                 if (count > 3) break;
             }
+            if (Progress_step(ll+1, re)) break;
         }
+        Vol_free(P); Vol_free(P_prev); Vol_free(R); Vol_free(InputRef_xyz);
+    }
+    else {
+        float *P1=NULL, *P2=NULL, *P1_prev=NULL, *P2_prev=NULL, *R1=NULL, *R2=NULL, *InputRef_x=NULL, *InputRef_y=NULL;
+        P1 = Vol_calloc(DimTotal);
+        P2 = Vol_calloc(DimTotal);
+        P1_prev = Vol_calloc(DimTotal);
+        P2_prev = Vol_calloc(DimTotal);
+        R1 = Vol_calloc(DimTotal);
+        R2 = Vol_calloc(DimTotal);
+        InputRef_x = Vol_calloc(DimTotal);
+        InputRef_y = Vol_calloc(DimTotal);
+
+        if (dimZ <= 1) {
+            /*2D case */
+            /* calculate gradient field (smoothed) for the reference image */
+            GradNorm_func2D(InputRef, InputRef_x, InputRef_y, eta, (long)(dimX), (long)(dimY));
+
+            /* begin iterations */
+            for(ll=0; ll<iterationsNumb; ll++) {
+
+                if ((epsil != 0.0f)  && (ll % 5 == 0)) copyIm(Output, Output_prev, (long)(dimX), (long)(dimY), 1l);
+                /*projects a 2D vector field R-1,2 onto the orthogonal complement of another 2D vector field InputRef_xy*/
+                ProjectVect_func2D(R1, R2, InputRef_x, InputRef_y, (long)(dimX), (long)(dimY));
+
+                /* computing the gradient of the objective function */
+                Obj_dfunc2D(Input, Output, R1, R2, lambdaPar, (long)(dimX), (long)(dimY));
+
+                /* apply nonnegativity */
+                if (nonneg == 1) for(j=0; j<DimTotal; j++) {if (Output[j] < 0.0f) Output[j] = 0.0f;}
+
+                /*Taking a step towards minus of the gradient*/
+                Grad_dfunc2D(P1, P2, Output, R1, R2, InputRef_x, InputRef_y, lambdaPar, (long)(dimX), (long)(dimY));
+
+                /* projection step */
+                Proj_func2D(P1, P2, methodTV, DimTotal);
+
+                /*updating R and t*/
+                tkp1 = (1.0f + sqrt(1.0f + 4.0f*tk*tk))*0.5f;
+                Rupd_dfunc2D(P1, P1_prev, P2, P2_prev, R1, R2, tkp1, tk, DimTotal);
+
+                copyIm(P1, P1_prev, (long)(dimX), (long)(dimY), 1l);
+                copyIm(P2, P2_prev, (long)(dimX), (long)(dimY), 1l);
+                tk = tkp1;
+
+                /* check early stopping criteria */
+                if ((epsil != 0.0f)  && (ll % 5 == 0)) {
+                    re = 0.0f; re1 = 0.0f;
+                    for(j=0; j<DimTotal; j++)
+                    {
+                        re += powf(Output[j] - Output_prev[j],2);
+                        re1 += powf(Output[j],2);
+                    }
+                    re = sqrtf(re)/sqrtf(re1);
+                    if (re < epsil)  count++;
+                    if (count > 3) break;
+                }
+                if (Progress_step(ll+1, re)) break;
+            }
+        }
+        else {
+            /*3D case*/
+            float *P3=NULL, *P3_prev=NULL, *R3=NULL, *InputRef_z=NULL;
+
+            P3 = Vol_calloc(DimTotal);
+            P3_prev = Vol_calloc(DimTotal);
+            R3 = Vol_calloc(DimTotal);
+            InputRef_z = Vol_calloc(DimTotal);
+
+            /* calculate gradient field (smoothed) for the reference volume */
+            GradNorm_func3D(InputRef, InputRef_x, InputRef_y, InputRef_z, eta, (long)(dimX), (long)(dimY), (long)(dimZ));
+
+            /* begin iterations */
+            for(ll=0; ll<iterationsNumb; ll++) {
+
+                if ((epsil != 0.0f)  && (ll % 5 == 0)) copyIm(Output, Output_prev, (long)(dimX), (long)(dimY), (long)(dimZ));
+
+                /*projects a 3D vector field R-1,2,3 onto the orthogonal complement of another 3D vector field InputRef_xyz*/
+                ProjectVect_func3D(R1, R2, R3, InputRef_x, InputRef_y, InputRef_z, (long)(dimX), (long)(dimY), (long)(dimZ));
+
+                /* computing the gradient of the objective function */
+                Obj_dfunc3D(Input, Output, R1, R2, R3, lambdaPar, (long)(dimX), (long)(dimY), (long)(dimZ));
+
+                /* apply nonnegativity */
+                if (nonneg == 1) for(j=0; j<DimTotal; j++) {if (Output[j] < 0.0f) Output[j] = 0.0f;}
+
+                /*Taking a step towards minus of the gradient*/
+                Grad_dfunc3D(P1, P2, P3, Output, R1, R2, R3, InputRef_x, InputRef_y, InputRef_z, lambdaPar, (long)(dimX), (long)(dimY), (long)(dimZ));
+
+                /* projection step */
+                Proj_func3D(P1, P2, P3, methodTV, DimTotal);
+
+                /*updating R and t*/
+                tkp1 = (1.0f + sqrt(1.0f + 4.0f*tk*tk))*0.5f;
+                Rupd_dfunc3D(P1, P1_prev, P2, P2_prev, P3, P3_prev, R1, R2, R3, tkp1, tk, DimTotal);
+
+                /*storing old values*/
+                copyIm(P1, P1_prev, (long)(dimX), (long)(dimY), (long)(dimZ));
+                copyIm(P2, P2_prev, (long)(dimX), (long)(dimY), (long)(dimZ));
+                copyIm(P3, P3_prev, (long)(dimX), (long)(dimY), (long)(dimZ));
+                tk = tkp1;
+
+                /* check early stopping criteria */
+                if ((epsil != 0.0f)  && (ll % 5 == 0)) {
+                    re = 0.0f; re1 = 0.0f;
+                    for(j=0; j<DimTotal; j++)
+                    {
+                        re += powf(Output[j] - Output_prev[j],2);
+                        re1 += powf(Output[j],2);
+                    }
+                    re = sqrtf(re)/sqrtf(re1);
+                    if (re < epsil)  count++;
+                    if (count > 3) break;
+                }
+                if (Progress_step(ll+1, re)) break;
+            }
 
-        free(P3); free(P3_prev); free(R3); free(InputRef_z);
+            Vol_free(P3); Vol_free(P3_prev); Vol_free(R3); Vol_free(InputRef_z);
+        }
+        Vol_free(P1); Vol_free(P2); Vol_free(P1_prev); Vol_free(P2_prev); Vol_free(R1); Vol_free(R2); Vol_free(InputRef_x); Vol_free(InputRef_y);
     }
-    if (epsil != 0.0f) free(Output_prev);
-    free(P1); free(P2); free(P1_prev); free(P2_prev); free(R1); free(R2); free(InputRef_x); free(InputRef_y);
+    if (epsil != 0.0f) Vol_free(Output_prev);
 
     /*adding info into info_vector */
     infovector[0] = (float)(ll);  /*iterations number (if stopped earlier based on tolerance)*/
@@ -181,6 +240,16 @@ float dTV_FGP_CPU_main(float *Input, float *InputRef, float *Output, float *info
     return 0;
 }
 
+/* Peak size in bytes of the work arrays allocated by dTV_FGP_CPU_main */
+long dTV_FGP_CPU_mem(float epsil, int layout, int dimX, int dimY, int dimZ)
+{
+    long DimTotal;
+    DimTotal = (long)(dimX)*(long)(dimY)*(long)(dimZ);
+    /* P, P_prev, R and the normalised gradient of the reference per direction */
+    if (dimZ <= 1) return (8l + (epsil != 0.0f))*DimTotal*sizeof(float);
+    return (12l + (epsil != 0.0f))*DimTotal*sizeof(float);
+}
+
 
 /********************************************************************/
 /***************************2D Functions*****************************/
@@ -376,3 +445,105 @@ float Rupd_dfunc3D(float *P1, float *P1_old, float *P2, float *P2_old, float *P3
     }
     return 1;
 }
+
+/********************************************************************/
+/*************3D Functions for the interleaved layout****************/
+/********************************************************************/
+/* the (x,y,z) components of the vector fields are kept at [3*index + 0,1,2] */
+float GradNorm_func3D_il(float *B, float *B_xyz, float eta, long dimX, long dimY, long dimZ)
+{
+    long i, j, k, index;
+    float val1, val2, val3, gradX, gradY, gradZ, magn;
+#pragma omp parallel for shared(B, B_xyz) private(i,j,k,index,val1,val2,val3,gradX,gradY,gradZ,magn)
+    for(k=0; k<dimZ; k++) {
+        for(j=0; j<dimY; j++) {
+            for(i=0; i<dimX; i++) {
+
+                index = (dimX*dimY)*k + j*dimX+i;
+
+                /* zero boundary conditions */
+                if (i == dimX-1) {val1 = 0.0f;} else {val1 = B[index+1];}
+                if (j == dimY-1) {val2 = 0.0f;} else {val2 = B[index+dimX];}
+                if (k == dimZ-1) {val3 = 0.0f;} else {val3 = B[index+dimX*dimY];}
+
+                gradX = val1 - B[index];
+                gradY = val2 - B[index];
+                gradZ = val3 - B[index];
+                magn = pow(gradX,2) + pow(gradY,2) + pow(gradZ,2);
+                magn = sqrt(magn + pow(eta,2)); /* the eta-smoothed gradients magnitude */
+                B_xyz[3*index] = gradX/magn;
+                B_xyz[3*index+1] = gradY/magn;
+                B_xyz[3*index+2] = gradZ/magn;
+            }}}
+    return 1;
+}
+
+float ProjectVect_func3D_il(float *R, float *B_xyz, long DimTotal)
+{
+    long i;
+    float in_prod;
+#pragma omp parallel for shared(R, B_xyz) private(i,in_prod)
+    for(i=0; i<DimTotal; i++) {
+        in_prod = R[3*i]*B_xyz[3*i] + R[3*i+1]*B_xyz[3*i+1] + R[3*i+2]*B_xyz[3*i+2];   /* calculate inner product */
+        R[3*i] = R[3*i] - in_prod*B_xyz[3*i];
+        R[3*i+1] = R[3*i+1] - in_prod*B_xyz[3*i+1];
+        R[3*i+2] = R[3*i+2] - in_prod*B_xyz[3*i+2];
+    }
+    return 1;
+}
+
+float Obj_dfunc3D_il(float *A, float *D, float *R, float lambda, long dimX, long dimY, long dimZ)
+{
+    float val1, val2, val3;
+    long i,j,k,index;
+#pragma omp parallel for shared(A,D,R) private(index,i,j,k,val1,val2,val3)
+    for(k=0; k<dimZ; k++) {
+        for(j=0; j<dimY; j++) {
+            for(i=0; i<dimX; i++) {
+                index = (dimX*dimY)*k + j*dimX+i;
+                /* boundary conditions */
+                if (i == 0) {val1 = 0.0f;} else {val1 = R[3*(index-1)];}
+                if (j == 0) {val2 = 0.0f;} else {val2 = R[3*(index-dimX) + 1];}
+                if (k == 0) {val3 = 0.0f;} else {val3 = R[3*(index-dimX*dimY) + 2];}
+                D[index] = A[index] - lambda*(R[3*index] + R[3*index+1] + R[3*index+2] - val1 - val2 - val3);
+            }}}
+    return *D;
+}
+float Grad_dfunc3D_il(float *P, float *D, float *R, float *B_xyz, float lambda, long dimX, long dimY, long dimZ)
+{
+    float val1, val2, val3, multip, in_prod;
+    long i,j,k, index;
+    multip = (1.0f/(26.0f*lambda));
+#pragma omp parallel for shared(P,D,R,B_xyz,multip) private(index,i,j,k,val1,val2,val3,in_prod)
+    for(k=0; k<dimZ; k++) {
+        for(j=0; j<dimY; j++) {
+            for(i=0; i<dimX; i++) {
+                index = (dimX*dimY)*k + j*dimX+i;
+                /* boundary conditions */
+                if (i == dimX-1) val1 = 0.0f; else val1 = D[index] - D[index+1];
+                if (j == dimY-1) val2 = 0.0f; else val2 = D[index] - D[index+dimX];
+                if (k == dimZ-1) val3 = 0.0f; else val3 = D[index] - D[index+dimX*dimY];
+
+                in_prod = val1*B_xyz[3*index] + val2*B_xyz[3*index+1] + val3*B_xyz[3*index+2];   /* calculate inner product */
+                val1 = val1 - in_prod*B_xyz[3*index];
+                val2 = val2 - in_prod*B_xyz[3*index+1];
+                val3 = val3 - in_prod*B_xyz[3*index+2];
+
+                P[3*index] = R[3*index] + multip*val1;
+                P[3*index+1] = R[3*index+1] + multip*val2;
+                P[3*index+2] = R[3*index+2] + multip*val3;
+            }}}
+    return 1;
+}
+float Rupd_dfunc3D_il(float *P, float *P_old, float *R, float tkp1, float tk, long DimTotal)
+{
+    long i;
+    float multip;
+    multip = ((tk-1.0f)/tkp1);
+#pragma omp parallel for shared(P,P_old,R,multip) private(i)
+    for(i=0; i<3*DimTotal; i++) {
+        R[i] = P[i] + multip*(P[i] - P_old[i]);
+        P_old[i] = P[i];
+    }
+    return 1;
+}
@@ -39,7 +39,7 @@ limitations under the License.
  * 6. eta: smoothing constant to calculate gradient of the reference [OPTIONAL] *
  * 7. TV-type: methodTV - 'iso' (0) or 'l1' (1) [OPTIONAL]
  * 8. nonneg: 'nonnegativity (0 is OFF by default) [OPTIONAL]
- * 9. print information: 0 (off) or 1 (on) [OPTIONAL]
+ * 9. layout: storage of the 3D dual fields, planar arrays (0) or interleaved (x,y,z) triples (1) [OPTIONAL]
  *
  * Output:
  * [1] Filtered/regularized image/volume
@@ -53,7 +53,8 @@ limitations under the License.
 #ifdef __cplusplus
 extern "C" {
 #endif
-CCPI_EXPORT float dTV_FGP_CPU_main(float *Input, float *InputRef, float *Output, float *infovector, float lambdaPar, int iterationsNumb, float epsil, float eta, int methodTV, int nonneg, int dimX, int dimY, int dimZ);
+CCPI_EXPORT float dTV_FGP_CPU_main(float *Input, float *InputRef, float *Output, float *infovector, float lambdaPar, int iterationsNumb, float epsil, float eta, int methodTV, int nonneg, int layout, int dimX, int dimY, int dimZ);
+CCPI_EXPORT long dTV_FGP_CPU_mem(float epsil, int layout, int dimX, int dimY, int dimZ);
 
 CCPI_EXPORT float GradNorm_func2D(float *B, float *B_x, float *B_y, float eta, long dimX, long dimY);
 CCPI_EXPORT float ProjectVect_func2D(float *R1, float *R2, float *B_x, float *B_y, long dimX, long dimY);
@@ -66,6 +67,12 @@ CCPI_EXPORT float ProjectVect_func3D(float *R1, float *R2, float *R3, float *B_x
 CCPI_EXPORT float Obj_dfunc3D(float *A, float *D, float *R1, float *R2, float *R3, float lambda, long dimX, long dimY, long dimZ);
 CCPI_EXPORT float Grad_dfunc3D(float *P1, float *P2, float *P3, float *D, float *R1, float *R2, float *R3, float *B_x, float *B_y, float *B_z, float lambda, long dimX, long dimY, long dimZ);
 CCPI_EXPORT float Rupd_dfunc3D(float *P1, float *P1_old, float *P2, float *P2_old, float *P3, float *P3_old, float *R1, float *R2, float *R3, float tkp1, float tk, long DimTotal);
+
+CCPI_EXPORT float GradNorm_func3D_il(float *B, float *B_xyz, float eta, long dimX, long dimY, long dimZ);
+CCPI_EXPORT float ProjectVect_func3D_il(float *R, float *B_xyz, long DimTotal);
+CCPI_EXPORT float Obj_dfunc3D_il(float *A, float *D, float *R, float lambda, long dimX, long dimY, long dimZ);
+CCPI_EXPORT float Grad_dfunc3D_il(float *P, float *D, float *R, float *B_xyz, float lambda, long dimX, long dimY, long dimZ);
+CCPI_EXPORT float Rupd_dfunc3D_il(float *P, float *P_old, float *R, float tkp1, float tk, long DimTotal);
 #ifdef __cplusplus
 }
 #endif
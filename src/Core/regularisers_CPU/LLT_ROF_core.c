@@ -41,6 +41,7 @@ int signLLT(float x) {
  * 4. tau - time-marching step
  * 5. iter - iterations number (for both models)
  * 6. eplsilon: tolerance constant
+ * 7. algorithm: explicit time marching (0) or the primal-dual solver (1), see LLT_ROF_core.h
  *
  * Output:
  * [1] Filtered/regularized image/volume
@@ -51,27 +52,64 @@ int signLLT(float x) {
  * [2] Rudin, Osher, Fatemi, "Nonlinear Total Variation based noise removal algorithms"
  */
 
-float LLT_ROF_CPU_main(float *Input, float *Output, float *infovector, float lambdaROF, float lambdaLLT, int iterationsNumb, float tau, float epsil, int dimX, int dimY, int dimZ)
+float LLT_ROF_CPU_main(float *Input, float *Output, float *infovector, float lambdaROF, float lambdaLLT, int iterationsNumb, float tau, float epsil, int algorithm, int dimX, int dimY, int dimZ)
 {
     long DimTotal;
     int ll, j;
-    float re, re1;
+    float re = 0.0f, re1;
     re = 0.0f; re1 = 0.0f;
     int count = 0;
     
     float *D1_LLT=NULL, *D2_LLT=NULL, *D3_LLT=NULL, *D1_ROF=NULL, *D2_ROF=NULL, *D3_ROF=NULL, *Output_prev=NULL;
     DimTotal = (long)(dimX*dimY*dimZ);
     
-    D1_ROF = calloc(DimTotal, sizeof(float));
-    D2_ROF = calloc(DimTotal, sizeof(float));
-    D3_ROF = calloc(DimTotal, sizeof(float));
+    if (algorithm == LLT_ROF_PRIMAL_DUAL) {
+        /* the dual fields of TV (P) and of the second differences (Q), U_bar - the extrapolated
+         * solution the dual step is taken at */
+        float *U_bar=NULL, *P1=NULL, *P2=NULL, *P3=NULL, *Q1=NULL, *Q2=NULL, *Q3=NULL;
+        float sigma, theta, step;
+        
+        tau = 1.0f/sqrtf(20.0f*((dimZ == 1) ? 2.0f : 3.0f));
+        sigma = tau;
+        U_bar = Vol_calloc(DimTotal);
+        P1 = Vol_calloc(DimTotal); P2 = Vol_calloc(DimTotal);
+        Q1 = Vol_calloc(DimTotal); Q2 = Vol_calloc(DimTotal);
+        if (dimZ > 1) {P3 = Vol_calloc(DimTotal); Q3 = Vol_calloc(DimTotal);}
+        copyIm(Input, Output, (long)(dimX), (long)(dimY), (long)(dimZ)); /* initialize  */
+        copyIm(Input, U_bar, (long)(dimX), (long)(dimY), (long)(dimZ));
+        
+        for(ll = 0; ll < iterationsNumb; ll++) {
+            DualLLT_ROF(U_bar, P1, P2, P3, Q1, Q2, Q3, lambdaROF, lambdaLLT, sigma, (long)(dimX), (long)(dimY), (long)(dimZ));
+            /* the fidelity is strongly convex with gamma = 1 */
+            step = tau;
+            theta = PD_steps(1.0f, &tau, &sigma);
+            re = PrimalLLT_ROF(Input, Output, U_bar, P1, P2, P3, Q1, Q2, Q3, step, theta, (long)(dimX), (long)(dimY), (long)(dimZ));
+            
+            /* check early stopping criteria */
+            if ((epsil != 0.0f) && (ll % 5 == 0)) {
+                if (re < epsil)  count++;
+                if (count > 3) break;
+            }
+            if (Progress_step(ll+1, re)) break;
+        }
+        Vol_free(U_bar); Vol_free(P1); Vol_free(P2); Vol_free(Q1); Vol_free(Q2);
+        if (dimZ > 1) {Vol_free(P3); Vol_free(Q3);}
+        
+        infovector[0] = (float)(ll);
+        infovector[1] = re;
+        return 0;
+    }
+    
+    D1_ROF = Vol_calloc(DimTotal);
+    D2_ROF = Vol_calloc(DimTotal);
+    D3_ROF = Vol_calloc(DimTotal);
     
-    D1_LLT = calloc(DimTotal, sizeof(float));
-    D2_LLT = calloc(DimTotal, sizeof(float));
-    D3_LLT = calloc(DimTotal, sizeof(float));
+    D1_LLT = Vol_calloc(DimTotal);
+    D2_LLT = Vol_calloc(DimTotal);
+    D3_LLT = Vol_calloc(DimTotal);
     
     copyIm(Input, Output, (long)(dimX), (long)(dimY), (long)(dimZ)); /* initialize  */
-    if (epsil != 0.0f) Output_prev = calloc(DimTotal, sizeof(float));
+    if (epsil != 0.0f) Output_prev = Vol_calloc(DimTotal);
     
     for(ll = 0; ll < iterationsNumb; ll++) {
         if ((epsil != 0.0f) && (ll % 5 == 0)) copyIm(Output, Output_prev, (long)(dimX), (long)(dimY), (long)(dimZ));
@@ -114,10 +152,11 @@ float LLT_ROF_CPU_main(float *Input, float *Output, float *infovector, float lam
             if (count > 3) break;
         }
         
+        if (Progress_step(ll+1, re)) break;
     } /*end of iterations*/
-    free(D1_LLT);free(D2_LLT);free(D3_LLT);
-    free(D1_ROF);free(D2_ROF);free(D3_ROF);
-    if (epsil != 0.0f) free(Output_prev);
+    Vol_free(D1_LLT);Vol_free(D2_LLT);Vol_free(D3_LLT);
+    Vol_free(D1_ROF);Vol_free(D2_ROF);Vol_free(D3_ROF);
+    if (epsil != 0.0f) Vol_free(Output_prev);
     
     /*adding info into info_vector */
     infovector[0] = (float)(ll);  /*iterations number (if stopped earlier based on tolerance)*/
@@ -125,6 +164,16 @@ float LLT_ROF_CPU_main(float *Input, float *Output, float *infovector, float lam
     return 0;
 }
 
+/* Peak size in bytes of the work arrays allocated by LLT_ROF_CPU_main, the six D arrays are used in 2D as well;
+ * the primal-dual solver keeps U_bar and two dual fields of one component per dimension */
+long LLT_ROF_CPU_mem(float epsil, int algorithm, int dimX, int dimY, int dimZ)
+{
+    long DimTotal;
+    DimTotal = (long)(dimX)*(long)(dimY)*(long)(dimZ);
+    if (algorithm == LLT_ROF_PRIMAL_DUAL) return (1l + ((dimZ == 1) ? 4l : 6l))*DimTotal*sizeof(float);
+    return (6l + (epsil != 0.0f))*DimTotal*sizeof(float);
+}
+
 /*************************************************************************/
 /**********************LLT-related functions *****************************/
 /*************************************************************************/
@@ -434,3 +483,91 @@ float Update3D_LLT_ROF(float *U0, float *U, float *D1_LLT, float *D2_LLT, float
     }
     return *U;
 }
+
+/*************************************************************************/
+/**********************Primal-dual LLT-ROF functions *********************/
+/*************************************************************************/
+
+/* Dual step at the extrapolated solution U: P (TV) takes the forward differences, zero across the
+ * last pixel (Neumann), and is projected on the balls of radius lambdaROF; Q (LLT) takes the second
+ * differences with Neumann boundaries and is clipped to [-lambdaLLT, lambdaLLT]. P3, Q3 are not
+ * used in 2D */
+float DualLLT_ROF(float *U, float *P1, float *P2, float *P3, float *Q1, float *Q2, float *Q3, float lambdaROF, float lambdaLLT, float sigma, long dimX, long dimY, long dimZ)
+{
+    long i, j, k, l, index, slice;
+    float u, nrm, scale, d2;
+    slice = dimX*dimY;
+#pragma omp parallel for shared(U,P1,P2,P3,Q1,Q2,Q3) private(i, j, k, l, index, u, nrm, scale, d2)
+    for (l = 0; l<dimY*dimZ; l++) {
+        j = l%dimY; k = l/dimY;
+        for (i = 0; i<dimX; i++) {
+            index = slice*k + j*dimX + i;
+            u = U[index];
+            
+            /*ROF-related part*/
+            if (i < dimX-1) P1[index] += sigma*(U[index+1] - u);
+            if (j < dimY-1) P2[index] += sigma*(U[index+dimX] - u);
+            nrm = P1[index]*P1[index] + P2[index]*P2[index];
+            if (dimZ > 1) {
+                if (k < dimZ-1) P3[index] += sigma*(U[index+slice] - u);
+                nrm += P3[index]*P3[index];
+            }
+            if (nrm > lambdaROF*lambdaROF) {
+                scale = lambdaROF/sqrtf(nrm);
+                P1[index] *= scale; P2[index] *= scale;
+                if (dimZ > 1) P3[index] *= scale;
+            }
+            
+            /*LLT-related part*/
+            d2 = ((i > 0) ? (U[index-1] - u) : 0.0f) + ((i < dimX-1) ? (U[index+1] - u) : 0.0f);
+            Q1[index] = MAX(-lambdaLLT, MIN(lambdaLLT, Q1[index] + sigma*d2));
+            d2 = ((j > 0) ? (U[index-dimX] - u) : 0.0f) + ((j < dimY-1) ? (U[index+dimX] - u) : 0.0f);
+            Q2[index] = MAX(-lambdaLLT, MIN(lambdaLLT, Q2[index] + sigma*d2));
+            if (dimZ > 1) {
+                d2 = ((k > 0) ? (U[index-slice] - u) : 0.0f) + ((k < dimZ-1) ? (U[index+slice] - u) : 0.0f);
+                Q3[index] = MAX(-lambdaLLT, MIN(lambdaLLT, Q3[index] + sigma*d2));
+            }
+        }
+    }
+    return 1;
+}
+
+/* Primal step: the proximal step of the fidelity with the divergence of P and the second differences
+ * of Q (the adjoint operators), then the extrapolation U_bar = U + theta*(U - U_old). Returns the
+ * relative change of U */
+float PrimalLLT_ROF(float *U0, float *U, float *U_bar, float *P1, float *P2, float *P3, float *Q1, float *Q2, float *Q3, float tau, float theta, long dimX, long dimY, long dimZ)
+{
+    long i, j, k, l, index, slice;
+    float div, laplc, u, u_old;
+    double re, re1;
+    re = 0.0; re1 = 0.0;
+    slice = dimX*dimY;
+#pragma omp parallel for shared(U0,U,U_bar,P1,P2,P3,Q1,Q2,Q3) private(i, j, k, l, index, div, laplc, u, u_old) reduction(+:re,re1)
+    for (l = 0; l<dimY*dimZ; l++) {
+        j = l%dimY; k = l/dimY;
+        for (i = 0; i<dimX; i++) {
+            index = slice*k + j*dimX + i;
+            
+            /*ROF-related part*/
+            div = ((i < dimX-1) ? P1[index] : 0.0f) - ((i > 0) ? P1[index-1] : 0.0f) +
+                  ((j < dimY-1) ? P2[index] : 0.0f) - ((j > 0) ? P2[index-dimX] : 0.0f);
+            
+            /*LLT-related part*/
+            laplc = ((i > 0) ? (Q1[index-1] - Q1[index]) : 0.0f) + ((i < dimX-1) ? (Q1[index+1] - Q1[index]) : 0.0f) +
+                    ((j > 0) ? (Q2[index-dimX] - Q2[index]) : 0.0f) + ((j < dimY-1) ? (Q2[index+dimX] - Q2[index]) : 0.0f);
+            if (dimZ > 1) {
+                div += ((k < dimZ-1) ? P3[index] : 0.0f) - ((k > 0) ? P3[index-slice] : 0.0f);
+                laplc += ((k > 0) ? (Q3[index-slice] - Q3[index]) : 0.0f) + ((k < dimZ-1) ? (Q3[index+slice] - Q3[index]) : 0.0f);
+            }
+            
+            u_old = U[index];
+            u = (u_old + tau*(div - laplc + U0[index]))/(1.0f + tau);
+            U[index] = u;
+            U_bar[index] = u + theta*(u - u_old);
+            re += (double)((u - u_old)*(u - u_old));
+            re1 += (double)(u*u);
+        }
+    }
+    if (re1 == 0.0) return 0.0f;
+    return (float)(sqrt(re)/sqrt(re1));
+}
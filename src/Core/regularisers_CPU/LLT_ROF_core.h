@@ -37,6 +37,15 @@ limitations under the License.
 * 3. lambdaLLT - LLT-related regularisation parameter
 * 4. tau - time-marching step
 * 5. iter - iterations number (for both models)
+* 6. eplsilon: tolerance constant
+* 7. algorithm: explicit time marching (0) or the primal-dual solver (1)
+*
+* The primal-dual solver minimises the same energy
+*   1/2||U - U0||^2 + lambdaROF*TV(U) + lambdaLLT*sum_i |U_ii|
+* (U_ii - second differences along the axes) with the accelerated scheme of Chambolle and Pock [3]:
+* the dual field of TV is projected on the balls of radius lambdaROF, those of the second
+* differences are clipped to [-lambdaLLT, lambdaLLT]. The steps follow from the norm of the
+* operator (20 per dimension) and the strong convexity of the fidelity, tau is not used.
 *
 * Output:
 * Filtered/regularised image
@@ -44,12 +53,17 @@ limitations under the License.
 * References:
 * [1] Lysaker, M., Lundervold, A. and Tai, X.C., 2003. Noise removal using fourth-order partial differential equation with applications to medical magnetic resonance images in space and time. IEEE Transactions on image processing, 12(12), pp.1579-1590.
 * [2] Rudin, Osher, Fatemi, "Nonlinear Total Variation based noise removal algorithms"
+* [3] Antonin Chambolle, Thomas Pock. "A First-Order Primal-Dual Algorithm for Convex Problems with Applications to Imaging", 2010
 */
 
+#define LLT_ROF_EXPLICIT 0
+#define LLT_ROF_PRIMAL_DUAL 1
+
 #ifdef __cplusplus
 extern "C" {
 #endif
-CCPI_EXPORT float LLT_ROF_CPU_main(float *Input, float *Output, float *infovector, float lambdaROF, float lambdaLLT, int iterationsNumb, float tau, float epsil, int dimX, int dimY, int dimZ);
+CCPI_EXPORT float LLT_ROF_CPU_main(float *Input, float *Output, float *infovector, float lambdaROF, float lambdaLLT, int iterationsNumb, float tau, float epsil, int algorithm, int dimX, int dimY, int dimZ);
+CCPI_EXPORT long LLT_ROF_CPU_mem(float epsil, int algorithm, int dimX, int dimY, int dimZ);
 
 CCPI_EXPORT float der2D_LLT(float *U, float *D1, float *D2, long dimX, long dimY, long dimZ);
 CCPI_EXPORT float der3D_LLT(float *U, float *D1, float *D2, float *D3, long dimX, long dimY, long dimZ);
@@ -60,6 +74,9 @@ CCPI_EXPORT float D3_func_ROF(float *A, float *D3, long dimX, long dimY, long di
 
 CCPI_EXPORT float Update2D_LLT_ROF(float *U0, float *U, float *D1_LLT, float *D2_LLT, float *D1_ROF, float *D2_ROF, float lambdaROF, float lambdaLLT, float tau, long dimX, long dimY, long dimZ);
 CCPI_EXPORT float Update3D_LLT_ROF(float *U0, float *U, float *D1_LLT, float *D2_LLT, float *D3_LLT, float *D1_ROF, float *D2_ROF, float *D3_ROF, float lambdaROF, float lambdaLLT, float tau, long dimX, long dimY, long dimZ);
+
+CCPI_EXPORT float DualLLT_ROF(float *U, float *P1, float *P2, float *P3, float *Q1, float *Q2, float *Q3, float lambdaROF, float lambdaLLT, float sigma, long dimX, long dimY, long dimZ);
+CCPI_EXPORT float PrimalLLT_ROF(float *U0, float *U, float *U_bar, float *P1, float *P2, float *P3, float *Q1, float *Q2, float *Q3, float tau, float theta, long dimX, long dimY, long dimZ);
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,116 @@
+/*
+ * This work is part of the Core Imaging Library developed by
+ * Visual Analytics and Imaging System Group of the Science Technology
+ * Facilities Council, STFC
+ *
+ * Copyright 2017 Daniil Kazantsev
+ * Copyright 2017 Srikanth Nagella, Edoardo Pasca
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Noise_core.h"
+
+/* absolute finest diagonal Haar coefficients of slice k into H, returns their number */
+static long Haar_diagonal(float *Input, float *H, long k, long dimX, long dimY)
+{
+    long i, j, n, index;
+    float *A = Input + k*dimX*dimY;
+
+    if (dimY < 2) {
+        for(i=0; i<dimX/2; i++) H[i] = fabsf(A[2*i] - A[2*i+1])*0.70710678f;
+        return dimX/2;
+    }
+    n = (dimX/2)*(dimY/2);
+    for(j=0; j<dimY/2; j++) {
+        for(i=0; i<dimX/2; i++) {
+            index = 2*j*dimX + 2*i;
+            H[j*(dimX/2) + i] = 0.5f*fabsf(A[index] - A[index+1] - A[index+dimX] + A[index+dimX+1]);
+        }}
+    return n;
+}
+
+/* median of the n non-negative values of A: each round histograms the values inside the bin
+ * holding the median in the previous round, two rounds of NOISE_BINS bins resolve it to float
+ * precision */
+float Median_abs(float *A, long n)
+{
+    long j, b, rank, below, *hist, nthreads;
+    int round;
+    float lo, hi, width, vmax = 0.0f;
+
+    if (n <= 0) return 0.0f;
+#pragma omp parallel for shared(A) private(j) reduction(max:vmax)
+    for(j=0; j<n; j++) if (A[j] > vmax) vmax = A[j];
+
+    rank = n/2;
+    lo = 0.0f; hi = vmax;
+    for(round=0; (round<2) && (hi > lo); round++) {
+        width = (hi - lo)/(float)NOISE_BINS;
+#pragma omp parallel shared(A, hist, nthreads) private(j, b)
+        {
+            /* one histogram per thread of the team which runs, a single one when called for a
+             * slice inside the parallel loop of Noise_estimate */
+#pragma omp single
+            {
+                nthreads = omp_get_num_threads();
+                hist = (long*) calloc(nthreads*NOISE_BINS, sizeof(long));
+            }
+            long *h = hist + omp_get_thread_num()*NOISE_BINS;
+#pragma omp for
+            for(j=0; j<n; j++) {
+                if ((A[j] < lo) || (A[j] > hi)) continue;
+                b = (long)((A[j] - lo)/width);
+                if (b >= NOISE_BINS) b = NOISE_BINS-1;
+                h[b]++;
+            }
+        }
+        /* values below lo were counted out of the rank in the previous round */
+        below = 0;
+        for(b=0; b<NOISE_BINS; b++) {
+            for(j=1; j<nthreads; j++) hist[b] += hist[j*NOISE_BINS + b];
+            if (below + hist[b] > rank) break;
+            below += hist[b];
+        }
+        if (b == NOISE_BINS) b = NOISE_BINS-1;
+        free(hist);
+        rank -= below;
+        lo = lo + b*width;
+        hi = lo + width;
+    }
+    return 0.5f*(lo + hi);
+}
+
+float Noise_estimate(float *Input, float *sigma, int perslice, int dimX, int dimY, int dimZ)
+{
+    long k, m, nslice, DimZ;
+    float *H;
+
+    DimZ = (dimZ < 1) ? 1 : (long)(dimZ);
+    nslice = (dimY < 2) ? (long)(dimX)/2 : ((long)(dimX)/2)*((long)(dimY)/2);
+    H = Vol_calloc(nslice*DimZ);
+
+    if (perslice && (DimZ > 1)) {
+        /* one slice per thread */
+#pragma omp parallel for shared(Input, H, sigma) private(k, m)
+        for(k=0; k<DimZ; k++) {
+            m = Haar_diagonal(Input, H + k*nslice, k, (long)(dimX), (long)(dimY));
+            sigma[k] = Median_abs(H + k*nslice, m)/NOISE_MAD;
+        }
+    }
+    else {
+#pragma omp parallel for shared(Input, H) private(k)
+        for(k=0; k<DimZ; k++) Haar_diagonal(Input, H + k*nslice, k, (long)(dimX), (long)(dimY));
+        sigma[0] = Median_abs(H, nslice*DimZ)/NOISE_MAD;
+    }
+    Vol_free(H);
+    return sigma[0];
+}
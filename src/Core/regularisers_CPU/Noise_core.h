@@ -0,0 +1,60 @@
+/*
+This work is part of the Core Imaging Library developed by
+Visual Analytics and Imaging System Group of the Science Technology
+Facilities Council, STFC
+
+Copyright 2017 Daniil Kazantsev
+Copyright 2017 Srikanth Nagella, Edoardo Pasca
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <math.h>
+#include <stdlib.h>
+#include <memory.h>
+#include <stdio.h>
+#include "omp.h"
+#include "utils.h"
+#include "CCPiDefines.h"
+
+/* C-OMP estimation of the standard deviation of additive white Gaussian noise (2D/3D) [1]
+ *
+ * The estimate is the median absolute deviation of the finest diagonal Haar wavelet coefficients
+ * of every slice, HH = (a - b - c + d)/2 over the 2x2 blocks, divided by 0.6745. The noise gives
+ * HH coefficients of its own standard deviation while the image content (mostly smooth areas and
+ * edges along X or Y) gives few large ones, which the median ignores. Images of one row use the
+ * 1D detail coefficients (a - b)/sqrt(2).
+ *
+ * Input Parameters:
+ * 1. Noisy image/volume
+ * 2. perslice: 0 - one estimate for the whole image/volume, 1 - one estimate per slice (3D)
+ *
+ * Output:
+ * [1] sigma: the estimate (sigma[0]) or the estimates of the dimZ slices
+ *
+ * The coefficients are computed in parallel; the median of all coefficients is found by two
+ * rounds of parallel histograms (NOISE_BINS bins each, to float precision), the medians of the
+ * slices are found one slice per thread.
+ *
+ * [1] Donoho, D.L. and Johnstone, I.M., 1994. Ideal spatial adaptation by wavelet shrinkage. Biometrika, 81(3), pp.425-455.
+ */
+
+#define NOISE_BINS 4096
+#define NOISE_MAD 0.6745f
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+CCPI_EXPORT float Noise_estimate(float *Input, float *sigma, int perslice, int dimX, int dimY, int dimZ);
+CCPI_EXPORT float Median_abs(float *A, long n);
+#ifdef __cplusplus
+}
+#endif
@@ -43,17 +43,33 @@
 /*****************************************************************************/
 
 float Nonlocal_TV_CPU_main(float *A_orig, float *Output, unsigned short *H_i, unsigned short *H_j, unsigned short *H_k, float *Weights, int dimX, int dimY, int dimZ, int NumNeighb, float lambdaReg, int IterNumb, int switchM)
+{
+    return Nonlocal_TV_CPU_ckpt(A_orig, Output, H_i, H_j, H_k, Weights, dimX, dimY, dimZ, NumNeighb, lambdaReg, IterNumb, switchM, NULL, 0, 0);
+}
+
+float Nonlocal_TV_CPU_ckpt(float *A_orig, float *Output, unsigned short *H_i, unsigned short *H_j, unsigned short *H_k, float *Weights, int dimX, int dimY, int dimZ, int NumNeighb, float lambdaReg, int IterNumb, int switchM, const char *checkpoint, int interval, int resume)
 {
     
     long i, j, k;
-    int iter;
+    int iter, iter0, count;
+    float params[6], scalars[CKPT_SCALARS] = {0.0f};
+    Ckpt *ckpt = NULL;
+    
+    if (checkpoint != NULL) {
+        params[0] = lambdaReg; params[1] = (float)NumNeighb; params[2] = (float)switchM;
+        params[3] = (float)dimX; params[4] = (float)dimY; params[5] = (float)dimZ;
+        ckpt = Ckpt_open(checkpoint, interval, CKPT_NLTV, (long)(dimX)*(long)(dimY)*(long)((dimZ == 0) ? 1 : dimZ), 1, params, 6, resume);
+        if (ckpt == NULL) return -1.0f;
+    }
     lambdaReg = 1.0f/lambdaReg;
     
     /*****2D INPUT *****/
     if (dimZ == 0) {
         copyIm(A_orig, Output, (long)(dimX), (long)(dimY), 1l);
+        iter0 = 0;
+        if (resume) Ckpt_load(ckpt, &Output, &iter0, &count, scalars);
         /* for each pixel store indeces of the most similar neighbours (patches) */
-        for(iter=0; iter<IterNumb; iter++) {
+        for(iter=iter0; iter<IterNumb; iter++) {
 #pragma omp parallel for shared (A_orig, Output, Weights, H_i, H_j, iter) private(i,j)
             for(j=0; j<(long)(dimY); j++) {
                 for(i=0; i<(long)(dimX); i++) {
@@ -65,13 +81,17 @@ float Nonlocal_TV_CPU_main(float *A_orig, float *Output, unsigned short *H_i, un
                         NLM_TV_2D(Output, A_orig, H_i, H_j, Weights, i, j, (long)(dimX), (long)(dimY), NumNeighb, lambdaReg);  /* NLM - TV penalty */
                     }
                 }}
+            if (Ckpt_due(ckpt, iter+1, iter+1 == IterNumb)) Ckpt_save(ckpt, &Output, iter+1, 0, scalars);
+            if (Progress_step(iter+1, 0.0f)) break;
         }
     }
     else {
         /*****3D INPUT *****/
         copyIm(A_orig, Output, (long)(dimX), (long)(dimY), (long)(dimZ));
+        iter0 = 0;
+        if (resume) Ckpt_load(ckpt, &Output, &iter0, &count, scalars);
         /* for each pixel store indeces of the most similar neighbours (patches) */
-        for(iter=0; iter<IterNumb; iter++) {
+        for(iter=iter0; iter<IterNumb; iter++) {
 #pragma omp parallel for shared (A_orig, Output, Weights, H_i, H_j, H_k, iter) private(i,j,k)
             for(k=0; k<(long)(dimZ); k++) {
                 for(j=0; j<(long)(dimY); j++) {
@@ -79,11 +99,58 @@ float Nonlocal_TV_CPU_main(float *A_orig, float *Output, unsigned short *H_i, un
                         /* NLM_H1_3D(Output, A_orig, H_i, H_j, H_k, Weights, i, j, k, dimX, dimY, dimZ, NumNeighb, lambdaReg); */ /* NLM - H1 penalty */
                         NLM_TV_3D(Output, A_orig, H_i, H_j, H_k, Weights, i, j, k, (long)(dimX), (long)(dimY), (long)(dimZ), NumNeighb, lambdaReg);   /* NLM - TV penalty */
                     }}}
+            if (Ckpt_due(ckpt, iter+1, iter+1 == IterNumb)) Ckpt_save(ckpt, &Output, iter+1, 0, scalars);
+            if (Progress_step(iter+1, 0.0f)) break;
         }
     }
+    Ckpt_close(ckpt);
+    return *Output;
+}
+
+float Nonlocal_TV_CPU_csr(float *A_orig, float *Output, long long *RowPtr, int *Neighb, float *WeightsCSR, int dimX, int dimY, int dimZ, float lambdaReg, int IterNumb, const char *checkpoint, int interval, int resume)
+{
+    long l, index, DimZ, DimTotal, planes, plane;
+    int iter, iter0, count;
+    float params[6], scalars[CKPT_SCALARS] = {0.0f};
+    Ckpt *ckpt = NULL;
+    
+    DimZ = (dimZ == 0) ? 1 : (long)(dimZ);
+    DimTotal = (long)(dimX)*(long)(dimY)*DimZ;
+    if (checkpoint != NULL) {
+        /* the number of entries and switch 2 tell the checkpoint of a CSR graph from a dense one */
+        params[0] = lambdaReg; params[1] = (float)RowPtr[DimTotal]; params[2] = 2.0f;
+        params[3] = (float)dimX; params[4] = (float)dimY; params[5] = (float)dimZ;
+        ckpt = Ckpt_open(checkpoint, interval, CKPT_NLTV, DimTotal, 1, params, 6, resume);
+        if (ckpt == NULL) return -1.0f;
+    }
+    lambdaReg = 1.0f/lambdaReg;
+    /* rows of a 2D image and slices of a volume are shared out as in Nonlocal_TV_CPU_main */
+    planes = (dimZ == 0) ? (long)(dimY) : DimZ;
+    plane = DimTotal/planes;
+    
+    copyIm(A_orig, Output, (long)(dimX), (long)(dimY), DimZ);
+    iter0 = 0;
+    if (resume) Ckpt_load(ckpt, &Output, &iter0, &count, scalars);
+    for(iter=iter0; iter<IterNumb; iter++) {
+#pragma omp parallel for shared (A_orig, Output, RowPtr, Neighb, WeightsCSR, iter) private(l, index)
+        for(l=0; l<planes; l++) {
+            for(index=l*plane; index<(l+1)*plane; index++) {
+                NLM_TV_CSR(Output, A_orig, RowPtr, Neighb, WeightsCSR, index, lambdaReg);
+            }}
+        if (Ckpt_due(ckpt, iter+1, iter+1 == IterNumb)) Ckpt_save(ckpt, &Output, iter+1, 0, scalars);
+        if (Progress_step(iter+1, 0.0f)) break;
+    }
+    Ckpt_close(ckpt);
     return *Output;
 }
 
+/* Peak size in bytes of the work arrays allocated by Nonlocal_TV_CPU_main and Nonlocal_TV_CPU_csr,
+ * they update the output in place */
+long Nonlocal_TV_CPU_mem(int dimX, int dimY, int dimZ)
+{
+    return 0l;
+}
+
 /***********<<<<Main Function for NLM - H1 penalty>>>>**********/
 float NLM_H1_2D(float *A, float *A_orig, unsigned short *H_i, unsigned short *H_j, float *Weights, long i, long j, long dimX, long dimY, int NumNeighb, float lambdaReg)
 {
@@ -175,3 +242,23 @@ float NLM_TV_3D(float *A, float *A_orig, unsigned short *H_i, unsigned short *H_
     A[(dimX*dimY*k) + j*dimX+i] = (lambdaReg*A_orig[(dimX*dimY*k) + j*dimX+i] + value)/(lambdaReg + normweight);
     return *A;
 }
+/* the TV penalty of a voxel with the neighbours of the CSR graph, any dimension */
+float NLM_TV_CSR(float *A, float *A_orig, long long *RowPtr, int *Neighb, float *WeightsCSR, long index, float lambdaReg)
+{
+    long x;
+    float value = 0.0f, normweight  = 0.0f, NLgrad_magn = 0.0f, NLCoeff;
+    
+    for(x=RowPtr[index]; x < RowPtr[index+1]; x++) {
+        NLgrad_magn += powf((A[Neighb[x]] - A[index]),2)*WeightsCSR[x];
+    }
+    
+    NLgrad_magn = sqrtf(NLgrad_magn); /*Non Local Gradients Magnitude */
+    NLCoeff = 2.0f*(1.0f/(NLgrad_magn + EPS));
+    
+    for(x=RowPtr[index]; x < RowPtr[index+1]; x++) {
+        value += A[Neighb[x]]*NLCoeff*WeightsCSR[x];
+        normweight += WeightsCSR[x]*NLCoeff;
+    }
+    A[index] = (lambdaReg*A_orig[index] + value)/(lambdaReg + normweight);
+    return *A;
+}
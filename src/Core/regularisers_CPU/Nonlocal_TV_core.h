@@ -24,6 +24,7 @@
 #include <stdio.h>
 #include "omp.h"
 #include "utils.h"
+#include "checkpoint.h"
 #include "CCPiDefines.h"
 
 #define EPS 1.0000e-9
@@ -45,6 +46,18 @@
 
  * Output:
  * 1. denoised image/volume
+ *
+ * Nonlocal_TV_CPU_ckpt writes the image/volume and the iteration counter to the checkpoint file
+ * 'checkpoint' every 'interval' iterations and after the last one; with resume the iterations
+ * continue from the checkpoint in the file (see checkpoint.h). The weights are not part of the
+ * checkpoint, the same weights must be given when resuming. Returns -1 when the checkpoint file
+ * cannot be used.
+ *
+ * Nonlocal_TV_CPU_csr takes the graph in the compressed (CSR) form of PatchSelect_CPU_csr: the
+ * neighbours of the voxel n are Neighb[RowPtr[n]] ... Neighb[RowPtr[n+1]-1] (linear indices) with
+ * the weights WeightsCSR at the same positions, so each voxel has its own number of neighbours.
+ * The voxels are swept in the order of Nonlocal_TV_CPU_main, with all the non-zero weights kept
+ * the result is the same.
  * Elmoataz, Abderrahim, Olivier Lezoray, and Sébastien Bougleux. "Nonlocal discrete regularization on weighted graphs: a framework for image and manifold processing." IEEE Trans.   Image Processing 17, no. 7 (2008): 1047-1060.
  */
 
@@ -52,10 +65,14 @@
 extern "C" {
 #endif
 CCPI_EXPORT float Nonlocal_TV_CPU_main(float *A_orig, float *Output, unsigned short *H_i, unsigned short *H_j, unsigned short *H_k, float *Weights, int dimX, int dimY, int dimZ, int NumNeighb, float lambdaReg, int IterNumb, int switchM);
+CCPI_EXPORT float Nonlocal_TV_CPU_ckpt(float *A_orig, float *Output, unsigned short *H_i, unsigned short *H_j, unsigned short *H_k, float *Weights, int dimX, int dimY, int dimZ, int NumNeighb, float lambdaReg, int IterNumb, int switchM, const char *checkpoint, int interval, int resume);
+CCPI_EXPORT float Nonlocal_TV_CPU_csr(float *A_orig, float *Output, long long *RowPtr, int *Neighb, float *WeightsCSR, int dimX, int dimY, int dimZ, float lambdaReg, int IterNumb, const char *checkpoint, int interval, int resume);
+CCPI_EXPORT long Nonlocal_TV_CPU_mem(int dimX, int dimY, int dimZ);
 CCPI_EXPORT float NLM_H1_2D(float *A, float *A_orig, unsigned short *H_i, unsigned short *H_j, float *Weights, long i, long j, long dimX, long dimY, int NumNeighb, float lambdaReg);
 CCPI_EXPORT float NLM_TV_2D(float *A, float *A_orig, unsigned short *H_i, unsigned short *H_j, float *Weights, long i, long j, long dimX, long dimY, int NumNeighb, float lambdaReg);
 CCPI_EXPORT float NLM_H1_3D(float *A, float *A_orig, unsigned short *H_i, unsigned short *H_j, unsigned short *H_k, float *Weights, long i, long j, long k, long dimX, long dimY, long dimZ, int NumNeighb, float lambdaReg);
 CCPI_EXPORT float NLM_TV_3D(float *A, float *A_orig, unsigned short *H_i, unsigned short *H_j, unsigned short *H_k, float *Weights, long i, long j, long k, long dimX, long dimY, long dimZ, int NumNeighb, float lambdaReg);
+CCPI_EXPORT float NLM_TV_CSR(float *A, float *A_orig, long long *RowPtr, int *Neighb, float *WeightsCSR, long index, float lambdaReg);
 #ifdef __cplusplus
 }
 #endif
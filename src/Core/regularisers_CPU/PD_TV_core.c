@@ -29,6 +29,9 @@
  * 5. lipschitz_const: convergence related parameter
  * 6. TV-type: methodTV - 'iso' (0) or 'l1' (1)
  * 7. nonneg: 'nonnegativity (0 is OFF by default, 1 is ON)
+ * 8. algorithm: fixed steps (0) or the accelerated scheme (1) of [1] for the strongly convex fidelity,
+ *    tau, sigma and theta are updated every iteration (O(1/k^2) instead of O(1/k))
+ * 9. layout: storage of the 3D dual field, planar P1/P2/P3 arrays (0) or interleaved (x,y,z) triples (1)
 
  * Output:
  * [1] TV - Filtered/regularized image/volume
@@ -37,11 +40,12 @@
  * [1] Antonin Chambolle, Thomas Pock. "A First-Order Primal-Dual Algorithm for Convex Problems with Applications to Imaging", 2010
  */
 
-float PDTV_CPU_main(float *Input, float *U, float *infovector, float lambdaPar, int iterationsNumb, float epsil, float lipschitz_const, int methodTV, int nonneg, int dimX, int dimY, int dimZ)
+float PDTV_CPU_main(float *Input, float *U, float *infovector, float lambdaPar, int iterationsNumb, float epsil, float lipschitz_const, int methodTV, int nonneg, int algorithm, int layout, int dimX, int dimY, int dimZ)
 {
-    int ll;
+    int ll, last, fused = 0, progress, stop = 0;
+    output_pass *pass;
     long j, DimTotal;
-    float re, re1, sigma, theta, lt, tau;
+    float re = 0.0f, re1, sigma, theta, lt, tau, gamma;
     re = 0.0f; re1 = 0.0f;
     int count = 0;
 
@@ -52,38 +56,119 @@ float PDTV_CPU_main(float *Input, float *U, float *infovector, float lambdaPar,
     theta = 1.0f;
     lt = tau/lambdaPar;
     ll = 0;
+    /* the fidelity (1/(2*lambdaPar))||U - Input||^2 is strongly convex with gamma = 1/lambdaPar,
+     * the accelerated scheme starts from balanced steps which then decrease (tau) and grow (sigma) */
+    gamma = 1.0f/lambdaPar;
+    if (algorithm == PD_ACCELERATED) {
+        tau = 1.0f/sqrtf(lipschitz_const);
+        sigma = tau;
+        lt = tau/lambdaPar;
+    }
 
 
     DimTotal = (long)(dimX*dimY*dimZ);
 
     copyIm(Input, U, (long)(dimX), (long)(dimY), (long)(dimZ));
+    /* the output pass (Output_bind) is applied by getX of the last iteration, after its early
+     * stopping check; U is planar in all layouts */
+    pass = Output_take(DimTotal, 1);
+    last = iterationsNumb-1;
 
     if (dimZ <= 1) {
         /*2D case */
         float *U_old=NULL, *P1=NULL, *P2=NULL;
 
-        U_old = calloc(DimTotal, sizeof(float));
-        P1 = calloc(DimTotal, sizeof(float));
-        P2 = calloc(DimTotal, sizeof(float));
+        U_old = Vol_calloc(DimTotal);
+        P1 = Vol_calloc(DimTotal);
+        P2 = Vol_calloc(DimTotal);
 
-        /* begin iterations */
-        for(ll=0; ll<iterationsNumb; ll++) {
+        /* the whole iteration loop runs in one parallel region, the kernels are split statically
+         * over its threads, so small images do not pay a fork/join per kernel; with the pool
+         * running the loop stays on the calling thread and the kernels go to the pool */
+        progress = Progress_active();
+#pragma omp parallel if(Pool_threads() == 0) firstprivate(count) private(j)
+        {
+        int it;
+        float rel = 0.0f;
+        for(it=0; it<iterationsNumb; it++) {
 
             /* computing the the dual P variable */
             DualP2D(U, P1, P2, (long)(dimX), (long)(dimY), sigma);
 
             /* apply nonnegativity */
-            if (nonneg == 1) for(j=0; j<DimTotal; j++) {if (U[j] < 0.0f) U[j] = 0.0f;}
+            if (nonneg == 1) Nonneg_ws(U, DimTotal);
 
             /* projection step */
-            Proj_func2D(P1, P2, methodTV, DimTotal);
+            Proj_func2D_ws(P1, P2, methodTV, DimTotal);
 
             /* copy U to U_old */
-            copyIm(U, U_old, (long)(dimX), (long)(dimY), 1l);
+            copyIm_ws(U, U_old, DimTotal);
 
             /* calculate divergence */
             DivProj2D(U, Input, P1, P2,(long)(dimX), (long)(dimY), lt, tau);
 
+            /* check early stopping criteria */
+            if ((epsil != 0.0f)  && (it % 5 == 0)) {
+#pragma omp single
+                {re = 0.0f; re1 = 0.0f;}
+#pragma omp for reduction(+:re,re1)
+                for(j=0; j<DimTotal; j++)
+                {
+                    re += powf(U[j] - U_old[j],2);
+                    re1 += powf(U[j],2);
+                }
+                rel = sqrtf(re)/sqrtf(re1);
+                if (rel < epsil)  count++;
+                if (count > 3) break;
+            }
+            /* accelerated steps */
+            if (algorithm == PD_ACCELERATED) {
+#pragma omp single
+                {theta = PD_steps(gamma, &tau, &sigma); lt = tau/lambdaPar;}
+            }
+            /*get updated solution*/
+            getX(U, U_old, theta, (it == last) ? pass : NULL, DimTotal);
+            if (it == last) {
+#pragma omp master
+                fused = 1;
+            }
+            /* the thread that bound the progress record reports it, all threads stop together */
+            if (progress) {
+#pragma omp master
+                stop = Progress_step(it+1, rel);
+#pragma omp barrier
+                if (stop) break;
+            }
+        }
+#pragma omp barrier
+#pragma omp master
+        {ll = it; re = rel;}
+        }
+        Vol_free(P1); Vol_free(P2); Vol_free(U_old);
+    }
+    else if (layout == LAYOUT_INTERLEAVED) {
+        /*3D case, the dual field is stored as interleaved (x,y,z) triples */
+        float *U_old=NULL, *P=NULL;
+        U_old = Vol_calloc(DimTotal);
+        P = Vol_calloc(3*DimTotal);
+
+        /* begin iterations */
+        for(ll=0; ll<iterationsNumb; ll++) {
+
+            /* computing the the dual P variable */
+            DualP3D_il(U, P, (long)(dimX), (long)(dimY),  (long)(dimZ), sigma);
+
+            /* apply nonnegativity */
+            if (nonneg == 1) Nonneg_ws(U, DimTotal);
+
+            /* projection step */
+            Proj_func3D_il(P, methodTV, DimTotal);
+
+            /* copy U to U_old */
+            copyIm(U, U_old, (long)(dimX), (long)(dimY), (long)(dimZ));
+
+            DivProj3D_il(U, Input, P, (long)(dimX), (long)(dimY), (long)(dimZ), lt, tau);
+
             /* check early stopping criteria */
             if ((epsil != 0.0f)  && (ll % 5 == 0)) {
                 re = 0.0f; re1 = 0.0f;
@@ -96,19 +181,26 @@ float PDTV_CPU_main(float *Input, float *U, float *infovector, float lambdaPar,
                 if (re < epsil)  count++;
                 if (count > 3) break;
             }
+            /* accelerated steps */
+            if (algorithm == PD_ACCELERATED) {
+                theta = PD_steps(gamma, &tau, &sigma);
+                lt = tau/lambdaPar;
+            }
             /*get updated solution*/
 
-            getX(U, U_old, theta, DimTotal);
+            getX(U, U_old, theta, (ll == last) ? pass : NULL, DimTotal);
+            fused = (ll == last);
+            if (Progress_step(ll+1, re)) break;
         }
-        free(P1); free(P2); free(U_old);
+        Vol_free(P); Vol_free(U_old);
     }
     else {
           /*3D case*/
         float *U_old=NULL, *P1=NULL, *P2=NULL, *P3=NULL;
-        U_old = calloc(DimTotal, sizeof(float));
-        P1 = calloc(DimTotal, sizeof(float));
-        P2 = calloc(DimTotal, sizeof(float));
-        P3 = calloc(DimTotal, sizeof(float));
+        U_old = Vol_calloc(DimTotal);
+        P1 = Vol_calloc(DimTotal);
+        P2 = Vol_calloc(DimTotal);
+        P3 = Vol_calloc(DimTotal);
 
         /* begin iterations */
         for(ll=0; ll<iterationsNumb; ll++) {
@@ -117,7 +209,7 @@ float PDTV_CPU_main(float *Input, float *U, float *infovector, float lambdaPar,
             DualP3D(U, P1, P2, P3, (long)(dimX), (long)(dimY),  (long)(dimZ), sigma);
 
             /* apply nonnegativity */
-            if (nonneg == 1) for(j=0; j<DimTotal; j++) {if (U[j] < 0.0f) U[j] = 0.0f;}
+            if (nonneg == 1) Nonneg_ws(U, DimTotal);
 
             /* projection step */
             Proj_func3D(P1, P2, P3, methodTV, DimTotal);
@@ -139,12 +231,20 @@ float PDTV_CPU_main(float *Input, float *U, float *infovector, float lambdaPar,
                 if (re < epsil)  count++;
                 if (count > 3) break;
             }
+            /* accelerated steps */
+            if (algorithm == PD_ACCELERATED) {
+                theta = PD_steps(gamma, &tau, &sigma);
+                lt = tau/lambdaPar;
+            }
             /*get updated solution*/
 
-            getX(U, U_old, theta, DimTotal);
+            getX(U, U_old, theta, (ll == last) ? pass : NULL, DimTotal);
+            fused = (ll == last);
+            if (Progress_step(ll+1, re)) break;
         }
-        free(P1); free(P2); free(P3); free(U_old);
+        Vol_free(P1); Vol_free(P2); Vol_free(P3); Vol_free(U_old);
     }
+    if (fused && (pass != NULL)) Output_done(pass, U);
     /*adding info into info_vector */
     infovector[0] = (float)(ll);  /*iterations number (if stopped earlier based on tolerance)*/
     infovector[1] = re;  /* reached tolerance */
@@ -152,35 +252,88 @@ float PDTV_CPU_main(float *Input, float *U, float *infovector, float lambdaPar,
     return 0;
 }
 
+/* Peak size in bytes of the work arrays allocated by PDTV_CPU_main (U_old and the dual variables) */
+long PDTV_CPU_mem(int layout, int dimX, int dimY, int dimZ)
+{
+    long DimTotal;
+    DimTotal = (long)(dimX)*(long)(dimY)*(long)(dimZ);
+    if (dimZ <= 1) return 3l*DimTotal*sizeof(float);
+    return 4l*DimTotal*sizeof(float);
+}
+
 /*****************************************************************/
 /************************2D-case related Functions */
 /*****************************************************************/
+/* The planar kernels are bodies over rows, (k,j) in 3D and j in 2D (elements for getX), started
+ * by Run_rows; the 2D kernels and getX are called by every thread of the parallel region of the
+ * 2D solver and start them with Run_rows_team (pool.h) */
+typedef struct {
+    float *U, *U_old, *Input, *P1, *P2, *P3;
+    float sigma, lt, tau, theta;
+    long dimX, dimY, dimZ;
+    output_pass *pass;  /* applied by getX to U (Output_rows), NULL - none */
+} pd_args;
 
 /*Calculating dual variable (using forward differences)*/
-float DualP2D(float *U, float *P1, float *P2, long dimX, long dimY, float sigma)
+static void DualP_rows(void *arg, long r0, long r1)
 {
-     long i,j,index;
-     #pragma omp parallel for shared(U,P1,P2) private(index,i,j)
-     for(j=0; j<dimY; j++) {
-       for(i=0; i<dimX; i++) {
+    pd_args *a = (pd_args*)arg;
+    float *U = a->U, *P1 = a->P1, *P2 = a->P2, *P3 = a->P3, sigma = a->sigma;
+    long dimX = a->dimX, dimY = a->dimY, dimZ = a->dimZ;
+    long i,j,k,r,index;
+    for(r=r0; r<r1; r++) {
+        k = r/dimY; j = r - k*dimY;
+        if (dimZ > 1) {
+           for(i=0; i<dimX; i++) {
+          index = (dimX*dimY)*k + j*dimX+i;
+          /* symmetric boundary conditions (Neuman) */
+          if (i == dimX-1) P1[index] += sigma*(U[(dimX*dimY)*k + j*dimX+(i-1)] - U[index]);
+          else P1[index] += sigma*(U[(dimX*dimY)*k + j*dimX+(i+1)] - U[index]);
+          if (j == dimY-1) P2[index] += sigma*(U[(dimX*dimY)*k + (j-1)*dimX+i] - U[index]);
+          else  P2[index] += sigma*(U[(dimX*dimY)*k + (j+1)*dimX+i] - U[index]);
+          if (k == dimZ-1) P3[index] += sigma*(U[(dimX*dimY)*(k-1) + j*dimX+i] - U[index]);
+          else  P3[index] += sigma*(U[(dimX*dimY)*(k+1) + j*dimX+i] - U[index]);
+           }
+        }
+        else {
+           for(i=0; i<dimX; i++) {
           index = j*dimX+i;
           /* symmetric boundary conditions (Neuman) */
           if (i == dimX-1) P1[index] += sigma*(U[j*dimX+(i-1)] - U[index]);
           else P1[index] += sigma*(U[j*dimX+(i+1)] - U[index]);
           if (j == dimY-1) P2[index] += sigma*(U[(j-1)*dimX+i] - U[index]);
           else  P2[index] += sigma*(U[(j+1)*dimX+i] - U[index]);
-        }}
-     return 1;
+           }
+        }
+    }
 }
 
 /* Divergence for P dual */
-float DivProj2D(float *U, float *Input, float *P1, float *P2, long dimX, long dimY, float lt, float tau)
+static void DivProj_rows(void *arg, long r0, long r1)
 {
-  long i,j,index;
-  float P_v1, P_v2, div_var;
-  #pragma omp parallel for shared(U,Input,P1,P2) private(index, i, j, P_v1, P_v2, div_var)
-  for(j=0; j<dimY; j++) {
-    for(i=0; i<dimX; i++) {
+    pd_args *a = (pd_args*)arg;
+    float *U = a->U, *Input = a->Input, *P1 = a->P1, *P2 = a->P2, *P3 = a->P3, lt = a->lt, tau = a->tau;
+    long dimX = a->dimX, dimY = a->dimY, dimZ = a->dimZ;
+    float P_v1, P_v2, P_v3, div_var;
+    long i,j,k,r,index;
+    for(r=r0; r<r1; r++) {
+        k = r/dimY; j = r - k*dimY;
+        if (dimZ > 1) {
+        for(i=0; i<dimX; i++) {
+            index = (dimX*dimY)*k + j*dimX+i;
+            /* symmetric boundary conditions (Neuman) */
+            if (i == 0) P_v1 = -P1[index];
+            else P_v1 = -(P1[index] - P1[(dimX*dimY)*k + j*dimX+(i-1)]);
+            if (j == 0) P_v2 = -P2[index];
+            else  P_v2 = -(P2[index] - P2[(dimX*dimY)*k + (j-1)*dimX+i]);
+            if (k == 0) P_v3 = -P3[index];
+            else  P_v3 = -(P3[index] - P3[(dimX*dimY)*(k-1) + j*dimX+i]);
+            div_var = P_v1 + P_v2 + P_v3;
+            U[index] = (U[index] - tau*div_var + lt*Input[index])/(1.0 + lt);
+        }
+        }
+        else {
+        for(i=0; i<dimX; i++) {
             index = j*dimX+i;
             /* symmetric boundary conditions (Neuman) */
             if (i == 0) P_v1 = -P1[index];
@@ -189,18 +342,53 @@ float DivProj2D(float *U, float *Input, float *P1, float *P2, long dimX, long di
             else  P_v2 = -(P2[index] - P2[(j-1)*dimX+i]);
             div_var = P_v1 + P_v2;
             U[index] = (U[index] - tau*div_var + lt*Input[index])/(1.0 + lt);
-          }}
-  return *U;
+        }
+        }
+    }
 }
 
-/*get the updated solution*/
-float getX(float *U, float *U_old, float theta, long DimTotal)
+static void getX_rows(void *arg, long r0, long r1)
 {
-    long i;
-    #pragma omp parallel for shared(U,U_old) private(i)
-    for(i=0; i<DimTotal; i++) {
+    pd_args *a = (pd_args*)arg;
+    float *U = a->U, *U_old = a->U_old, theta = a->theta;
+    output_pass *pass = a->pass;
+    output_acc acc;
+    long i, c, c1;
+    if (pass != NULL) Output_open(pass, &acc);
+    for(c=r0; c<r1; c=c1) {
+        /* with the output pass in chunks it reads from the cache */
+        c1 = (pass != NULL) ? c + OUTPUT_CHUNK : r1;
+        if (c1 > r1) c1 = r1;
+        for(i=c; i<c1; i++) {
           U[i] +=  theta*(U[i] - U_old[i]);
           }
+        if (pass != NULL) Output_rows(pass, &acc, U + c, c1 - c);
+    }
+    if (pass != NULL) Output_close(pass, &acc);
+}
+
+/*****************************************************************/
+/************************2D-case related Functions */
+/*****************************************************************/
+float DualP2D(float *U, float *P1, float *P2, long dimX, long dimY, float sigma)
+{
+    pd_args a = {U, NULL, NULL, P1, P2, NULL, sigma, 0.0f, 0.0f, 0.0f, dimX, dimY, 1l};
+    Run_rows_team(dimY, DualP_rows, &a);
+    return 1;
+}
+
+float DivProj2D(float *U, float *Input, float *P1, float *P2, long dimX, long dimY, float lt, float tau)
+{
+    pd_args a = {U, NULL, Input, P1, P2, NULL, 0.0f, lt, tau, 0.0f, dimX, dimY, 1l};
+    Run_rows_team(dimY, DivProj_rows, &a);
+    return *U;
+}
+
+/*get the updated solution*/
+float getX(float *U, float *U_old, float theta, output_pass *pass, long DimTotal)
+{
+    pd_args a = {U, U_old, NULL, NULL, NULL, NULL, 0.0f, 0.0f, 0.0f, theta, DimTotal, 1l, 1l, pass};
+    Run_rows_team(DimTotal, getX_rows, &a);
     return *U;
 }
 
@@ -208,43 +396,60 @@ float getX(float *U, float *U_old, float theta, long DimTotal)
 /*****************************************************************/
 /************************3D-case related Functions */
 /*****************************************************************/
-/*Calculating dual variable (using forward differences)*/
 float DualP3D(float *U, float *P1, float *P2, float *P3, long dimX, long dimY, long dimZ, float sigma)
+{
+    pd_args a = {U, NULL, NULL, P1, P2, P3, sigma, 0.0f, 0.0f, 0.0f, dimX, dimY, dimZ};
+    Run_rows(dimZ*dimY, DualP_rows, &a);
+    return 1;
+}
+
+float DivProj3D(float *U, float *Input, float *P1, float *P2, float *P3, long dimX, long dimY, long dimZ, float lt, float tau)
+{
+    pd_args a = {U, NULL, Input, P1, P2, P3, 0.0f, lt, tau, 0.0f, dimX, dimY, dimZ};
+    Run_rows(dimZ*dimY, DivProj_rows, &a);
+    return *U;
+}
+
+/*****************************************************************/
+/*********3D-case Functions for the interleaved P layout *********/
+/*****************************************************************/
+/*Calculating dual variable (using forward differences), P[3*index + 0,1,2] keeps the (x,y,z) components */
+float DualP3D_il(float *U, float *P, long dimX, long dimY, long dimZ, float sigma)
 {
      long i,j,k,index;
-     #pragma omp parallel for shared(U,P1,P2,P3) private(index,i,j,k)
+     #pragma omp parallel for shared(U,P) private(index,i,j,k)
      for(k=0; k<dimZ; k++) {
          for(j=0; j<dimY; j++) {
            for(i=0; i<dimX; i++) {
           index = (dimX*dimY)*k + j*dimX+i;
           /* symmetric boundary conditions (Neuman) */
-          if (i == dimX-1) P1[index] += sigma*(U[(dimX*dimY)*k + j*dimX+(i-1)] - U[index]);
-          else P1[index] += sigma*(U[(dimX*dimY)*k + j*dimX+(i+1)] - U[index]);
-          if (j == dimY-1) P2[index] += sigma*(U[(dimX*dimY)*k + (j-1)*dimX+i] - U[index]);
-          else  P2[index] += sigma*(U[(dimX*dimY)*k + (j+1)*dimX+i] - U[index]);
-          if (k == dimZ-1) P3[index] += sigma*(U[(dimX*dimY)*(k-1) + j*dimX+i] - U[index]);
-          else  P3[index] += sigma*(U[(dimX*dimY)*(k+1) + j*dimX+i] - U[index]);
+          if (i == dimX-1) P[3*index] += sigma*(U[index-1] - U[index]);
+          else P[3*index] += sigma*(U[index+1] - U[index]);
+          if (j == dimY-1) P[3*index+1] += sigma*(U[index-dimX] - U[index]);
+          else  P[3*index+1] += sigma*(U[index+dimX] - U[index]);
+          if (k == dimZ-1) P[3*index+2] += sigma*(U[index-dimX*dimY] - U[index]);
+          else  P[3*index+2] += sigma*(U[index+dimX*dimY] - U[index]);
         }}}
      return 1;
 }
 
-/* Divergence for P dual */
-float DivProj3D(float *U, float *Input, float *P1, float *P2, float *P3, long dimX, long dimY, long dimZ, float lt, float tau)
+/* Divergence for the interleaved P dual */
+float DivProj3D_il(float *U, float *Input, float *P, long dimX, long dimY, long dimZ, float lt, float tau)
 {
   long i,j,k,index;
   float P_v1, P_v2, P_v3, div_var;
-  #pragma omp parallel for shared(U,Input,P1,P2) private(index, i, j, k, P_v1, P_v2, P_v3, div_var)
+  #pragma omp parallel for shared(U,Input,P) private(index, i, j, k, P_v1, P_v2, P_v3, div_var)
   for(k=0; k<dimZ; k++) {
       for(j=0; j<dimY; j++) {
         for(i=0; i<dimX; i++) {
             index = (dimX*dimY)*k + j*dimX+i;
             /* symmetric boundary conditions (Neuman) */
-            if (i == 0) P_v1 = -P1[index];
-            else P_v1 = -(P1[index] - P1[(dimX*dimY)*k + j*dimX+(i-1)]);
-            if (j == 0) P_v2 = -P2[index];
-            else  P_v2 = -(P2[index] - P2[(dimX*dimY)*k + (j-1)*dimX+i]);
-            if (k == 0) P_v3 = -P3[index];
-            else  P_v3 = -(P3[index] - P3[(dimX*dimY)*(k-1) + j*dimX+i]);
+            if (i == 0) P_v1 = -P[3*index];
+            else P_v1 = -(P[3*index] - P[3*(index-1)]);
+            if (j == 0) P_v2 = -P[3*index+1];
+            else  P_v2 = -(P[3*index+1] - P[3*(index-dimX)+1]);
+            if (k == 0) P_v3 = -P[3*index+2];
+            else  P_v3 = -(P[3*index+2] - P[3*(index-dimX*dimY)+2]);
             div_var = P_v1 + P_v2 + P_v3;
             U[index] = (U[index] - tau*div_var + lt*Input[index])/(1.0 + lt);
    }}}
@@ -24,6 +24,7 @@ limitations under the License.
 #include <stdio.h>
 #include "omp.h"
 #include "utils.h"
+#include "pool.h"
 #include "CCPiDefines.h"
 
 /* C-OMP implementation of Primal-Dual TV [1] by Chambolle Pock denoising/regularization model (2D/3D case)
@@ -36,6 +37,9 @@ limitations under the License.
  * 5. lipschitz_const: convergence related parameter
  * 6. TV-type: methodTV - 'iso' (0) or 'l1' (1)
  * 7. nonneg: 'nonnegativity (0 is OFF by default, 1 is ON)
+ * 8. algorithm: fixed steps (0) or the accelerated scheme (1) of [1] for the strongly convex fidelity,
+ *    tau, sigma and theta are updated every iteration (O(1/k^2) instead of O(1/k))
+ * 9. layout: storage of the 3D dual field, planar P1/P2/P3 arrays (0) or interleaved (x,y,z) triples (1)
 
  * Output:
  * [1] TV - Filtered/regularized image/volume
@@ -47,14 +51,18 @@ limitations under the License.
 #ifdef __cplusplus
 extern "C" {
 #endif
-CCPI_EXPORT float PDTV_CPU_main(float *Input, float *U, float *infovector, float lambdaPar, int iterationsNumb, float epsil, float lipschitz_const, int methodTV, int nonneg, int dimX, int dimY, int dimZ);
+CCPI_EXPORT float PDTV_CPU_main(float *Input, float *U, float *infovector, float lambdaPar, int iterationsNumb, float epsil, float lipschitz_const, int methodTV, int nonneg, int algorithm, int layout, int dimX, int dimY, int dimZ);
+CCPI_EXPORT long PDTV_CPU_mem(int layout, int dimX, int dimY, int dimZ);
 
 CCPI_EXPORT float DualP2D(float *U, float *P1, float *P2, long dimX, long dimY, float sigma);
 CCPI_EXPORT float DivProj2D(float *U, float *Input, float *P1, float *P2, long dimX, long dimY, float lt, float tau);
-CCPI_EXPORT float getX(float *U, float *U_old, float theta, long DimTotal);
+CCPI_EXPORT float getX(float *U, float *U_old, float theta, output_pass *pass, long DimTotal);
 
 CCPI_EXPORT float DualP3D(float *U, float *P1, float *P2, float *P3, long dimX, long dimY, long dimZ, float sigma);
 CCPI_EXPORT float DivProj3D(float *U, float *Input, float *P1, float *P2, float *P3, long dimX, long dimY, long dimZ, float lt, float tau);
+
+CCPI_EXPORT float DualP3D_il(float *U, float *P, long dimX, long dimY, long dimZ, float sigma);
+CCPI_EXPORT float DivProj3D_il(float *U, float *Input, float *P, long dimX, long dimY, long dimZ, float lt, float tau);
 #ifdef __cplusplus
 }
 #endif
@@ -57,24 +57,83 @@ void swapUS(unsigned short *xp, unsigned short *yp)
     *xp = *yp;
     *yp = temp;
 }
+/* weighted distance between the patches at (i,j) and (i1,j1), the kernel is taken in the
+ * order of the pairs of voxels inside the image */
+static float Distance2D(float *Aorig, long i, long j, long i1, long j1, long dimX, long dimY, float *Eucl_Vec, int SimilarWin)
+{
+    long i_c, j_c, i2, j2, i3, j3, counterG = 0;
+    float normsum = 0.0f;
+    for(i_c=-SimilarWin; i_c<=SimilarWin; i_c++) {
+        for(j_c=-SimilarWin; j_c<=SimilarWin; j_c++) {
+            i2 = i1 + i_c;
+            j2 = j1 + j_c;
+            i3 = i + i_c;
+            j3 = j + j_c;
+            if (((i2 >= 0) && (i2 < dimX)) && ((j2 >= 0) && (j2 < dimY))) {
+                if (((i3 >= 0) && (i3 < dimX)) && ((j3 >= 0) && (j3 < dimY))) {
+                    normsum += Eucl_Vec[counterG]*POW2(Aorig[j3*dimX + (i3)] - Aorig[j2*dimX + (i2)]);
+                    counterG++;
+                }}
+        }}
+    return normsum;
+}
+
+static float Distance3D(float *Aorig, long i, long j, long k, long i1, long j1, long k1, long dimX, long dimY, long dimZ, float *Eucl_Vec, int SimilarWin)
+{
+    long i_c, j_c, k_c, i2, j2, k2, i3, j3, k3, counterG = 0;
+    float normsum = 0.0f;
+    for(i_c=-SimilarWin; i_c<=SimilarWin; i_c++) {
+        for(j_c=-SimilarWin; j_c<=SimilarWin; j_c++) {
+            for(k_c=-SimilarWin; k_c<=SimilarWin; k_c++) {
+                i2 = i1 + i_c;
+                j2 = j1 + j_c;
+                k2 = k1 + k_c;
+                i3 = i + i_c;
+                j3 = j + j_c;
+                k3 = k + k_c;
+                if (((i2 >= 0) && (i2 < dimX)) && ((j2 >= 0) && (j2 < dimY)) && ((k2 >= 0) && (k2 < dimZ))) {
+                    if (((i3 >= 0) && (i3 < dimX)) && ((j3 >= 0) && (j3 < dimY)) && ((k3 >= 0) && (k3 < dimZ))) {
+                        normsum += Eucl_Vec[counterG]*POW2(Aorig[(dimX*dimY*k3) + j3*dimX + (i3)] - Aorig[(dimX*dimY*k2) + j2*dimX + (i2)]);
+                        counterG++;
+                    }}
+            }}}
+    return normsum;
+}
+
+/* Gaussian kernel of the patch distances */
+static float *Patch_kernel(int SimilarWin, int dimZ)
+{
+    long i, j, k, counterG = 0;
+    float *Eucl_Vec;
+    if (dimZ == 0) {
+        Eucl_Vec = (float*) calloc ((2*SimilarWin+1)*(2*SimilarWin+1),sizeof(float));
+        for(i=-SimilarWin; i<=SimilarWin; i++) {
+            for(j=-SimilarWin; j<=SimilarWin; j++) {
+                Eucl_Vec[counterG] = (float)exp(-(pow(((float) i), 2) + pow(((float) j), 2))/(2*SimilarWin*SimilarWin));
+                counterG++;
+            }}
+        return Eucl_Vec;
+    }
+    Eucl_Vec = (float*) calloc ((2*SimilarWin+1)*(2*SimilarWin+1)*(2*SimilarWin+1),sizeof(float));
+    for(i=-SimilarWin; i<=SimilarWin; i++) {
+        for(j=-SimilarWin; j<=SimilarWin; j++) {
+            for(k=-SimilarWin; k<=SimilarWin; k++) {
+                Eucl_Vec[counterG] = (float)exp(-(pow(((float) i), 2) + pow(((float) j), 2) + pow(((float) k), 2))/(2*SimilarWin*SimilarWin*SimilarWin));
+                counterG++;
+            }}}
+    return Eucl_Vec;
+}
 /**************************************************/
 
 float PatchSelect_CPU_main(float *A, unsigned short *H_i, unsigned short *H_j, unsigned short *H_k, float *Weights, int dimX, int dimY, int dimZ, int SearchWindow, int SimilarWin, int NumNeighb, float h)
 {
-    int counterG;
     long i, j, k;
     float *Eucl_Vec, h2;
     h2 = h*h;
     /****************2D INPUT ***************/
     if (dimZ == 0) {
         /* generate a 2D Gaussian kernel for NLM procedure */
-        Eucl_Vec = (float*) calloc ((2*SimilarWin+1)*(2*SimilarWin+1),sizeof(float));
-        counterG = 0;
-        for(i=-SimilarWin; i<=SimilarWin; i++) {
-            for(j=-SimilarWin; j<=SimilarWin; j++) {
-                Eucl_Vec[counterG] = (float)exp(-(pow(((float) i), 2) + pow(((float) j), 2))/(2*SimilarWin*SimilarWin));
-                counterG++;
-            }} /*main neighb loop */
+        Eucl_Vec = Patch_kernel(SimilarWin, 0);
         /* for each pixel store indeces of the most similar neighbours (patches) */
 #pragma omp parallel for shared (A, Weights, H_i, H_j) private(i,j)
         for(j=0; j<(long)(dimY); j++) {
@@ -85,14 +144,7 @@ float PatchSelect_CPU_main(float *A, unsigned short *H_i, unsigned short *H_j, u
     else {
         /****************3D INPUT ***************/
         /* generate a 3D Gaussian kernel for NLM procedure */
-        Eucl_Vec = (float*) calloc ((2*SimilarWin+1)*(2*SimilarWin+1)*(2*SimilarWin+1),sizeof(float));
-        counterG = 0;
-        for(i=-SimilarWin; i<=SimilarWin; i++) {
-            for(j=-SimilarWin; j<=SimilarWin; j++) {
-                for(k=-SimilarWin; k<=SimilarWin; k++) {
-                    Eucl_Vec[counterG] = (float)exp(-(pow(((float) i), 2) + pow(((float) j), 2) + pow(((float) k), 2))/(2*SimilarWin*SimilarWin*SimilarWin));
-                    counterG++;
-                }}} /*main neighb loop */
+        Eucl_Vec = Patch_kernel(SimilarWin, dimZ);
         
         /* for each voxel store indeces of the most similar neighbours (patches) */
 #pragma omp parallel for shared (A, Weights, H_i, H_j, H_k) private(i,j,k)
@@ -106,9 +158,179 @@ float PatchSelect_CPU_main(float *A, unsigned short *H_i, unsigned short *H_j, u
     return 1;
 }
 
+/* marks the voxels within R of a marked one along a line of n voxels of M (at the given stride) */
+static void Dilate_line(float *M, unsigned char *T, long start, long stride, long n, long R)
+{
+    long x, last;
+    last = -R-1;
+    for(x=0; x<n; x++) {
+        if (M[start + x*stride] > 0.0f) last = x;
+        T[x] = (unsigned char)(x - last <= R);
+    }
+    last = n+R;
+    for(x=n-1; x>=0; x--) {
+        if (M[start + x*stride] > 0.0f) last = x;
+        if (last - x <= R) T[x] = 1;
+    }
+    for(x=0; x<n; x++) M[start + x*stride] = (float)T[x];
+}
+
+/* weights of the kept neighbours on the current data, the empty entries (weight 0) stay empty */
+static void Refresh2D(float *Aorig, unsigned short *H_i, unsigned short *H_j, float *Weights, long i, long j, long dimX, long dimY, float *Eucl_Vec, int NumNeighb, int SimilarWin, float h2)
+{
+    long x, index;
+    for(x=0; x < NumNeighb; x++) {
+        index = (dimX*dimY*x) + j*dimX+i;
+        if (Weights[index] != 0.0f) VEXP(Weights[index], -Distance2D(Aorig, i, j, (long)H_i[index], (long)H_j[index], dimX, dimY, Eucl_Vec, SimilarWin)/h2);
+    }
+}
+
+/* the dimensions in the order Indeces3D takes them */
+static void Refresh3D(float *Aorig, unsigned short *H_i, unsigned short *H_j, unsigned short *H_k, float *Weights, long i, long j, long k, long dimY, long dimX, long dimZ, float *Eucl_Vec, int NumNeighb, int SimilarWin, float h2)
+{
+    long x, index;
+    for(x=0; x < NumNeighb; x++) {
+        index = dimX*dimY*dimZ*x + (dimX*dimY*k) + j*dimX+i;
+        if (Weights[index] != 0.0f) VEXP(Weights[index], -Distance3D(Aorig, i, j, k, (long)H_i[index], (long)H_j[index], (long)H_k[index], dimX, dimY, dimZ, Eucl_Vec, SimilarWin)/h2);
+    }
+}
+
+float PatchSelect_CPU_update(float *A, float *A_prev, unsigned short *H_i, unsigned short *H_j, unsigned short *H_k, float *Weights, int dimX, int dimY, int dimZ, int SearchWindow, int SimilarWin, int NumNeighb, float h, float threshold)
+{
+    long i, j, k, l, index, DimZ, DimTotal, R, searched = 0;
+    float *Changed, *Eucl_Vec, h2;
+    h2 = h*h;
+    DimZ = (dimZ == 0) ? 1 : (long)(dimZ);
+    DimTotal = (long)(dimX)*(long)(dimY)*DimZ;
+    R = (long)(SearchWindow + SimilarWin);
+
+    /* voxels changed beyond the threshold, dilated by the reach of the search */
+    Changed = Vol_calloc(DimTotal);
+#pragma omp parallel for shared(A, A_prev, Changed) private(index)
+    for(index=0; index<DimTotal; index++) Changed[index] = (fabsf(A[index] - A_prev[index]) > threshold) ? 1.0f : 0.0f;
+#pragma omp parallel shared(Changed) private(l)
+    {
+        unsigned char *T = (unsigned char*) malloc(((dimX > dimY) ? (dimX > DimZ ? dimX : DimZ) : (dimY > DimZ ? dimY : DimZ))*sizeof(unsigned char));
+#pragma omp for
+        for(l=0; l<(long)(dimY)*DimZ; l++) Dilate_line(Changed, T, l*dimX, 1l, (long)(dimX), R);
+#pragma omp for
+        for(l=0; l<(long)(dimX)*DimZ; l++) Dilate_line(Changed, T, (l/dimX)*dimX*dimY + l%dimX, (long)(dimX), (long)(dimY), R);
+        if (DimZ > 1) {
+#pragma omp for
+            for(l=0; l<(long)(dimX)*dimY; l++) Dilate_line(Changed, T, l, (long)(dimX)*dimY, DimZ, R);
+        }
+        free(T);
+    }
+
+    Eucl_Vec = Patch_kernel(SimilarWin, dimZ);
+    if (dimZ == 0) {
+#pragma omp parallel for shared (A, Weights, H_i, H_j, Changed) private(i,j) reduction(+:searched)
+        for(j=0; j<(long)(dimY); j++) {
+            for(i=0; i<(long)(dimX); i++) {
+                if (Changed[j*dimX+i] > 0.0f) {
+                    Indeces2D(A, H_i, H_j, Weights, i, j, (long)(dimX), (long)(dimY), Eucl_Vec, NumNeighb, SearchWindow, SimilarWin, h2);
+                    searched++;
+                }
+                else Refresh2D(A, H_i, H_j, Weights, i, j, (long)(dimX), (long)(dimY), Eucl_Vec, NumNeighb, SimilarWin, h2);
+            }}
+    }
+    else {
+#pragma omp parallel for shared (A, Weights, H_i, H_j, H_k, Changed) private(i,j,k) reduction(+:searched)
+        for(k=0; k<dimZ; k++) {
+            for(j=0; j<dimY; j++) {
+                for(i=0; i<dimX; i++) {
+                    if (Changed[(k*dimY + j)*dimX + i] > 0.0f) {
+                        Indeces3D(A, H_i, H_j, H_k, Weights, i, j, k, (long)(dimX), (long)(dimY), (long)(dimZ), Eucl_Vec, NumNeighb, SearchWindow, SimilarWin, h2);
+                        searched++;
+                    }
+                    else Refresh3D(A, H_i, H_j, H_k, Weights, i, j, k, (long)(dimX), (long)(dimY), (long)(dimZ), Eucl_Vec, NumNeighb, SimilarWin, h2);
+                }}}
+    }
+    free(Eucl_Vec);
+    Vol_free(Changed);
+    return (float)searched;
+}
+
+/* marks in Keep the neighbours of the dense row (NumNeighb weights 'stride' apart) kept in the
+ * CSR graph, Order holds NumNeighb indices; returns their number */
+static long Keep_row(float *Weights, long start, long stride, int NumNeighb, float mass, int *Order, unsigned char *Keep)
+{
+    long x, y, kept;
+    int temp;
+    float total = 0.0f, sum = 0.0f;
+    /* the neighbours by weight [HIGH to LOW], the dense graph of a 3D search is not sorted */
+    for(x=0; x<NumNeighb; x++) {
+        for(y=x; (y > 0) && (Weights[start + Order[y-1]*stride] < Weights[start + x*stride]); y--) Order[y] = Order[y-1];
+        Order[y] = (int)x;
+        Keep[x] = 0;
+    }
+    for(x=0; x<NumNeighb; x++) total += Weights[start + Order[x]*stride];
+    for(kept=0; kept<NumNeighb; kept++) {
+        temp = Order[kept];
+        if (Weights[start + temp*stride] <= 0.0f) break;
+        if ((mass < 1.0f) && (sum >= mass*total)) break;
+        sum += Weights[start + temp*stride];
+        Keep[temp] = 1;
+    }
+    return kept;
+}
+
+long PatchSelect_CPU_csr(unsigned short *H_i, unsigned short *H_j, unsigned short *H_k, float *Weights, long long *RowPtr, int *Neighb, float *WeightsCSR, int dimX, int dimY, int dimZ, int NumNeighb, float mass)
+{
+    long index, x, n, DimTotal;
+    DimTotal = (long)(dimX)*(long)(dimY)*(long)((dimZ == 0) ? 1 : dimZ);
+    
+#pragma omp parallel shared(H_i, H_j, H_k, Weights, RowPtr, Neighb, WeightsCSR) private(index, x, n)
+    {
+        int *Order = (int*) malloc(NumNeighb*sizeof(int));
+        unsigned char *Keep = (unsigned char*) malloc(NumNeighb*sizeof(unsigned char));
+        if (Neighb == NULL) {
+            /* the number of neighbours of every voxel, summed up below */
+#pragma omp for
+            for(index=0; index<DimTotal; index++) RowPtr[index+1] = Keep_row(Weights, index, DimTotal, NumNeighb, mass, Order, Keep);
+        }
+        else {
+#pragma omp for
+            for(index=0; index<DimTotal; index++) {
+                Keep_row(Weights, index, DimTotal, NumNeighb, mass, Order, Keep);
+                n = RowPtr[index];
+                for(x=0; x<NumNeighb; x++) {
+                    if (Keep[x]) {
+                        Neighb[n] = (int)((((dimZ == 0) ? 0l : (long)H_k[DimTotal*x + index])*dimY + H_j[DimTotal*x + index])*dimX + H_i[DimTotal*x + index]);
+                        WeightsCSR[n] = Weights[DimTotal*x + index];
+                        n++;
+                    }
+                }
+            }
+        }
+        free(Order);
+        free(Keep);
+    }
+    if (Neighb == NULL) {
+        RowPtr[0] = 0;
+        for(index=0; index<DimTotal; index++) RowPtr[index+1] += RowPtr[index];
+    }
+    return RowPtr[DimTotal];
+}
+
+/* Peak size in bytes of the work arrays allocated by PatchSelect_CPU_main: the Gaussian kernel
+ * and the search-window buffers held by every thread */
+long PatchSelect_CPU_mem(int dimZ, int SearchWindow, int SimilarWin)
+{
+    long sizeWin_tot, sizeSim_tot;
+    if (dimZ == 0) {
+        sizeWin_tot = (2l*SearchWindow + 1)*(2l*SearchWindow + 1);
+        sizeSim_tot = (2l*SimilarWin + 1)*(2l*SimilarWin + 1);
+        return sizeSim_tot*sizeof(float) + omp_get_max_threads()*sizeWin_tot*(sizeof(float) + 2*sizeof(unsigned short));
+    }
+    sizeWin_tot = (2l*SearchWindow + 1)*(2l*SearchWindow + 1)*(2l*SearchWindow + 1);
+    sizeSim_tot = (2l*SimilarWin + 1)*(2l*SimilarWin + 1)*(2l*SimilarWin + 1);
+    return sizeSim_tot*sizeof(float) + omp_get_max_threads()*sizeWin_tot*(sizeof(float) + 3*sizeof(unsigned short));
+}
+
 float Indeces2D(float *Aorig, unsigned short *H_i, unsigned short *H_j, float *Weights, long i, long j, long dimX, long dimY, float *Eucl_Vec, int NumNeighb, int SearchWindow, int SimilarWin, float h2)
 {
-    long i1, j1, i_m, j_m, i_c, j_c, i2, j2, i3, j3, counter, x, y, index, sizeWin_tot, counterG;
+    long i1, j1, i_m, j_m, counter, x, y, index, sizeWin_tot;
     float *Weight_Vec, normsum;
     unsigned short *ind_i, *ind_j;
     
@@ -124,28 +346,18 @@ float Indeces2D(float *Aorig, unsigned short *H_i, unsigned short *H_j, float *W
             i1 = i+i_m;
             j1 = j+j_m;
             if (((i1 >= 0) && (i1 < dimX)) && ((j1 >= 0) && (j1 < dimY))) {
-                normsum = 0.0f; counterG = 0;
-                for(i_c=-SimilarWin; i_c<=SimilarWin; i_c++) {
-                    for(j_c=-SimilarWin; j_c<=SimilarWin; j_c++) {
-                        i2 = i1 + i_c;
-                        j2 = j1 + j_c;
-                        i3 = i + i_c;
-                        j3 = j + j_c;
-                        if (((i2 >= 0) && (i2 < dimX)) && ((j2 >= 0) && (j2 < dimY))) {
-                            if (((i3 >= 0) && (i3 < dimX)) && ((j3 >= 0) && (j3 < dimY))) {
-                                normsum += Eucl_Vec[counterG]*powf(Aorig[j3*dimX + (i3)] - Aorig[j2*dimX + (i2)], 2);
-                                counterG++;
-                            }}
-                    }}
+                normsum = Distance2D(Aorig, i, j, i1, j1, dimX, dimY, Eucl_Vec, SimilarWin);
                 /* writing temporarily into vectors */
                 if (normsum > EPS) {
-                    Weight_Vec[counter] = expf(-normsum/h2);
+                    Weight_Vec[counter] = -normsum/h2;
                     ind_i[counter] = i1;
                     ind_j[counter] = j1;
                     counter++;
                 }
             }
         }}
+    /* the weights of all candidates in one vectorised pass */
+    Vec_exp(Weight_Vec, counter);
     /* do sorting to choose the most prominent weights [HIGH to LOW] */
     /* and re-arrange indeces accordingly */
     for (x = 0; x < counter-1; x++)  {
@@ -173,7 +385,7 @@ float Indeces2D(float *Aorig, unsigned short *H_i, unsigned short *H_j, float *W
 
 float Indeces3D(float *Aorig, unsigned short *H_i, unsigned short *H_j, unsigned short *H_k, float *Weights, long i, long j, long k, long dimY, long dimX, long dimZ, float *Eucl_Vec, int NumNeighb, int SearchWindow, int SimilarWin, float h2)
 {
-    long i1, j1, k1, i_m, j_m, k_m, i_c, j_c, k_c, i2, j2, k2, i3, j3, k3, counter, x, y, index, sizeWin_tot, counterG;
+    long i1, j1, k1, i_m, j_m, k_m, counter, x, y, index, sizeWin_tot;
     float *Weight_Vec, normsum, temp;
     unsigned short *ind_i, *ind_j, *ind_k, temp_i, temp_j, temp_k;
     
@@ -192,25 +404,10 @@ float Indeces3D(float *Aorig, unsigned short *H_i, unsigned short *H_j, unsigned
                 i1 = i+i_m;
                 j1 = j+j_m;
                 if (((i1 >= 0) && (i1 < dimX)) && ((j1 >= 0) && (j1 < dimY)) && ((k1 >= 0) && (k1 < dimZ))) {
-                    normsum = 0.0f; counterG = 0l;
-                    for(i_c=-SimilarWin; i_c<=SimilarWin; i_c++) {
-                        for(j_c=-SimilarWin; j_c<=SimilarWin; j_c++) {
-                            for(k_c=-SimilarWin; k_c<=SimilarWin; k_c++) {
-                                i2 = i1 + i_c;
-                                j2 = j1 + j_c;
-                                k2 = k1 + k_c;
-                                i3 = i + i_c;
-                                j3 = j + j_c;
-                                k3 = k + k_c;
-                                if (((i2 >= 0) && (i2 < dimX)) && ((j2 >= 0) && (j2 < dimY)) && ((k2 >= 0) && (k2 < dimZ))) {
-                                    if (((i3 >= 0) && (i3 < dimX)) && ((j3 >= 0) && (j3 < dimY)) && ((k3 >= 0) && (k3 < dimZ))) {
-                                        normsum += Eucl_Vec[counterG]*pow(Aorig[(dimX*dimY*k3) + j3*dimX + (i3)] - Aorig[(dimX*dimY*k2) + j2*dimX + (i2)], 2);
-                                        counterG++;
-                                    }}
-                            }}}
+                    normsum = Distance3D(Aorig, i, j, k, i1, j1, k1, dimX, dimY, dimZ, Eucl_Vec, SimilarWin);
                     /* writing temporarily into vectors */
                     if (normsum > EPS) {
-                        Weight_Vec[counter] = expf(-normsum/h2);
+                        Weight_Vec[counter] = -normsum/h2;
                         ind_i[counter] = i1;
                         ind_j[counter] = j1;
                         ind_k[counter] = k1;
@@ -218,6 +415,8 @@ float Indeces3D(float *Aorig, unsigned short *H_i, unsigned short *H_j, unsigned
                     }
                 }
             }}}
+    /* the weights of all candidates in one vectorised pass */
+    Vec_exp(Weight_Vec, counter);
     /* do sorting to choose the most prominent weights [HIGH to LOW] */
     /* and re-arrange indeces accordingly */
     for (x = 0; x < counter; x++)  {
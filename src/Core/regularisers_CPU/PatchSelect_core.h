@@ -24,6 +24,7 @@
 #include <stdio.h>
 #include "omp.h"
 #include "utils.h"
+#include "vec_math.h"
 #include "CCPiDefines.h"
 #define EPS 1.0000e-12
 
@@ -49,12 +50,31 @@
  * 2. AR_j - indeces of j neighbours
  * 3. AR_k - indeces of j neighbours
  * 4. Weights_ijk - associated weights
+ *
+ * PatchSelect_CPU_update updates the neighbours and weights of the previous frame of a
+ * time series (A_prev, passed in H_i, H_j, H_k and Weights) for the frame A. The result of
+ * a voxel depends on the data within SearchWindow + SimilarWin of it: where no voxel there
+ * changed by more than threshold the neighbours are kept and only their weights are computed
+ * on A, elsewhere the full search is done. With threshold 0 the result equals that of
+ * PatchSelect_CPU_main on A. Returns the number of voxels searched.
+ *
+ * PatchSelect_CPU_csr compresses the graph of PatchSelect_CPU_main into the CSR form taken by
+ * Nonlocal_TV_CPU_csr: of the neighbours of a voxel it keeps the fewest with the largest weights
+ * that make up the fraction 'mass' of the sum of its weights (mass >= 1 keeps all with a non-zero
+ * weight), in their order in the dense graph. The neighbours of the voxel n go to
+ * Neighb[RowPtr[n]] ... Neighb[RowPtr[n+1]-1] as linear indices, their weights to WeightsCSR.
+ * Called with Neighb NULL it only fills RowPtr (dimX*dimY*dimZ + 1 entries), the arrays of
+ * RowPtr[dimX*dimY*dimZ] entries are then allocated by the caller and filled by a second call.
+ * Returns the number of entries.
  */
 /*****************************************************************************/
 #ifdef __cplusplus
 extern "C" {
 #endif
 CCPI_EXPORT float PatchSelect_CPU_main(float *A, unsigned short *H_i, unsigned short *H_j, unsigned short *H_k, float *Weights, int dimX, int dimY, int dimZ, int SearchWindow, int SimilarWin, int NumNeighb, float h);
+CCPI_EXPORT float PatchSelect_CPU_update(float *A, float *A_prev, unsigned short *H_i, unsigned short *H_j, unsigned short *H_k, float *Weights, int dimX, int dimY, int dimZ, int SearchWindow, int SimilarWin, int NumNeighb, float h, float threshold);
+CCPI_EXPORT long PatchSelect_CPU_csr(unsigned short *H_i, unsigned short *H_j, unsigned short *H_k, float *Weights, long long *RowPtr, int *Neighb, float *WeightsCSR, int dimX, int dimY, int dimZ, int NumNeighb, float mass);
+CCPI_EXPORT long PatchSelect_CPU_mem(int dimZ, int SearchWindow, int SimilarWin);
 CCPI_EXPORT float Indeces2D(float *Aorig, unsigned short *H_i, unsigned short *H_j, float *Weights, long i, long j, long dimX, long dimY, float *Eucl_Vec, int NumNeighb, int SearchWindow, int SimilarWin, float h2);
 CCPI_EXPORT float Indeces3D(float *Aorig, unsigned short *H_i, unsigned short *H_j, unsigned short *H_k, float *Weights, long i, long j, long k, long dimY, long dimX, long dimZ, float *Eucl_Vec, int NumNeighb, int SearchWindow, int SimilarWin, float h2);
 #ifdef __cplusplus
@@ -37,6 +37,7 @@ int sign(float x) {
  * 3. tau - marching step for explicit scheme, ~1 is recommended [REQUIRED]
  * 4. Number of iterations, for explicit scheme >= 150 is recommended  [REQUIRED]
  * 5. eplsilon: tolerance constant
+ * 6. layout: storage of the 3D work arrays, planar (0) or 8x8x8 bricks (2)
  *
  * Output:
  * [1] Regularised image/volume
@@ -46,50 +47,95 @@ int sign(float x) {
  * [1] Rudin, Osher, Fatemi, "Nonlinear Total Variation based noise removal algorithms"
  */
 
-/* Running iterations of TV-ROF function */
-float TV_ROF_CPU_main(float *Input, float *Output, float *infovector, float *lambdaPar, int lambda_is_arr, int iterationsNumb, float tau, float epsil, int dimX, int dimY, int dimZ)
+/* Running iterations of TV-ROF function, Input and Output may be strided views */
+static float TV_ROF_CPU_run(float *Input, long inPitchY, long inPitchZ, float *Output, long outPitchY, long outPitchZ, float *infovector, float *lambdaPar, int lambda_is_arr, int iterationsNumb, float tau, float epsil, int layout, int dimX, int dimY, int dimZ)
 {
-    float *D1=NULL, *D2=NULL, *D3=NULL, *Output_prev=NULL;
-    float re, re1;
+    float *D1=NULL, *D2=NULL, *D3=NULL, *Output_prev=NULL, *U=NULL, *A=NULL;
+    float re = 0.0f, re1;
     re = 0.0f; re1 = 0.0f;
     int count = 0;
-    int i;
+    int i, bricked, last;
+    output_pass *pass = NULL;
     long DimTotal,j;
     DimTotal = (long)(dimX*dimY*dimZ);
+    bricked = ((dimZ > 1) && (layout == LAYOUT_BRICKED));
+    if (bricked) DimTotal = Bricked_size((long)(dimX), (long)(dimY), (long)(dimZ));
     
-    D1 = calloc(DimTotal, sizeof(float));
-    D2 = calloc(DimTotal, sizeof(float));
-    D3 = calloc(DimTotal, sizeof(float));
+    D1 = Vol_calloc(DimTotal);
+    D2 = Vol_calloc(DimTotal);
+    D3 = Vol_calloc(DimTotal);
     
-    /* copy into output */
-    copyIm(Input, Output, (long)(dimX), (long)(dimY), (long)(dimZ));
-    if (epsil != 0.0f) Output_prev = calloc(DimTotal, sizeof(float));
+    if (bricked) {
+        /* the input and the initial output are bricked in one sweep */
+        A = Vol_calloc(DimTotal);
+        U = Vol_calloc(DimTotal);
+        Planar_to_bricked(Input, A, U, (long)(dimX), (long)(dimY), (long)(dimZ));
+    }
+    else if (STRIDED_DENSE(inPitchY, inPitchZ, dimX, dimY, dimZ) && STRIDED_DENSE(outPitchY, outPitchZ, dimX, dimY, dimZ) && (Input != Output)) {
+        /* copy into output */
+        copyIm(Input, Output, (long)(dimX), (long)(dimY), (long)(dimZ));
+        A = Input; U = Output;
+    }
+    else {
+        /* strided views or in place, the input and the initial output are gathered in one sweep (Strided_to_planar) */
+        A = (STRIDED_DENSE(inPitchY, inPitchZ, dimX, dimY, dimZ) && (Input != Output)) ? Input : (float*)calloc(DimTotal, sizeof(float));
+        U = STRIDED_DENSE(outPitchY, outPitchZ, dimX, dimY, dimZ) ? Output : (float*)calloc(DimTotal, sizeof(float));
+        Strided_to_planar(Input, inPitchY, inPitchZ, (A != Input) ? A : NULL, U, (long)(dimX), (long)(dimY), (long)(dimZ));
+    }
+    if (epsil != 0.0f) Output_prev = Vol_calloc(DimTotal);
+    /* the output pass (Output_bind) is applied by the planar kernel of the last iteration, unless
+     * its operations change U before the early stopping check reads it */
+    if (!bricked) pass = Output_take(DimTotal, 1);
+    last = ((pass != NULL) && (pass->nops > 0) && (epsil != 0.0f) && ((iterationsNumb-1) % 5 == 0)) ? -1 : iterationsNumb-1;
     
     /* start TV iterations */
     for(i=0; i < iterationsNumb; i++) {
-        if ((epsil != 0.0f) && (i % 5 == 0)) copyIm(Output, Output_prev, (long)(dimX), (long)(dimY), (long)(dimZ));
+        if ((epsil != 0.0f) && (i % 5 == 0)) copyIm(U, Output_prev, DimTotal, 1l, 1l);
         
         /* calculate differences */
-        D1_func(Output, D1, (long)(dimX), (long)(dimY), (long)(dimZ));
-        D2_func(Output, D2, (long)(dimX), (long)(dimY), (long)(dimZ));
-        if (dimZ > 1) D3_func(Output, D3, (long)(dimX), (long)(dimY), (long)(dimZ));
-        TV_kernel(D1, D2, D3, Output, Input, lambdaPar, lambda_is_arr, tau, (long)(dimX), (long)(dimY), (long)(dimZ));
+        if (bricked) {
+            D1_func_br(U, D1, (long)(dimX), (long)(dimY), (long)(dimZ));
+            D2_func_br(U, D2, (long)(dimX), (long)(dimY), (long)(dimZ));
+            D3_func_br(U, D3, (long)(dimX), (long)(dimY), (long)(dimZ));
+            /* the last iteration also writes the planar output */
+            TV_kernel_br(D1, D2, D3, U, A, (i == iterationsNumb-1) ? Output : NULL, lambdaPar, lambda_is_arr, tau, (long)(dimX), (long)(dimY), (long)(dimZ));
+        }
+        else {
+            D1_func(U, D1, (long)(dimX), (long)(dimY), (long)(dimZ));
+            D2_func(U, D2, (long)(dimX), (long)(dimY), (long)(dimZ));
+            if (dimZ > 1) D3_func(U, D3, (long)(dimX), (long)(dimY), (long)(dimZ));
+            TV_kernel(D1, D2, D3, U, A, lambdaPar, lambda_is_arr, tau, (i == last) ? pass : NULL, (long)(dimX), (long)(dimY), (long)(dimZ));
+            if ((i == last) && (pass != NULL)) Output_done(pass, U);
+        }
         
         /* check early stopping criteria */
         if ((epsil != 0.0f) && (i % 5 == 0)) {
             re = 0.0f; re1 = 0.0f;
             for(j=0; j<DimTotal; j++)
             {
-                re += powf(Output[j] - Output_prev[j],2);
-                re1 += powf(Output[j],2);
+                re += powf(U[j] - Output_prev[j],2);
+                re1 += powf(U[j],2);
             }
             re = sqrtf(re)/sqrtf(re1);
             if (re < epsil)  count++;
             if (count > 3) break;
         }
+        if (Progress_step(i+1, re)) break;
+    }
+    Vol_free(D1);Vol_free(D2); Vol_free(D3);
+    if (epsil != 0.0f) Vol_free(Output_prev);
+    if (bricked) {
+        /* the planar output is still to be written if the iterations stopped earlier */
+        if ((iterationsNumb == 0) || (i < iterationsNumb)) Bricked_to_planar(U, Output, (long)(dimX), (long)(dimY), (long)(dimZ));
+        Vol_free(A); Vol_free(U);
+    }
+    else {
+        if (U != Output) {
+            Planar_to_strided(U, Output, outPitchY, outPitchZ, (long)(dimX), (long)(dimY), (long)(dimZ));
+            free(U);
+        }
+        if (A != Input) free(A);
     }
-    free(D1);free(D2); free(D3);
-    if (epsil != 0.0f) free(Output_prev);
     
     /*adding info into info_vector */
     infovector[0] = (float)(i);  /*iterations number (if stopped earlier based on tolerance)*/
@@ -98,48 +144,122 @@ float TV_ROF_CPU_main(float *Input, float *Output, float *infovector, float *lam
     return 0;
 }
 
+float TV_ROF_CPU_main(float *Input, float *Output, float *infovector, float *lambdaPar, int lambda_is_arr, int iterationsNumb, float tau, float epsil, int layout, int dimX, int dimY, int dimZ)
+{
+    return TV_ROF_CPU_run(Input, (long)(dimX), (long)(dimX)*dimY, Output, (long)(dimX), (long)(dimX)*dimY, infovector, lambdaPar, lambda_is_arr, iterationsNumb, tau, epsil, layout, dimX, dimY, dimZ);
+}
+
+float TV_ROF_CPU_strided(float *Input, long inPitchY, long inPitchZ, float *Output, long outPitchY, long outPitchZ, float *infovector, float *lambdaPar, int lambda_is_arr, int iterationsNumb, float tau, float epsil, int dimX, int dimY, int dimZ)
+{
+    return TV_ROF_CPU_run(Input, inPitchY, inPitchZ, Output, outPitchY, outPitchZ, infovector, lambdaPar, lambda_is_arr, iterationsNumb, tau, epsil, LAYOUT_PLANAR, dimX, dimY, dimZ);
+}
+
+/* Peak size in bytes of the work arrays allocated by TV_ROF_CPU_main */
+long TV_ROF_CPU_mem(float epsil, int layout, int dimX, int dimY, int dimZ)
+{
+    long DimTotal;
+    if ((dimZ > 1) && (layout == LAYOUT_BRICKED)) {
+        /* D1, D2, D3 and the bricked input and output */
+        DimTotal = Bricked_size((long)(dimX), (long)(dimY), (long)(dimZ));
+        return (5l + (epsil != 0.0f))*DimTotal*sizeof(float);
+    }
+    DimTotal = (long)(dimX)*(long)(dimY)*(long)(dimZ);
+    return (3l + (epsil != 0.0f))*DimTotal*sizeof(float);
+}
+
+/* Peak size in bytes of the work arrays allocated by TV_ROF_CPU_strided: the planar copies of
+ * the strided (or in place) input and output */
+long TV_ROF_CPU_strided_mem(float epsil, int in_strided, int out_strided, int dimX, int dimY, int dimZ)
+{
+    return TV_ROF_CPU_mem(epsil, LAYOUT_PLANAR, dimX, dimY, dimZ) + (long)(in_strided + out_strided)*dimX*dimY*dimZ*sizeof(float);
+}
+
+/* the iterations of a tile, the state is the output and D1, D2 are tile work arrays */
+typedef struct {
+    float lambda, tau;
+} rof_tile_args;
+
+static void TV_ROF_tile(void *arg, float *A, float **S, float **W, long nx, long ny, int it0, int iterations)
+{
+    rof_tile_args *p = (rof_tile_args*)arg;
+    int i;
+    for(i=0; i<iterations; i++) {
+        D1_func(S[0], W[0], nx, ny, 1l);
+        D2_func(S[0], W[1], nx, ny, 1l);
+        TV_kernel(W[0], W[1], W[1], S[0], A, &p->lambda, 0, p->tau, NULL, nx, ny, 1l);
+    }
+}
+
+float TV_ROF_CPU_tiled(float *Input, float *Output, float *infovector, float lambdaPar, int iterationsNumb, float tau, int tile, int sync, float accuracy, int dimX, int dimY)
+{
+    rof_tile_args p = {lambdaPar, tau};
+    copyIm(Input, Output, (long)(dimX), (long)(dimY), 1l);
+    Tile_run(TV_ROF_tile, &p, 1, 2, 1, Input, &Output, iterationsNumb, tile, sync, accuracy, (long)(dimX), (long)(dimY));
+    infovector[0] = (float)(iterationsNumb);
+    infovector[1] = 0.0f;
+    return 0;
+}
+
+/* Peak size in bytes of the work arrays allocated by TV_ROF_CPU_tiled */
+long TV_ROF_CPU_tiled_mem(int tile, int sync, float accuracy, int dimX, int dimY)
+{
+    return Tile_mem(1, 2, 1, tile, sync, accuracy, (long)(dimX), (long)(dimY));
+}
+
+/* The planar kernels are bodies over rows, (k,j) in 3D and j in 2D, started by Run_rows
+ * on the shared pool or on OpenMP (pool.h) */
+typedef struct {
+    float *A, *D1, *D2, *D3, *B, *lambda;
+    int lambda_is_arr;
+    float tau;
+    long dimX, dimY, dimZ;
+    int stream;     /* D1, D2, D3 are written with streaming stores (utils.h) */
+    output_pass *pass;  /* applied by TV_kernel to the rows of B (Output_rows), NULL - none */
+} rof_args;
+
 /* calculate differences 1 */
-float D1_func(float *A, float *D1, long dimX, long dimY, long dimZ)
+static void D1_func_rows(void *arg, long r0, long r1)
 {
+    rof_args *a = (rof_args*)arg;
+    float *A = a->A, *D1 = a->D1;
+    long dimX = a->dimX, dimY = a->dimY, dimZ = a->dimZ;
     float NOMx_1, NOMy_1, NOMy_0, NOMz_1, NOMz_0, denom1, denom2,denom3, T1;
-    long i,j,k,i1,i2,k1,j1,j2,k2,index;
+    long i,j,k,i1,i2,k1,j1,j2,k2,index,r;
     
     if (dimZ > 1) {
-#pragma omp parallel for shared (A, D1, dimX, dimY, dimZ) private(index, i, j, k, i1, j1, k1, i2, j2, k2, NOMx_1,NOMy_1,NOMy_0,NOMz_1,NOMz_0,denom1,denom2,denom3,T1)
-        for(k=0; k<dimZ; k++) {
-            for(j=0; j<dimY; j++) {
-                for(i=0; i<dimX; i++) {
-                    index = (dimX*dimY)*k + j*dimX+i;
-                    /* symmetric boundary conditions (Neuman) */
-                    i1 = i + 1; if (i1 >= dimX) i1 = i-1;
-                    i2 = i - 1; if (i2 < 0) i2 = i+1;
-                    j1 = j + 1; if (j1 >= dimY) j1 = j-1;
-                    j2 = j - 1; if (j2 < 0) j2 = j+1;
-                    k1 = k + 1; if (k1 >= dimZ) k1 = k-1;
-                    k2 = k - 1; if (k2 < 0) k2 = k+1;
-                    
-                    /* Forward-backward differences */
-                    NOMx_1 = A[(dimX*dimY)*k + j1*dimX + i] - A[index]; /* x+ */
-                    NOMy_1 = A[(dimX*dimY)*k + j*dimX + i1] - A[index]; /* y+ */
-                    /*NOMx_0 = (A[(i)*dimY + j] - A[(i2)*dimY + j]); */  /* x- */
-                    NOMy_0 = A[index] - A[(dimX*dimY)*k + j*dimX + i2]; /* y- */
-                    
-                    NOMz_1 = A[(dimX*dimY)*k1 + j*dimX + i] - A[index]; /* z+ */
-                    NOMz_0 = A[index] - A[(dimX*dimY)*k2 + j*dimX + i]; /* z- */
-                    
-                    
-                    denom1 = NOMx_1*NOMx_1;
-                    denom2 = 0.5f*(sign(NOMy_1) + sign(NOMy_0))*(MIN(fabs(NOMy_1),fabs(NOMy_0)));
-                    denom2 = denom2*denom2;
-                    denom3 = 0.5f*(sign(NOMz_1) + sign(NOMz_0))*(MIN(fabs(NOMz_1),fabs(NOMz_0)));
-                    denom3 = denom3*denom3;
-                    T1 = sqrt(denom1 + denom2 + denom3 + EPS);
-                    D1[index] = NOMx_1/T1;
-                }}}
+        for(r=r0; r<r1; r++) {
+            k = r/dimY; j = r - k*dimY;
+            for(i=0; i<dimX; i++) {
+                index = (dimX*dimY)*k + j*dimX+i;
+                /* symmetric boundary conditions (Neuman) */
+                i1 = i + 1; if (i1 >= dimX) i1 = i-1;
+                i2 = i - 1; if (i2 < 0) i2 = i+1;
+                j1 = j + 1; if (j1 >= dimY) j1 = j-1;
+                j2 = j - 1; if (j2 < 0) j2 = j+1;
+                k1 = k + 1; if (k1 >= dimZ) k1 = k-1;
+                k2 = k - 1; if (k2 < 0) k2 = k+1;
+                
+                /* Forward-backward differences */
+                NOMx_1 = A[(dimX*dimY)*k + j1*dimX + i] - A[index]; /* x+ */
+                NOMy_1 = A[(dimX*dimY)*k + j*dimX + i1] - A[index]; /* y+ */
+                /*NOMx_0 = (A[(i)*dimY + j] - A[(i2)*dimY + j]); */  /* x- */
+                NOMy_0 = A[index] - A[(dimX*dimY)*k + j*dimX + i2]; /* y- */
+                
+                NOMz_1 = A[(dimX*dimY)*k1 + j*dimX + i] - A[index]; /* z+ */
+                NOMz_0 = A[index] - A[(dimX*dimY)*k2 + j*dimX + i]; /* z- */
+                
+                
+                denom1 = NOMx_1*NOMx_1;
+                denom2 = 0.5f*(sign(NOMy_1) + sign(NOMy_0))*(MIN(fabs(NOMy_1),fabs(NOMy_0)));
+                denom2 = denom2*denom2;
+                denom3 = 0.5f*(sign(NOMz_1) + sign(NOMz_0))*(MIN(fabs(NOMz_1),fabs(NOMz_0)));
+                denom3 = denom3*denom3;
+                T1 = sqrt(denom1 + denom2 + denom3 + EPS);
+                if (a->stream) STREAM_STORE(&D1[index], NOMx_1/T1); else D1[index] = NOMx_1/T1;
+            }}
     }
     else {
-#pragma omp parallel for shared (A, D1, dimX, dimY) private(i, j, i1, j1, i2, j2,NOMx_1,NOMy_1,NOMy_0,denom1,denom2,T1,index)
-        for(j=0; j<dimY; j++) {
+        for(j=r0; j<r1; j++) {
             for(i=0; i<dimX; i++) {
                 index = j*dimX+i;
                 /* symmetric boundary conditions (Neuman) */
@@ -158,51 +278,58 @@ float D1_func(float *A, float *D1, long dimX, long dimY, long dimZ)
                 denom2 = 0.5f*(sign(NOMy_1) + sign(NOMy_0))*(MIN(fabs(NOMy_1),fabs(NOMy_0)));
                 denom2 = denom2*denom2;
                 T1 = sqrtf(denom1 + denom2 + EPS);
-                D1[index] = NOMx_1/T1;
+                if (a->stream) STREAM_STORE(&D1[index], NOMx_1/T1); else D1[index] = NOMx_1/T1;
             }}
     }
+    if (a->stream) Stream_fence();
+}
+float D1_func(float *A, float *D1, long dimX, long dimY, long dimZ)
+{
+    rof_args a = {A, D1, NULL, NULL, NULL, NULL, 0, 0.0f, dimX, dimY, dimZ, Vol_stream(dimX*dimY*dimZ)};
+    Run_rows((dimZ > 1) ? dimZ*dimY : dimY, D1_func_rows, &a);
     return *D1;
 }
 /* calculate differences 2 */
-float D2_func(float *A, float *D2, long dimX, long dimY, long dimZ)
+static void D2_func_rows(void *arg, long r0, long r1)
 {
+    rof_args *a = (rof_args*)arg;
+    float *A = a->A, *D2 = a->D2;
+    long dimX = a->dimX, dimY = a->dimY, dimZ = a->dimZ;
     float NOMx_1, NOMy_1, NOMx_0, NOMz_1, NOMz_0, denom1, denom2, denom3, T2;
-    long i,j,k,i1,i2,k1,j1,j2,k2,index;
+    long i,j,k,i1,i2,k1,j1,j2,k2,index,r;
     
     if (dimZ > 1) {
-#pragma omp parallel for shared (A, D2, dimX, dimY, dimZ) private(index, i, j, k, i1, j1, k1, i2, j2, k2,  NOMx_1, NOMy_1, NOMx_0, NOMz_1, NOMz_0, denom1, denom2, denom3, T2)
-        for(k=0; k<dimZ; k++) {
-            for(j=0; j<dimY; j++) {
-                for(i=0; i<dimX; i++) {
-                    index = (dimX*dimY)*k + j*dimX+i;
-                    /* symmetric boundary conditions (Neuman) */
-                    i1 = i + 1; if (i1 >= dimX) i1 = i-1;
-                    i2 = i - 1; if (i2 < 0) i2 = i+1;
-                    j1 = j + 1; if (j1 >= dimY) j1 = j-1;
-                    j2 = j - 1; if (j2 < 0) j2 = j+1;
-                    k1 = k + 1; if (k1 >= dimZ) k1 = k-1;
-                    k2 = k - 1; if (k2 < 0) k2 = k+1;
-                    
-                    /* Forward-backward differences */
-                    NOMx_1 = A[(dimX*dimY)*k + (j1)*dimX + i] - A[index]; /* x+ */
-                    NOMy_1 = A[(dimX*dimY)*k + (j)*dimX + i1] - A[index]; /* y+ */
-                    NOMx_0 = A[index] - A[(dimX*dimY)*k + (j2)*dimX + i]; /* x- */
-                    NOMz_1 = A[(dimX*dimY)*k1 + j*dimX + i] - A[index]; /* z+ */
-                    NOMz_0 = A[index] - A[(dimX*dimY)*k2 + (j)*dimX + i]; /* z- */
-                    
-                    
-                    denom1 = NOMy_1*NOMy_1;
-                    denom2 = 0.5f*(sign(NOMx_1) + sign(NOMx_0))*(MIN(fabs(NOMx_1),fabs(NOMx_0)));
-                    denom2 = denom2*denom2;
-                    denom3 = 0.5f*(sign(NOMz_1) + sign(NOMz_0))*(MIN(fabs(NOMz_1),fabs(NOMz_0)));
-                    denom3 = denom3*denom3;
-                    T2 = sqrtf(denom1 + denom2 + denom3 + EPS);
-                    D2[index] = NOMy_1/T2;
-                }}}
+        for(r=r0; r<r1; r++) {
+            k = r/dimY; j = r - k*dimY;
+            for(i=0; i<dimX; i++) {
+                index = (dimX*dimY)*k + j*dimX+i;
+                /* symmetric boundary conditions (Neuman) */
+                i1 = i + 1; if (i1 >= dimX) i1 = i-1;
+                i2 = i - 1; if (i2 < 0) i2 = i+1;
+                j1 = j + 1; if (j1 >= dimY) j1 = j-1;
+                j2 = j - 1; if (j2 < 0) j2 = j+1;
+                k1 = k + 1; if (k1 >= dimZ) k1 = k-1;
+                k2 = k - 1; if (k2 < 0) k2 = k+1;
+                
+                /* Forward-backward differences */
+                NOMx_1 = A[(dimX*dimY)*k + (j1)*dimX + i] - A[index]; /* x+ */
+                NOMy_1 = A[(dimX*dimY)*k + (j)*dimX + i1] - A[index]; /* y+ */
+                NOMx_0 = A[index] - A[(dimX*dimY)*k + (j2)*dimX + i]; /* x- */
+                NOMz_1 = A[(dimX*dimY)*k1 + j*dimX + i] - A[index]; /* z+ */
+                NOMz_0 = A[index] - A[(dimX*dimY)*k2 + (j)*dimX + i]; /* z- */
+                
+                
+                denom1 = NOMy_1*NOMy_1;
+                denom2 = 0.5f*(sign(NOMx_1) + sign(NOMx_0))*(MIN(fabs(NOMx_1),fabs(NOMx_0)));
+                denom2 = denom2*denom2;
+                denom3 = 0.5f*(sign(NOMz_1) + sign(NOMz_0))*(MIN(fabs(NOMz_1),fabs(NOMz_0)));
+                denom3 = denom3*denom3;
+                T2 = sqrtf(denom1 + denom2 + denom3 + EPS);
+                if (a->stream) STREAM_STORE(&D2[index], NOMy_1/T2); else D2[index] = NOMy_1/T2;
+            }}
     }
     else {
-#pragma omp parallel for shared (A, D2, dimX, dimY) private(i, j, i1, j1, i2, j2, NOMx_1,NOMy_1,NOMx_0,denom1,denom2,T2,index)
-        for(j=0; j<dimY; j++) {
+        for(j=r0; j<r1; j++) {
             for(i=0; i<dimX; i++) {
                 index = j*dimX+i;
                 /* symmetric boundary conditions (Neuman) */
@@ -221,23 +348,83 @@ float D2_func(float *A, float *D2, long dimX, long dimY, long dimZ)
                 denom2 = 0.5f*(sign(NOMx_1) + sign(NOMx_0))*(MIN(fabs(NOMx_1),fabs(NOMx_0)));
                 denom2 = denom2*denom2;
                 T2 = sqrtf(denom1 + denom2 + EPS);
-                D2[index] = NOMy_1/T2;
+                if (a->stream) STREAM_STORE(&D2[index], NOMy_1/T2); else D2[index] = NOMy_1/T2;
             }}
     }
+    if (a->stream) Stream_fence();
+}
+float D2_func(float *A, float *D2, long dimX, long dimY, long dimZ)
+{
+    rof_args a = {A, NULL, D2, NULL, NULL, NULL, 0, 0.0f, dimX, dimY, dimZ, Vol_stream(dimX*dimY*dimZ)};
+    Run_rows((dimZ > 1) ? dimZ*dimY : dimY, D2_func_rows, &a);
     return *D2;
 }
 
 /* calculate differences 3 */
-float D3_func(float *A, float *D3, long dimX, long dimY, long dimZ)
+static void D3_func_rows(void *arg, long r0, long r1)
 {
+    rof_args *a = (rof_args*)arg;
+    float *A = a->A, *D3 = a->D3;
+    long dimX = a->dimX, dimY = a->dimY, dimZ = a->dimZ;
     float NOMx_1, NOMy_1, NOMx_0, NOMy_0, NOMz_1, denom1, denom2, denom3, T3;
-    long index,i,j,k,i1,i2,k1,j1,j2,k2;
+    long index,i,j,k,i1,i2,k1,j1,j2,k2,r;
     
-#pragma omp parallel for shared (A, D3, dimX, dimY, dimZ) private(index, i, j, k, i1, j1, k1, i2, j2, k2,  NOMx_1, NOMy_1, NOMy_0, NOMx_0, NOMz_1, denom1, denom2, denom3, T3)
-    for(k=0; k<dimZ; k++) {
-        for(j=0; j<dimY; j++) {
+    for(r=r0; r<r1; r++) {
+        k = r/dimY; j = r - k*dimY;
+        for(i=0; i<dimX; i++) {
+            index = (dimX*dimY)*k + j*dimX+i;
+            /* symmetric boundary conditions (Neuman) */
+            i1 = i + 1; if (i1 >= dimX) i1 = i-1;
+            i2 = i - 1; if (i2 < 0) i2 = i+1;
+            j1 = j + 1; if (j1 >= dimY) j1 = j-1;
+            j2 = j - 1; if (j2 < 0) j2 = j+1;
+            k1 = k + 1; if (k1 >= dimZ) k1 = k-1;
+            k2 = k - 1; if (k2 < 0) k2 = k+1;
+            
+            /* Forward-backward differences */
+            NOMx_1 = A[(dimX*dimY)*k + (j1)*dimX + i] - A[index]; /* x+ */
+            NOMy_1 = A[(dimX*dimY)*k + (j)*dimX + i1] - A[index]; /* y+ */
+            NOMy_0 = A[index] - A[(dimX*dimY)*k + (j)*dimX + i2]; /* y- */
+            NOMx_0 = A[index] - A[(dimX*dimY)*k + (j2)*dimX + i]; /* x- */
+            NOMz_1 = A[(dimX*dimY)*k1 + j*dimX + i] - A[index]; /* z+ */
+            /*NOMz_0 = A[(dimX*dimY)*k + (i)*dimY + j] - A[(dimX*dimY)*k2 + (i)*dimY + j]; */ /* z- */
+            
+            denom1 = NOMz_1*NOMz_1;
+            denom2 = 0.5f*(sign(NOMx_1) + sign(NOMx_0))*(MIN(fabs(NOMx_1),fabs(NOMx_0)));
+            denom2 = denom2*denom2;
+            denom3 = 0.5f*(sign(NOMy_1) + sign(NOMy_0))*(MIN(fabs(NOMy_1),fabs(NOMy_0)));
+            denom3 = denom3*denom3;
+            T3 = sqrtf(denom1 + denom2 + denom3 + EPS);
+            if (a->stream) STREAM_STORE(&D3[index], NOMz_1/T3); else D3[index] = NOMz_1/T3;
+        }}
+    if (a->stream) Stream_fence();
+}
+float D3_func(float *A, float *D3, long dimX, long dimY, long dimZ)
+{
+    rof_args a = {A, NULL, NULL, D3, NULL, NULL, 0, 0.0f, dimX, dimY, dimZ, Vol_stream(dimX*dimY*dimZ)};
+    Run_rows((dimZ > 1) ? dimZ*dimY : dimY, D3_func_rows, &a);
+    return *D3;
+}
+
+/* calculate divergence */
+static void TV_kernel_rows(void *arg, long r0, long r1)
+{
+    rof_args *a = (rof_args*)arg;
+    float *D1 = a->D1, *D2 = a->D2, *D3 = a->D3, *B = a->B, *A = a->A, *lambda = a->lambda, tau = a->tau;
+    int lambda_is_arr = a->lambda_is_arr;
+    output_pass *pass = a->pass;
+    long dimX = a->dimX, dimY = a->dimY, dimZ = a->dimZ;
+    float dv1, dv2, dv3, lambda_val;
+    long index,i,j,k,i1,i2,k1,j1,j2,k2,r;
+    output_acc acc;
+    
+    if (pass != NULL) Output_open(pass, &acc);
+    if (dimZ > 1) {
+        for(r=r0; r<r1; r++) {
+            k = r/dimY; j = r - k*dimY;
             for(i=0; i<dimX; i++) {
                 index = (dimX*dimY)*k + j*dimX+i;
+                lambda_val = *(lambda + index* lambda_is_arr);
                 /* symmetric boundary conditions (Neuman) */
                 i1 = i + 1; if (i1 >= dimX) i1 = i-1;
                 i2 = i - 1; if (i2 < 0) i2 = i+1;
@@ -246,57 +433,18 @@ float D3_func(float *A, float *D3, long dimX, long dimY, long dimZ)
                 k1 = k + 1; if (k1 >= dimZ) k1 = k-1;
                 k2 = k - 1; if (k2 < 0) k2 = k+1;
                 
-                /* Forward-backward differences */
-                NOMx_1 = A[(dimX*dimY)*k + (j1)*dimX + i] - A[index]; /* x+ */
-                NOMy_1 = A[(dimX*dimY)*k + (j)*dimX + i1] - A[index]; /* y+ */
-                NOMy_0 = A[index] - A[(dimX*dimY)*k + (j)*dimX + i2]; /* y- */
-                NOMx_0 = A[index] - A[(dimX*dimY)*k + (j2)*dimX + i]; /* x- */
-                NOMz_1 = A[(dimX*dimY)*k1 + j*dimX + i] - A[index]; /* z+ */
-                /*NOMz_0 = A[(dimX*dimY)*k + (i)*dimY + j] - A[(dimX*dimY)*k2 + (i)*dimY + j]; */ /* z- */
+                /*divergence components */
+                dv1 = D1[index] - D1[(dimX*dimY)*k + j2*dimX+i];
+                dv2 = D2[index] - D2[(dimX*dimY)*k + j*dimX+i2];
+                dv3 = D3[index] - D3[(dimX*dimY)*k2 + j*dimX+i];
                 
-                denom1 = NOMz_1*NOMz_1;
-                denom2 = 0.5f*(sign(NOMx_1) + sign(NOMx_0))*(MIN(fabs(NOMx_1),fabs(NOMx_0)));
-                denom2 = denom2*denom2;
-                denom3 = 0.5f*(sign(NOMy_1) + sign(NOMy_0))*(MIN(fabs(NOMy_1),fabs(NOMy_0)));
-                denom3 = denom3*denom3;
-                T3 = sqrtf(denom1 + denom2 + denom3 + EPS);
-                D3[index] = NOMz_1/T3;
-            }}}
-    return *D3;
-}
-
-/* calculate divergence */
-float TV_kernel(float *D1, float *D2, float *D3, float *B, float *A, float *lambda, int lambda_is_arr, float tau, long dimX, long dimY, long dimZ)
-{
-    float dv1, dv2, dv3, lambda_val;
-    long index,i,j,k,i1,i2,k1,j1,j2,k2;
-    
-    if (dimZ > 1) {
-#pragma omp parallel for shared (D1, D2, D3, B, dimX, dimY, dimZ) private(index, i, j, k, i1, j1, k1, i2, j2, k2, dv1,dv2,dv3,lambda_val)
-        for(k=0; k<dimZ; k++) {
-            for(j=0; j<dimY; j++) {
-                for(i=0; i<dimX; i++) {
-                    index = (dimX*dimY)*k + j*dimX+i;
-                    lambda_val = *(lambda + index* lambda_is_arr);
-                    /* symmetric boundary conditions (Neuman) */
-                    i1 = i + 1; if (i1 >= dimX) i1 = i-1;
-                    i2 = i - 1; if (i2 < 0) i2 = i+1;
-                    j1 = j + 1; if (j1 >= dimY) j1 = j-1;
-                    j2 = j - 1; if (j2 < 0) j2 = j+1;
-                    k1 = k + 1; if (k1 >= dimZ) k1 = k-1;
-                    k2 = k - 1; if (k2 < 0) k2 = k+1;
-                    
-                    /*divergence components */
-                    dv1 = D1[index] - D1[(dimX*dimY)*k + j2*dimX+i];
-                    dv2 = D2[index] - D2[(dimX*dimY)*k + j*dimX+i2];
-                    dv3 = D3[index] - D3[(dimX*dimY)*k2 + j*dimX+i];
-                    
-                    B[index] += tau*(lambda_val*(dv1 + dv2 + dv3) - (B[index] - A[index]));
-                }}}
+                B[index] += tau*(lambda_val*(dv1 + dv2 + dv3) - (B[index] - A[index]));
+            }
+            if (pass != NULL) Output_rows(pass, &acc, B + (dimX*dimY)*k + j*dimX, dimX);
+        }
     }
     else {
-#pragma omp parallel for shared (D1, D2, B, dimX, dimY) private(index, i, j, i1, j1, i2, j2,dv1,dv2,lambda_val)
-        for(j=0; j<dimY; j++) {
+        for(j=r0; j<r1; j++) {
             for(i=0; i<dimX; i++) {
                 index = j*dimX+i;
                 lambda_val = *(lambda + index* lambda_is_arr);
@@ -311,7 +459,332 @@ float TV_kernel(float *D1, float *D2, float *D3, float *B, float *A, float *lamb
                 dv2 = D2[index] - D2[j*dimX + i2];
                 
                 B[index] += tau*(lambda_val*(dv1 + dv2) - (B[index] - A[index]));
-            }}
+            }
+            if (pass != NULL) Output_rows(pass, &acc, B + j*dimX, dimX);
+        }
+    }
+    if (pass != NULL) Output_close(pass, &acc);
+}
+float TV_kernel(float *D1, float *D2, float *D3, float *B, float *A, float *lambda, int lambda_is_arr, float tau, output_pass *pass, long dimX, long dimY, long dimZ)
+{
+    rof_args a = {A, D1, D2, D3, B, lambda, lambda_is_arr, tau, dimX, dimY, dimZ, 0, pass};
+    Run_rows((dimZ > 1) ? dimZ*dimY : dimY, TV_kernel_rows, &a);
+    return *B;
+}
+
+/********************************************************************/
+/**************3D Functions for the bricked layout*******************/
+/********************************************************************/
+/* the kernels below run brick by brick, neighbours across the brick faces are reached through BIDX */
+float D1_func_br(float *A, float *D1, long dimX, long dimY, long dimZ)
+{
+    float NOMx_1, NOMy_1, NOMy_0, NOMz_1, NOMz_0, denom1, denom2,denom3, T1;
+    int stream;
+    long b,i,j,k,i0,j0,k0,i1,i2,k1,j1,j2,k2,index,nbX,nbY,nbZ;
+    nbX = (dimX+BRICK-1)/BRICK; nbY = (dimY+BRICK-1)/BRICK; nbZ = (dimZ+BRICK-1)/BRICK;
+    stream = Vol_stream(Bricked_size(dimX, dimY, dimZ));
+    
+#pragma omp parallel shared (A, D1) private(b, index, i, j, k, i0, j0, k0, i1, j1, k1, i2, j2, k2, NOMx_1,NOMy_1,NOMy_0,NOMz_1,NOMz_0,denom1,denom2,denom3,T1)
+    {
+#pragma omp for
+    for(b=0; b<nbX*nbY*nbZ; b++) {
+        i0 = (b % nbX)*BRICK; j0 = ((b/nbX) % nbY)*BRICK; k0 = (b/(nbX*nbY))*BRICK;
+        for(k=k0; k<MIN(k0+BRICK,dimZ); k++) {
+            for(j=j0; j<MIN(j0+BRICK,dimY); j++) {
+                for(i=i0; i<MIN(i0+BRICK,dimX); i++) {
+                    index = BIDX(i,j,k,nbX,nbY);
+                    /* symmetric boundary conditions (Neuman) */
+                    i1 = i + 1; if (i1 >= dimX) i1 = i-1;
+                    i2 = i - 1; if (i2 < 0) i2 = i+1;
+                    j1 = j + 1; if (j1 >= dimY) j1 = j-1;
+                    j2 = j - 1; if (j2 < 0) j2 = j+1;
+                    k1 = k + 1; if (k1 >= dimZ) k1 = k-1;
+                    k2 = k - 1; if (k2 < 0) k2 = k+1;
+                    
+                    /* Forward-backward differences */
+                    NOMx_1 = A[BIDX(i,j1,k,nbX,nbY)] - A[index]; /* x+ */
+                    NOMy_1 = A[BIDX(i1,j,k,nbX,nbY)] - A[index]; /* y+ */
+                    NOMy_0 = A[index] - A[BIDX(i2,j,k,nbX,nbY)]; /* y- */
+                    NOMz_1 = A[BIDX(i,j,k1,nbX,nbY)] - A[index]; /* z+ */
+                    NOMz_0 = A[index] - A[BIDX(i,j,k2,nbX,nbY)]; /* z- */
+                    
+                    denom1 = NOMx_1*NOMx_1;
+                    denom2 = 0.5f*(sign(NOMy_1) + sign(NOMy_0))*(MIN(fabs(NOMy_1),fabs(NOMy_0)));
+                    denom2 = denom2*denom2;
+                    denom3 = 0.5f*(sign(NOMz_1) + sign(NOMz_0))*(MIN(fabs(NOMz_1),fabs(NOMz_0)));
+                    denom3 = denom3*denom3;
+                    T1 = sqrt(denom1 + denom2 + denom3 + EPS);
+                    if (stream) STREAM_STORE(&D1[index], NOMx_1/T1); else D1[index] = NOMx_1/T1;
+                }}}}
+    if (stream) Stream_fence();
+    }
+    return *D1;
+}
+float D2_func_br(float *A, float *D2, long dimX, long dimY, long dimZ)
+{
+    float NOMx_1, NOMy_1, NOMx_0, NOMz_1, NOMz_0, denom1, denom2, denom3, T2;
+    int stream;
+    long b,i,j,k,i0,j0,k0,i1,i2,k1,j1,j2,k2,index,nbX,nbY,nbZ;
+    nbX = (dimX+BRICK-1)/BRICK; nbY = (dimY+BRICK-1)/BRICK; nbZ = (dimZ+BRICK-1)/BRICK;
+    stream = Vol_stream(Bricked_size(dimX, dimY, dimZ));
+    
+#pragma omp parallel shared (A, D2) private(b, index, i, j, k, i0, j0, k0, i1, j1, k1, i2, j2, k2, NOMx_1, NOMy_1, NOMx_0, NOMz_1, NOMz_0, denom1, denom2, denom3, T2)
+    {
+#pragma omp for
+    for(b=0; b<nbX*nbY*nbZ; b++) {
+        i0 = (b % nbX)*BRICK; j0 = ((b/nbX) % nbY)*BRICK; k0 = (b/(nbX*nbY))*BRICK;
+        for(k=k0; k<MIN(k0+BRICK,dimZ); k++) {
+            for(j=j0; j<MIN(j0+BRICK,dimY); j++) {
+                for(i=i0; i<MIN(i0+BRICK,dimX); i++) {
+                    index = BIDX(i,j,k,nbX,nbY);
+                    /* symmetric boundary conditions (Neuman) */
+                    i1 = i + 1; if (i1 >= dimX) i1 = i-1;
+                    i2 = i - 1; if (i2 < 0) i2 = i+1;
+                    j1 = j + 1; if (j1 >= dimY) j1 = j-1;
+                    j2 = j - 1; if (j2 < 0) j2 = j+1;
+                    k1 = k + 1; if (k1 >= dimZ) k1 = k-1;
+                    k2 = k - 1; if (k2 < 0) k2 = k+1;
+                    
+                    /* Forward-backward differences */
+                    NOMx_1 = A[BIDX(i,j1,k,nbX,nbY)] - A[index]; /* x+ */
+                    NOMy_1 = A[BIDX(i1,j,k,nbX,nbY)] - A[index]; /* y+ */
+                    NOMx_0 = A[index] - A[BIDX(i,j2,k,nbX,nbY)]; /* x- */
+                    NOMz_1 = A[BIDX(i,j,k1,nbX,nbY)] - A[index]; /* z+ */
+                    NOMz_0 = A[index] - A[BIDX(i,j,k2,nbX,nbY)]; /* z- */
+                    
+                    denom1 = NOMy_1*NOMy_1;
+                    denom2 = 0.5f*(sign(NOMx_1) + sign(NOMx_0))*(MIN(fabs(NOMx_1),fabs(NOMx_0)));
+                    denom2 = denom2*denom2;
+                    denom3 = 0.5f*(sign(NOMz_1) + sign(NOMz_0))*(MIN(fabs(NOMz_1),fabs(NOMz_0)));
+                    denom3 = denom3*denom3;
+                    T2 = sqrtf(denom1 + denom2 + denom3 + EPS);
+                    if (stream) STREAM_STORE(&D2[index], NOMy_1/T2); else D2[index] = NOMy_1/T2;
+                }}}}
+    if (stream) Stream_fence();
     }
+    return *D2;
+}
+float D3_func_br(float *A, float *D3, long dimX, long dimY, long dimZ)
+{
+    float NOMx_1, NOMy_1, NOMx_0, NOMy_0, NOMz_1, denom1, denom2, denom3, T3;
+    int stream;
+    long b,i,j,k,i0,j0,k0,i1,i2,k1,j1,j2,index,nbX,nbY,nbZ;
+    nbX = (dimX+BRICK-1)/BRICK; nbY = (dimY+BRICK-1)/BRICK; nbZ = (dimZ+BRICK-1)/BRICK;
+    stream = Vol_stream(Bricked_size(dimX, dimY, dimZ));
+    
+#pragma omp parallel shared (A, D3) private(b, index, i, j, k, i0, j0, k0, i1, j1, k1, i2, j2, NOMx_1, NOMy_1, NOMy_0, NOMx_0, NOMz_1, denom1, denom2, denom3, T3)
+    {
+#pragma omp for
+    for(b=0; b<nbX*nbY*nbZ; b++) {
+        i0 = (b % nbX)*BRICK; j0 = ((b/nbX) % nbY)*BRICK; k0 = (b/(nbX*nbY))*BRICK;
+        for(k=k0; k<MIN(k0+BRICK,dimZ); k++) {
+            for(j=j0; j<MIN(j0+BRICK,dimY); j++) {
+                for(i=i0; i<MIN(i0+BRICK,dimX); i++) {
+                    index = BIDX(i,j,k,nbX,nbY);
+                    /* symmetric boundary conditions (Neuman) */
+                    i1 = i + 1; if (i1 >= dimX) i1 = i-1;
+                    i2 = i - 1; if (i2 < 0) i2 = i+1;
+                    j1 = j + 1; if (j1 >= dimY) j1 = j-1;
+                    j2 = j - 1; if (j2 < 0) j2 = j+1;
+                    k1 = k + 1; if (k1 >= dimZ) k1 = k-1;
+                    
+                    /* Forward-backward differences */
+                    NOMx_1 = A[BIDX(i,j1,k,nbX,nbY)] - A[index]; /* x+ */
+                    NOMy_1 = A[BIDX(i1,j,k,nbX,nbY)] - A[index]; /* y+ */
+                    NOMy_0 = A[index] - A[BIDX(i2,j,k,nbX,nbY)]; /* y- */
+                    NOMx_0 = A[index] - A[BIDX(i,j2,k,nbX,nbY)]; /* x- */
+                    NOMz_1 = A[BIDX(i,j,k1,nbX,nbY)] - A[index]; /* z+ */
+                    
+                    denom1 = NOMz_1*NOMz_1;
+                    denom2 = 0.5f*(sign(NOMx_1) + sign(NOMx_0))*(MIN(fabs(NOMx_1),fabs(NOMx_0)));
+                    denom2 = denom2*denom2;
+                    denom3 = 0.5f*(sign(NOMy_1) + sign(NOMy_0))*(MIN(fabs(NOMy_1),fabs(NOMy_0)));
+                    denom3 = denom3*denom3;
+                    T3 = sqrtf(denom1 + denom2 + denom3 + EPS);
+                    if (stream) STREAM_STORE(&D3[index], NOMz_1/T3); else D3[index] = NOMz_1/T3;
+                }}}}
+    if (stream) Stream_fence();
+    }
+    return *D3;
+}
+/* divergence and update of the bricked B, if Out is not NULL the result is also stored in planar order */
+float TV_kernel_br(float *D1, float *D2, float *D3, float *B, float *A, float *Out, float *lambda, int lambda_is_arr, float tau, long dimX, long dimY, long dimZ)
+{
+    float dv1, dv2, dv3, lambda_val;
+    long b,i,j,k,i0,j0,k0,j2,i2,k2,index,nbX,nbY,nbZ;
+    nbX = (dimX+BRICK-1)/BRICK; nbY = (dimY+BRICK-1)/BRICK; nbZ = (dimZ+BRICK-1)/BRICK;
+    
+#pragma omp parallel for shared (D1, D2, D3, B, A, Out) private(b, index, i, j, k, i0, j0, k0, i2, j2, k2, dv1,dv2,dv3,lambda_val)
+    for(b=0; b<nbX*nbY*nbZ; b++) {
+        i0 = (b % nbX)*BRICK; j0 = ((b/nbX) % nbY)*BRICK; k0 = (b/(nbX*nbY))*BRICK;
+        for(k=k0; k<MIN(k0+BRICK,dimZ); k++) {
+            for(j=j0; j<MIN(j0+BRICK,dimY); j++) {
+                for(i=i0; i<MIN(i0+BRICK,dimX); i++) {
+                    index = BIDX(i,j,k,nbX,nbY);
+                    /* lambda array (if given) stays in the planar order */
+                    lambda_val = *(lambda + ((dimX*dimY)*k + j*dimX+i)*lambda_is_arr);
+                    /* symmetric boundary conditions (Neuman) */
+                    i2 = i - 1; if (i2 < 0) i2 = i+1;
+                    j2 = j - 1; if (j2 < 0) j2 = j+1;
+                    k2 = k - 1; if (k2 < 0) k2 = k+1;
+                    
+                    /*divergence components */
+                    dv1 = D1[index] - D1[BIDX(i,j2,k,nbX,nbY)];
+                    dv2 = D2[index] - D2[BIDX(i2,j,k,nbX,nbY)];
+                    dv3 = D3[index] - D3[BIDX(i,j,k2,nbX,nbY)];
+                    
+                    B[index] += tau*(lambda_val*(dv1 + dv2 + dv3) - (B[index] - A[index]));
+                    if (Out != NULL) Out[(dimX*dimY)*k + j*dimX+i] = B[index];
+                }}}}
     return *B;
 }
+
+/********************************************************************/
+/*******Lockstep solution of K problems with different lambdas*******/
+/********************************************************************/
+/* The K solutions are interleaved per voxel, U[index*K + l], so that one stencil pass computes the
+ * neighbour indices and reads the input once for all lanes, the lane loops are vectorised.
+ * In 2D the z neighbours are the voxel itself and the z terms vanish. */
+typedef struct {
+    float *A, *U, *D1, *D2, *D3, *lambdas;
+    int K;
+    float tau;
+    long dimX, dimY, dimZ;
+} rofm_args;
+
+/* square of 0.5*(sign(a) + sign(b))*min(|a|,|b|) */
+#define MINMOD2(a, b) ((((a)*(b)) > 0.0f) ? MIN((a)*(a), (b)*(b)) : 0.0f)
+
+/* calculate differences D1, D2 (and D3 in 3D) for all lanes */
+static void D_func_multi_rows(void *arg, long r0, long r1)
+{
+    rofm_args *a = (rofm_args*)arg;
+    float *U = a->U, *D1 = a->D1, *D2 = a->D2, *D3 = a->D3;
+    long K = a->K, dimX = a->dimX, dimY = a->dimY, dimZ = a->dimZ;
+    long i,j,k,l,r,index,ni1,ni2,nj1,nj2,nk1,nk2;
+
+    for(r=r0; r<r1; r++) {
+        k = r/dimY; j = r - k*dimY;
+        for(i=0; i<dimX; i++) {
+            index = (dimX*dimY)*k + j*dimX+i;
+            /* symmetric boundary conditions (Neuman), neighbours as offsets of the lane vectors */
+            ni1 = (i + 1 >= dimX) ? index-1 : index+1;
+            ni2 = (i - 1 < 0) ? index+1 : index-1;
+            nj1 = (j + 1 >= dimY) ? index-dimX : index+dimX;
+            nj2 = (j - 1 < 0) ? index+dimX : index-dimX;
+            if (dimZ > 1) {
+                nk1 = (k + 1 >= dimZ) ? index-dimX*dimY : index+dimX*dimY;
+                nk2 = (k - 1 < 0) ? index+dimX*dimY : index-dimX*dimY;
+            }
+            else {nk1 = index; nk2 = index;}
+            index *= K; ni1 *= K; ni2 *= K; nj1 *= K; nj2 *= K; nk1 *= K; nk2 *= K;
+
+            OMP_SIMD
+            for(l=0; l<K; l++) {
+                float u0 = U[index+l];
+                /* Forward-backward differences */
+                float NOMx_1 = U[nj1+l] - u0; /* x+ */
+                float NOMx_0 = u0 - U[nj2+l]; /* x- */
+                float NOMy_1 = U[ni1+l] - u0; /* y+ */
+                float NOMy_0 = u0 - U[ni2+l]; /* y- */
+                float NOMz_1 = U[nk1+l] - u0; /* z+ */
+                float NOMz_0 = u0 - U[nk2+l]; /* z- */
+
+                double T1 = NOMx_1*NOMx_1 + MINMOD2(NOMy_1,NOMy_0) + MINMOD2(NOMz_1,NOMz_0) + EPS;
+                /* D1_func takes the square root in double in 3D */
+                D1[index+l] = NOMx_1/((dimZ > 1) ? (float)sqrt(T1) : sqrtf((float)T1));
+                D2[index+l] = NOMy_1/sqrtf(NOMy_1*NOMy_1 + MINMOD2(NOMx_1,NOMx_0) + MINMOD2(NOMz_1,NOMz_0) + EPS);
+            }
+            if (dimZ > 1) {
+                OMP_SIMD
+                for(l=0; l<K; l++) {
+                    float u0 = U[index+l];
+                    float NOMx_1 = U[nj1+l] - u0; /* x+ */
+                    float NOMx_0 = u0 - U[nj2+l]; /* x- */
+                    float NOMy_1 = U[ni1+l] - u0; /* y+ */
+                    float NOMy_0 = u0 - U[ni2+l]; /* y- */
+                    float NOMz_1 = U[nk1+l] - u0; /* z+ */
+                    D3[index+l] = NOMz_1/sqrtf(NOMz_1*NOMz_1 + MINMOD2(NOMx_1,NOMx_0) + MINMOD2(NOMy_1,NOMy_0) + EPS);
+                }
+            }
+        }}
+}
+
+/* calculate divergence and update all lanes, lane l uses lambdas[l] */
+static void TV_kernel_multi_rows(void *arg, long r0, long r1)
+{
+    rofm_args *a = (rofm_args*)arg;
+    float *A = a->A, *U = a->U, *D1 = a->D1, *D2 = a->D2, *D3 = a->D3, *lambdas = a->lambdas, tau = a->tau;
+    long K = a->K, dimX = a->dimX, dimY = a->dimY, dimZ = a->dimZ;
+    float a0;
+    long i,j,k,l,r,index,ni2,nj2,nk2;
+
+    for(r=r0; r<r1; r++) {
+        k = r/dimY; j = r - k*dimY;
+        for(i=0; i<dimX; i++) {
+            index = (dimX*dimY)*k + j*dimX+i;
+            a0 = A[index];
+            ni2 = ((i - 1 < 0) ? index+1 : index-1)*K;
+            nj2 = ((j - 1 < 0) ? index+dimX : index-dimX)*K;
+            nk2 = ((dimZ > 1) ? ((k - 1 < 0) ? index+dimX*dimY : index-dimX*dimY) : index)*K;
+            index *= K;
+
+            OMP_SIMD
+            for(l=0; l<K; l++) {
+                /*divergence components */
+                float dv1 = D1[index+l] - D1[nj2+l];
+                float dv2 = D2[index+l] - D2[ni2+l];
+                float dv3 = D3[index+l] - D3[nk2+l];
+                U[index+l] += tau*(lambdas[l]*(dv1 + dv2 + dv3) - (U[index+l] - a0));
+            }
+        }}
+}
+
+/* Runs iterationsNumb ROF-TV iterations for the K regularisation parameters lambdas[0..K-1] in
+ * lockstep. Output keeps the K planar results one after the other. The iterations are not stopped
+ * on a tolerance (all lanes run the same number), infovector is [iterations, 0]. */
+float TV_ROF_CPU_multi(float *Input, float *Output, float *infovector, float *lambdas, int K, int iterationsNumb, float tau, int dimX, int dimY, int dimZ)
+{
+    float *U=NULL, *D1=NULL, *D2=NULL, *D3=NULL;
+    long DimTotal, index, l, rows;
+    int i;
+    DimTotal = (long)(dimX)*(long)(dimY)*(long)(dimZ);
+    rows = (long)(dimY)*(long)(dimZ);
+
+    U = Vol_calloc(K*DimTotal);
+    D1 = Vol_calloc(K*DimTotal);
+    D2 = Vol_calloc(K*DimTotal);
+    /* in 2D the z neighbour is the voxel itself, D1 stands in for D3 and dv3 is zero */
+    D3 = (dimZ > 1) ? Vol_calloc(K*DimTotal) : D1;
+
+#pragma omp parallel for shared(Input, U) private(index, l)
+    for(index=0; index<DimTotal; index++) {
+        for(l=0; l<K; l++) U[index*K+l] = Input[index];
+    }
+
+    rofm_args a = {Input, U, D1, D2, D3, lambdas, K, tau, (long)(dimX), (long)(dimY), (long)(dimZ)};
+    for(i=0; i < iterationsNumb; i++) {
+        Run_rows(rows, D_func_multi_rows, &a);
+        Run_rows(rows, TV_kernel_multi_rows, &a);
+    }
+
+    /* de-interleaving the lanes into the K outputs */
+#pragma omp parallel for shared(Output, U) private(index, l)
+    for(index=0; index<DimTotal; index++) {
+        for(l=0; l<K; l++) Output[l*DimTotal+index] = U[index*K+l];
+    }
+    Vol_free(U); Vol_free(D1); Vol_free(D2);
+    if (dimZ > 1) Vol_free(D3);
+
+    infovector[0] = (float)(iterationsNumb);
+    infovector[1] = 0.0f;
+    return 0;
+}
+
+/* Peak size in bytes of the work arrays allocated by TV_ROF_CPU_multi */
+long TV_ROF_CPU_multi_mem(int K, int dimX, int dimY, int dimZ)
+{
+    long DimTotal;
+    DimTotal = (long)(dimX)*(long)(dimY)*(long)(dimZ);
+    return (long)(K)*(3l + (dimZ > 1))*DimTotal*sizeof(float);
+}
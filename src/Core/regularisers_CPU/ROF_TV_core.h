@@ -23,6 +23,8 @@ limitations under the License.
 #include <stdio.h>
 #include "omp.h"
 #include "utils.h"
+#include "pool.h"
+#include "tile.h"
 #include "CCPiDefines.h"
 
 /* C-OMP implementation of ROF-TV denoising/regularization model [1] (2D/3D case)
@@ -33,6 +35,7 @@ limitations under the License.
  * 3. tau - marching step for explicit scheme, ~1 is recommended [REQUIRED]
  * 4. Number of iterations, for explicit scheme >= 150 is recommended  [REQUIRED]
  * 5. eplsilon: tolerance constant
+ * 6. layout: storage of the 3D work arrays, planar (0) or 8x8x8 bricks (2)
  *
  * Output:
  * [1] Regularised image/volume
@@ -40,16 +43,39 @@ limitations under the License.
  *
  * This function is based on the paper by
  * [1] Rudin, Osher, Fatemi, "Nonlinear Total Variation based noise removal algorithms"
+ *
+ * TV_ROF_CPU_multi solves the problem for K scalar lambdas in lockstep (planar storage, fixed
+ * number of iterations) and returns the K results one after the other in Output
+ *
+ * TV_ROF_CPU_tiled runs the 2D iterations on cache-sized tiles (tile.h): tile - tile edge,
+ * sync - iterations between halo exchanges, accuracy - 1 for the result of TV_ROF_CPU_main,
+ * smaller for narrower halos (a fixed number of iterations, no tolerance)
+ *
+ * TV_ROF_CPU_strided takes Input and Output as strided views (utils.h), e.g. a sub-volume of a
+ * larger array or a padded buffer: rows pitchY and slices pitchZ floats apart. The views are
+ * gathered and scattered by the core, planar storage is used; a lambda array is dense. Output
+ * may be Input (in place), other overlaps are not allowed
  */
 
 #ifdef __cplusplus
 extern "C" {
 #endif
-CCPI_EXPORT float TV_ROF_CPU_main(float *Input, float *Output, float *infovector, float *lambdaPar, int lambda_is_arr, int iterationsNumb, float tau, float epsil, int dimX, int dimY, int dimZ);
-CCPI_EXPORT float TV_kernel(float *D1, float *D2, float *D3, float *B, float *A, float *lambda, int lambda_is_arr, float tau, long dimX, long dimY, long dimZ);
+CCPI_EXPORT float TV_ROF_CPU_main(float *Input, float *Output, float *infovector, float *lambdaPar, int lambda_is_arr, int iterationsNumb, float tau, float epsil, int layout, int dimX, int dimY, int dimZ);
+CCPI_EXPORT long TV_ROF_CPU_mem(float epsil, int layout, int dimX, int dimY, int dimZ);
+CCPI_EXPORT float TV_ROF_CPU_strided(float *Input, long inPitchY, long inPitchZ, float *Output, long outPitchY, long outPitchZ, float *infovector, float *lambdaPar, int lambda_is_arr, int iterationsNumb, float tau, float epsil, int dimX, int dimY, int dimZ);
+CCPI_EXPORT long TV_ROF_CPU_strided_mem(float epsil, int in_strided, int out_strided, int dimX, int dimY, int dimZ);
+CCPI_EXPORT float TV_ROF_CPU_multi(float *Input, float *Output, float *infovector, float *lambdas, int K, int iterationsNumb, float tau, int dimX, int dimY, int dimZ);
+CCPI_EXPORT float TV_ROF_CPU_tiled(float *Input, float *Output, float *infovector, float lambdaPar, int iterationsNumb, float tau, int tile, int sync, float accuracy, int dimX, int dimY);
+CCPI_EXPORT long TV_ROF_CPU_tiled_mem(int tile, int sync, float accuracy, int dimX, int dimY);
+CCPI_EXPORT long TV_ROF_CPU_multi_mem(int K, int dimX, int dimY, int dimZ);
+CCPI_EXPORT float TV_kernel(float *D1, float *D2, float *D3, float *B, float *A, float *lambda, int lambda_is_arr, float tau, output_pass *pass, long dimX, long dimY, long dimZ);
 CCPI_EXPORT float D1_func(float *A, float *D1, long dimX, long dimY, long dimZ);
 CCPI_EXPORT float D2_func(float *A, float *D2, long dimX, long dimY, long dimZ);
 CCPI_EXPORT float D3_func(float *A, float *D3, long dimX, long dimY, long dimZ);
+CCPI_EXPORT float TV_kernel_br(float *D1, float *D2, float *D3, float *B, float *A, float *Out, float *lambda, int lambda_is_arr, float tau, long dimX, long dimY, long dimZ);
+CCPI_EXPORT float D1_func_br(float *A, float *D1, long dimX, long dimY, long dimZ);
+CCPI_EXPORT float D2_func_br(float *A, float *D2, long dimX, long dimY, long dimZ);
+CCPI_EXPORT float D3_func_br(float *A, float *D3, long dimX, long dimY, long dimZ);
 #ifdef __cplusplus
 }
 #endif
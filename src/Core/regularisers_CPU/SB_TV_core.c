@@ -27,6 +27,7 @@
  * 3. Number of iterations [OPTIONAL parameter]
  * 4. eplsilon - tolerance constant [OPTIONAL parameter]
  * 5. TV-type: 'iso' or 'l1' [OPTIONAL parameter]
+ * 6. solver of the u-subproblem: SB_GAUSS_SEIDEL or SB_MULTIGRID
  *
  * Output:
  * [1] Filtered/regularized image/volume
@@ -35,23 +36,29 @@
  * [1]. Goldstein, T. and Osher, S., 2009. The split Bregman method for L1-regularized problems. SIAM journal on imaging sciences, 2(2), pp.323-343.
  */
 
-float SB_TV_CPU_main(float *Input, float *Output, float *infovector, float mu, int iter, float epsil, int methodTV, int dimX, int dimY, int dimZ)
+float SB_TV_CPU_main(float *Input, float *Output, float *infovector, float mu, int iter, float epsil, int methodTV, int solver, int dimX, int dimY, int dimZ)
 {
     int ll;
     long j, DimTotal;
-    float re, re1, lambda;
+    float re = 0.0f, re1, lambda;
     re = 0.0f; re1 = 0.0f;
     int count = 0;
     mu = 1.0f/mu;
     lambda = 2.0f*mu;
     
-    float *Output_prev=NULL, *Dx=NULL, *Dy=NULL, *Bx=NULL, *By=NULL;
+    float *Output_prev=NULL, *Dx=NULL, *Dy=NULL, *Bx=NULL, *By=NULL, *F=NULL;
+    MG *mg=NULL;
     DimTotal = (long)(dimX*dimY*dimZ);
-    Output_prev = calloc(DimTotal, sizeof(float));
-    Dx = calloc(DimTotal, sizeof(float));
-    Dy = calloc(DimTotal, sizeof(float));
-    Bx = calloc(DimTotal, sizeof(float));
-    By = calloc(DimTotal, sizeof(float));
+    Output_prev = Vol_calloc(DimTotal);
+    Dx = Vol_calloc(DimTotal);
+    Dy = Vol_calloc(DimTotal);
+    Bx = Vol_calloc(DimTotal);
+    By = Vol_calloc(DimTotal);
+    if (solver == SB_MULTIGRID) {
+        /* (mu - lambda*Laplacian) u = F, the levels are built once */
+        F = Vol_calloc(DimTotal);
+        mg = MG_create(NULL, mu, lambda, (long)(dimX), (long)(dimY), (long)(dimZ));
+    }
     
     if (dimZ == 1) {
         /* 2D case */
@@ -63,11 +70,18 @@ float SB_TV_CPU_main(float *Input, float *Output, float *infovector, float mu, i
             /* storing old estimate */
             copyIm(Output, Output_prev, (long)(dimX), (long)(dimY), 1l);
             
-            /* perform two GS iterations (normally 2 is enough for the convergence) */
-            gauss_seidel2D(Output, Input, Output_prev, Dx, Dy, Bx, By, (long)(dimX), (long)(dimY), lambda, mu);
-            copyIm(Output, Output_prev, (long)(dimX), (long)(dimY), 1l);
-            /*GS iteration */
-            gauss_seidel2D(Output, Input, Output_prev, Dx, Dy, Bx, By, (long)(dimX), (long)(dimY), lambda, mu);
+            if (solver == SB_MULTIGRID) {
+                /* one V-cycle started from the previous estimate */
+                SB_rhs2D(F, Input, Dx, Dy, Bx, By, (long)(dimX), (long)(dimY), lambda, mu);
+                MG_solve(mg, Output, F, 1, 0.0f, NULL);
+            }
+            else {
+                /* perform two GS iterations (normally 2 is enough for the convergence) */
+                gauss_seidel2D(Output, Input, Output_prev, Dx, Dy, Bx, By, (long)(dimX), (long)(dimY), lambda, mu);
+                copyIm(Output, Output_prev, (long)(dimX), (long)(dimY), 1l);
+                /*GS iteration */
+                gauss_seidel2D(Output, Input, Output_prev, Dx, Dy, Bx, By, (long)(dimX), (long)(dimY), lambda, mu);
+            }
             
             /* TV-related step */
             if (methodTV == 1)  updDxDy_shrinkAniso2D(Output, Dx, Dy, Bx, By, (long)(dimX), (long)(dimY), lambda);
@@ -89,14 +103,15 @@ float SB_TV_CPU_main(float *Input, float *Output, float *infovector, float mu, i
                 if (re < epsil)  count++;
                 if (count > 3) break;
             }
+            if (Progress_step(ll+1, re)) break;
         }
     }
     else {
         /* 3D case */
         float *Dz=NULL, *Bz=NULL;
         
-        Dz = calloc(DimTotal, sizeof(float));
-        Bz = calloc(DimTotal, sizeof(float));
+        Dz = Vol_calloc(DimTotal);
+        Bz = Vol_calloc(DimTotal);
         
         copyIm(Input, Output, (long)(dimX), (long)(dimY), (long)(dimZ)); /*initialize */
         
@@ -106,11 +121,18 @@ float SB_TV_CPU_main(float *Input, float *Output, float *infovector, float mu, i
             /* storing old estimate */
             copyIm(Output, Output_prev, (long)(dimX), (long)(dimY), (long)(dimZ));
             
-            /* perform two GS iterations (normally 2 is enough for the convergence) */
-            gauss_seidel3D(Output, Input, Output_prev, Dx, Dy, Dz, Bx, By, Bz, (long)(dimX), (long)(dimY), (long)(dimZ), lambda, mu);
-            copyIm(Output, Output_prev, (long)(dimX), (long)(dimY), (long)(dimZ));
-            /*GS iteration */
-            gauss_seidel3D(Output, Input, Output_prev, Dx, Dy, Dz, Bx, By, Bz, (long)(dimX), (long)(dimY), (long)(dimZ), lambda, mu);
+            if (solver == SB_MULTIGRID) {
+                /* one V-cycle started from the previous estimate */
+                SB_rhs3D(F, Input, Dx, Dy, Dz, Bx, By, Bz, (long)(dimX), (long)(dimY), (long)(dimZ), lambda, mu);
+                MG_solve(mg, Output, F, 1, 0.0f, NULL);
+            }
+            else {
+                /* perform two GS iterations (normally 2 is enough for the convergence) */
+                gauss_seidel3D(Output, Input, Output_prev, Dx, Dy, Dz, Bx, By, Bz, (long)(dimX), (long)(dimY), (long)(dimZ), lambda, mu);
+                copyIm(Output, Output_prev, (long)(dimX), (long)(dimY), (long)(dimZ));
+                /*GS iteration */
+                gauss_seidel3D(Output, Input, Output_prev, Dx, Dy, Dz, Bx, By, Bz, (long)(dimX), (long)(dimY), (long)(dimZ), lambda, mu);
+            }
             
             /* TV-related step */
             if (methodTV == 1)  updDxDyDz_shrinkAniso3D(Output, Dx, Dy, Dz, Bx, By, Bz, (long)(dimX), (long)(dimY), (long)(dimZ), lambda);
@@ -132,17 +154,30 @@ float SB_TV_CPU_main(float *Input, float *Output, float *infovector, float mu, i
                 if (re < epsil)  count++;
                 if (count > 3) break;
             }
+            if (Progress_step(ll+1, re)) break;
         }
-        free(Dz); free(Bz);
+        Vol_free(Dz); Vol_free(Bz);
     }
     
-    free(Output_prev); free(Dx); free(Dy); free(Bx); free(By);
+    Vol_free(Output_prev); Vol_free(Dx); Vol_free(Dy); Vol_free(Bx); Vol_free(By);
+    Vol_free(F); MG_free(mg);
     /*adding info into info_vector */
     infovector[0] = (float)(ll);  /*iterations number (if stopped earlier based on tolerance)*/
     infovector[1] = re;  /* reached tolerance */
     return 0;
 }
 
+/* Peak size in bytes of the work arrays allocated by SB_TV_CPU_main, Output_prev is always kept */
+long SB_TV_CPU_mem(int solver, int dimX, int dimY, int dimZ)
+{
+    long DimTotal, mem;
+    DimTotal = (long)(dimX)*(long)(dimY)*(long)(dimZ);
+    mem = ((dimZ == 1) ? 5l : 7l)*DimTotal*sizeof(float);
+    /* the right-hand side and the multigrid levels */
+    if (solver == SB_MULTIGRID) mem += DimTotal*sizeof(float) + MG_mem(0, (long)(dimX), (long)(dimY), (long)(dimZ));
+    return mem;
+}
+
 /********************************************************************/
 /***************************2D Functions*****************************/
 /********************************************************************/
@@ -172,6 +207,24 @@ float gauss_seidel2D(float *U, float *A, float *U_prev, float *Dx, float *Dy, fl
     return *U;
 }
 
+/* right-hand side of the u-subproblem (mu - lambda*Laplacian) u = F solved by multigrid,
+ * the system of gauss_seidel2D */
+float SB_rhs2D(float *F, float *A, float *Dx, float *Dy, float *Bx, float *By, long dimX, long dimY, float lambda, float mu)
+{
+    long i,j,i2,j2,index;
+
+#pragma omp parallel for shared(F) private(index,i,j,i2,j2)
+    for(j=0; j<dimY; j++) {
+        /* symmetric boundary conditions (Neuman) */
+        j2 = j-1; if (j2 < 0) j2 = j+1;
+        for(i=0; i<dimX; i++) {
+            i2 = i-1; if (i2 < 0) i2 = i+1;
+            index = j*dimX+i;
+            F[index] = mu*A[index] + lambda*(Dx[j*dimX+i2] - Dx[index] + Dy[j2*dimX+i] - Dy[index] - Bx[j*dimX+i2] + Bx[index] - By[j2*dimX+i] + By[index]);
+        }}
+    return *F;
+}
+
 float updDxDy_shrinkAniso2D(float *U, float *Dx, float *Dy, float *Bx, float *By, long dimX, long dimY, float lambda)
 {
     long i,j,i1,j1,index;
@@ -281,6 +334,28 @@ float gauss_seidel3D(float *U, float *A, float *U_prev, float *Dx, float *Dy, fl
     return *U;
 }
 
+/* right-hand side of the u-subproblem solved by multigrid, the system of gauss_seidel3D */
+float SB_rhs3D(float *F, float *A, float *Dx, float *Dy, float *Dz, float *Bx, float *By, float *Bz, long dimX, long dimY, long dimZ, float lambda, float mu)
+{
+    long i,j,k,i2,j2,k2,index;
+    float d_val, b_val;
+
+#pragma omp parallel for shared(F) private(index,i,j,k,i2,j2,k2,d_val,b_val)
+    for(k=0; k<dimZ; k++) {
+        k2 = k-1; if (k2 < 0) k2 = k+1;
+        for(j=0; j<dimY; j++) {
+            j2 = j-1; if (j2 < 0) j2 = j+1;
+            for(i=0; i<dimX; i++) {
+                /* symmetric boundary conditions (Neuman) */
+                i2 = i-1; if (i2 < 0) i2 = i+1;
+                index = (dimX*dimY)*k + j*dimX+i;
+                d_val = Dx[(dimX*dimY)*k + j*dimX+i2] - Dx[index] + Dy[(dimX*dimY)*k + j2*dimX+i] - Dy[index] + Dz[(dimX*dimY)*k2 + j*dimX+i] - Dz[index];
+                b_val = -Bx[(dimX*dimY)*k + j*dimX+i2] + Bx[index] - By[(dimX*dimY)*k + j2*dimX+i] + By[index] - Bz[(dimX*dimY)*k2 + j*dimX+i] + Bz[index];
+                F[index] = mu*A[index] + lambda*(d_val + b_val);
+            }}}
+    return *F;
+}
+
 float updDxDyDz_shrinkAniso3D(float *U, float *Dx, float *Dy, float *Dz, float *Bx, float *By, float *Bz, long dimX, long dimY, long dimZ, float lambda)
 {
     long i,j,i1,j1,k,k1,index;
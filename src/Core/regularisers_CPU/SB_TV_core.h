@@ -23,6 +23,7 @@ limitations under the License.
 #include <stdio.h>
 #include "omp.h"
 #include "utils.h"
+#include "multigrid.h"
 #include "CCPiDefines.h"
 
 
@@ -34,6 +35,9 @@ limitations under the License.
 * 3. Number of iterations [OPTIONAL parameter]
 * 4. eplsilon - tolerance constant [OPTIONAL parameter]
 * 5. TV-type: 'iso' or 'l1' [OPTIONAL parameter]
+* 6. solver of the u-subproblem: SB_GAUSS_SEIDEL - two Jacobi-type sweeps (gauss_seidel2D/3D),
+*    SB_MULTIGRID - one multigrid V-cycle (multigrid.h), a much more accurate inner solve at
+*    the cost of about 3 sweeps
 
 * Output:
 * [1] Filtered/regularized image/volume
@@ -42,20 +46,27 @@ limitations under the License.
 * [1]. Goldstein, T. and Osher, S., 2009. The split Bregman method for L1-regularized problems. SIAM journal on imaging sciences, 2(2), pp.323-343.
 */
 
+/* solvers of the u-subproblem */
+#define SB_GAUSS_SEIDEL 0
+#define SB_MULTIGRID 1
+
 #ifdef __cplusplus
 extern "C" {
 #endif
-CCPI_EXPORT float SB_TV_CPU_main(float *Input, float *Output, float *infovector, float mu, int iter, float epsil, int methodTV, int dimX, int dimY, int dimZ);
+CCPI_EXPORT float SB_TV_CPU_main(float *Input, float *Output, float *infovector, float mu, int iter, float epsil, int methodTV, int solver, int dimX, int dimY, int dimZ);
+CCPI_EXPORT long SB_TV_CPU_mem(int solver, int dimX, int dimY, int dimZ);
 
 CCPI_EXPORT float gauss_seidel2D(float *U, float *A, float *U_prev, float *Dx, float *Dy, float *Bx, float *By, long dimX, long dimY, float lambda, float mu);
 CCPI_EXPORT float updDxDy_shrinkAniso2D(float *U, float *Dx, float *Dy, float *Bx, float *By, long dimX, long dimY, float lambda);
 CCPI_EXPORT float updDxDy_shrinkIso2D(float *U, float *Dx, float *Dy, float *Bx, float *By, long dimX, long dimY, float lambda);
 CCPI_EXPORT float updBxBy2D(float *U, float *Dx, float *Dy, float *Bx, float *By, long dimX, long dimY);
+CCPI_EXPORT float SB_rhs2D(float *F, float *A, float *Dx, float *Dy, float *Bx, float *By, long dimX, long dimY, float lambda, float mu);
 
 CCPI_EXPORT float gauss_seidel3D(float *U, float *A, float *U_prev, float *Dx, float *Dy, float *Dz, float *Bx, float *By, float *Bz, long dimX, long dimY, long dimZ, float lambda, float mu);
 CCPI_EXPORT float updDxDyDz_shrinkAniso3D(float *U, float *Dx, float *Dy, float *Dz, float *Bx, float *By, float *Bz, long dimX, long dimY, long dimZ, float lambda);
 CCPI_EXPORT float updDxDyDz_shrinkIso3D(float *U, float *Dx, float *Dy, float *Dz, float *Bx, float *By, float *Bz, long dimX, long dimY, long dimZ, float lambda);
 CCPI_EXPORT float updBxByBz3D(float *U, float *Dx, float *Dy, float *Dz, float *Bx, float *By, float *Bz, long dimX, long dimY, long dimZ);
+CCPI_EXPORT float SB_rhs3D(float *F, float *A, float *Dx, float *Dy, float *Dz, float *Bx, float *By, float *Bz, long dimX, long dimY, long dimZ, float lambda, float mu);
 #ifdef __cplusplus
 }
 #endif
@@ -30,6 +30,8 @@
  * 5. Number of Chambolle-Pock (Primal-Dual) iterations
  * 6. Lipshitz constant (default is 12)
  * 7. eplsilon: tolerance constant
+ * 8. algorithm (TGV_main_ckpt): fixed steps (0) or the accelerated scheme (1) of Chambolle and Pock
+ *    for the strongly convex fidelity, tau, sigma and theta are updated every iteration
  *
  * Output:
  * [1] Filtered/regularized image/volume
@@ -41,39 +43,70 @@
  */
 
 float TGV_main(float *U0, float *U, float *infovector, float lambda, float alpha1, float alpha0, int iter, float L2, float epsil, int dimX, int dimY, int dimZ)
+{
+    return TGV_main_ckpt(U0, U, infovector, lambda, alpha1, alpha0, iter, L2, epsil, PD_STANDARD, dimX, dimY, dimZ, NULL, 0, 0);
+}
+
+float TGV_main_ckpt(float *U0, float *U, float *infovector, float lambda, float alpha1, float alpha0, int iter, float L2, float epsil, int algorithm, int dimX, int dimY, int dimZ, const char *checkpoint, int interval, int resume)
 {
     long DimTotal;
-    int ll, j;
+    int ll, j, it0, progress, stop = 0;
     float re, re1;
     re = 0.0f; re1 = 0.0f;
     int count = 0;
-    float *U_old, *P1, *P2, *Q1, *Q2, *Q3, *V1, *V1_old, *V2, *V2_old, tau, sigma;
+    float *U_old, *P1, *P2, *Q1, *Q2, *Q3, *V1, *V1_old, *V2, *V2_old, tau, sigma, theta, gamma;
+    float params[9], scalars[CKPT_SCALARS] = {0.0f};
+    Ckpt *ckpt = NULL;
     
     DimTotal = (long)(dimX*dimY*dimZ);
+    if (checkpoint != NULL) {
+        params[0] = lambda; params[1] = alpha1; params[2] = alpha0; params[3] = L2; params[4] = epsil;
+        params[5] = (float)dimX; params[6] = (float)dimY; params[7] = (float)dimZ; params[8] = (float)algorithm;
+        ckpt = Ckpt_open(checkpoint, interval, CKPT_TGV, DimTotal, (dimZ == 1) ? 8 : 13, params, 9, resume);
+        if (ckpt == NULL) return -1.0f;
+    }
+    it0 = 0;
     copyIm(U0, U, (long)(dimX), (long)(dimY), (long)(dimZ)); /* initialize */
     tau = pow(L2,-0.5);
     sigma = pow(L2,-0.5);
+    theta = 1.0f;
+    /* the fidelity (1/(2*lambda))||U - U0||^2 is strongly convex in U with gamma = 1/lambda */
+    gamma = 1.0f/lambda;
     
     /* dual variables */
-    P1 = calloc(DimTotal, sizeof(float));
-    P2 = calloc(DimTotal, sizeof(float));
+    P1 = Vol_calloc(DimTotal);
+    P2 = Vol_calloc(DimTotal);
     
-    Q1 = calloc(DimTotal, sizeof(float));
-    Q2 = calloc(DimTotal, sizeof(float));
-    Q3 = calloc(DimTotal, sizeof(float));
+    Q1 = Vol_calloc(DimTotal);
+    Q2 = Vol_calloc(DimTotal);
+    Q3 = Vol_calloc(DimTotal);
     
-    U_old = calloc(DimTotal, sizeof(float));
+    U_old = Vol_calloc(DimTotal);
     
-    V1 = calloc(DimTotal, sizeof(float));
-    V1_old = calloc(DimTotal, sizeof(float));
-    V2 = calloc(DimTotal, sizeof(float));
-    V2_old = calloc(DimTotal, sizeof(float));
+    V1 = Vol_calloc(DimTotal);
+    V1_old = Vol_calloc(DimTotal);
+    V2 = Vol_calloc(DimTotal);
+    V2_old = Vol_calloc(DimTotal);
     
     if (dimZ == 1) {
         /*2D case*/
+        float *state[8] = {U, P1, P2, Q1, Q2, Q3, V1, V2};
+        if (resume && Ckpt_load(ckpt, state, &it0, &count, scalars)) {
+            /* reached tolerance and the steps of the accelerated scheme */
+            re = scalars[0];
+            if (algorithm == PD_ACCELERATED) {tau = scalars[1]; sigma = scalars[2]; theta = scalars[3];}
+        }
         
+        /* the whole iteration loop runs in one parallel region, the kernels are split statically
+         * over its threads, so small images do not pay a fork/join per kernel; with the pool
+         * running the loop stays on the calling thread and the kernels go to the pool */
+        progress = Progress_active();
+#pragma omp parallel if(Pool_threads() == 0) firstprivate(count) private(j)
+        {
+        int it;
+        float rel = re;
         /* Primal-dual iterations begin here */
-        for(ll = 0; ll < iter; ll++) {
+        for(it = it0; it < iter; it++) {
             
             /* Calculate Dual Variable P */
             DualP_2D(U, V1, V2, P1, P2, (long)(dimX), (long)(dimY), sigma);
@@ -88,52 +121,86 @@ float TGV_main(float *U0, float *U, float *infovector, float lambda, float alpha
             ProjQ_2D(Q1, Q2, Q3, (long)(dimX), (long)(dimY), alpha0);
             
             /*saving U into U_old*/
-            copyIm(U, U_old, (long)(dimX), (long)(dimY), 1l);
+            copyIm_ws(U, U_old, DimTotal);
             
             /*adjoint operation  -> divergence and projection of P*/
             DivProjP_2D(U, U0, P1, P2, (long)(dimX), (long)(dimY), lambda, tau);
             
-            /*get updated solution U*/
-            newU(U, U_old, (long)(dimX), (long)(dimY));
-            
             /*saving V into V_old*/
-            copyIm(V1, V1_old, (long)(dimX), (long)(dimY), 1l);
-            copyIm(V2, V2_old, (long)(dimX), (long)(dimY), 1l);
+            copyIm_ws(V1, V1_old, DimTotal);
+            copyIm_ws(V2, V2_old, DimTotal);
             
             /* upd V*/
             UpdV_2D(V1, V2, P1, P2, Q1, Q2, Q3, (long)(dimX), (long)(dimY), tau);
             
-            /*get new V*/
-            newU(V1, V1_old, (long)(dimX), (long)(dimY));
-            newU(V2, V2_old, (long)(dimX), (long)(dimY));
+            if (algorithm == PD_ACCELERATED) {
+                /* accelerated steps, the extrapolation of U and V with theta */
+#pragma omp single
+                {theta = PD_steps(gamma, &tau, &sigma);}
+                newU_theta(U, U_old, theta, DimTotal);
+                newU_theta(V1, V1_old, theta, DimTotal);
+                newU_theta(V2, V2_old, theta, DimTotal);
+            }
+            else {
+                /*get updated solution U*/
+                newU(U, U_old, (long)(dimX), (long)(dimY));
+                
+                /*get new V*/
+                newU(V1, V1_old, (long)(dimX), (long)(dimY));
+                newU(V2, V2_old, (long)(dimX), (long)(dimY));
+            }
             
             /* check early stopping criteria */
-            if ((epsil != 0.0f)  && (ll % 5 == 0)) {
-                re = 0.0f; re1 = 0.0f;
+            if ((epsil != 0.0f)  && (it % 5 == 0)) {
+#pragma omp single
+                {re = 0.0f; re1 = 0.0f;}
+#pragma omp for reduction(+:re,re1)
                 for(j=0; j<DimTotal; j++)
                 {
                     re += powf(U[j] - U_old[j],2);
                     re1 += powf(U[j],2);
                 }
-                re = sqrtf(re)/sqrtf(re1);
-                if (re < epsil)  count++;
+                rel = sqrtf(re)/sqrtf(re1);
+                if (rel < epsil)  count++;
                 if (count > 3) break;
             }
+            if (Ckpt_due(ckpt, it+1, it+1 == iter)) {
+#pragma omp single
+                {scalars[0] = rel; scalars[1] = tau; scalars[2] = sigma; scalars[3] = theta;
+                 Ckpt_save(ckpt, state, it+1, count, scalars);}
+            }
+            /* the thread that bound the progress record reports it, all threads stop together */
+            if (progress) {
+#pragma omp master
+                stop = Progress_step(it+1, rel);
+#pragma omp barrier
+                if (stop) break;
+            }
         } /*end of iterations*/
+#pragma omp barrier
+#pragma omp master
+        {ll = it; re = rel;}
+        }
     }
     else {
         /*3D case*/
         float *P3, *Q4, *Q5, *Q6, *V3, *V3_old;
         
-        P3 = calloc(DimTotal, sizeof(float));
-        Q4 = calloc(DimTotal, sizeof(float));
-        Q5 = calloc(DimTotal, sizeof(float));
-        Q6 = calloc(DimTotal, sizeof(float));
-        V3 = calloc(DimTotal, sizeof(float));
-        V3_old = calloc(DimTotal, sizeof(float));
+        P3 = Vol_calloc(DimTotal);
+        Q4 = Vol_calloc(DimTotal);
+        Q5 = Vol_calloc(DimTotal);
+        Q6 = Vol_calloc(DimTotal);
+        V3 = Vol_calloc(DimTotal);
+        V3_old = Vol_calloc(DimTotal);
+        float *state[13] = {U, P1, P2, P3, Q1, Q2, Q3, Q4, Q5, Q6, V1, V2, V3};
+        if (resume && Ckpt_load(ckpt, state, &it0, &count, scalars)) {
+            /* reached tolerance and the steps of the accelerated scheme */
+            re = scalars[0];
+            if (algorithm == PD_ACCELERATED) {tau = scalars[1]; sigma = scalars[2]; theta = scalars[3];}
+        }
         
         /* Primal-dual iterations begin here */
-        for(ll = 0; ll < iter; ll++) {
+        for(ll = it0; ll < iter; ll++) {
             
             /* Calculate Dual Variable P */
             DualP_3D(U, V1, V2, V3, P1, P2, P3, (long)(dimX), (long)(dimY), (long)(dimZ), sigma);
@@ -153,17 +220,27 @@ float TGV_main(float *U0, float *U, float *infovector, float lambda, float alpha
             /*adjoint operation  -> divergence and projection of P*/
             DivProjP_3D(U, U0, P1, P2, P3, (long)(dimX), (long)(dimY), (long)(dimZ), lambda, tau);
             
-            /*get updated solution U*/
-            newU3D(U, U_old, (long)(dimX), (long)(dimY), (long)(dimZ));
-            
             /*saving V into V_old*/
             copyIm_3Ar(V1, V2, V3, V1_old, V2_old, V3_old, (long)(dimX), (long)(dimY), (long)(dimZ));
             
             /* upd V*/
             UpdV_3D(V1, V2, V3, P1, P2, P3, Q1, Q2, Q3, Q4, Q5, Q6, (long)(dimX), (long)(dimY), (long)(dimZ), tau);
             
-            /*get new V*/
-            newU3D_3Ar(V1, V2, V3, V1_old, V2_old, V3_old, (long)(dimX), (long)(dimY), (long)(dimZ));
+            if (algorithm == PD_ACCELERATED) {
+                /* accelerated steps, the extrapolation of U and V with theta */
+                theta = PD_steps(gamma, &tau, &sigma);
+                newU3D_theta(U, U_old, theta, DimTotal);
+                newU3D_theta(V1, V1_old, theta, DimTotal);
+                newU3D_theta(V2, V2_old, theta, DimTotal);
+                newU3D_theta(V3, V3_old, theta, DimTotal);
+            }
+            else {
+                /*get updated solution U*/
+                newU3D(U, U_old, (long)(dimX), (long)(dimY), (long)(dimZ));
+                
+                /*get new V*/
+                newU3D_3Ar(V1, V2, V3, V1_old, V2_old, V3_old, (long)(dimX), (long)(dimY), (long)(dimZ));
+            }
             
             /* check early stopping criteria */
             if ((epsil != 0.0f)  && (ll % 5 == 0)) {
@@ -177,14 +254,20 @@ float TGV_main(float *U0, float *U, float *infovector, float lambda, float alpha
                 if (re < epsil)  count++;
                 if (count > 3) break;
             }
+            if (Ckpt_due(ckpt, ll+1, ll+1 == iter)) {
+                scalars[0] = re; scalars[1] = tau; scalars[2] = sigma; scalars[3] = theta;
+                Ckpt_save(ckpt, state, ll+1, count, scalars);
+            }
             
+            if (Progress_step(ll+1, re)) break;
         } /*end of iterations*/
-        free(P3);free(Q4);free(Q5);free(Q6);free(V3);free(V3_old);
+        Vol_free(P3);Vol_free(Q4);Vol_free(Q5);Vol_free(Q6);Vol_free(V3);Vol_free(V3_old);
     }
     
     /*freeing*/
-    free(P1);free(P2);free(Q1);free(Q2);free(Q3);free(U_old);
-    free(V1);free(V2);free(V1_old);free(V2_old);
+    Vol_free(P1);Vol_free(P2);Vol_free(Q1);Vol_free(Q2);Vol_free(Q3);Vol_free(U_old);
+    Vol_free(V1);Vol_free(V2);Vol_free(V1_old);Vol_free(V2_old);
+    Ckpt_close(ckpt);
     
     /*adding info into info_vector */
     infovector[0] = (float)(ll);  /*iterations number (if stopped earlier based on tolerance)*/
@@ -193,167 +276,35 @@ float TGV_main(float *U0, float *U, float *infovector, float lambda, float alpha
     return 0;
 }
 
-/********************************************************************/
-/***************************2D Functions*****************************/
-/********************************************************************/
-/*Calculating dual variable P (using forward differences)*/
-float DualP_2D(float *U, float *V1, float *V2, float *P1, float *P2, long dimX, long dimY, float sigma)
-{
-    long i,j, index;
-#pragma omp parallel for shared(U,V1,V2,P1,P2) private(i,j,index)
-    for(j=0; j<dimY; j++) {
-        for(i=0; i<dimX; i++) {
-            index = j*dimX+i;
-            /* symmetric boundary conditions (Neuman) */
-            if (i == dimX-1) P1[index] += sigma*(-V1[index]);
-            else P1[index] += sigma*((U[j*dimX+(i+1)] - U[index])  - V1[index]);
-            if (j == dimY-1) P2[index] += sigma*(-V2[index]);
-            else  P2[index] += sigma*((U[(j+1)*dimX+i] - U[index])  - V2[index]);
-            
-        }}
-    return 1;
-}
-/*Projection onto convex set for P*/
-float ProjP_2D(float *P1, float *P2, long dimX, long dimY, float alpha1)
-{
-    float grad_magn;
-    long i,j,index;
-#pragma omp parallel for shared(P1,P2) private(i,j,index,grad_magn)
-    for(j=0; j<dimY; j++) {
-        for(i=0; i<dimX; i++) {
-            index = j*dimX+i;
-            grad_magn = (sqrtf(pow(P1[index],2) + pow(P2[index],2)))/alpha1;
-            if (grad_magn > 1.0f) {
-                P1[index] /= grad_magn;
-                P2[index] /= grad_magn;
-            }
-        }}
-    return 1;
-}
-/*Calculating dual variable Q (using forward differences)*/
-float DualQ_2D(float *V1, float *V2, float *Q1, float *Q2, float *Q3, long dimX, long dimY, float sigma)
-{
-    long i,j,index;
-    float q1, q2, q11, q22;
-#pragma omp parallel for shared(Q1,Q2,Q3,V1,V2) private(i,j,index,q1,q2,q11,q22)
-    for(j=0; j<dimY; j++) {
-        for(i=0; i<dimX; i++) {
-            index = j*dimX+i;
-            q1 = 0.0f; q11 = 0.0f; q2 = 0.0f; q22 = 0.0f;
-            /* boundary conditions (Neuman) */
-            if (i != dimX-1){
-                q1 = V1[j*dimX+(i+1)] - V1[index];
-                q11 = V2[j*dimX+(i+1)] - V2[index];
-            }
-            if (j != dimY-1) {
-                q2 = V2[(j+1)*dimX+i] - V2[index];
-                q22 = V1[(j+1)*dimX+i] - V1[index];
-            }
-            Q1[index] += sigma*(q1);
-            Q2[index] += sigma*(q2);
-            Q3[index] += sigma*(0.5f*(q11 + q22));
-        }}
-    return 1;
-}
-float ProjQ_2D(float *Q1, float *Q2, float *Q3, long dimX, long dimY, float alpha0)
-{
-    float grad_magn;
-    long i,j,index;
-#pragma omp parallel for shared(Q1,Q2,Q3) private(i,j,index,grad_magn)
-    for(j=0; j<dimY; j++) {
-        for(i=0; i<dimX; i++) {
-            index = j*dimX+i;
-            grad_magn = sqrtf(pow(Q1[index],2) + pow(Q2[index],2) + 2*pow(Q3[index],2));
-            grad_magn = grad_magn/alpha0;
-            if (grad_magn > 1.0f) {
-                Q1[index] /= grad_magn;
-                Q2[index] /= grad_magn;
-                Q3[index] /= grad_magn;
-            }
-        }}
-    return 1;
-}
-/* Divergence and projection for P (backward differences)*/
-float DivProjP_2D(float *U, float *U0, float *P1, float *P2, long dimX, long dimY, float lambda, float tau)
-{
-    long i,j,index;
-    float P_v1, P_v2, div;
-#pragma omp parallel for shared(U,U0,P1,P2) private(i,j,index,P_v1,P_v2,div)
-    for(j=0; j<dimY; j++) {
-        for(i=0; i<dimX; i++) {
-            index = j*dimX+i;
-            
-            if (i == 0) P_v1 = P1[index];
-            else if (i == dimX-1) P_v1 = -P1[j*dimX+(i-1)];
-            else P_v1 = P1[index] - P1[j*dimX+(i-1)];
-            
-            if (j == 0) P_v2 = P2[index];
-            else if (j == dimY-1) P_v2 = -P2[(j-1)*dimX+i];
-            else P_v2 = P2[index] - P2[(j-1)*dimX+i];
-            
-            div = P_v1 + P_v2;
-            U[index] = (lambda*(U[index] + tau*div) + tau*U0[index])/(lambda + tau);
-        }}
-    return *U;
-}
-/*get updated solution U*/
-float newU(float *U, float *U_old, long dimX, long dimY)
-{
-    long i;
-#pragma omp parallel for shared(U,U_old) private(i)
-    for(i=0; i<dimX*dimY; i++) U[i] = 2*U[i] - U_old[i];
-    return *U;
-}
-/*get update for V (backward differences)*/
-float UpdV_2D(float *V1, float *V2, float *P1, float *P2, float *Q1, float *Q2, float *Q3, long dimX, long dimY, float tau)
+/* Peak size in bytes of the work arrays allocated by TGV_main */
+long TGV_mem(int dimX, int dimY, int dimZ)
 {
-    long i, j, index;
-    float q1, q3_x, q3_y, q2, div1, div2;
-#pragma omp parallel for shared(V1,V2,P1,P2,Q1,Q2,Q3) private(i, j, index, q1, q3_x, q3_y, q2, div1, div2)
-    for(j=0; j<dimY; j++) {
-        for(i=0; i<dimX; i++) {
-            index = j*dimX+i;
-            
-            /* boundary conditions (Neuman) */
-            if (i == 0) {
-                q1 = Q1[index];
-                q3_x = Q3[index]; }
-            else if (i == dimX-1) {
-                q1 = -Q1[j*dimX+(i-1)];
-                q3_x = -Q3[j*dimX+(i-1)];  }
-            else {
-                q1 = Q1[index] - Q1[j*dimX+(i-1)];
-                q3_x = Q3[index] - Q3[j*dimX+(i-1)];  }
-            
-            if (j == 0) {
-                q2 = Q2[index];
-                q3_y = Q3[index]; }
-            else if (j == dimY-1) {
-                q2 = -Q2[(j-1)*dimX+i];
-                q3_y = -Q3[(j-1)*dimX+i]; }
-            else {
-                q2 = Q2[index] - Q2[(j-1)*dimX+i];
-                q3_y = Q3[index] - Q3[(j-1)*dimX+i]; }
-            
-            
-            div1 = q1 + q3_y;
-            div2 = q3_x + q2;
-            V1[index] += tau*(P1[index] + div1);
-            V2[index] += tau*(P2[index] + div2);
-        }}
-    return 1;
+    long DimTotal;
+    DimTotal = (long)(dimX)*(long)(dimY)*(long)(dimZ);
+    if (dimZ == 1) return 10l*DimTotal*sizeof(float);
+    return 16l*DimTotal*sizeof(float);
 }
 
-/********************************************************************/
-/***************************3D Functions*****************************/
-/********************************************************************/
+/* The kernels are bodies over rows, (k,j) in 3D and j in 2D (elements for the pointwise updates),
+ * started by Run_rows; the 2D kernels are called by every thread of the parallel region of the
+ * 2D solver and start them with Run_rows_team (pool.h) */
+typedef struct {
+    float *U, *U0, *U_old, *P1, *P2, *P3, *Q1, *Q2, *Q3, *Q4, *Q5, *Q6;
+    float *V1, *V2, *V3, *V1_old, *V2_old, *V3_old;
+    float sigma, tau, lambda, alpha, theta;
+    long dimX, dimY, dimZ;
+} tgv_args;
+
 /*Calculating dual variable P (using forward differences)*/
-float DualP_3D(float *U, float *V1, float *V2, float *V3, float *P1, float *P2, float *P3, long dimX, long dimY, long dimZ, float sigma)
+static void DualP_rows(void *arg, long r0, long r1)
 {
-    long i,j,k, index;
-#pragma omp parallel for shared(U,V1,V2,V3,P1,P2,P3) private(i,j,k,index)
-    for(k=0; k<dimZ; k++) {
-        for(j=0; j<dimY; j++) {
+    tgv_args *a = (tgv_args*)arg;
+    float *U = a->U, *V1 = a->V1, *V2 = a->V2, *V3 = a->V3, *P1 = a->P1, *P2 = a->P2, *P3 = a->P3, sigma = a->sigma;
+    long dimX = a->dimX, dimY = a->dimY, dimZ = a->dimZ;
+    long i,j,k,r,index;
+    for(r=r0; r<r1; r++) {
+        k = r/dimY; j = r - k*dimY;
+        if (dimZ > 1) {
             for(i=0; i<dimX; i++) {
                 index = (dimX*dimY)*k + j*dimX+i;
                 /* symmetric boundary conditions (Neuman) */
@@ -363,36 +314,49 @@ float DualP_3D(float *U, float *V1, float *V2, float *V3, float *P1, float *P2,
                 else  P2[index] += sigma*((U[(dimX*dimY)*k + (j+1)*dimX+i] - U[index])  - V2[index]);
                 if (k == dimZ-1) P3[index] += sigma*(-V3[index]);
                 else  P3[index] += sigma*((U[(dimX*dimY)*(k+1) + j*dimX+i] - U[index])  - V3[index]);
-            }}}
-    return 1;
+            }
+        }
+        else {
+            for(i=0; i<dimX; i++) {
+                index = j*dimX+i;
+                /* symmetric boundary conditions (Neuman) */
+                if (i == dimX-1) P1[index] += sigma*(-V1[index]);
+                else P1[index] += sigma*((U[j*dimX+(i+1)] - U[index])  - V1[index]);
+                if (j == dimY-1) P2[index] += sigma*(-V2[index]);
+                else  P2[index] += sigma*((U[(j+1)*dimX+i] - U[index])  - V2[index]);
+            }
+        }
+    }
 }
 /*Projection onto convex set for P*/
-float ProjP_3D(float *P1, float *P2, float *P3, long dimX, long dimY, long dimZ, float alpha1)
+static void ProjP_rows(void *arg, long r0, long r1)
 {
+    tgv_args *a = (tgv_args*)arg;
+    float *P1 = a->P1, *P2 = a->P2, *P3 = a->P3, alpha1 = a->alpha;
+    long dimX = a->dimX;
     float grad_magn;
-    long i,j,k,index;
-#pragma omp parallel for shared(P1,P2,P3) private(i,j,k,index,grad_magn)
-    for(k=0; k<dimZ; k++) {
-        for(j=0; j<dimY; j++) {
-            for(i=0; i<dimX; i++) {
-                index = (dimX*dimY)*k + j*dimX+i;
-                grad_magn = (sqrtf(pow(P1[index],2) + pow(P2[index],2) + pow(P3[index],2)))/alpha1;
-                if (grad_magn > 1.0f) {
-                    P1[index] /= grad_magn;
-                    P2[index] /= grad_magn;
-                    P3[index] /= grad_magn;
-                }
-            }}}
-    return 1;
+    long index;
+    for(index=r0*dimX; index<r1*dimX; index++) {
+        if (P3 != NULL) grad_magn = (sqrtf(pow(P1[index],2) + pow(P2[index],2) + pow(P3[index],2)))/alpha1;
+        else grad_magn = (sqrtf(pow(P1[index],2) + pow(P2[index],2)))/alpha1;
+        if (grad_magn > 1.0f) {
+            P1[index] /= grad_magn;
+            P2[index] /= grad_magn;
+            if (P3 != NULL) P3[index] /= grad_magn;
+        }
+    }
 }
 /*Calculating dual variable Q (using forward differences)*/
-float DualQ_3D(float *V1, float *V2, float *V3, float *Q1, float *Q2, float *Q3, float *Q4, float *Q5, float *Q6, long dimX, long dimY, long dimZ, float sigma)
+static void DualQ_rows(void *arg, long r0, long r1)
 {
-    long i,j,k,index;
+    tgv_args *a = (tgv_args*)arg;
+    float *V1 = a->V1, *V2 = a->V2, *V3 = a->V3, *Q1 = a->Q1, *Q2 = a->Q2, *Q3 = a->Q3, *Q4 = a->Q4, *Q5 = a->Q5, *Q6 = a->Q6, sigma = a->sigma;
+    long dimX = a->dimX, dimY = a->dimY, dimZ = a->dimZ;
+    long i,j,k,r,index;
     float q1, q2, q3, q11, q22, q33, q44, q55, q66;
-#pragma omp parallel for shared(Q1,Q2,Q3,Q4,Q5,Q6,V1,V2,V3) private(i,j,k,index,q1,q2,q3,q11,q22,q33,q44,q55,q66)
-    for(k=0; k<dimZ; k++) {
-        for(j=0; j<dimY; j++) {
+    for(r=r0; r<r1; r++) {
+        k = r/dimY; j = r - k*dimY;
+        if (dimZ > 1) {
             for(i=0; i<dimX; i++) {
                 index = (dimX*dimY)*k + j*dimX+i;
                 q1 = 0.0f; q11 = 0.0f; q33 = 0.0f; q2 = 0.0f; q22 = 0.0f; q55 = 0.0f; q3 = 0.0f; q44 = 0.0f; q66 = 0.0f;
@@ -419,39 +383,71 @@ float DualQ_3D(float *V1, float *V2, float *V3, float *Q1, float *Q2, float *Q3,
                 Q4[index] += sigma*(0.5f*(q11 + q22)); /* Q21 / Q12 */
                 Q5[index] += sigma*(0.5f*(q33 + q44)); /* Q31 / Q13 */
                 Q6[index] += sigma*(0.5f*(q55 + q66)); /* Q32 / Q23 */
-            }}}
-    return 1;
+            }
+        }
+        else {
+            for(i=0; i<dimX; i++) {
+                index = j*dimX+i;
+                q1 = 0.0f; q11 = 0.0f; q2 = 0.0f; q22 = 0.0f;
+                /* boundary conditions (Neuman) */
+                if (i != dimX-1){
+                    q1 = V1[j*dimX+(i+1)] - V1[index];
+                    q11 = V2[j*dimX+(i+1)] - V2[index];
+                }
+                if (j != dimY-1) {
+                    q2 = V2[(j+1)*dimX+i] - V2[index];
+                    q22 = V1[(j+1)*dimX+i] - V1[index];
+                }
+                Q1[index] += sigma*(q1);
+                Q2[index] += sigma*(q2);
+                Q3[index] += sigma*(0.5f*(q11 + q22));
+            }
+        }
+    }
 }
-float ProjQ_3D(float *Q1, float *Q2, float *Q3, float *Q4, float *Q5, float *Q6, long dimX, long dimY, long dimZ, float alpha0)
+/*Projection onto convex set for Q*/
+static void ProjQ_rows(void *arg, long r0, long r1)
 {
+    tgv_args *a = (tgv_args*)arg;
+    float *Q1 = a->Q1, *Q2 = a->Q2, *Q3 = a->Q3, *Q4 = a->Q4, *Q5 = a->Q5, *Q6 = a->Q6, alpha0 = a->alpha;
+    long dimX = a->dimX;
     float grad_magn;
-    long i,j,k,index;
-#pragma omp parallel for shared(Q1,Q2,Q3,Q4,Q5,Q6) private(i,j,k,index,grad_magn)
-    for(k=0; k<dimZ; k++) {
-        for(j=0; j<dimY; j++) {
-            for(i=0; i<dimX; i++) {
-                index = (dimX*dimY)*k + j*dimX+i;
-                grad_magn = sqrtf(pow(Q1[index],2) + pow(Q2[index],2) + pow(Q3[index],2) + 2.0f*pow(Q4[index],2) + 2.0f*pow(Q5[index],2) + 2.0f*pow(Q6[index],2));
-                grad_magn = grad_magn/alpha0;
-                if (grad_magn > 1.0f) {
-                    Q1[index] /= grad_magn;
-                    Q2[index] /= grad_magn;
-                    Q3[index] /= grad_magn;
-                    Q4[index] /= grad_magn;
-                    Q5[index] /= grad_magn;
-                    Q6[index] /= grad_magn;
-                }
-            }}}
-    return 1;
+    long index;
+    for(index=r0*dimX; index<r1*dimX; index++) {
+        if (Q4 != NULL) {
+            grad_magn = sqrtf(pow(Q1[index],2) + pow(Q2[index],2) + pow(Q3[index],2) + 2.0f*pow(Q4[index],2) + 2.0f*pow(Q5[index],2) + 2.0f*pow(Q6[index],2));
+            grad_magn = grad_magn/alpha0;
+            if (grad_magn > 1.0f) {
+                Q1[index] /= grad_magn;
+                Q2[index] /= grad_magn;
+                Q3[index] /= grad_magn;
+                Q4[index] /= grad_magn;
+                Q5[index] /= grad_magn;
+                Q6[index] /= grad_magn;
+            }
+        }
+        else {
+            grad_magn = sqrtf(pow(Q1[index],2) + pow(Q2[index],2) + 2*pow(Q3[index],2));
+            grad_magn = grad_magn/alpha0;
+            if (grad_magn > 1.0f) {
+                Q1[index] /= grad_magn;
+                Q2[index] /= grad_magn;
+                Q3[index] /= grad_magn;
+            }
+        }
+    }
 }
-/* Divergence and projection for P*/
-float DivProjP_3D(float *U, float *U0, float *P1, float *P2, float *P3, long dimX, long dimY, long dimZ, float lambda, float tau)
+/* Divergence and projection for P (backward differences)*/
+static void DivProjP_rows(void *arg, long r0, long r1)
 {
-    long i,j,k,index;
+    tgv_args *a = (tgv_args*)arg;
+    float *U = a->U, *U0 = a->U0, *P1 = a->P1, *P2 = a->P2, *P3 = a->P3, lambda = a->lambda, tau = a->tau;
+    long dimX = a->dimX, dimY = a->dimY, dimZ = a->dimZ;
+    long i,j,k,r,index;
     float P_v1, P_v2, P_v3, div;
-#pragma omp parallel for shared(U,U0,P1,P2,P3) private(i,j,k,index,P_v1,P_v2,P_v3,div)
-    for(k=0; k<dimZ; k++) {
-        for(j=0; j<dimY; j++) {
+    for(r=r0; r<r1; r++) {
+        k = r/dimY; j = r - k*dimY;
+        if (dimZ > 1) {
             for(i=0; i<dimX; i++) {
                 index = (dimX*dimY)*k + j*dimX+i;
                 
@@ -467,17 +463,38 @@ float DivProjP_3D(float *U, float *U0, float *P1, float *P2, float *P3, long dim
                 
                 div = P_v1 + P_v2 + P_v3;
                 U[index] = (lambda*(U[index] + tau*div) + tau*U0[index])/(lambda + tau);
-            }}}
-    return *U;
+            }
+        }
+        else {
+            for(i=0; i<dimX; i++) {
+                index = j*dimX+i;
+                
+                if (i == 0) P_v1 = P1[index];
+                else if (i == dimX-1) P_v1 = -P1[j*dimX+(i-1)];
+                else P_v1 = P1[index] - P1[j*dimX+(i-1)];
+                
+                if (j == 0) P_v2 = P2[index];
+                else if (j == dimY-1) P_v2 = -P2[(j-1)*dimX+i];
+                else P_v2 = P2[index] - P2[(j-1)*dimX+i];
+                
+                div = P_v1 + P_v2;
+                U[index] = (lambda*(U[index] + tau*div) + tau*U0[index])/(lambda + tau);
+            }
+        }
+    }
 }
-/*get update for V*/
-float UpdV_3D(float *V1, float *V2, float *V3, float *P1, float *P2, float *P3, float *Q1, float *Q2, float *Q3, float *Q4, float *Q5, float *Q6, long dimX, long dimY, long dimZ, float tau)
+/*get update for V (backward differences)*/
+static void UpdV_rows(void *arg, long r0, long r1)
 {
-    long i,j,k,index;
-    float q1, q4x, q5x, q2, q4y, q6y, q6z, q5z, q3, div1, div2, div3;
-#pragma omp parallel for shared(V1,V2,V3,P1,P2,P3,Q1,Q2,Q3,Q4,Q5,Q6) private(i,j,k,index,q1,q4x,q5x,q2,q4y,q6y,q6z,q5z,q3,div1,div2,div3)
-    for(k=0; k<dimZ; k++) {
-        for(j=0; j<dimY; j++) {
+    tgv_args *a = (tgv_args*)arg;
+    float *V1 = a->V1, *V2 = a->V2, *V3 = a->V3, *P1 = a->P1, *P2 = a->P2, *P3 = a->P3, tau = a->tau;
+    float *Q1 = a->Q1, *Q2 = a->Q2, *Q3 = a->Q3, *Q4 = a->Q4, *Q5 = a->Q5, *Q6 = a->Q6;
+    long dimX = a->dimX, dimY = a->dimY, dimZ = a->dimZ;
+    long i,j,k,r,index;
+    float q1, q4x, q5x, q2, q4y, q6y, q6z, q5z, q3, q3_x, q3_y, div1, div2, div3;
+    for(r=r0; r<r1; r++) {
+        k = r/dimY; j = r - k*dimY;
+        if (dimZ > 1) {
             for(i=0; i<dimX; i++) {
                 index = (dimX*dimY)*k + j*dimX+i;
                 q1 = 0.0f; q4x= 0.0f; q5x= 0.0f; q2= 0.0f; q4y= 0.0f; q6y= 0.0f; q6z= 0.0f; q5z= 0.0f; q3= 0.0f;
@@ -528,41 +545,231 @@ float UpdV_3D(float *V1, float *V2, float *V3, float *P1, float *P2, float *P3,
                 V1[index] += tau*(P1[index] + div1);
                 V2[index] += tau*(P2[index] + div2);
                 V3[index] += tau*(P3[index] + div3);
-            }}}
+            }
+        }
+        else {
+            for(i=0; i<dimX; i++) {
+                index = j*dimX+i;
+                
+                /* boundary conditions (Neuman) */
+                if (i == 0) {
+                    q1 = Q1[index];
+                    q3_x = Q3[index]; }
+                else if (i == dimX-1) {
+                    q1 = -Q1[j*dimX+(i-1)];
+                    q3_x = -Q3[j*dimX+(i-1)];  }
+                else {
+                    q1 = Q1[index] - Q1[j*dimX+(i-1)];
+                    q3_x = Q3[index] - Q3[j*dimX+(i-1)];  }
+                
+                if (j == 0) {
+                    q2 = Q2[index];
+                    q3_y = Q3[index]; }
+                else if (j == dimY-1) {
+                    q2 = -Q2[(j-1)*dimX+i];
+                    q3_y = -Q3[(j-1)*dimX+i]; }
+                else {
+                    q2 = Q2[index] - Q2[(j-1)*dimX+i];
+                    q3_y = Q3[index] - Q3[(j-1)*dimX+i]; }
+                
+                
+                div1 = q1 + q3_y;
+                div2 = q3_x + q2;
+                V1[index] += tau*(P1[index] + div1);
+                V2[index] += tau*(P2[index] + div2);
+            }
+        }
+    }
+}
+/* pointwise over the elements: U = 2U - U_old (and the same for V2, V3 when set) */
+static void newU_rows(void *arg, long r0, long r1)
+{
+    tgv_args *a = (tgv_args*)arg;
+    float *U = a->U, *U_old = a->U_old, *V2 = a->V2, *V2_old = a->V2_old, *V3 = a->V3, *V3_old = a->V3_old;
+    long i;
+    for(i=r0; i<r1; i++) U[i] = 2.0f*U[i] - U_old[i];
+    if (V2 != NULL) for(i=r0; i<r1; i++) V2[i] = 2.0f*V2[i] - V2_old[i];
+    if (V3 != NULL) for(i=r0; i<r1; i++) V3[i] = 2.0f*V3[i] - V3_old[i];
+}
+/* U += theta(U - U_old), the extrapolation of the accelerated scheme */
+static void newU_theta_rows(void *arg, long r0, long r1)
+{
+    tgv_args *a = (tgv_args*)arg;
+    float *U = a->U, *U_old = a->U_old, theta = a->theta;
+    long i;
+    for(i=r0; i<r1; i++) U[i] += theta*(U[i] - U_old[i]);
+}
+static void copyIm_3Ar_rows(void *arg, long r0, long r1)
+{
+    tgv_args *a = (tgv_args*)arg;
+    long n = (r1 - r0)*sizeof(float);
+    memcpy(a->V1_old + r0, a->V1 + r0, n);
+    memcpy(a->V2_old + r0, a->V2 + r0, n);
+    memcpy(a->V3_old + r0, a->V3 + r0, n);
+}
+
+/********************************************************************/
+/***************************2D Functions*****************************/
+/********************************************************************/
+/*Calculating dual variable P (using forward differences)*/
+float DualP_2D(float *U, float *V1, float *V2, float *P1, float *P2, long dimX, long dimY, float sigma)
+{
+    tgv_args a = {NULL};
+    a.U = U; a.V1 = V1; a.V2 = V2; a.P1 = P1; a.P2 = P2; a.sigma = sigma;
+    a.dimX = dimX; a.dimY = dimY; a.dimZ = 1l;
+    Run_rows_team(dimY, DualP_rows, &a);
+    return 1;
+}
+/*Projection onto convex set for P*/
+float ProjP_2D(float *P1, float *P2, long dimX, long dimY, float alpha1)
+{
+    tgv_args a = {NULL};
+    a.P1 = P1; a.P2 = P2; a.alpha = alpha1;
+    a.dimX = dimX; a.dimY = dimY; a.dimZ = 1l;
+    Run_rows_team(dimY, ProjP_rows, &a);
+    return 1;
+}
+/*Calculating dual variable Q (using forward differences)*/
+float DualQ_2D(float *V1, float *V2, float *Q1, float *Q2, float *Q3, long dimX, long dimY, float sigma)
+{
+    tgv_args a = {NULL};
+    a.V1 = V1; a.V2 = V2; a.Q1 = Q1; a.Q2 = Q2; a.Q3 = Q3; a.sigma = sigma;
+    a.dimX = dimX; a.dimY = dimY; a.dimZ = 1l;
+    Run_rows_team(dimY, DualQ_rows, &a);
+    return 1;
+}
+float ProjQ_2D(float *Q1, float *Q2, float *Q3, long dimX, long dimY, float alpha0)
+{
+    tgv_args a = {NULL};
+    a.Q1 = Q1; a.Q2 = Q2; a.Q3 = Q3; a.alpha = alpha0;
+    a.dimX = dimX; a.dimY = dimY; a.dimZ = 1l;
+    Run_rows_team(dimY, ProjQ_rows, &a);
+    return 1;
+}
+/* Divergence and projection for P (backward differences)*/
+float DivProjP_2D(float *U, float *U0, float *P1, float *P2, long dimX, long dimY, float lambda, float tau)
+{
+    tgv_args a = {NULL};
+    a.U = U; a.U0 = U0; a.P1 = P1; a.P2 = P2; a.lambda = lambda; a.tau = tau;
+    a.dimX = dimX; a.dimY = dimY; a.dimZ = 1l;
+    Run_rows_team(dimY, DivProjP_rows, &a);
+    return *U;
+}
+/*get updated solution U*/
+float newU(float *U, float *U_old, long dimX, long dimY)
+{
+    tgv_args a = {NULL};
+    a.U = U; a.U_old = U_old;
+    Run_rows_team(dimX*dimY, newU_rows, &a);
+    return *U;
+}
+/*get updated solution U with the extrapolation theta of the accelerated scheme*/
+float newU_theta(float *U, float *U_old, float theta, long DimTotal)
+{
+    tgv_args a = {NULL};
+    a.U = U; a.U_old = U_old; a.theta = theta;
+    Run_rows_team(DimTotal, newU_theta_rows, &a);
+    return *U;
+}
+/*get update for V (backward differences)*/
+float UpdV_2D(float *V1, float *V2, float *P1, float *P2, float *Q1, float *Q2, float *Q3, long dimX, long dimY, float tau)
+{
+    tgv_args a = {NULL};
+    a.V1 = V1; a.V2 = V2; a.P1 = P1; a.P2 = P2; a.Q1 = Q1; a.Q2 = Q2; a.Q3 = Q3; a.tau = tau;
+    a.dimX = dimX; a.dimY = dimY; a.dimZ = 1l;
+    Run_rows_team(dimY, UpdV_rows, &a);
+    return 1;
+}
+
+/********************************************************************/
+/***************************3D Functions*****************************/
+/********************************************************************/
+/*Calculating dual variable P (using forward differences)*/
+float DualP_3D(float *U, float *V1, float *V2, float *V3, float *P1, float *P2, float *P3, long dimX, long dimY, long dimZ, float sigma)
+{
+    tgv_args a = {NULL};
+    a.U = U; a.V1 = V1; a.V2 = V2; a.V3 = V3; a.P1 = P1; a.P2 = P2; a.P3 = P3; a.sigma = sigma;
+    a.dimX = dimX; a.dimY = dimY; a.dimZ = dimZ;
+    Run_rows(dimZ*dimY, DualP_rows, &a);
+    return 1;
+}
+/*Projection onto convex set for P*/
+float ProjP_3D(float *P1, float *P2, float *P3, long dimX, long dimY, long dimZ, float alpha1)
+{
+    tgv_args a = {NULL};
+    a.P1 = P1; a.P2 = P2; a.P3 = P3; a.alpha = alpha1;
+    a.dimX = dimX; a.dimY = dimY; a.dimZ = dimZ;
+    Run_rows(dimZ*dimY, ProjP_rows, &a);
+    return 1;
+}
+/*Calculating dual variable Q (using forward differences)*/
+float DualQ_3D(float *V1, float *V2, float *V3, float *Q1, float *Q2, float *Q3, float *Q4, float *Q5, float *Q6, long dimX, long dimY, long dimZ, float sigma)
+{
+    tgv_args a = {NULL};
+    a.V1 = V1; a.V2 = V2; a.V3 = V3; a.Q1 = Q1; a.Q2 = Q2; a.Q3 = Q3; a.Q4 = Q4; a.Q5 = Q5; a.Q6 = Q6; a.sigma = sigma;
+    a.dimX = dimX; a.dimY = dimY; a.dimZ = dimZ;
+    Run_rows(dimZ*dimY, DualQ_rows, &a);
+    return 1;
+}
+float ProjQ_3D(float *Q1, float *Q2, float *Q3, float *Q4, float *Q5, float *Q6, long dimX, long dimY, long dimZ, float alpha0)
+{
+    tgv_args a = {NULL};
+    a.Q1 = Q1; a.Q2 = Q2; a.Q3 = Q3; a.Q4 = Q4; a.Q5 = Q5; a.Q6 = Q6; a.alpha = alpha0;
+    a.dimX = dimX; a.dimY = dimY; a.dimZ = dimZ;
+    Run_rows(dimZ*dimY, ProjQ_rows, &a);
+    return 1;
+}
+/* Divergence and projection for P*/
+float DivProjP_3D(float *U, float *U0, float *P1, float *P2, float *P3, long dimX, long dimY, long dimZ, float lambda, float tau)
+{
+    tgv_args a = {NULL};
+    a.U = U; a.U0 = U0; a.P1 = P1; a.P2 = P2; a.P3 = P3; a.lambda = lambda; a.tau = tau;
+    a.dimX = dimX; a.dimY = dimY; a.dimZ = dimZ;
+    Run_rows(dimZ*dimY, DivProjP_rows, &a);
+    return *U;
+}
+/*get update for V*/
+float UpdV_3D(float *V1, float *V2, float *V3, float *P1, float *P2, float *P3, float *Q1, float *Q2, float *Q3, float *Q4, float *Q5, float *Q6, long dimX, long dimY, long dimZ, float tau)
+{
+    tgv_args a = {NULL};
+    a.V1 = V1; a.V2 = V2; a.V3 = V3; a.P1 = P1; a.P2 = P2; a.P3 = P3;
+    a.Q1 = Q1; a.Q2 = Q2; a.Q3 = Q3; a.Q4 = Q4; a.Q5 = Q5; a.Q6 = Q6; a.tau = tau;
+    a.dimX = dimX; a.dimY = dimY; a.dimZ = dimZ;
+    Run_rows(dimZ*dimY, UpdV_rows, &a);
     return 1;
 }
 
 float copyIm_3Ar(float *V1, float *V2, float *V3, float *V1_old, float *V2_old, float *V3_old, long dimX, long dimY, long dimZ)
 {
-    long j;
-#pragma omp parallel for shared(V1, V2, V3, V1_old, V2_old, V3_old) private(j)
-    for (j = 0; j<dimX*dimY*dimZ; j++)  {
-        V1_old[j] = V1[j];
-        V2_old[j] = V2[j];
-        V3_old[j] = V3[j];
-    }
+    tgv_args a = {NULL};
+    a.V1 = V1; a.V2 = V2; a.V3 = V3; a.V1_old = V1_old; a.V2_old = V2_old; a.V3_old = V3_old;
+    Run_rows(dimX*dimY*dimZ, copyIm_3Ar_rows, &a);
     return 1;
 }
 
 /*get updated solution U*/
 float newU3D(float *U, float *U_old, long dimX, long dimY, long dimZ)
 {
-    long i;
-#pragma omp parallel for shared(U, U_old) private(i)
-    for(i=0; i<dimX*dimY*dimZ; i++) U[i] = 2.0f*U[i] - U_old[i];
+    tgv_args a = {NULL};
+    a.U = U; a.U_old = U_old;
+    Run_rows(dimX*dimY*dimZ, newU_rows, &a);
     return *U;
 }
 
+/*get updated solution U with the extrapolation theta of the accelerated scheme*/
+float newU3D_theta(float *U, float *U_old, float theta, long DimTotal)
+{
+    tgv_args a = {NULL};
+    a.U = U; a.U_old = U_old; a.theta = theta;
+    Run_rows(DimTotal, newU_theta_rows, &a);
+    return *U;
+}
 
 /*get updated solution U*/
 float newU3D_3Ar(float *V1, float *V2, float *V3, float *V1_old, float *V2_old, float *V3_old, long dimX, long dimY, long dimZ)
 {
-    long i;
-#pragma omp parallel for shared(V1, V2, V3, V1_old, V2_old, V3_old) private(i)
-    for(i=0; i<dimX*dimY*dimZ; i++) {
-        V1[i] = 2.0f*V1[i] - V1_old[i];
-        V2[i] = 2.0f*V2[i] - V2_old[i];
-        V3[i] = 2.0f*V3[i] - V3_old[i];
-    }
+    tgv_args a = {NULL};
+    a.U = V1; a.U_old = V1_old; a.V2 = V2; a.V2_old = V2_old; a.V3 = V3; a.V3_old = V3_old;
+    Run_rows(dimX*dimY*dimZ, newU_rows, &a);
     return 1;
 }
@@ -23,6 +23,8 @@ limitations under the License.
 #include <stdio.h>
 #include "omp.h"
 #include "utils.h"
+#include "checkpoint.h"
+#include "pool.h"
 #include "CCPiDefines.h"
 
 /* C-OMP implementation of Primal-Dual denoising method for
@@ -36,11 +38,18 @@ limitations under the License.
  * 5. Number of Chambolle-Pock (Primal-Dual) iterations
  * 6. Lipshitz constant (default is 12)
  * 7. eplsilon: tolerance constant
+ * 8. algorithm (TGV_main_ckpt): fixed steps (0) or the accelerated scheme (1) of Chambolle and Pock
+ *    for the strongly convex fidelity, tau, sigma and theta are updated every iteration
  *
  * Output:
  * [1] Filtered/regularized image/volume
  * [2] Information vector which contains [iteration no., reached tolerance]
  *
+ * TGV_main_ckpt writes the state (U, P, Q, V, iteration and early stopping counters) to the
+ * checkpoint file 'checkpoint' every 'interval' iterations and after the last one; with resume
+ * the iterations continue from the checkpoint in the file (see checkpoint.h). It returns -1 when
+ * the checkpoint file cannot be used.
+ *
  * References:
  * [1] K. Bredies "Total Generalized Variation"
  */
@@ -51,6 +60,8 @@ extern "C" {
 #endif
 
 CCPI_EXPORT float TGV_main(float *U0, float *U, float *infovector, float lambda, float alpha1, float alpha0, int iter, float L2, float epsil, int dimX, int dimY, int dimZ);
+CCPI_EXPORT float TGV_main_ckpt(float *U0, float *U, float *infovector, float lambda, float alpha1, float alpha0, int iter, float L2, float epsil, int algorithm, int dimX, int dimY, int dimZ, const char *checkpoint, int interval, int resume);
+CCPI_EXPORT long TGV_mem(int dimX, int dimY, int dimZ);
 
 /* 2D functions */
 CCPI_EXPORT float DualP_2D(float *U, float *V1, float *V2, float *P1, float *P2, long dimX, long dimY, float sigma);
@@ -60,6 +71,7 @@ CCPI_EXPORT float ProjQ_2D(float *Q1, float *Q2, float *Q3, long dimX, long dimY
 CCPI_EXPORT float DivProjP_2D(float *U, float *U0, float *P1, float *P2, long dimX, long dimY, float lambda, float tau);
 CCPI_EXPORT float UpdV_2D(float *V1, float *V2, float *P1, float *P2, float *Q1, float *Q2, float *Q3, long dimX, long dimY, float tau);
 CCPI_EXPORT float newU(float *U, float *U_old, long dimX, long dimY);
+CCPI_EXPORT float newU_theta(float *U, float *U_old, float theta, long DimTotal);
 /* 3D functions */
 CCPI_EXPORT float DualP_3D(float *U, float *V1, float *V2, float *V3, float *P1, float *P2, float *P3, long dimX, long dimY, long dimZ, float sigma);
 CCPI_EXPORT float ProjP_3D(float *P1, float *P2, float *P3, long dimX, long dimY, long dimZ, float alpha1);
@@ -68,6 +80,7 @@ CCPI_EXPORT float ProjQ_3D(float *Q1, float *Q2, float *Q3, float *Q4, float *Q5
 CCPI_EXPORT float DivProjP_3D(float *U, float *U0, float *P1, float *P2, float *P3, long dimX, long dimY, long dimZ, float lambda, float tau);
 CCPI_EXPORT float UpdV_3D(float *V1, float *V2, float *V3, float *P1, float *P2, float *P3, float *Q1, float *Q2, float *Q3, float *Q4, float *Q5, float *Q6, long dimX, long dimY, long dimZ, float tau);
 CCPI_EXPORT float newU3D(float *U, float *U_old, long dimX, long dimY, long dimZ);
+CCPI_EXPORT float newU3D_theta(float *U, float *U_old, float theta, long DimTotal);
 CCPI_EXPORT float copyIm_3Ar(float *V1, float *V2, float *V3, float *V1_old, float *V2_old, float *V3_old, long dimX, long dimY, long dimZ);
 CCPI_EXPORT float newU3D_3Ar(float *V1, float *V2, float *V3, float *V1_old, float *V2_old, float *V3_old, long dimX, long dimY, long dimZ);
 #ifdef __cplusplus
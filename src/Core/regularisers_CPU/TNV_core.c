@@ -55,26 +55,26 @@ float TNV_CPU_main(float *Input, float *u, float lambda, int maxIter, float tol,
     float theta = 1.0f;
     
     // Auxiliar vectors
-    u_upd = calloc(DimTotal, sizeof(float));
-    gx = calloc(DimTotal, sizeof(float));
-    gy = calloc(DimTotal, sizeof(float));
-    gx_upd = calloc(DimTotal, sizeof(float));
-    gy_upd = calloc(DimTotal, sizeof(float));
-    qx = calloc(DimTotal, sizeof(float));
-    qy = calloc(DimTotal, sizeof(float));
-    qx_upd = calloc(DimTotal, sizeof(float));
-    qy_upd = calloc(DimTotal, sizeof(float));
-    v = calloc(DimTotal, sizeof(float));
-    vx = calloc(DimTotal, sizeof(float));
-    vy = calloc(DimTotal, sizeof(float));
-    gradx = calloc(DimTotal, sizeof(float));
-    grady = calloc(DimTotal, sizeof(float));
-    gradx_upd = calloc(DimTotal, sizeof(float));
-    grady_upd = calloc(DimTotal, sizeof(float));
-    gradx_ubar = calloc(DimTotal, sizeof(float));
-    grady_ubar = calloc(DimTotal, sizeof(float));
-    div = calloc(DimTotal, sizeof(float));
-    div_upd = calloc(DimTotal, sizeof(float));
+    u_upd = Vol_calloc(DimTotal);
+    gx = Vol_calloc(DimTotal);
+    gy = Vol_calloc(DimTotal);
+    gx_upd = Vol_calloc(DimTotal);
+    gy_upd = Vol_calloc(DimTotal);
+    qx = Vol_calloc(DimTotal);
+    qy = Vol_calloc(DimTotal);
+    qx_upd = Vol_calloc(DimTotal);
+    qy_upd = Vol_calloc(DimTotal);
+    v = Vol_calloc(DimTotal);
+    vx = Vol_calloc(DimTotal);
+    vy = Vol_calloc(DimTotal);
+    gradx = Vol_calloc(DimTotal);
+    grady = Vol_calloc(DimTotal);
+    gradx_upd = Vol_calloc(DimTotal);
+    grady_upd = Vol_calloc(DimTotal);
+    gradx_ubar = Vol_calloc(DimTotal);
+    grady_ubar = Vol_calloc(DimTotal);
+    div = Vol_calloc(DimTotal);
+    div_upd = Vol_calloc(DimTotal);
     
     // Backtracking parameters
     float s = 1.0f;
@@ -222,15 +222,24 @@ if (residual < tol) {
     printf("Iterations stopped at %i with the residual %f \n", iter, residual);
     break; }
 
+        if (Progress_step(iter+1, residual)) break;
     }
     printf("Iterations stopped at %i with the residual %f \n", iter, residual);
-    free (u_upd); free(gx); free(gy); free(gx_upd); free(gy_upd);
-    free(qx); free(qy); free(qx_upd); free(qy_upd); free(v); free(vx); free(vy);
-    free(gradx); free(grady); free(gradx_upd); free(grady_upd); free(gradx_ubar);
-    free(grady_ubar); free(div); free(div_upd);    
+    Vol_free(u_upd); Vol_free(gx); Vol_free(gy); Vol_free(gx_upd); Vol_free(gy_upd);
+    Vol_free(qx); Vol_free(qy); Vol_free(qx_upd); Vol_free(qy_upd); Vol_free(v); Vol_free(vx); Vol_free(vy);
+    Vol_free(gradx); Vol_free(grady); Vol_free(gradx_upd); Vol_free(grady_upd); Vol_free(gradx_ubar);
+    Vol_free(grady_ubar); Vol_free(div); Vol_free(div_upd);    
     return *u;
 }
 
+/* Peak size in bytes of the work arrays allocated by TNV_CPU_main (the projection pair lives on the stack) */
+long TNV_CPU_mem(int dimX, int dimY, int dimZ)
+{
+    long DimTotal;
+    DimTotal = (long)(dimX)*(long)(dimY)*(long)(dimZ);
+    return 20l*DimTotal*sizeof(float);
+}
+
 float proxG(float *u_upd, float *v, float *f, float taulambda, long dimX, long dimY, long dimZ)
 {
     float constant;
@@ -286,14 +295,13 @@ float proxF(float *gx, float *gy, float *vx, float *vy, float sigma, int p, int
 //             }}}
     
     // Auxiliar vector
-    float *proj, sum, shrinkfactor ;
+    float proj[2], sum, shrinkfactor ;
     float M1,M2,M3,valuex,valuey,T,D,det,eig1,eig2,sig1,sig2,V1, V2, V3, V4, v0,v1,v2, mu1,mu2,sig1_upd,sig2_upd,t1,t2,t3;
     long i,j,k, ii, num;
 #pragma omp parallel for shared (gx,gy,vx,vy,p) private(i,ii,j,k,proj,num, sum, shrinkfactor, M1,M2,M3,valuex,valuey,T,D,det,eig1,eig2,sig1,sig2,V1, V2, V3, V4,v0,v1,v2,mu1,mu2,sig1_upd,sig2_upd,t1,t2,t3)
     for(i=0; i<dimX; i++) {
         for(j=0; j<dimY; j++) {
             
-            proj = (float*) calloc (2,sizeof(float));
             // Compute matrix $M\in\R^{2\times 2}$
             M1 = 0.0f;
             M2 = 0.0f;
@@ -312,11 +320,11 @@ float proxF(float *gx, float *gy, float *vx, float *vy, float sigma, int p, int
             // Compute eigenvalues of M
             T = M1 + M3;
             D = M1 * M3 - M2 * M2;
-            det = sqrt(MAX((T * T / 4.0f) - D, 0.0f));
+            det = sqrtf(MAX((T * T / 4.0f) - D, 0.0f));
             eig1 = MAX((T / 2.0f) + det, 0.0f);
             eig2 = MAX((T / 2.0f) - det, 0.0f);
-            sig1 = sqrt(eig1);
-            sig2 = sqrt(eig2);
+            sig1 = sqrtf(eig1);
+            sig2 = sqrtf(eig2);
             
             // Compute normalized eigenvectors
             V1 = V2 = V3 = V4 = 0.0f;
@@ -415,9 +423,6 @@ float proxF(float *gx, float *gy, float *vx, float *vy, float sigma, int p, int
                 gx[(dimX*dimY)*k + j*dimX + i] = vx[(dimX*dimY)*k + j*dimX + i] * t1 + vy[(dimX*dimY)*k + j*dimX + i] * t2;
                 gy[(dimX*dimY)*k + j*dimX + i] = vx[(dimX*dimY)*k + j*dimX + i] * t2 + vy[(dimX*dimY)*k + j*dimX + i] * t3;
             }           
-            
-            // Delete allocated memory
-            free(proj);
         }}
     
     return 1;
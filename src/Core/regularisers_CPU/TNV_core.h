@@ -36,6 +36,7 @@ limitations under the License.
 extern "C" {
 #endif
 CCPI_EXPORT float TNV_CPU_main(float *Input, float *u, float lambda, int maxIter, float tol, int dimX, int dimY, int dimZ);
+CCPI_EXPORT long TNV_CPU_mem(int dimX, int dimY, int dimZ);
 
 /*float PDHG(float *A, float *B, float tau, float sigma, float theta, float lambda, int p, int q, int r, float tol, int maxIter, int d_c, int d_w, int d_h);*/
 CCPI_EXPORT float proxG(float *u_upd, float *v, float *f, float taulambda, long dimX, long dimY, long dimZ);
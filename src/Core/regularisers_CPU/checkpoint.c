@@ -0,0 +1,282 @@
+/*
+ * This work is part of the Core Imaging Library developed by
+ * Visual Analytics and Imaging System Group of the Science Technology
+ * Facilities Council, STFC
+ *
+ * Copyright 2017 Daniil Kazantsev
+ * Copyright 2017 Srikanth Nagella, Edoardo Pasca
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "checkpoint.h"
+
+#define CKPT_MAGIC "CCPICKPT"
+#define CKPT_VERSION 1
+/* the header and the slots start at multiples of CKPT_ALIGN, a multiple of the page size of the
+ * supported platforms as msync needs page aligned ranges */
+#define CKPT_ALIGN 65536l
+/* floats copied per task when the arrays are copied to and from the file */
+#define CKPT_CHUNK 262144l
+
+typedef struct {
+    int complete;                 /* 1 once the arrays of the slot are in the file */
+    int iteration;                /* iterations done */
+    int count;                    /* early stopping counter */
+    float scalars[CKPT_SCALARS];
+} ckpt_slot;
+
+typedef struct {
+    char magic[8];
+    int version, solver, narrays, nparams;
+    long long DimTotal;
+    float params[CKPT_PARAMS];
+    ckpt_slot slot[2];
+} ckpt_header;
+
+struct Ckpt {
+    int interval;
+    long DimTotal;
+    int narrays;
+    long slotbytes;               /* bytes of a slot, rounded up to CKPT_ALIGN */
+    int next;                     /* slot receiving the next checkpoint */
+    ckpt_header *h;
+#if defined(_MSC_VER)
+    FILE *f;
+    ckpt_header hdr;
+#else
+    int fd;
+    char *map;
+    long size;
+#endif
+};
+
+/* copies n floats in parallel (one thread when called inside a parallel region) */
+static void Ckpt_copy(float *dst, const float *src, long n)
+{
+    long c;
+#pragma omp parallel for shared(dst, src, n) private(c)
+    for(c=0; c<n; c+=CKPT_CHUNK) memcpy(dst + c, src + c, ((n - c < CKPT_CHUNK) ? (n - c) : CKPT_CHUNK)*sizeof(float));
+}
+
+#if defined(_MSC_VER)
+#include <io.h>
+
+static int Ckpt_map(Ckpt *c, const char *path, int *created)
+{
+    c->f = fopen(path, "r+b");
+    *created = (c->f == NULL);
+    if (*created) c->f = fopen(path, "w+b");
+    if (c->f == NULL) return 0;
+    c->h = &c->hdr;
+    memset(c->h, 0, sizeof(ckpt_header));
+    if (!*created && (fread(c->h, sizeof(ckpt_header), 1, c->f) != 1)) *created = 1;
+    return 1;
+}
+
+static void Ckpt_unmap(Ckpt *c)
+{
+    fclose(c->f);
+}
+
+/* writes the header to the file */
+static void Ckpt_sync_header(Ckpt *c)
+{
+    _fseeki64(c->f, 0, SEEK_SET);
+    fwrite(c->h, sizeof(ckpt_header), 1, c->f);
+    fflush(c->f);
+    _commit(_fileno(c->f));
+}
+
+static void Ckpt_put(Ckpt *c, int s, int a, const float *A)
+{
+    _fseeki64(c->f, CKPT_ALIGN + s*c->slotbytes + a*c->DimTotal*(long)sizeof(float), SEEK_SET);
+    fwrite(A, sizeof(float), c->DimTotal, c->f);
+}
+
+static void Ckpt_sync_slot(Ckpt *c, int s)
+{
+    fflush(c->f);
+    _commit(_fileno(c->f));
+}
+
+static void Ckpt_get(Ckpt *c, int s, int a, float *A)
+{
+    _fseeki64(c->f, CKPT_ALIGN + s*c->slotbytes + a*c->DimTotal*(long)sizeof(float), SEEK_SET);
+    fread(A, sizeof(float), c->DimTotal, c->f);
+}
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static int Ckpt_map(Ckpt *c, const char *path, int *created)
+{
+    struct stat st;
+    c->size = CKPT_ALIGN + 2l*c->slotbytes;
+    c->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (c->fd < 0) return 0;
+    *created = (fstat(c->fd, &st) != 0) || (st.st_size != c->size);
+    if (*created && (ftruncate(c->fd, c->size) != 0)) {close(c->fd); return 0;}
+    c->map = (char*) mmap(NULL, c->size, PROT_READ | PROT_WRITE, MAP_SHARED, c->fd, 0);
+    if (c->map == MAP_FAILED) {close(c->fd); return 0;}
+    c->h = (ckpt_header*) c->map;
+    return 1;
+}
+
+static void Ckpt_unmap(Ckpt *c)
+{
+    munmap(c->map, c->size);
+    close(c->fd);
+}
+
+static void Ckpt_sync_header(Ckpt *c)
+{
+    msync(c->map, CKPT_ALIGN, MS_SYNC);
+}
+
+static void Ckpt_put(Ckpt *c, int s, int a, const float *A)
+{
+    Ckpt_copy((float*)(c->map + CKPT_ALIGN + s*c->slotbytes) + a*c->DimTotal, A, c->DimTotal);
+}
+
+static void Ckpt_sync_slot(Ckpt *c, int s)
+{
+    msync(c->map + CKPT_ALIGN + s*c->slotbytes, c->slotbytes, MS_SYNC);
+}
+
+static void Ckpt_get(Ckpt *c, int s, int a, float *A)
+{
+    Ckpt_copy(A, (float*)(c->map + CKPT_ALIGN + s*c->slotbytes) + a*c->DimTotal, c->DimTotal);
+}
+#endif
+
+/* the complete slot with the most iterations, -1 when there is none */
+static int Ckpt_latest(const ckpt_header *h)
+{
+    int s, best = -1;
+    for(s=0; s<2; s++) {
+        if (h->slot[s].complete && ((best < 0) || (h->slot[s].iteration > h->slot[best].iteration))) best = s;
+    }
+    return best;
+}
+
+static int Ckpt_match(const ckpt_header *h, int solver, long DimTotal, int narrays, const float *params, int nparams)
+{
+    return (memcmp(h->magic, CKPT_MAGIC, 8) == 0) && (h->version == CKPT_VERSION) && (h->solver == solver) &&
+           (h->narrays == narrays) && (h->DimTotal == DimTotal) && (h->nparams == nparams) &&
+           (memcmp(h->params, params, nparams*sizeof(float)) == 0);
+}
+
+/* reads the header of a checkpoint file, 0 when there is no such file or it is not a checkpoint */
+static int Ckpt_read_header(const char *path, ckpt_header *h)
+{
+    int n;
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) return 0;
+    n = (int) fread(h, sizeof(ckpt_header), 1, f);
+    fclose(f);
+    return (n == 1) && (memcmp(h->magic, CKPT_MAGIC, 8) == 0);
+}
+
+/* Opens the checkpoint file of a run, the state is written after every 'interval' iterations
+ * (0 - after the last one only).
+ * With resume a file holding a checkpoint of the same solver, data size and parameters is kept
+ * for Ckpt_load, a missing or empty file starts the run afresh and a file of another run is an
+ * error. Without resume the file is (re)initialised. Returns NULL on error. */
+Ckpt *Ckpt_open(const char *path, int interval, int solver, long DimTotal, int narrays, const float *params, int nparams, int resume)
+{
+    Ckpt *c;
+    ckpt_header h;
+    int created;
+    if ((path == NULL) || (nparams > CKPT_PARAMS)) return NULL;
+    /* a checkpoint of another run is not overwritten */
+    if (resume && Ckpt_read_header(path, &h) && (Ckpt_latest(&h) >= 0) &&
+        !Ckpt_match(&h, solver, DimTotal, narrays, params, nparams)) return NULL;
+    c = (Ckpt*) calloc(1, sizeof(Ckpt));
+    c->interval = interval;
+    c->DimTotal = DimTotal;
+    c->narrays = narrays;
+    c->slotbytes = ((narrays*DimTotal*(long)sizeof(float) + CKPT_ALIGN - 1)/CKPT_ALIGN)*CKPT_ALIGN;
+    if (!Ckpt_map(c, path, &created)) {free(c); return NULL;}
+    if (!resume || created || !Ckpt_match(c->h, solver, DimTotal, narrays, params, nparams)) {
+        memset(c->h, 0, sizeof(ckpt_header));
+        memcpy(c->h->magic, CKPT_MAGIC, 8);
+        c->h->version = CKPT_VERSION;
+        c->h->solver = solver;
+        c->h->narrays = narrays;
+        c->h->nparams = nparams;
+        c->h->DimTotal = DimTotal;
+        memcpy(c->h->params, params, nparams*sizeof(float));
+        Ckpt_sync_header(c);
+    }
+    c->next = (Ckpt_latest(c->h) == 0) ? 1 : 0;
+    return c;
+}
+
+/* Copies the latest checkpoint into the state arrays, returns 0 when there is none */
+int Ckpt_load(Ckpt *c, float **arrays, int *iteration, int *count, float *scalars)
+{
+    int a, s;
+    if ((c == NULL) || ((s = Ckpt_latest(c->h)) < 0)) return 0;
+    for(a=0; a<c->narrays; a++) Ckpt_get(c, s, a, arrays[a]);
+    *iteration = c->h->slot[s].iteration;
+    *count = c->h->slot[s].count;
+    memcpy(scalars, c->h->slot[s].scalars, CKPT_SCALARS*sizeof(float));
+    c->next = 1 - s;
+    return 1;
+}
+
+/* Writes the state into the slot not holding the latest checkpoint */
+int Ckpt_save(Ckpt *c, float **arrays, int iteration, int count, const float *scalars)
+{
+    int a, s;
+    if (c == NULL) return 0;
+    s = c->next;
+    c->h->slot[s].complete = 0;
+    Ckpt_sync_header(c);
+    for(a=0; a<c->narrays; a++) Ckpt_put(c, s, a, arrays[a]);
+    Ckpt_sync_slot(c, s);
+    c->h->slot[s].iteration = iteration;
+    c->h->slot[s].count = count;
+    memcpy(c->h->slot[s].scalars, scalars, CKPT_SCALARS*sizeof(float));
+    c->h->slot[s].complete = 1;
+    Ckpt_sync_header(c);
+    c->next = 1 - s;
+    return 1;
+}
+
+/* 1 when a checkpoint is due after 'iteration' iterations (last - no iterations follow),
+ * an interval of 0 checkpoints after the last iteration only */
+int Ckpt_due(Ckpt *c, int iteration, int last)
+{
+    if (c == NULL) return 0;
+    if (c->interval <= 0) return last;
+    return ((iteration % c->interval) == 0) || last;
+}
+
+void Ckpt_close(Ckpt *c)
+{
+    if (c == NULL) return;
+    Ckpt_unmap(c);
+    free(c);
+}
+
+/* Iterations done in the latest checkpoint of the file, -1 when it holds none */
+int Ckpt_iterations(const char *path)
+{
+    ckpt_header h;
+    int s;
+    if (!Ckpt_read_header(path, &h)) return -1;
+    s = Ckpt_latest(&h);
+    return (s < 0) ? -1 : h.slot[s].iteration;
+}
@@ -0,0 +1,61 @@
+/*
+This work is part of the Core Imaging Library developed by
+Visual Analytics and Imaging System Group of the Science Technology
+Facilities Council, STFC
+
+Copyright 2017 Daniil Kazantsev
+Copyright 2017 Srikanth Nagella, Edoardo Pasca
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include "CCPiDefines.h"
+
+/* Checkpointing of the state of the iterative cores (primal and dual arrays, iteration counter,
+ * early stopping counter and a few scalars) into a memory-mapped file.
+ *
+ * The file holds a header followed by two slots, each slot a copy of all state arrays. The
+ * checkpoints alternate between the slots and a slot is marked complete in the header only after
+ * its arrays are flushed to the file, so a run killed in the middle of a checkpoint still leaves
+ * the previous one intact. On resume the complete slot with the most iterations is loaded.
+ * The header records the solver, the data size and the parameters of the run; a checkpoint
+ * written for other data or parameters is not resumed (Ckpt_open fails). Without mmap (MSVC)
+ * the same file is written with stdio.
+ *
+ * A core checkpoints after every 'interval' iterations and after its last one (Ckpt_due), so
+ * the overhead is bounded by the interval; with resume the run continues from the checkpoint
+ * and gives the same output bit for bit as an uninterrupted run. */
+
+/* solvers writing checkpoints */
+#define CKPT_TGV 1
+#define CKPT_NLTV 2
+
+/* parameters of the run kept in the header, scalars of the state kept per slot */
+#define CKPT_PARAMS 16
+#define CKPT_SCALARS 4
+
+typedef struct Ckpt Ckpt;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+CCPI_EXPORT Ckpt *Ckpt_open(const char *path, int interval, int solver, long DimTotal, int narrays, const float *params, int nparams, int resume);
+CCPI_EXPORT int Ckpt_load(Ckpt *c, float **arrays, int *iteration, int *count, float *scalars);
+CCPI_EXPORT int Ckpt_save(Ckpt *c, float **arrays, int iteration, int count, const float *scalars);
+CCPI_EXPORT int Ckpt_due(Ckpt *c, int iteration, int last);
+CCPI_EXPORT void Ckpt_close(Ckpt *c);
+CCPI_EXPORT int Ckpt_iterations(const char *path);
+#ifdef __cplusplus
+}
+#endif
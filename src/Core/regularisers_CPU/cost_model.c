@@ -0,0 +1,68 @@
+/*
+ * This work is part of the Core Imaging Library developed by
+ * Visual Analytics and Imaging System Group of the Science Technology
+ * Facilities Council, STFC
+ *
+ * Copyright 2017 Daniil Kazantsev
+ * Copyright 2017 Srikanth Nagella, Edoardo Pasca
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cost_model.h"
+
+/* the set-up and per-iteration costs at N voxels from the calibrated points (sorted by size) */
+static void Cost_at(double N, int points, const double *Np, const double *s, const double *c, double *s_N, double *c_N)
+{
+    double w;
+    int p;
+    if ((points == 1) || (N <= Np[0])) {*s_N = s[0]; *c_N = c[0]; return;}
+    if (N >= Np[points-1]) {*s_N = s[points-1]; *c_N = c[points-1]; return;}
+    for(p=1; (p<points-1) && (N > Np[p]); p++);
+    w = log(N/Np[p-1])/log(Np[p]/Np[p-1]);
+    *s_N = (1.0 - w)*s[p-1] + w*s[p];
+    *c_N = (1.0 - w)*c[p-1] + w*c[p];
+}
+
+float Cost_predict(const char *path, const char *method, long dimX, long dimY, long dimZ, int iterations, int threads)
+{
+    FILE *f;
+    char line[4096], name[COST_NAME], *rest;
+    double Np[COST_POINTS], s[COST_POINTS], c[COST_POINTS], fraction, N, s_N, c_N, T = -1.0;
+    int ndim, timed, points, p, n;
+
+    f = fopen(path, "r");
+    if (f == NULL) return -1.0f;
+    if (threads <= 0) threads = omp_get_max_threads();
+    N = (double)(dimX)*(double)(dimY)*(double)(dimZ);
+    while (fgets(line, sizeof(line), f) != NULL) {
+        if ((line[0] == '#') || (sscanf(line, "%31s %d %lf %d %d%n", name, &ndim, &fraction, &timed, &points, &n) != 5)) continue;
+        if ((strcmp(name, method) != 0) || (ndim != ((dimZ > 1) ? 3 : 2)) || (points < 1) || (points > COST_POINTS)) continue;
+        rest = line + n;
+        for(p=0; p<points; p++) {
+            if (sscanf(rest, "%lf %lf %lf%n", &Np[p], &s[p], &c[p], &n) != 3) break;
+            rest += n;
+        }
+        if (p < points) continue;
+        Cost_at(N, points, Np, s, c, &s_N, &c_N);
+        T = N*(s_N + (double)(iterations)*c_N)*((1.0 - fraction) + fraction/(double)(threads));
+        break;
+    }
+    fclose(f);
+    return (float)(T);
+}
+
+int Cost_threads(int threads)
+{
+    int previous = omp_get_max_threads();
+    if (threads > 0) omp_set_num_threads(threads);
+    return previous;
+}
@@ -0,0 +1,58 @@
+/*
+This work is part of the Core Imaging Library developed by
+Visual Analytics and Imaging System Group of the Science Technology
+Facilities Council, STFC
+
+Copyright 2017 Daniil Kazantsev
+Copyright 2017 Srikanth Nagella, Edoardo Pasca
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "omp.h"
+#include "CCPiDefines.h"
+
+/* Calibrated runtime model of the regularisers (wall time of one call on this machine)
+ *
+ *   T = N*(s(N) + iterations*c(N))*((1 - f) + f/threads)
+ *
+ * N - voxels, s and c - the set-up seconds per voxel and the seconds per voxel and iteration of
+ * one thread, measured at a few sizes and interpolated linearly in log(N) between them (held
+ * constant outside, so sizes above the largest calibrated one take its out-of-cache costs), f -
+ * the parallel fraction of Amdahl's law fitted from the timings with one and with all threads
+ * (1 when calibrated on a single thread).
+ *
+ * The calibration file is text, one line per regulariser and dimensionality ('#' starts a
+ * comment line):
+ *   name ndim f threads points N_1 s_1 c_1 ... N_points s_points c_points
+ * with threads the largest thread count timed. It is written by the Python calibration
+ * (calibrate_cost_model), which times the cores with a fixed number of iterations.
+ *
+ * Cost_predict returns the predicted seconds (threads <= 0 - the OpenMP thread count), -1 when
+ * the file cannot be read or has no line for the regulariser and dimensionality (dimZ > 1 - 3D).
+ * Cost_threads sets the OpenMP thread count of the following parallel regions of the calling
+ * thread (<= 0 - only query) and returns the previous one. */
+
+#define COST_POINTS 16
+#define COST_NAME 32
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+CCPI_EXPORT float Cost_predict(const char *path, const char *method, long dimX, long dimY, long dimZ, int iterations, int threads);
+CCPI_EXPORT int Cost_threads(int threads);
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,275 @@
+/*
+ * This work is part of the Core Imaging Library developed by
+ * Visual Analytics and Imaging System Group of the Science Technology
+ * Facilities Council, STFC
+ *
+ * Copyright 2017 Daniil Kazantsev
+ * Copyright 2017 Srikanth Nagella, Edoardo Pasca
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "multigrid.h"
+
+typedef struct {
+    long nx, ny, nz;
+    float wx, wy, wz;             /* weights of the second differences along X, Y, Z (0 - one cell) */
+    float *u, *f, *r, *c;         /* solution, right-hand side, residual, coefficients (NULL - c0) */
+} mg_level;
+
+struct MG {
+    int levels;
+    float c0;
+    mg_level *l;
+};
+
+/* neighbours with the symmetric boundary conditions of the cores, a dimension of one cell has none */
+#define MG_NB(i, n, ip, im) do { if ((n) == 1) {ip = i; im = i;} \
+    else {ip = ((i)+1 == (n)) ? (i)-1 : (i)+1; im = ((i) == 0) ? 1 : (i)-1;} } while (0)
+
+/* the next coarser size of a dimension */
+#define MG_HALF(n) (((n) + 1)/2)
+
+/* red-black Gauss-Seidel sweeps, the cells of one colour only depend on the other colour */
+static void MG_smooth(mg_level *L, float c0, int sweeps)
+{
+    long i, j, k, ip, im, jp, jm, kp, km, index, nx = L->nx, ny = L->ny, nz = L->nz, row;
+    int s, colour;
+    float c, diag, sum;
+
+    for(s=0; s<sweeps; s++) {
+        for(colour=0; colour<2; colour++) {
+#pragma omp parallel for shared(L) private(row, i, j, k, ip, im, jp, jm, kp, km, index, c, diag, sum)
+            for(row=0; row<ny*nz; row++) {
+                j = row % ny; k = row / ny;
+                MG_NB(j, ny, jp, jm);
+                MG_NB(k, nz, kp, km);
+                for(i=(colour + j + k) & 1; i<nx; i+=2) {
+                    MG_NB(i, nx, ip, im);
+                    index = (k*ny + j)*nx + i;
+                    c = (L->c != NULL) ? L->c[index] : c0;
+                    diag = c + 2.0f*(L->wx + L->wy + L->wz);
+                    if (diag == 0.0f) continue;
+                    sum = L->f[index] + L->wx*(L->u[(k*ny + j)*nx + ip] + L->u[(k*ny + j)*nx + im]) +
+                          L->wy*(L->u[(k*ny + jp)*nx + i] + L->u[(k*ny + jm)*nx + i]) +
+                          L->wz*(L->u[(kp*ny + j)*nx + i] + L->u[(km*ny + j)*nx + i]);
+                    L->u[index] = sum/diag;
+                }
+            }
+        }
+    }
+}
+
+/* r = f - A u, returns the squared norm of r */
+static float MG_residual(mg_level *L, float c0)
+{
+    long i, j, k, ip, im, jp, jm, kp, km, index, nx = L->nx, ny = L->ny, nz = L->nz, row;
+    float c, u, r, norm = 0.0f;
+
+#pragma omp parallel for shared(L) private(row, i, j, k, ip, im, jp, jm, kp, km, index, c, u, r) reduction(+:norm)
+    for(row=0; row<ny*nz; row++) {
+        j = row % ny; k = row / ny;
+        MG_NB(j, ny, jp, jm);
+        MG_NB(k, nz, kp, km);
+        for(i=0; i<nx; i++) {
+            MG_NB(i, nx, ip, im);
+            index = (k*ny + j)*nx + i;
+            c = (L->c != NULL) ? L->c[index] : c0;
+            u = L->u[index];
+            r = L->f[index] - c*u - L->wx*(2.0f*u - L->u[(k*ny + j)*nx + ip] - L->u[(k*ny + j)*nx + im]) -
+                L->wy*(2.0f*u - L->u[(k*ny + jp)*nx + i] - L->u[(k*ny + jm)*nx + i]) -
+                L->wz*(2.0f*u - L->u[(kp*ny + j)*nx + i] - L->u[(km*ny + j)*nx + i]);
+            L->r[index] = r;
+            norm += r*r;
+        }
+    }
+    return norm;
+}
+
+/* first and last fine cell of coarse cell I along a dimension */
+#define MG_CHILDREN(I, n, nc, i0, i1) do { if ((nc) == (n)) {i0 = I; i1 = I;} \
+    else {i0 = 2*(I); i1 = (2*(I)+1 < (n)) ? 2*(I)+1 : 2*(I);} } while (0)
+
+/* average of the (up to 8) fine cells of each coarse cell, A coarse from A fine */
+static void MG_average(const float *A, float *Ac, const mg_level *L, const mg_level *C)
+{
+    long I, J, K, i, j, k, i0, i1, j0, j1, k0, k1, row;
+    float sum;
+
+#pragma omp parallel for shared(A, Ac, L, C) private(row, I, J, K, i, j, k, i0, i1, j0, j1, k0, k1, sum)
+    for(row=0; row<C->ny*C->nz; row++) {
+        J = row % C->ny; K = row / C->ny;
+        MG_CHILDREN(J, L->ny, C->ny, j0, j1);
+        MG_CHILDREN(K, L->nz, C->nz, k0, k1);
+        for(I=0; I<C->nx; I++) {
+            MG_CHILDREN(I, L->nx, C->nx, i0, i1);
+            sum = 0.0f;
+            for(k=k0; k<=k1; k++)
+                for(j=j0; j<=j1; j++)
+                    for(i=i0; i<=i1; i++) sum += A[(k*L->ny + j)*L->nx + i];
+            Ac[(K*C->ny + J)*C->nx + I] = sum/(float)((i1-i0+1)*(j1-j0+1)*(k1-k0+1));
+        }
+    }
+}
+
+/* coarse cell and neighbour with the linear interpolation weight of the coarse cell (cell centred) */
+#define MG_PARENT(i, n, nc, I0, I1, w) do { if ((nc) == (n)) {I0 = i; I1 = i; w = 1.0f;} \
+    else {I0 = (i)>>1; I1 = ((i) & 1) ? I0+1 : I0-1; w = 0.75f; if ((I1 < 0) || (I1 >= (nc))) {I1 = I0; w = 1.0f;}} } while (0)
+
+/* u fine += P u coarse */
+static void MG_prolong(const mg_level *C, mg_level *L)
+{
+    long i, j, k, row, I0, I1, J0, J1, K0, K1;
+    float wi, wj, wk;
+    const float *e = C->u;
+
+#pragma omp parallel for shared(C, L, e) private(row, i, j, k, I0, I1, J0, J1, K0, K1, wi, wj, wk)
+    for(row=0; row<L->ny*L->nz; row++) {
+        j = row % L->ny; k = row / L->ny;
+        MG_PARENT(j, L->ny, C->ny, J0, J1, wj);
+        MG_PARENT(k, L->nz, C->nz, K0, K1, wk);
+        for(i=0; i<L->nx; i++) {
+            MG_PARENT(i, L->nx, C->nx, I0, I1, wi);
+            L->u[(k*L->ny + j)*L->nx + i] +=
+                wk*(wj*(wi*e[(K0*C->ny + J0)*C->nx + I0] + (1.0f-wi)*e[(K0*C->ny + J0)*C->nx + I1]) +
+                    (1.0f-wj)*(wi*e[(K0*C->ny + J1)*C->nx + I0] + (1.0f-wi)*e[(K0*C->ny + J1)*C->nx + I1])) +
+                (1.0f-wk)*(wj*(wi*e[(K1*C->ny + J0)*C->nx + I0] + (1.0f-wi)*e[(K1*C->ny + J0)*C->nx + I1]) +
+                    (1.0f-wj)*(wi*e[(K1*C->ny + J1)*C->nx + I0] + (1.0f-wi)*e[(K1*C->ny + J1)*C->nx + I1]));
+        }
+    }
+}
+
+static void MG_vcycle(MG *mg, int l)
+{
+    mg_level *L = &mg->l[l], *C;
+    long n;
+    if (l == mg->levels-1) {
+        MG_smooth(L, mg->c0, MG_COARSE);
+        return;
+    }
+    C = &mg->l[l+1];
+    MG_smooth(L, mg->c0, MG_PRE);
+    MG_residual(L, mg->c0);
+    MG_average(L->r, C->f, L, C);
+    n = C->nx*C->ny*C->nz;
+    memset(C->u, 0, n*sizeof(float));
+    MG_vcycle(mg, l+1);
+    MG_prolong(C, L);
+    MG_smooth(L, mg->c0, MG_POST);
+}
+
+/* sizes of the next coarser level, 0 when L is the coarsest */
+static int MG_coarsen(const mg_level *L, mg_level *C)
+{
+    if ((L->nx <= 2) && (L->ny <= 2) && (L->nz <= 2)) return 0;
+    C->nx = MG_HALF(L->nx); C->ny = MG_HALF(L->ny); C->nz = MG_HALF(L->nz);
+    /* the grid spacing doubles along the coarsened dimensions */
+    C->wx = (C->nx == 1) ? 0.0f : ((C->nx < L->nx) ? 0.25f*L->wx : L->wx);
+    C->wy = (C->ny == 1) ? 0.0f : ((C->ny < L->ny) ? 0.25f*L->wy : L->wy);
+    C->wz = (C->nz == 1) ? 0.0f : ((C->nz < L->nz) ? 0.25f*L->wz : L->wz);
+    return 1;
+}
+
+static void MG_finest(mg_level *L, float lambda, long dimX, long dimY, long dimZ)
+{
+    L->nx = dimX; L->ny = dimY; L->nz = (dimZ < 1) ? 1 : dimZ;
+    L->wx = (L->nx == 1) ? 0.0f : lambda;
+    L->wy = (L->ny == 1) ? 0.0f : lambda;
+    L->wz = (L->nz == 1) ? 0.0f : lambda;
+}
+
+MG *MG_create(float *C, float c0, float lambda, long dimX, long dimY, long dimZ)
+{
+    MG *mg;
+    mg_level L, Lc;
+    int l;
+    long n;
+
+    mg = (MG*) calloc(1, sizeof(MG));
+    mg->c0 = c0;
+    MG_finest(&L, lambda, dimX, dimY, dimZ);
+    mg->levels = 1;
+    while (MG_coarsen(&L, &Lc)) {mg->levels++; L = Lc;}
+    mg->l = (mg_level*) calloc(mg->levels, sizeof(mg_level));
+
+    MG_finest(&mg->l[0], lambda, dimX, dimY, dimZ);
+    mg->l[0].c = C;
+    mg->l[0].r = Vol_calloc(mg->l[0].nx*mg->l[0].ny*mg->l[0].nz);
+    for(l=1; l<mg->levels; l++) {
+        MG_coarsen(&mg->l[l-1], &mg->l[l]);
+        n = mg->l[l].nx*mg->l[l].ny*mg->l[l].nz;
+        mg->l[l].u = Vol_calloc(n);
+        mg->l[l].f = Vol_calloc(n);
+        mg->l[l].r = Vol_calloc(n);
+        if (C != NULL) {
+            mg->l[l].c = Vol_calloc(n);
+            MG_average(mg->l[l-1].c, mg->l[l].c, &mg->l[l-1], &mg->l[l]);
+        }
+    }
+    return mg;
+}
+
+float MG_solve(MG *mg, float *U, float *F, int cycles, float tol, float *info)
+{
+    long j, n;
+    int cycle;
+    float fnorm = 0.0f, re = 0.0f;
+    mg_level *L = &mg->l[0];
+
+    L->u = U; L->f = F;
+    n = L->nx*L->ny*L->nz;
+#pragma omp parallel for shared(F) private(j) reduction(+:fnorm)
+    for(j=0; j<n; j++) fnorm += F[j]*F[j];
+    fnorm = (fnorm > 0.0f) ? sqrtf(fnorm) : 1.0f;
+
+    for(cycle=0; cycle<cycles; cycle++) {
+        MG_vcycle(mg, 0);
+        if (tol != 0.0f) {
+            re = sqrtf(MG_residual(L, mg->c0))/fnorm;
+            if (re < tol) {cycle++; break;}
+        }
+        /* the cycles of a solve inside another core (info NULL) are not reported */
+        if ((info != NULL) && Progress_step(cycle+1, re)) {cycle++; break;}
+    }
+    if (info != NULL) {
+        if (tol == 0.0f) re = sqrtf(MG_residual(L, mg->c0))/fnorm;
+        info[0] = (float)(cycle);
+        info[1] = re;
+    }
+    return re;
+}
+
+void MG_free(MG *mg)
+{
+    int l;
+    if (mg == NULL) return;
+    Vol_free(mg->l[0].r);
+    for(l=1; l<mg->levels; l++) {
+        Vol_free(mg->l[l].u); Vol_free(mg->l[l].f); Vol_free(mg->l[l].r);
+        Vol_free(mg->l[l].c);
+    }
+    free(mg->l);
+    free(mg);
+}
+
+/* Peak size in bytes of the levels allocated by MG_create (coefficients - a C array is given) */
+long MG_mem(int coefficients, long dimX, long dimY, long dimZ)
+{
+    mg_level L, Lc;
+    long bytes;
+    MG_finest(&L, 1.0f, dimX, dimY, dimZ);
+    bytes = L.nx*L.ny*L.nz*sizeof(float);
+    while (MG_coarsen(&L, &Lc)) {
+        bytes += (3l + (coefficients != 0))*Lc.nx*Lc.ny*Lc.nz*sizeof(float);
+        L = Lc;
+    }
+    return bytes;
+}
@@ -0,0 +1,59 @@
+/*
+This work is part of the Core Imaging Library developed by
+Visual Analytics and Imaging System Group of the Science Technology
+Facilities Council, STFC
+
+Copyright 2017 Daniil Kazantsev
+Copyright 2017 Srikanth Nagella, Edoardo Pasca
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <math.h>
+#include <stdlib.h>
+#include "omp.h"
+#include "utils.h"
+#include "CCPiDefines.h"
+
+/* Geometric multigrid solver of the linear (elliptic) subproblems of the cores (2D/3D)
+ *
+ *   C(x)*u - lambda*Laplacian(u) = F
+ *
+ * with the symmetric (Neumann) boundary conditions of the cores, C - per-voxel coefficients
+ * (NULL - the constant c0), e.g. the fidelity weights of a spatially varying lambda or a mask.
+ *
+ * Every level halves each dimension longer than one cell (cell-centred coarsening), the
+ * coefficients are averaged and lambda is scaled for the coarse grid spacing. A V-cycle smooths
+ * with red-black Gauss-Seidel sweeps (MG_PRE before and MG_POST after the coarse grid correction,
+ * MG_COARSE on the coarsest grid of at most 2 cells per dimension), restricts the residual by
+ * averaging and prolongates the correction (bi/trilinear). A V-cycle costs O(N) and reduces the
+ * residual by a factor independent of the grid size. All kernels are OpenMP loops.
+ *
+ * MG_create builds the levels once for an operator, MG_solve runs V-cycles on U (the initial
+ * guess, overwritten by the solution) until 'cycles' are done or the residual relative to F is
+ * below tol (0 - all cycles); info (or NULL) receives [cycles done, relative residual]. */
+
+#define MG_PRE 2
+#define MG_POST 2
+#define MG_COARSE 50
+
+typedef struct MG MG;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+CCPI_EXPORT MG *MG_create(float *C, float c0, float lambda, long dimX, long dimY, long dimZ);
+CCPI_EXPORT float MG_solve(MG *mg, float *U, float *F, int cycles, float tol, float *info);
+CCPI_EXPORT void MG_free(MG *mg);
+CCPI_EXPORT long MG_mem(int coefficients, long dimX, long dimY, long dimZ);
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,180 @@
+/*
+ * This work is part of the Core Imaging Library developed by
+ * Visual Analytics and Imaging System Group of the Science Technology
+ * Facilities Council, STFC
+ *
+ * Copyright 2017 Daniil Kazantsev
+ * Copyright 2017 Srikanth Nagella, Edoardo Pasca
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "pipeline.h"
+
+/* pointwise stages are fused with their pointwise neighbours */
+static int Pipe_pointwise(int method)
+{
+    return (method == PIPE_CLAMP) || (method == PIPE_SCALE);
+}
+
+/* a run of pointwise stages as the operations of an output pass (Output_bind), none if the run
+ * is longer than a pass holds */
+static void Pipe_output_ops(output_pass *pass, int nstages, int *methods, float *params)
+{
+    int s;
+    if (nstages > OUTPUT_OPS) return;
+    for(s=0; s<nstages; s++) {
+        pass->ops[s] = (methods[s] == PIPE_CLAMP) ? OUTPUT_CLAMP : OUTPUT_SCALE;
+        pass->params[2*s] = params[s*PIPE_PARAMS];
+        pass->params[2*s+1] = params[s*PIPE_PARAMS+1];
+    }
+    pass->nops = nstages;
+}
+
+/* bytes of the work arrays of a solver stage */
+static long Pipe_stage_mem(int method, float *p, int dimX, int dimY, int dimZ)
+{
+    switch (method) {
+    case PIPE_ROF: return TV_ROF_CPU_mem(p[2], LAYOUT_PLANAR, dimX, dimY, dimZ);
+    case PIPE_FGP: return TV_FGP_CPU_mem(p[1], LAYOUT_PLANAR, dimX, dimY, dimZ);
+    case PIPE_PD: return PDTV_CPU_mem(LAYOUT_PLANAR, dimX, dimY, dimZ);
+    case PIPE_NDF: return Diffusion_CPU_mem(p[4], LAYOUT_PLANAR, dimX, dimY, dimZ);
+    case PIPE_DIFF4TH: return Diffus4th_CPU_mem(p[3], (int)(p[4]), LAYOUT_PLANAR, dimX, dimY, dimZ);
+    case PIPE_LLT: return LLT_ROF_CPU_mem(p[3], (int)(p[4]), dimX, dimY, dimZ);
+    case PIPE_TGV: return TGV_mem(dimX, dimY, dimZ);
+    }
+    return 0l;
+}
+
+static float Pipe_stage_run(int method, int iterations, float *p, float *Input, float *Output, float *infovector, int dimX, int dimY, int dimZ)
+{
+    switch (method) {
+    case PIPE_ROF: return TV_ROF_CPU_main(Input, Output, infovector, p, 0, iterations, p[1], p[2], LAYOUT_PLANAR, dimX, dimY, dimZ);
+    case PIPE_FGP: return TV_FGP_CPU_main(Input, Output, infovector, p[0], iterations, p[1], (int)(p[2]), (int)(p[3]), LAYOUT_PLANAR, dimX, dimY, dimZ);
+    case PIPE_PD: return PDTV_CPU_main(Input, Output, infovector, p[0], iterations, p[1], p[2], (int)(p[3]), (int)(p[4]), (int)(p[5]), LAYOUT_PLANAR, dimX, dimY, dimZ);
+    case PIPE_NDF: return Diffusion_CPU_main(Input, Output, infovector, p[0], p[1], iterations, p[2], (int)(p[3]), p[4], LAYOUT_PLANAR, dimX, dimY, dimZ);
+    case PIPE_DIFF4TH: return Diffus4th_CPU_main(Input, Output, infovector, p[0], p[1], iterations, p[2], p[3], (int)(p[4]), LAYOUT_PLANAR, dimX, dimY, dimZ);
+    case PIPE_LLT: return LLT_ROF_CPU_main(Input, Output, infovector, p[0], p[1], iterations, p[2], p[3], (int)(p[4]), dimX, dimY, dimZ);
+    case PIPE_TGV: return TGV_main_ckpt(Input, Output, infovector, p[0], p[1], p[2], iterations, p[3], p[4], (int)(p[5]), dimX, dimY, dimZ, NULL, 0, 0);
+    }
+    return 0;
+}
+
+float Pipeline_run(float *Input, float *Output, float *infovector, float *energy, int nstages, int *methods, int *iterations, float *params, int dimX, int dimY, int dimZ)
+{
+    long DimTotal, need, m, info[4];
+    int s, e, k, solvers, done, own;
+    float *T = NULL, *src, *dst;
+    double joules = -1.0;
+    output_pass pass, *outer;
+
+    DimTotal = (long)(dimX)*(long)(dimY)*(long)(dimZ);
+    solvers = 0;
+    need = 0l;
+    for(s=0; s<nstages; s++) {
+        if (Pipe_pointwise(methods[s])) continue;
+        solvers++;
+        m = Pipe_stage_mem(methods[s], params + s*PIPE_PARAMS, dimX, dimY, dimZ);
+        if (m > need) need = m;
+    }
+    /* the scratch array of the ping-pong, needed for two solvers or a pointwise run before the
+     * first solver; it lives across the stages and is not part of the workspace */
+    if ((solvers > 1) || ((solvers == 1) && Pipe_pointwise(methods[0]))) T = Vol_calloc(DimTotal);
+    /* a few WS_ALIGN for the rounding of the chunks */
+    own = (need > 0l) && (Vol_workspace(need + 32l*WS_ALIGN) > 0l);
+    Vol_workspace_info(info);
+
+    /* an output pass bound by the caller is not for the outputs of the stages, its statistics
+     * are taken by the last solver */
+    outer = Output_bind(NULL);
+    src = Input;
+    done = 0;
+    for(s=0; s<nstages; s=e) {
+        if (energy != NULL) joules = Energy_read();
+        if (Pipe_pointwise(methods[s])) {
+            /* a leading run, into the array the first solver does not write */
+            for(e=s; (e<nstages) && Pipe_pointwise(methods[e]); e++) {infovector[2*e] = 1.0f; infovector[2*e+1] = 0.0f;}
+            dst = ((solvers == 0) || ((solvers - 1) % 2 == 1)) ? Output : T;
+            Pipeline_pointwise(src, dst, e - s, methods + s, params + s*PIPE_PARAMS, DimTotal);
+        }
+        else {
+            /* the run of pointwise stages after a solver is applied by its last update (ROF, FGP,
+             * PD and NDF), in place after it otherwise */
+            for(e=s+1; (e<nstages) && Pipe_pointwise(methods[e]); e++) {infovector[2*e] = 1.0f; infovector[2*e+1] = 0.0f;}
+            dst = ((solvers - 1 - done) % 2 == 0) ? Output : T;
+            Output_init(&pass, DimTotal);
+            Pipe_output_ops(&pass, e - s - 1, methods + s + 1, params + (s + 1)*PIPE_PARAMS);
+            if ((e == nstages) && (pass.nops == e - s - 1) && (outer != NULL) && (outer->stats != NULL) && (outer->nops == 0) && !outer->taken && (outer->DimTotal == DimTotal)) {
+                pass.stats = outer->stats; pass.hist = outer->hist; pass.nbins = outer->nbins;
+                pass.lo = outer->lo; pass.hi = outer->hi;
+            }
+            if ((pass.nops > 0) || (pass.stats != NULL)) Output_bind(&pass);
+            Pipe_stage_run(methods[s], iterations[s], params + s*PIPE_PARAMS, src, dst, infovector + 2*s, dimX, dimY, dimZ);
+            Output_bind(NULL);
+            if ((e > s + 1) && !pass.applied) Pipeline_pointwise(dst, dst, e - s - 1, methods + s + 1, params + (s + 1)*PIPE_PARAMS, DimTotal);
+            if ((pass.stats != NULL) && pass.applied) {outer->taken = 1; outer->applied = 1;}
+            done++;
+        }
+        /* a run of pointwise stages is measured with the solver before it, a leading one on its
+         * first stage */
+        if (energy != NULL) {
+            energy[s] = (joules < 0.0) ? -1.0f : (float)(Energy_read() - joules);
+            for(k=s+1; k<e; k++) energy[k] = (joules < 0.0) ? -1.0f : 0.0f;
+        }
+        src = dst;
+    }
+    if (src == Input) copyIm(Input, Output, (long)(dimX), (long)(dimY), (long)(dimZ));
+
+    Vol_workspace_info(info);
+    infovector[2*nstages] = (float)(info[0]);
+    infovector[2*nstages+1] = (float)(info[3]);
+    if (own) Vol_workspace(0l);
+    if (T != NULL) Vol_free(T);
+    Output_bind(outer);
+    return 0;
+}
+
+/* Peak size in bytes of the arrays allocated by Pipeline_run: the scratch array and the workspace */
+long Pipeline_mem(int nstages, int *methods, float *params, int dimX, int dimY, int dimZ)
+{
+    long DimTotal, need, m;
+    int s, solvers;
+    DimTotal = (long)(dimX)*(long)(dimY)*(long)(dimZ);
+    solvers = 0;
+    need = 0l;
+    for(s=0; s<nstages; s++) {
+        if (Pipe_pointwise(methods[s])) continue;
+        solvers++;
+        m = Pipe_stage_mem(methods[s], params + s*PIPE_PARAMS, dimX, dimY, dimZ);
+        if (m > need) need = m;
+    }
+    if (need > 0l) need = (need + 33l*WS_ALIGN - 1l) & ~(WS_ALIGN - 1l);
+    if ((solvers > 1) || ((solvers == 1) && Pipe_pointwise(methods[0]))) need += DimTotal*(long)sizeof(float);
+    return need;
+}
+
+/* One pass of a run of pointwise stages from Input to Output (may be the same array) */
+float Pipeline_pointwise(float *Input, float *Output, int nstages, int *methods, float *params, long DimTotal)
+{
+    long j;
+    int s;
+    float v;
+#pragma omp parallel for shared(Input, Output, methods, params) private(j, s, v)
+    for(j=0; j<DimTotal; j++) {
+        v = Input[j];
+        for(s=0; s<nstages; s++) {
+            if (methods[s] == PIPE_CLAMP) v = fminf(fmaxf(v, params[s*PIPE_PARAMS]), params[s*PIPE_PARAMS+1]);
+            else v = params[s*PIPE_PARAMS]*v + params[s*PIPE_PARAMS+1];
+        }
+        Output[j] = v;
+    }
+    return 1;
+}
@@ -0,0 +1,81 @@
+/*
+This work is part of the Core Imaging Library developed by
+Visual Analytics and Imaging System Group of the Science Technology
+Facilities Council, STFC
+
+Copyright 2017 Daniil Kazantsev
+Copyright 2017 Srikanth Nagella, Edoardo Pasca
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <math.h>
+#include <stdlib.h>
+#include "omp.h"
+#include "utils.h"
+#include "CCPiDefines.h"
+#include "ROF_TV_core.h"
+#include "FGP_TV_core.h"
+#include "PD_TV_core.h"
+#include "Diffusion_core.h"
+#include "Diffus4th_order_core.h"
+#include "LLT_ROF_core.h"
+#include "TGV_core.h"
+
+/* Chained regularisers: the stages run one after the other on one image/volume, each on the
+ * output of the previous one
+ *
+ * The outputs ping-pong between Output and one scratch array, the order chosen so that the last
+ * solver writes Output. The work arrays of all stages are taken from one workspace
+ * (Vol_workspace) sized for the largest stage, so a stage reuses the memory the previous one
+ * released instead of allocating and faulting in its own. A run of pointwise stages (CLAMP, SCALE)
+ * after a solver is applied by the last update of the solver to the rows it writes (the output
+ * pass of Output_bind, ROF, FGP and PD); after the other solvers, when their iterations stop early
+ * and before the first solver the run is one separate pass.
+ *
+ * Stage s is methods[s] with iterations[s] and the parameters params[s*PIPE_PARAMS + ...]:
+ *   PIPE_ROF      lambda, tau, epsil
+ *   PIPE_FGP      lambda, epsil, methodTV, nonneg
+ *   PIPE_PD       lambda, epsil, lipschitz_const, methodTV, nonneg, algorithm
+ *   PIPE_NDF      lambda, sigma, tau, penaltytype, epsil
+ *   PIPE_DIFF4TH  lambda, sigma, tau, epsil, scheme
+ *   PIPE_LLT      lambdaROF, lambdaLLT, tau, epsil, algorithm
+ *   PIPE_TGV      lambda, alpha1, alpha0, L2, epsil, algorithm
+ *   PIPE_CLAMP    lo, hi (+-inf - no bound)
+ *   PIPE_SCALE    a, b: U = a*U + b
+ *
+ * Output:
+ * [1] Filtered/regularised image/volume
+ * [2] Information vector: [iteration no., reached tolerance] of every stage (pointwise stages
+ *     [1, 0]), then the size of the workspace and the number of work arrays which did not fit
+ * [3] energy (when not NULL): the joules of every stage from Energy_read, -1 when they cannot be
+ *     read; pointwise stages count on the solver before them (0 on their own) */
+
+#define PIPE_ROF 0
+#define PIPE_FGP 1
+#define PIPE_PD 2
+#define PIPE_NDF 3
+#define PIPE_DIFF4TH 4
+#define PIPE_LLT 5
+#define PIPE_TGV 6
+#define PIPE_CLAMP 7
+#define PIPE_SCALE 8
+#define PIPE_PARAMS 8
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+CCPI_EXPORT float Pipeline_run(float *Input, float *Output, float *infovector, float *energy, int nstages, int *methods, int *iterations, float *params, int dimX, int dimY, int dimZ);
+CCPI_EXPORT long Pipeline_mem(int nstages, int *methods, float *params, int dimX, int dimY, int dimZ);
+CCPI_EXPORT float Pipeline_pointwise(float *Input, float *Output, int nstages, int *methods, float *params, long DimTotal);
+#ifdef __cplusplus
+}
+#endif
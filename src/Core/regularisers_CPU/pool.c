@@ -0,0 +1,276 @@
+/*
+ * This work is part of the Core Imaging Library developed by
+ * Visual Analytics and Imaging System Group of the Science Technology
+ * Facilities Council, STFC
+ *
+ * Copyright 2017 Daniil Kazantsev
+ * Copyright 2017 Srikanth Nagella, Edoardo Pasca
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "pool.h"
+
+/* OpenMP split of the rows, used when the pool is not running */
+static void Run_rows_omp(long rows, Pool_body body, void *arg)
+{
+#pragma omp parallel
+    {
+        long nthr = omp_get_num_threads(), t = omp_get_thread_num();
+        long start = rows*t/nthr, end = rows*(t+1)/nthr;
+        if (start < end) body(arg, start, end);
+    }
+}
+
+/* Runs body over rows [0, rows) from all threads of an enclosing parallel region, every thread
+ * takes a static share of the rows and the call ends with a barrier like an omp for. A single
+ * thread (the region was not forked since the pool is running, or is nested) starts the rows
+ * with Run_rows instead. */
+void Run_rows_team(long rows, Pool_body body, void *arg)
+{
+    long nthr = omp_get_num_threads(), t = omp_get_thread_num();
+    long start = rows*t/nthr, end = rows*(t+1)/nthr;
+    if (nthr == 1) {Run_rows(rows, body, arg); return;}
+    if (start < end) body(arg, start, end);
+#pragma omp barrier
+}
+
+#if defined(_MSC_VER)
+/* no pthreads, the kernels always run on OpenMP */
+int Pool_start(int threads) { return 0; }
+void Pool_stop(void) { }
+int Pool_threads(void) { return 0; }
+void Run_rows(long rows, Pool_body body, void *arg) { Run_rows_omp(rows, body, arg); }
+#else
+#include <pthread.h>
+
+typedef struct pool_job {
+    long pending;                 /* tasks of the call not finished yet */
+    pthread_mutex_t m;
+    pthread_cond_t done;
+} pool_job;
+
+typedef struct {
+    Pool_body body;
+    void *arg;
+    long start, end;
+    pool_job *job;
+} pool_task;
+
+/* the owner pushes and pops at the tail, thieves take from the head */
+typedef struct {
+    pthread_mutex_t m;
+    pool_task *t;
+    long head, tail, cap;
+} pool_deque;
+
+static int pool_n = 0;
+static pthread_t *pool_thr = NULL;
+static pool_deque *pool_dq = NULL;
+static pthread_mutex_t pool_m = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_cv = PTHREAD_COND_INITIALIZER;
+static long pool_queued = 0;      /* tasks waiting in all deques */
+static long pool_next = 0;        /* deque receiving the first task of the next call */
+static int pool_quit = 0;
+static long pool_users = 0;       /* Run_rows calls in flight on the pool */
+static int pool_closing = 0;      /* Pool_stop waits for them, new calls go to OpenMP */
+static pthread_cond_t pool_idle = PTHREAD_COND_INITIALIZER;
+static pthread_mutex_t pool_admin = PTHREAD_MUTEX_INITIALIZER;   /* one Pool_start/Pool_stop at a time */
+
+static void Deque_push(pool_deque *d, pool_task *task)
+{
+    pthread_mutex_lock(&d->m);
+    if (d->tail - d->head == d->cap) {
+        long n = d->tail - d->head, c;
+        pool_task *t = (pool_task*) malloc(2*d->cap*sizeof(pool_task));
+        for (c = 0; c < n; c++) t[c] = d->t[(d->head + c) % d->cap];
+        free(d->t);
+        d->t = t; d->head = 0; d->tail = n; d->cap *= 2;
+    }
+    d->t[d->tail % d->cap] = *task;
+    d->tail++;
+    pthread_mutex_unlock(&d->m);
+}
+
+static int Deque_take(pool_deque *d, pool_task *task, int steal)
+{
+    int found = 0;
+    pthread_mutex_lock(&d->m);
+    if (d->tail > d->head) {
+        if (steal) {*task = d->t[d->head % d->cap]; d->head++;}
+        else {d->tail--; *task = d->t[d->tail % d->cap];}
+        found = 1;
+    }
+    pthread_mutex_unlock(&d->m);
+    return found;
+}
+
+/* own deque first (self < 0 for a calling thread), then steal from the others */
+static int Pool_take(int self, pool_task *task)
+{
+    int v, found = 0;
+    if (self >= 0) found = Deque_take(&pool_dq[self], task, 0);
+    for (v = 1; (v <= pool_n) && !found; v++)
+        found = Deque_take(&pool_dq[(self + v + pool_n) % pool_n], task, 1);
+    if (found) {
+        pthread_mutex_lock(&pool_m);
+        pool_queued--;
+        pthread_mutex_unlock(&pool_m);
+    }
+    return found;
+}
+
+static void Pool_run(pool_task *task)
+{
+    task->body(task->arg, task->start, task->end);
+    pthread_mutex_lock(&task->job->m);
+    if (--task->job->pending == 0) pthread_cond_signal(&task->job->done);
+    pthread_mutex_unlock(&task->job->m);
+}
+
+static void *Pool_worker(void *self)
+{
+    pool_task task;
+    int w = (int)(long)self;
+    for (;;) {
+        if (Pool_take(w, &task)) {Pool_run(&task); continue;}
+        pthread_mutex_lock(&pool_m);
+        while ((pool_queued == 0) && !pool_quit) pthread_cond_wait(&pool_cv, &pool_m);
+        if ((pool_queued == 0) && pool_quit) {pthread_mutex_unlock(&pool_m); break;}
+        pthread_mutex_unlock(&pool_m);
+    }
+    return NULL;
+}
+
+/* Stops a running pool once the Run_rows calls in flight on it are done, pool_admin held */
+static void Pool_close(void)
+{
+    int w;
+    if (pool_n == 0) return;
+    pthread_mutex_lock(&pool_m);
+    pool_closing = 1;
+    while (pool_users > 0) pthread_cond_wait(&pool_idle, &pool_m);
+    pool_quit = 1;
+    pthread_cond_broadcast(&pool_cv);
+    pthread_mutex_unlock(&pool_m);
+    for (w = 0; w < pool_n; w++) pthread_join(pool_thr[w], NULL);
+    for (w = 0; w < pool_n; w++) {free(pool_dq[w].t); pthread_mutex_destroy(&pool_dq[w].m);}
+    free(pool_dq); free(pool_thr);
+    pool_dq = NULL; pool_thr = NULL;
+    pthread_mutex_lock(&pool_m);
+    pool_n = 0;
+    pool_closing = 0;
+    pthread_mutex_unlock(&pool_m);
+}
+
+/* Starts the pool with the given number of workers (0 - the OpenMP thread count), a running
+ * pool is restarted. May be called while regularisers are running, see Pool_stop. Returns the
+ * workers. */
+int Pool_start(int threads)
+{
+    long w;
+    pthread_mutex_lock(&pool_admin);
+    Pool_close();
+    if (threads <= 0) threads = omp_get_max_threads();
+    pool_dq = (pool_deque*) calloc(threads, sizeof(pool_deque));
+    pool_thr = (pthread_t*) calloc(threads, sizeof(pthread_t));
+    for (w = 0; w < threads; w++) {
+        pthread_mutex_init(&pool_dq[w].m, NULL);
+        pool_dq[w].cap = 64;
+        pool_dq[w].t = (pool_task*) malloc(pool_dq[w].cap*sizeof(pool_task));
+    }
+    pool_quit = 0;
+    pthread_mutex_lock(&pool_m);
+    pool_n = threads;
+    pthread_mutex_unlock(&pool_m);
+    for (w = 0; w < threads; w++) pthread_create(&pool_thr[w], NULL, Pool_worker, (void*)w);
+    pthread_mutex_unlock(&pool_admin);
+    return threads;
+}
+
+/* Stops the pool, the kernels return to OpenMP. The kernels in flight on the pool (of
+ * regularisers running on other threads) are finished first, the following ones run on OpenMP. */
+void Pool_stop(void)
+{
+    pthread_mutex_lock(&pool_admin);
+    Pool_close();
+    pthread_mutex_unlock(&pool_admin);
+}
+
+int Pool_threads(void)
+{
+    int n;
+    pthread_mutex_lock(&pool_m);
+    n = pool_closing ? 0 : pool_n;
+    pthread_mutex_unlock(&pool_m);
+    return n;
+}
+
+/* Runs body over rows [0, rows), on the pool when it is running and on OpenMP otherwise */
+void Run_rows(long rows, Pool_body body, void *arg)
+{
+    pool_job job;
+    pool_task task, other;
+    long ntasks, first = 0, t, n;
+
+    if (rows <= 0) return;
+    /* the pool is not stopped while this call uses it */
+    pthread_mutex_lock(&pool_m);
+    n = pool_closing ? 0 : pool_n;
+    if (n > 0) {
+        pool_users++;
+        first = pool_next;
+        pool_next = (pool_next + 1) % n;
+    }
+    pthread_mutex_unlock(&pool_m);
+    if (n == 0) {Run_rows_omp(rows, body, arg); return;}
+
+    /* a few tasks per worker so that stealing can balance the load */
+    ntasks = 4l*n;
+    if (ntasks > rows) ntasks = rows;
+    job.pending = ntasks;
+    pthread_mutex_init(&job.m, NULL);
+    pthread_cond_init(&job.done, NULL);
+
+    pthread_mutex_lock(&pool_m);
+    pool_queued += ntasks;
+    pthread_mutex_unlock(&pool_m);
+    task.body = body; task.arg = arg; task.job = &job;
+    for (t = 0; t < ntasks; t++) {
+        task.start = rows*t/ntasks;
+        task.end = rows*(t+1)/ntasks;
+        Deque_push(&pool_dq[(first + t) % n], &task);
+    }
+    pthread_mutex_lock(&pool_m);
+    pthread_cond_broadcast(&pool_cv);
+    pthread_mutex_unlock(&pool_m);
+
+    /* the calling thread works on queued tasks while its own are pending */
+    for (;;) {
+        pthread_mutex_lock(&job.m);
+        t = job.pending;
+        pthread_mutex_unlock(&job.m);
+        if (t == 0) break;
+        if (Pool_take(-1, &other)) Pool_run(&other);
+        else {
+            pthread_mutex_lock(&job.m);
+            while (job.pending > 0) pthread_cond_wait(&job.done, &job.m);
+            pthread_mutex_unlock(&job.m);
+            break;
+        }
+    }
+    pthread_mutex_destroy(&job.m);
+    pthread_cond_destroy(&job.done);
+    pthread_mutex_lock(&pool_m);
+    if (--pool_users == 0) pthread_cond_broadcast(&pool_idle);
+    pthread_mutex_unlock(&pool_m);
+}
+#endif
@@ -0,0 +1,47 @@
+/*
+This work is part of the Core Imaging Library developed by
+Visual Analytics and Imaging System Group of the Science Technology
+Facilities Council, STFC
+
+Copyright 2017 Daniil Kazantsev
+Copyright 2017 Srikanth Nagella, Edoardo Pasca
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <stdlib.h>
+#include "omp.h"
+#include "CCPiDefines.h"
+
+/* Library-wide work-stealing thread pool shared by concurrent regulariser calls.
+ *
+ * A kernel is written as a body over a range of rows (slices in 3D) and started with Run_rows.
+ * When the pool is running the rows are cut into tasks which are spread over the deques of the
+ * workers; a worker takes tasks from its own deque and steals from the others when it is empty,
+ * the calling thread helps until its own tasks are done. Calls made concurrently from several
+ * threads therefore share the pool threads instead of each starting an OpenMP team.
+ * When the pool is not running (default) Run_rows splits the rows over an OpenMP team.
+ * The solvers which keep their iteration loop in one parallel region start the kernels with
+ * Run_rows_team; the region is only forked when the pool is not running. */
+
+typedef void (*Pool_body)(void *arg, long start, long end);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+CCPI_EXPORT int Pool_start(int threads);
+CCPI_EXPORT void Pool_stop(void);
+CCPI_EXPORT int Pool_threads(void);
+CCPI_EXPORT void Run_rows(long rows, Pool_body body, void *arg);
+CCPI_EXPORT void Run_rows_team(long rows, Pool_body body, void *arg);
+#ifdef __cplusplus
+}
+#endif
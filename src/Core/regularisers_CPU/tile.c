@@ -0,0 +1,136 @@
+/*
+ * This work is part of the Core Imaging Library developed by
+ * Visual Analytics and Imaging System Group of the Science Technology
+ * Facilities Council, STFC
+ *
+ * Copyright 2017 Daniil Kazantsev
+ * Copyright 2017 Srikanth Nagella, Edoardo Pasca
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tile.h"
+
+/* tile edge and sync in use (0 - defaults), returns the halo width */
+static long Tile_halo(int radius, int *tile, int *sync, float accuracy)
+{
+    long H;
+    if (*tile <= 0) *tile = TILE_SIZE;
+    if (*sync <= 0) *sync = TILE_SYNC;
+    if (accuracy < 0.0f) accuracy = 0.0f;
+    if (accuracy > 1.0f) accuracy = 1.0f;
+    for(;;) {
+        H = (long)ceilf(accuracy*(float)(radius*(*sync) + 1));
+        if ((H <= *tile) || (*sync == 1)) break;
+        (*sync)--;
+    }
+    if (H > *tile) H = *tile;
+    return H;
+}
+
+float Tile_run(Tile_body body, void *arg, int nstate, int nwork, int radius, float *Input, float **State, int iterations, int tile, int sync, float accuracy, long dimX, long dimY)
+{
+    long T, H, ntx, nty, ntiles, wmax, hsize, vsize, bsize;
+    float *Bands = NULL;
+
+    H = Tile_halo(radius, &tile, &sync, accuracy);
+    T = (long)(tile);
+    ntx = (dimX + T - 1)/T;
+    nty = (dimY + T - 1)/T;
+    ntiles = ntx*nty;
+    /* the bands of a state array: 2H rows along every horizontal boundary, then 2H columns
+     * along every vertical boundary */
+    hsize = 2*H*dimX;
+    vsize = 2*H*dimY;
+    bsize = (nty-1)*hsize + (ntx-1)*vsize;
+    if (bsize > 0) Bands = Vol_calloc(nstate*bsize);
+    wmax = (T + 2*H)*(T + 2*H);
+
+#pragma omp parallel shared(Bands, State, Input)
+    {
+        float *buf, *A, *S[TILE_ARRAYS], *W[TILE_ARRAYS], *row;
+        long t, tx, ty, y, c, q, l, r, ix0, iy0, inx, iny, wx0, wy0, wx1, wy1, nx, ny;
+        int it, s;
+
+        buf = (float*) calloc(wmax*(1 + nstate + nwork), sizeof(float));
+        A = buf;
+        for(q=0; q<nstate; q++) S[q] = buf + (1 + q)*wmax;
+        for(q=0; q<nwork; q++) W[q] = buf + (1 + nstate + q)*wmax;
+
+        for(it=0; it<iterations; it+=s) {
+            s = (iterations - it < sync) ? (iterations - it) : sync;
+
+            /* the state near the tile boundaries before the sweep */
+            if (Bands != NULL) {
+#pragma omp for
+                for(l=0; l<nstate*(nty-1)*2*H; l++) {
+                    q = l/((nty-1)*2*H); r = l - q*(nty-1)*2*H;
+                    y = (r/(2*H) + 1)*T - H + r%(2*H);
+                    if (y < dimY) memcpy(Bands + q*bsize + (r/(2*H))*hsize + (r%(2*H))*dimX, State[q] + y*dimX, dimX*sizeof(float));
+                }
+#pragma omp for
+                for(l=0; l<nstate*(ntx-1)*dimY; l++) {
+                    q = l/((ntx-1)*dimY); r = l - q*(ntx-1)*dimY;
+                    c = (r/dimY + 1)*T - H;
+                    y = r%dimY;
+                    memcpy(Bands + q*bsize + (nty-1)*hsize + (r/dimY)*vsize + y*2*H, State[q] + y*dimX + c, ((dimX - c < 2*H) ? (dimX - c) : 2*H)*sizeof(float));
+                }
+            }
+
+#pragma omp for schedule(dynamic)
+            for(t=0; t<ntiles; t++) {
+                ty = t/ntx; tx = t - ty*ntx;
+                ix0 = tx*T; inx = (dimX - ix0 < T) ? (dimX - ix0) : T;
+                iy0 = ty*T; iny = (dimY - iy0 < T) ? (dimY - iy0) : T;
+                wx0 = (ix0 - H > 0) ? (ix0 - H) : 0; wx1 = (ix0 + inx + H < dimX) ? (ix0 + inx + H) : dimX;
+                wy0 = (iy0 - H > 0) ? (iy0 - H) : 0; wy1 = (iy0 + iny + H < dimY) ? (iy0 + iny + H) : dimY;
+                nx = wx1 - wx0; ny = wy1 - wy0;
+
+                for(y=wy0; y<wy1; y++) memcpy(A + (y-wy0)*nx, Input + y*dimX + wx0, nx*sizeof(float));
+                for(q=0; q<nstate; q++) {
+                    for(y=wy0; y<wy1; y++) {
+                        row = S[q] + (y-wy0)*nx;
+                        if (y < iy0) memcpy(row, Bands + q*bsize + (ty-1)*hsize + (y - iy0 + H)*dimX + wx0, nx*sizeof(float));
+                        else if (y >= iy0 + iny) memcpy(row, Bands + q*bsize + ty*hsize + (y - iy0 - iny + H)*dimX + wx0, nx*sizeof(float));
+                        else {
+                            if (wx0 < ix0) memcpy(row, Bands + q*bsize + (nty-1)*hsize + (tx-1)*vsize + y*2*H, (ix0 - wx0)*sizeof(float));
+                            memcpy(row + (ix0 - wx0), State[q] + y*dimX + ix0, inx*sizeof(float));
+                            if (wx1 > ix0 + inx) memcpy(row + (ix0 + inx - wx0), Bands + q*bsize + (nty-1)*hsize + tx*vsize + y*2*H + H, (wx1 - ix0 - inx)*sizeof(float));
+                        }
+                    }
+                }
+
+#pragma omp parallel num_threads(1)
+                body(arg, A, S, W, nx, ny, it, s);
+
+                for(q=0; q<nstate; q++) {
+                    for(y=iy0; y<iy0+iny; y++) memcpy(State[q] + y*dimX + ix0, S[q] + (y-wy0)*nx + (ix0 - wx0), inx*sizeof(float));
+                }
+            }
+        }
+        free(buf);
+    }
+    if (Bands != NULL) Vol_free(Bands);
+    return 0;
+}
+
+/* Peak size in bytes of the work arrays allocated by Tile_run: the bands and the tile buffers
+ * of every thread */
+long Tile_mem(int nstate, int nwork, int radius, int tile, int sync, float accuracy, long dimX, long dimY)
+{
+    long T, H, ntx, nty;
+    H = Tile_halo(radius, &tile, &sync, accuracy);
+    T = (long)(tile);
+    ntx = (dimX + T - 1)/T;
+    nty = (dimY + T - 1)/T;
+    return (nstate*((nty-1)*2*H*dimX + (ntx-1)*2*H*dimY) +
+            omp_get_max_threads()*(T + 2*H)*(T + 2*H)*(1l + nstate + nwork))*(long)sizeof(float);
+}
@@ -0,0 +1,62 @@
+/*
+This work is part of the Core Imaging Library developed by
+Visual Analytics and Imaging System Group of the Science Technology
+Facilities Council, STFC
+
+Copyright 2017 Daniil Kazantsev
+Copyright 2017 Srikanth Nagella, Edoardo Pasca
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "omp.h"
+#include "utils.h"
+#include "CCPiDefines.h"
+
+/* Tiled execution of the 2D iterations for images much larger than the caches
+ *
+ * The image is cut into tiles of tile x tile pixels which the threads take in turn. A tile is
+ * copied with a halo of neighbouring pixels into buffers of the thread (the input, the state
+ * arrays and the work arrays of the solver), 'sync' iterations run on the buffers while they
+ * stay in the cache and the tile without its halo is copied back: block Jacobi with halo
+ * synchronisation every 'sync' iterations. The work arrays exist for a tile only, of the
+ * full-size arrays only the state carried from one iteration to the next is kept.
+ *
+ * A tile reads the state of its neighbours as it was before the sweep from bands holding the
+ * pixels within the halo width of the tile boundaries, so the tiles are updated in place.
+ *
+ * An iteration changes the pixels within 'radius' of a wrong value, the boundary conditions
+ * at the artificial edge of the halo are wrong from the first iteration on. accuracy 1 gives a
+ * halo of radius*sync + 1 pixels: the result is that of the untiled solver. Smaller values
+ * narrow the halo in proportion (0 - none), the error at the tile boundaries grows. The halo
+ * is kept within one tile by lowering sync when needed.
+ *
+ * The body runs 'iterations' iterations, the first of them with number it0, on the nx x ny
+ * buffers A (input), S (state) and W (work) of one tile; it runs in a parallel region of one
+ * thread, so the work-shared kernels of the solvers can be called. */
+
+#define TILE_SIZE 256
+#define TILE_SYNC 8
+#define TILE_ARRAYS 8
+
+typedef void (*Tile_body)(void *arg, float *A, float **S, float **W, long nx, long ny, int it0, int iterations);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+CCPI_EXPORT float Tile_run(Tile_body body, void *arg, int nstate, int nwork, int radius, float *Input, float **State, int iterations, int tile, int sync, float accuracy, long dimX, long dimY);
+CCPI_EXPORT long Tile_mem(int nstate, int nwork, int radius, int tile, int sync, float accuracy, long dimX, long dimY);
+#ifdef __cplusplus
+}
+#endif
@@ -18,14 +18,78 @@
  */
 
 #include "utils.h"
+#include "vec_math.h"
+#include "pool.h"
 #include <math.h>
+#include <stdio.h>
+#include <string.h>
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+/* huge-page path of Vol_calloc: the bytes requested through it since the previous query and its
+ * huge_live arrays in use (the advised range of each, huge_slots entries allocated), under the
+ * ccpi_huge critical section */
+typedef struct {
+    char *base;
+    long bytes;
+} huge_range;
+static int huge_enabled = 1;
+static long huge_requested = 0l;
+static huge_range *huge_arrays = NULL;
+static long huge_live = 0l;
+static long huge_slots = 0l;
+
+/* arrays of at least stream_bytes are written with streaming stores (0 - off, -1 - not set yet) */
+static long stream_bytes = -1l;
+
+/* the workspace of Vol_workspace, bound to the thread that set it: ws_top bytes of it are handed
+ * out in ws_live chunks */
+static THREAD_LOCAL char *ws_base = NULL;
+static THREAD_LOCAL long ws_size = 0l;
+static THREAD_LOCAL long ws_top = 0l;
+static THREAD_LOCAL long ws_live = 0l;
+static THREAD_LOCAL long ws_peak = 0l;
+static THREAD_LOCAL long ws_served = 0l;
+static THREAD_LOCAL long ws_missed = 0l;
+static THREAD_LOCAL int ws_release = 0;
+
+static float *Workspace_chunk(long DimTotal);
+
+/* the progress record bound by the thread running a core */
+static THREAD_LOCAL volatile float *progress_record = NULL;
+
+/* the output pass bound by the thread running a core, the one of Output_stats_bind */
+static THREAD_LOCAL output_pass *output_bound = NULL;
+static THREAD_LOCAL output_pass stats_pass;
 
 /* Copy Image (float) */
 float copyIm(float *A, float *U, long dimX, long dimY, long dimZ)
 {
-    long j;
+    long j, DimTotal;
+    DimTotal = dimX*dimY*dimZ;
+#if defined(__SSE2__) || defined(_M_X64)
+    if (Vol_stream(DimTotal)) {
+        /* the copy is not read again soon (Output_prev, P_prev, the initial output): the aligned
+         * part of U is written in 16-byte streaming stores, the head and the tail are plain stores */
+        long head, blocks;
+        head = ((16l - (long)((size_t)U & 15))/(long)sizeof(float)) & 3l;
+        if (head > DimTotal) head = DimTotal;
+        blocks = (DimTotal - head)/4;
+        for (j = 0; j<head; j++)  U[j] = A[j];
+        for (j = head + 4*blocks; j<DimTotal; j++)  U[j] = A[j];
+#pragma omp parallel shared(A, U) private(j)
+        {
+#pragma omp for
+            for (j = 0; j<blocks; j++)  _mm_stream_ps(U + head + 4*j, _mm_loadu_ps(A + head + 4*j));
+            _mm_sfence();
+        }
+        return *U;
+    }
+#endif
 #pragma omp parallel for shared(A, U) private(j)
-    for (j = 0; j<dimX*dimY*dimZ; j++)  U[j] = A[j];
+    for (j = 0; j<DimTotal; j++)  U[j] = A[j];
     return *U;
 }
 
@@ -75,10 +139,10 @@ float TV_energy2D(float *U, float *U0, float *E_val, float lambda, int type, int
             j1 = j + 1; if (j == dimY-1) j1 = j;
 
             /* Forward differences */
-            NOMx_2 = powf((float)(U[j1*dimX + i] - U[index]),2); /* x+ */
-            NOMy_2 = powf((float)(U[j*dimX + i1] - U[index]),2); /* y+ */
+            NOMx_2 = POW2((float)(U[j1*dimX + i] - U[index])); /* x+ */
+            NOMy_2 = POW2((float)(U[j*dimX + i1] - U[index])); /* y+ */
             E_Grad += 2.0f*lambda*sqrtf((float)(NOMx_2) + (float)(NOMy_2)); /* gradient term energy */
-            E_Data += powf((float)(U[index]-U0[index]),2); /* fidelity term energy */
+            E_Data += POW2((float)(U[index]-U0[index])); /* fidelity term energy */
         }
     }
     if (type == 1) E_val[0] = E_Grad + E_Data;
@@ -102,12 +166,12 @@ float TV_energy3D(float *U, float *U0, float *E_val, float lambda, int type, int
                 k1 = k + 1; if (k == (long)(dimZ-1)) k1 = k;
 
                 /* Forward differences */
-                NOMx_2 = powf((float)(U[(dimX*dimY)*k + j1*dimX+i] - U[index]),2); /* x+ */
-                NOMy_2 = powf((float)(U[(dimX*dimY)*k + j*dimX+i1] - U[index]),2); /* y+ */
-                NOMz_2 = powf((float)(U[(dimX*dimY)*k1 + j*dimX+i] - U[index]),2); /* z+ */
+                NOMx_2 = POW2((float)(U[(dimX*dimY)*k + j1*dimX+i] - U[index])); /* x+ */
+                NOMy_2 = POW2((float)(U[(dimX*dimY)*k + j*dimX+i1] - U[index])); /* y+ */
+                NOMz_2 = POW2((float)(U[(dimX*dimY)*k1 + j*dimX+i] - U[index])); /* z+ */
 
                 E_Grad += 2.0f*lambda*sqrtf((float)(NOMx_2) + (float)(NOMy_2) + (float)(NOMz_2)); /* gradient term energy */
-                E_Data += (powf((float)(U[index]-U0[index]),2)); /* fidelity term energy */
+                E_Data += (POW2((float)(U[index]-U0[index]))); /* fidelity term energy */
             }
         }
     }
@@ -145,69 +209,895 @@ float Im_scale2D(float *Input, float *Scaled, int w, int h, int w2, int h2)
     return *Scaled;
 }
 
-/*2D Projection onto convex set for P (called in PD_TV, FGP_dTV and FGP_TV methods)*/
-float Proj_func2D(float *P1, float *P2, int methTV, long DimTotal)
+/* The projections onto the convex set for P (PD_TV, FGP_dTV and FGP_TV) are bodies over the
+ * elements, started by Run_rows or from a parallel region by Run_rows_team (pool.h) */
+typedef struct {
+    float *P1, *P2, *P3;
+    int methTV;
+} proj_args;
+
+static void Proj_rows(void *arg, long r0, long r1)
 {
-    float val1, val2, denom, sq_denom;
+    proj_args *a = (proj_args*)arg;
+    float *P1 = a->P1, *P2 = a->P2, *P3 = a->P3;
+    float val1, val2, val3, denom, sq_denom;
     long i;
-    if (methTV == 0) {
-        /* isotropic TV*/
-#pragma omp parallel for shared(P1,P2) private(i,denom,sq_denom)
-        for(i=0; i<DimTotal; i++) {
-            denom = powf(P1[i],2) +  powf(P2[i],2);
-            if (denom > 1.0f) {
-                sq_denom = 1.0f/sqrtf(denom);
-                P1[i] = P1[i]*sq_denom;
-                P2[i] = P2[i]*sq_denom;
+    if (P3 == NULL) {
+        if (a->methTV == 0) {
+            /* isotropic TV*/
+            for(i=r0; i<r1; i++) {
+                denom = POW2(P1[i]) +  POW2(P2[i]);
+                if (denom > 1.0f) {
+                    sq_denom = 1.0f/sqrtf(denom);
+                    P1[i] = P1[i]*sq_denom;
+                    P2[i] = P2[i]*sq_denom;
+                }
+            }
+        }
+        else {
+            /* anisotropic TV*/
+            for(i=r0; i<r1; i++) {
+                val1 = fabs(P1[i]);
+                val2 = fabs(P2[i]);
+                if (val1 < 1.0f) {val1 = 1.0f;}
+                if (val2 < 1.0f) {val2 = 1.0f;}
+                P1[i] = P1[i]/val1;
+                P2[i] = P2[i]/val2;
             }
         }
     }
     else {
-        /* anisotropic TV*/
-#pragma omp parallel for shared(P1,P2) private(i,val1,val2)
-        for(i=0; i<DimTotal; i++) {
-            val1 = fabs(P1[i]);
-            val2 = fabs(P2[i]);
-            if (val1 < 1.0f) {val1 = 1.0f;}
-            if (val2 < 1.0f) {val2 = 1.0f;}
-            P1[i] = P1[i]/val1;
-            P2[i] = P2[i]/val2;
+        if (a->methTV == 0) {
+            /* isotropic TV*/
+            for(i=r0; i<r1; i++) {
+                denom = POW2(P1[i]) + POW2(P2[i]) + POW2(P3[i]);
+                if (denom > 1.0f) {
+                    sq_denom = 1.0f/sqrtf(denom);
+                    P1[i] = P1[i]*sq_denom;
+                    P2[i] = P2[i]*sq_denom;
+                    P3[i] = P3[i]*sq_denom;
+                }
+            }
+        }
+        else {
+            /* anisotropic TV*/
+            for(i=r0; i<r1; i++) {
+                val1 = fabs(P1[i]);
+                val2 = fabs(P2[i]);
+                val3 = fabs(P3[i]);
+                if (val1 < 1.0f) {val1 = 1.0f;}
+                if (val2 < 1.0f) {val2 = 1.0f;}
+                if (val3 < 1.0f) {val3 = 1.0f;}
+                P1[i] = P1[i]/val1;
+                P2[i] = P2[i]/val2;
+                P3[i] = P3[i]/val3;
+            }
         }
     }
+}
+
+/* copy and clamping at zero over the elements */
+typedef struct {
+    float *A, *U;
+} copy_args;
+
+static void Copy_rows(void *arg, long r0, long r1)
+{
+    copy_args *a = (copy_args*)arg;
+    if (r1 > r0) memcpy(a->U + r0, a->A + r0, (r1 - r0)*sizeof(float));
+}
+
+static void Nonneg_rows(void *arg, long r0, long r1)
+{
+    float *A = ((copy_args*)arg)->A;
+    long j;
+    for(j=r0; j<r1; j++) {if (A[j] < 0.0f) A[j] = 0.0f;}
+}
+
+/*2D Projection onto convex set for P (called in PD_TV, FGP_dTV and FGP_TV methods)*/
+float Proj_func2D(float *P1, float *P2, int methTV, long DimTotal)
+{
+    proj_args a = {P1, P2, NULL, methTV};
+    Run_rows(DimTotal, Proj_rows, &a);
+    return 1;
+}
+/* Work-shared variants of copyIm, Proj_func2D/3D and the nonnegativity constraint, to be called
+ * by all threads of an enclosing parallel region (the persistent region of the 2D FGP, PD and TGV
+ * solvers and of the lockstep FGP solver) or by a single thread */
+float copyIm_ws(float *A, float *U, long DimTotal)
+{
+    copy_args a = {A, U};
+    Run_rows_team(DimTotal, Copy_rows, &a);
+    return 1;
+}
+float Nonneg_ws(float *A, long DimTotal)
+{
+    copy_args a = {A, NULL};
+    Run_rows_team(DimTotal, Nonneg_rows, &a);
+    return 1;
+}
+float Proj_func2D_ws(float *P1, float *P2, int methTV, long DimTotal)
+{
+    proj_args a = {P1, P2, NULL, methTV};
+    Run_rows_team(DimTotal, Proj_rows, &a);
+    return 1;
+}
+float Proj_func3D_ws(float *P1, float *P2, float *P3, int methTV, long DimTotal)
+{
+    proj_args a = {P1, P2, P3, methTV};
+    Run_rows_team(DimTotal, Proj_rows, &a);
     return 1;
 }
 /*3D Projection onto convex set for P (called in PD_TV, FGP_TV, FGP_dTV methods)*/
 float Proj_func3D(float *P1, float *P2, float *P3, int methTV, long DimTotal)
+{
+    proj_args a = {P1, P2, P3, methTV};
+    Run_rows(DimTotal, Proj_rows, &a);
+    return 1;
+}
+/*3D Projection onto convex set for the interleaved P = (P1,P2,P3) field (LAYOUT_INTERLEAVED of PD_TV, FGP_TV, FGP_dTV)*/
+float Proj_func3D_il(float *P, int methTV, long DimTotal)
 {
     float val1, val2, val3, denom, sq_denom;
     long i;
     if (methTV == 0) {
         /* isotropic TV*/
-#pragma omp parallel for shared(P1,P2,P3) private(i,val1,val2,val3,sq_denom)
+#pragma omp parallel for shared(P) private(i,denom,sq_denom)
         for(i=0; i<DimTotal; i++) {
-            denom = powf(P1[i],2) + powf(P2[i],2) + powf(P3[i],2);
+            denom = P[3*i]*P[3*i] + P[3*i+1]*P[3*i+1] + P[3*i+2]*P[3*i+2];
             if (denom > 1.0f) {
                 sq_denom = 1.0f/sqrtf(denom);
-                P1[i] = P1[i]*sq_denom;
-                P2[i] = P2[i]*sq_denom;
-                P3[i] = P3[i]*sq_denom;
+                P[3*i] = P[3*i]*sq_denom;
+                P[3*i+1] = P[3*i+1]*sq_denom;
+                P[3*i+2] = P[3*i+2]*sq_denom;
             }
         }
     }
     else {
         /* anisotropic TV*/
-#pragma omp parallel for shared(P1,P2,P3) private(i,val1,val2,val3)
+#pragma omp parallel for shared(P) private(i,val1,val2,val3)
         for(i=0; i<DimTotal; i++) {
-            val1 = fabs(P1[i]);
-            val2 = fabs(P2[i]);
-            val3 = fabs(P3[i]);
+            val1 = fabs(P[3*i]);
+            val2 = fabs(P[3*i+1]);
+            val3 = fabs(P[3*i+2]);
             if (val1 < 1.0f) {val1 = 1.0f;}
             if (val2 < 1.0f) {val2 = 1.0f;}
             if (val3 < 1.0f) {val3 = 1.0f;}
-            P1[i] = P1[i]/val1;
-            P2[i] = P2[i]/val2;
-            P3[i] = P3[i]/val3;
+            P[3*i] = P[3*i]/val1;
+            P[3*i+1] = P[3*i+1]/val2;
+            P[3*i+2] = P[3*i+2]/val3;
         }
     }
     return 1;
 }
+
+/* steps of the accelerated primal-dual scheme (Algorithm 2 of Chambolle and Pock, 2011) for a
+ * fidelity strongly convex with gamma: returns theta, tau and sigma are updated in place */
+float PD_steps(float gamma, float *tau, float *sigma)
+{
+    float theta;
+    theta = 1.0f/sqrtf(1.0f + 2.0f*gamma*(*tau));
+    *tau = theta*(*tau);
+    *sigma = (*sigma)/theta;
+    return theta;
+}
+
+/* number of floats needed to keep a dimX x dimY x dimZ volume in LAYOUT_BRICKED (padding included) */
+long Bricked_size(long dimX, long dimY, long dimZ)
+{
+    return ((dimX+BRICK-1)/BRICK)*((dimY+BRICK-1)/BRICK)*((dimZ+BRICK-1)/BRICK)*(long)(BRICK*BRICK*BRICK);
+}
+
+/* Copy of the strided view S into the planar volume A1 and, if A2 is not NULL, also into A2
+ * (e.g. input and initial output in one sweep); A1 may be NULL too */
+float Strided_to_planar(float *S, long pitchY, long pitchZ, float *A1, float *A2, long dimX, long dimY, long dimZ)
+{
+    long j, k, r, index;
+#pragma omp parallel for shared(S, A1, A2) private(j, k, r, index)
+    for(r=0; r<dimY*dimZ; r++) {
+        k = r/dimY; j = r - k*dimY;
+        index = r*dimX;
+        if (A1 != NULL) memcpy(A1 + index, S + k*pitchZ + j*pitchY, dimX*sizeof(float));
+        if (A2 != NULL) memcpy(A2 + index, S + k*pitchZ + j*pitchY, dimX*sizeof(float));
+    }
+    return 1;
+}
+
+/* Copy of the planar volume A into the strided view S */
+float Planar_to_strided(float *A, float *S, long pitchY, long pitchZ, long dimX, long dimY, long dimZ)
+{
+    long j, k, r;
+#pragma omp parallel for shared(S, A) private(j, k, r)
+    for(r=0; r<dimY*dimZ; r++) {
+        k = r/dimY; j = r - k*dimY;
+        memcpy(S + k*pitchZ + j*pitchY, A + r*dimX, dimX*sizeof(float));
+    }
+    return 1;
+}
+
+/* Conversion of the planar volume A into bricks, the bricked copy is written into B1 and,
+ * if B2 is not NULL, also into B2 (e.g. input and initial output in one sweep). The padding is zeroed. */
+float Planar_to_bricked(float *A, float *B1, float *B2, long dimX, long dimY, long dimZ)
+{
+    long i, j, k, nbX, nbY, DimBricked, index;
+    nbX = (dimX+BRICK-1)/BRICK;
+    nbY = (dimY+BRICK-1)/BRICK;
+    DimBricked = Bricked_size(dimX, dimY, dimZ);
+
+    if ((dimX % BRICK) || (dimY % BRICK) || (dimZ % BRICK)) {
+        memset(B1, 0, DimBricked*sizeof(float));
+        if (B2 != NULL) memset(B2, 0, DimBricked*sizeof(float));
+    }
+#pragma omp parallel for shared(A, B1, B2) private(i, j, k, index)
+    for(k=0; k<dimZ; k++) {
+        for(j=0; j<dimY; j++) {
+            for(i=0; i<dimX; i++) {
+                index = BIDX(i,j,k,nbX,nbY);
+                B1[index] = A[(dimX*dimY)*k + j*dimX + i];
+                if (B2 != NULL) B2[index] = B1[index];
+            }}}
+    return 1;
+}
+
+/* Conversion of the bricked volume B back into the planar volume A */
+float Bricked_to_planar(float *B, float *A, long dimX, long dimY, long dimZ)
+{
+    long i, j, k, nbX, nbY;
+    nbX = (dimX+BRICK-1)/BRICK;
+    nbY = (dimY+BRICK-1)/BRICK;
+#pragma omp parallel for shared(A, B) private(i, j, k)
+    for(k=0; k<dimZ; k++) {
+        for(j=0; j<dimY; j++) {
+            for(i=0; i<dimX; i++) {
+                A[(dimX*dimY)*k + j*dimX + i] = B[BIDX(i,j,k,nbX,nbY)];
+            }}}
+    return *A;
+}
+
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+/* an array of bytes on the huge-page path is counted, its advised part recorded for
+ * Vol_huge_pages_info */
+static void Huge_register(void *A, long bytes)
+{
+    huge_range *R;
+#pragma omp critical (ccpi_huge)
+    {
+        huge_requested += bytes;
+        if (huge_live == huge_slots) {
+            R = (huge_range*) realloc(huge_arrays, (2l*huge_slots + 16l)*sizeof(huge_range));
+            if (R != NULL) {huge_arrays = R; huge_slots = 2l*huge_slots + 16l;}
+        }
+        if (huge_live < huge_slots) {
+            huge_arrays[huge_live].base = (char*)A;
+            huge_arrays[huge_live].bytes = bytes & ~(HUGE_PAGE-1l);
+            huge_live++;
+        }
+    }
+}
+
+/* Bytes of the huge-page path arrays in use backed by huge pages: one pass over /proc/self/smaps,
+ * the AnonHugePages of every mapping counted up to the advised bytes of the arrays it holds, so
+ * other memory of the process is not counted. -1 if the kernel does not report it; called in the
+ * ccpi_huge critical section */
+static long Huge_backed(void)
+{
+    FILE *fp;
+    char line[512];
+    unsigned long start, end;
+    long q, lo, hi, overlap = 0l, kb, backed = -1l;
+    fp = fopen("/proc/self/smaps", "r");
+    if (fp == NULL) return -1l;
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        /* the rest of a long mapping line (its path) */
+        if (strchr(line, '\n') == NULL) {int c; while (((c = fgetc(fp)) != '\n') && (c != EOF)); }
+        if (sscanf(line, "%lx-%lx ", &start, &end) == 2) {
+            overlap = 0l;
+            for(q=0; q<huge_live; q++) {
+                lo = ((long)start > (long)huge_arrays[q].base) ? (long)start : (long)huge_arrays[q].base;
+                hi = ((long)end < (long)huge_arrays[q].base + huge_arrays[q].bytes) ? (long)end : (long)huge_arrays[q].base + huge_arrays[q].bytes;
+                if (hi > lo) overlap += hi - lo;
+            }
+        }
+        else if (sscanf(line, "AnonHugePages: %ld kB", &kb) == 1) {
+            if (backed < 0l) backed = 0l;
+            backed += (kb*1024l < overlap) ? kb*1024l : overlap;
+        }
+    }
+    fclose(fp);
+    return backed;
+}
+#endif
+
+/* every array of Vol_calloc (not a workspace chunk) has this header in the WS_ALIGN bytes before
+ * it: the block to release and whether it took the huge-page path, so ordinary frees go straight
+ * to free() without the ccpi_huge critical section */
+typedef struct {
+    char *base;
+    int huge;
+} vol_header;
+#define VOL_HEADER(A) ((vol_header*)((char*)(A) - WS_ALIGN))
+
+/* frees an array of Vol_calloc which is not a workspace chunk, dropping it from the huge-page path */
+static void Vol_release(void *A)
+{
+    long q;
+    char *base;
+    if (A == NULL) return;
+    base = VOL_HEADER(A)->base;
+    if (VOL_HEADER(A)->huge) {
+#pragma omp critical (ccpi_huge)
+        {
+            for(q=0; q<huge_live; q++) {
+                if (huge_arrays[q].base == base) {huge_arrays[q] = huge_arrays[--huge_live]; break;}
+            }
+        }
+    }
+    free(base);
+}
+
+/* Zero-initialised work array of DimTotal floats, released with Vol_free().
+ * While a workspace is set (Vol_workspace) the array is a chunk of it if it fits.
+ * On Linux arrays of at least HUGE_PAGE bytes start WS_ALIGN bytes (the vol_header) into a 2 MB
+ * aligned block advised with MADV_HUGEPAGE before it is touched, so that the kernel can back them
+ * with transparent huge pages. Otherwise (other platforms, small arrays, path switched off or
+ * failing) it is plain calloc. */
+float *Vol_calloc(long DimTotal)
+{
+    if (ws_base != NULL) {
+        float *W = Workspace_chunk(DimTotal);
+        if (W != NULL) return W;
+    }
+    char *A = NULL;
+    long bytes;
+    bytes = DimTotal*(long)sizeof(float);
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    long j;
+    void *H = NULL;
+    if ((huge_enabled == 1) && (bytes >= HUGE_PAGE) && (posix_memalign(&H, HUGE_PAGE, bytes + WS_ALIGN) == 0)) {
+        A = (char*)H + WS_ALIGN;
+        /* only the whole huge pages are advised, the tail stays in small pages */
+        madvise(H, bytes & ~(HUGE_PAGE-1l), MADV_HUGEPAGE);
+        /* first touch in parallel, the same way the cores later traverse the array */
+        if (Vol_stream(DimTotal)) {
+#pragma omp parallel shared(A) private(j)
+            {
+#pragma omp for
+                for(j=0; j<DimTotal; j++) STREAM_STORE((float*)A + j, 0.0f);
+                Stream_fence();
+            }
+        }
+        else {
+#pragma omp parallel for shared(A) private(j)
+            for(j=0; j<DimTotal; j++) ((float*)A)[j] = 0.0f;
+        }
+        Huge_register(H, bytes);
+        VOL_HEADER(A)->base = (char*)H;
+        VOL_HEADER(A)->huge = 1;
+        return (float*)A;
+    }
+#endif
+    A = (char*)calloc(bytes + WS_ALIGN, 1);
+    if (A == NULL) return NULL;
+    VOL_HEADER(A + WS_ALIGN)->base = A;
+    VOL_HEADER(A + WS_ALIGN)->huge = 0;
+    return (float*)(A + WS_ALIGN);
+}
+
+/* Releases an array of Vol_calloc: a chunk of the workspace goes back to it, the whole workspace
+ * is free again when its last chunk is returned; other arrays (and NULL) go to free() */
+void Vol_free(float *A)
+{
+    if ((ws_base != NULL) && ((char*)A >= ws_base) && ((char*)A < ws_base + ws_size)) {
+        ws_live--;
+        if (ws_live == 0l) {
+            ws_top = 0l;
+            /* released while the chunk was in use */
+            if (ws_release == 1) {
+                Vol_release(ws_base);
+                ws_base = NULL; ws_size = 0l; ws_release = 0;
+            }
+        }
+        return;
+    }
+    Vol_release(A);
+}
+
+/* Sets a workspace of bytes (rounded up to WS_ALIGN) the work arrays of the following calls of
+ * this thread are taken from, so consecutive calls (the stages of Pipeline_run) reuse the same
+ * memory instead of each allocating and faulting in its own; bytes = 0 releases it, once its
+ * chunks in use are returned. The workspace is bound to the calling thread like the progress
+ * record (Progress_bind): regularisers running on other threads at the same time allocate as
+ * before and never take its chunks. Arrays which do not fit are allocated as before.
+ * Returns the size of the workspace, -1 if this thread has one in use */
+long Vol_workspace(long bytes)
+{
+    char *W;
+    if (bytes <= 0l) {
+        if (ws_live > 0l) ws_release = 1;
+        else {
+            Vol_release(ws_base);
+            ws_base = NULL; ws_size = 0l;
+        }
+        return 0l;
+    }
+    if (ws_base != NULL) return -1l;
+    bytes = (bytes + WS_ALIGN - 1l) & ~(WS_ALIGN - 1l);
+    /* the huge-page path of Vol_calloc, the pages are faulted in once here */
+    W = (char*)Vol_calloc(bytes/(long)sizeof(float));
+    if (W == NULL) return 0l;
+    ws_base = W; ws_size = bytes; ws_top = 0l; ws_live = 0l; ws_peak = 0l; ws_release = 0;
+    return bytes;
+}
+
+/* info[0] - size of the workspace of this thread, info[1] - the most of it in use at once,
+ * info[2] - arrays taken from it and info[3] - arrays which did not fit since the previous call */
+void Vol_workspace_info(long *info)
+{
+    info[0] = ws_size;
+    info[1] = ws_peak;
+    info[2] = ws_served;
+    info[3] = ws_missed;
+    ws_served = 0l; ws_missed = 0l;
+}
+
+/* a zeroed chunk of DimTotal floats from the top of the workspace of this thread, NULL if it
+ * does not fit */
+static float *Workspace_chunk(long DimTotal)
+{
+    char *W;
+    long j, bytes;
+    bytes = (DimTotal*(long)sizeof(float) + WS_ALIGN - 1l) & ~(WS_ALIGN - 1l);
+    if ((ws_release == 1) || (ws_top + bytes > ws_size)) {
+        ws_missed++;
+        return NULL;
+    }
+    W = ws_base + ws_top;
+    ws_top += bytes;
+    ws_live++;
+    ws_served++;
+    if (ws_top > ws_peak) ws_peak = ws_top;
+#pragma omp parallel for shared(W) private(j)
+    for(j=0; j<DimTotal; j++) ((float*)W)[j] = 0.0f;
+    return (float*)W;
+}
+
+/* Switch the huge-page path of Vol_calloc on (1, the default) or off (0) */
+void Vol_huge_pages(int enable)
+{
+    huge_enabled = enable;
+}
+
+/* info[0] - bytes of the work arrays that took the huge-page path since the previous call,
+ * info[1] - bytes of the huge-page path arrays in use now which are backed by huge pages (-1 if
+ * the kernel does not report it); /proc/self/smaps is read here once, not on every allocation */
+void Vol_huge_pages_info(long *info)
+{
+#pragma omp critical (ccpi_huge)
+    {
+        info[0] = huge_requested;
+        huge_requested = 0l;
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+        info[1] = Huge_backed();
+#else
+        info[1] = -1l;
+#endif
+    }
+}
+
+/* Threshold in bytes from which arrays are written with streaming stores: bytes > 0 sets it,
+ * 0 switches the streaming stores off and -1 restores the default, a quarter of the last level
+ * cache (8 MB if unknown) since a solver touches several such arrays per iteration.
+ * Returns the threshold in use, 0 if off or not supported on the platform. */
+long Vol_streaming(long bytes)
+{
+#if defined(__SSE2__) || defined(_M_X64)
+    long llc = -1l;
+    if (bytes >= 0l) {stream_bytes = bytes; return stream_bytes;}
+    /* the default */
+#if defined(_SC_LEVEL3_CACHE_SIZE)
+    llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+#endif
+    stream_bytes = (llc > 0l) ? llc/4l : 8l*1024l*1024l;
+    return stream_bytes;
+#else
+    return 0l;
+#endif
+}
+
+/* the threshold in use, see Vol_streaming */
+long Vol_streaming_bytes(void)
+{
+    if (stream_bytes < 0l) return Vol_streaming(-1l);
+    return stream_bytes;
+}
+
+/* 1 when an array of DimTotal floats is to be written with streaming stores */
+int Vol_stream(long DimTotal)
+{
+    long bytes = Vol_streaming_bytes();
+    return (bytes > 0l) && (DimTotal*(long)sizeof(float) >= bytes);
+}
+
+/* orders the streaming stores of the calling thread before the following loads and stores */
+void Stream_fence(void)
+{
+#if defined(__SSE2__) || defined(_M_X64)
+    _mm_sfence();
+#endif
+}
+
+/* counts of the values of A in nbins bins over [lo, hi] (lo < hi) or into the first bin (lo == hi)
+ * added to hist, all values are in the range */
+static void Output_hist(float *A, long long *hist, int nbins, float lo, float hi, long DimTotal)
+{
+    long i;
+    int b, j, threads;
+    long long *hist_thr;
+    double scale;
+
+    threads = omp_get_max_threads();
+    hist_thr = (long long*) calloc((long)threads*nbins, sizeof(long long));
+    scale = (hi > lo) ? (double)nbins/((double)hi - (double)lo) : 0.0;
+#pragma omp parallel private(i, b)
+    {
+        long long *h = hist_thr + (long)omp_get_thread_num()*nbins;
+#pragma omp for
+        for (i = 0; i < DimTotal; i++) {
+            b = (int)(((double)A[i] - (double)lo)*scale);
+            if (b >= nbins) b = nbins - 1;
+            h[b]++;
+        }
+    }
+    for (b = 0; b < nbins; b++) {
+        for (j = 0; j < threads; j++) hist[b] += hist_thr[(long)j*nbins + b];
+    }
+    free(hist_thr);
+}
+
+/* Statistics of the regularised output in one parallel pass:
+ * stats = [min, max, mean, lo, hi] and hist - counts of a fixed-bin histogram over [lo, hi],
+ * the last bin is closed and values outside the range are not counted (as numpy.histogram).
+ * If lo >= hi the range of the data is used, this takes a second pass for the histogram; nbins >= 1.
+ * An empty output has zero statistics and counts.
+ * The cores ROF, FGP, PD and NDF compute the same in the last update of their iterations when the
+ * statistics are bound as an output pass (Output_bind). */
+float Output_stats(float *A, float *stats, long long *hist, int nbins, float lo, float hi, long DimTotal)
+{
+    long i;
+    int b, j, threads;
+    long long *hist_thr;
+    float vmin, vmax, val;
+    double sum, scale;
+    int ranged = (lo < hi);
+
+    memset(hist, 0, (long)nbins*sizeof(long long));
+    if (DimTotal <= 0l) {
+        stats[0] = 0.0f; stats[1] = 0.0f; stats[2] = 0.0f;
+        stats[3] = ranged ? lo : 0.0f;
+        stats[4] = ranged ? hi : 0.0f;
+        return *stats;
+    }
+    threads = omp_get_max_threads();
+    hist_thr = (long long*) calloc((long)threads*nbins, sizeof(long long));
+    vmin = A[0]; vmax = A[0]; sum = 0.0;
+    scale = ranged ? (double)nbins/((double)hi - (double)lo) : 0.0;
+
+#pragma omp parallel private(i, b, val) reduction(min:vmin) reduction(max:vmax) reduction(+:sum)
+    {
+        long long *h = hist_thr + (long)omp_get_thread_num()*nbins;
+#pragma omp for
+        for (i = 0; i < DimTotal; i++) {
+            val = A[i];
+            if (val < vmin) vmin = val;
+            if (val > vmax) vmax = val;
+            sum += (double)val;
+            if (ranged && (val >= lo) && (val <= hi)) {
+                b = (int)(((double)val - (double)lo)*scale);
+                if (b >= nbins) b = nbins - 1;
+                h[b]++;
+            }
+        }
+    }
+    for (b = 0; b < nbins; b++) {
+        for (j = 0; j < threads; j++) hist[b] += hist_thr[(long)j*nbins + b];
+    }
+    free(hist_thr);
+    if (!ranged) {
+        /* the range is the data range, all values fall into the histogram */
+        lo = vmin; hi = vmax;
+        Output_hist(A, hist, nbins, lo, hi, DimTotal);
+    }
+    stats[0] = vmin;
+    stats[1] = vmax;
+    stats[2] = (float)(sum/(double)DimTotal);
+    stats[3] = lo;
+    stats[4] = hi;
+    return *stats;
+}
+
+/* An output pass for an output of DimTotal floats without operations and statistics, the binder
+ * adds them */
+void Output_init(output_pass *pass, long DimTotal)
+{
+    memset(pass, 0, sizeof(output_pass));
+    pass->DimTotal = DimTotal;
+    pass->vmin = INFINITY;
+    pass->vmax = -INFINITY;
+}
+
+/* Output pass of the cores run by the calling thread: a core which supports it takes the pass
+ * (Output_take) and applies it to the rows of its output in the last update of its iterations
+ * (Output_rows), instead of separate passes over the output. It is not applied if the iterations
+ * stop early or the core cannot fuse it, the binder then checks pass->applied and makes the
+ * passes itself. Returns the pass bound before, NULL unbinds. */
+output_pass *Output_bind(output_pass *pass)
+{
+    output_pass *prev = output_bound;
+    output_bound = pass;
+    return prev;
+}
+
+/* called by a core on the thread running its loop: the bound pass if it is for an output of
+ * DimTotal floats and was not taken yet, NULL otherwise; ops = 0 for a core which can only
+ * read its output in the last update (statistics only) */
+output_pass *Output_take(long DimTotal, int ops)
+{
+    output_pass *pass = output_bound;
+    if ((pass == NULL) || pass->taken || (pass->DimTotal != DimTotal) || (!ops && (pass->nops > 0))) return NULL;
+    pass->taken = 1;
+    return pass;
+}
+
+/* starts the accumulation of a body of the last update, on the thread running the body */
+void Output_open(output_pass *pass, output_acc *acc)
+{
+    acc->vmin = INFINITY; acc->vmax = -INFINITY; acc->sum = 0.0;
+    acc->hist = NULL; acc->scale = 0.0;
+    if ((pass->stats != NULL) && (pass->lo < pass->hi)) {
+        acc->hist = (long long*) calloc(pass->nbins, sizeof(long long));
+        acc->scale = (double)pass->nbins/((double)pass->hi - (double)pass->lo);
+    }
+}
+
+/* applies the pass to n values of the output at U, called by the bodies of the last update
+ * on every row they have written while it is in the cache */
+void Output_rows(output_pass *pass, output_acc *acc, float *U, long n)
+{
+    long i;
+    int s, b;
+    float v;
+    if (pass->nops > 0) {
+        for(i=0; i<n; i++) {
+            v = U[i];
+            for(s=0; s<pass->nops; s++) {
+                if (pass->ops[s] == OUTPUT_CLAMP) v = fminf(fmaxf(v, pass->params[2*s]), pass->params[2*s+1]);
+                else v = pass->params[2*s]*v + pass->params[2*s+1];
+            }
+            U[i] = v;
+        }
+    }
+    if (pass->stats == NULL) return;
+    for(i=0; i<n; i++) {
+        v = U[i];
+        if (v < acc->vmin) acc->vmin = v;
+        if (v > acc->vmax) acc->vmax = v;
+        acc->sum += (double)v;
+        if ((acc->hist != NULL) && (v >= pass->lo) && (v <= pass->hi)) {
+            b = (int)(((double)v - (double)pass->lo)*acc->scale);
+            if (b >= pass->nbins) b = pass->nbins - 1;
+            acc->hist[b]++;
+        }
+    }
+}
+
+/* merges the accumulation of a body into the pass, the bodies run on OpenMP or pool threads */
+void Output_close(output_pass *pass, output_acc *acc)
+{
+    int b;
+    if (pass->stats == NULL) return;
+#pragma omp critical (ccpi_output)
+    {
+        if (acc->vmin < pass->vmin) pass->vmin = acc->vmin;
+        if (acc->vmax > pass->vmax) pass->vmax = acc->vmax;
+        pass->sum += acc->sum;
+        if (acc->hist != NULL) {
+            for (b = 0; b < pass->nbins; b++) pass->hist[b] += acc->hist[b];
+        }
+    }
+    free(acc->hist);
+}
+
+/* called by a core after the last update applied the pass to its output U: the statistics,
+ * with a pass for the histogram over the data range */
+void Output_done(output_pass *pass, float *U)
+{
+    if (pass->stats != NULL) {
+        if (!(pass->lo < pass->hi)) {
+            pass->lo = pass->vmin; pass->hi = pass->vmax;
+            Output_hist(U, pass->hist, pass->nbins, pass->lo, pass->hi, pass->DimTotal);
+        }
+        pass->stats[0] = pass->vmin;
+        pass->stats[1] = pass->vmax;
+        pass->stats[2] = (float)(pass->sum/(double)pass->DimTotal);
+        pass->stats[3] = pass->lo;
+        pass->stats[4] = pass->hi;
+    }
+    pass->applied = 1;
+}
+
+/* Binds the statistics of Output_stats of an output of DimTotal floats as the output pass of
+ * the next core the calling thread runs (ROF, FGP, PD, NDF), stats = NULL unbinds it. Returns 1
+ * when unbinding after the core computed them, 0 otherwise. */
+int Output_stats_bind(float *stats, long long *hist, int nbins, float lo, float hi, long DimTotal)
+{
+    if (stats == NULL) {
+        if (output_bound == &stats_pass) output_bound = NULL;
+        return stats_pass.applied;
+    }
+    Output_init(&stats_pass, DimTotal);
+    memset(hist, 0, (long)nbins*sizeof(long long));
+    stats_pass.stats = stats;
+    stats_pass.hist = hist;
+    stats_pass.nbins = nbins;
+    stats_pass.lo = lo;
+    stats_pass.hi = hi;
+    output_bound = &stats_pass;
+    return 0;
+}
+
+/* Progress of the cores run by the calling thread: the record of PROGRESS_SIZE floats is read by
+ * other threads while the core runs, the cores write the number of iterations done and the last
+ * relative change of the early stopping check (0 until one is computed) after every iteration and
+ * stop at the end of the iteration in which another thread set the cancel entry to non-zero,
+ * as if the tolerance were reached. NULL unbinds. */
+void Progress_bind(float *record)
+{
+    progress_record = record;
+}
+
+/* called by a core after every iteration on the thread running its loop, non-zero to stop */
+int Progress_step(long iteration, float residual)
+{
+    volatile float *record = progress_record;
+    if (record == NULL) return 0;
+    record[1] = residual;
+    record[0] = (float)(iteration);
+    return (record[2] != 0.0f);
+}
+
+/* non-zero when the calling thread has bound a record, the cores iterating in one parallel region
+ * only then add the barrier that makes all threads stop together */
+int Progress_active(void)
+{
+    return (progress_record != NULL);
+}
+
+/* Energy_read: the powercap directory, the counter files of the RAPL package domains, their
+ * wrap range (0 - unknown), the last raw readings (micro joules) and the joules accumulated since
+ * the first call; -1 domains - not looked up yet */
+static char energy_root[ENERGY_PATH/2] = "/sys/class/powercap";
+static int energy_domains = -1;
+static char energy_path[ENERGY_DOMAINS][ENERGY_PATH];
+static unsigned long long energy_range[ENERGY_DOMAINS];
+static unsigned long long energy_last[ENERGY_DOMAINS];
+static double energy_total = 0.0;
+
+static int Energy_value(const char *path, unsigned long long *value)
+{
+    FILE *f;
+    int ok;
+    f = fopen(path, "r");
+    if (f == NULL) return 0;
+    ok = (fscanf(f, "%llu", value) == 1);
+    fclose(f);
+    return ok;
+}
+
+/* the domains under energy_root, called in the ccpi_energy critical section */
+static void Energy_lookup(void)
+{
+    char path[ENERGY_PATH];
+    int d;
+    energy_domains = 0;
+    energy_total = 0.0;
+#if defined(__linux__)
+    for(d=0; d<ENERGY_DOMAINS; d++) {
+        snprintf(energy_path[energy_domains], ENERGY_PATH, "%s/intel-rapl:%d/energy_uj", energy_root, d);
+        if (!Energy_value(energy_path[energy_domains], &energy_last[energy_domains])) break;
+        snprintf(path, ENERGY_PATH, "%s/intel-rapl:%d/max_energy_range_uj", energy_root, d);
+        if (!Energy_value(path, &energy_range[energy_domains])) energy_range[energy_domains] = 0ull;
+        energy_domains++;
+    }
+#endif
+}
+
+/* Joules used by the processor packages since the first call, from the Linux powercap (RAPL)
+ * counters of the package domains (the core and dram subdomains are part of them). The
+ * wrap-around of the counters is followed, which needs a call at least once per wrap period
+ * (minutes at full load); a domain whose wrap range cannot be read contributes nothing for the
+ * interval in which it wrapped. Returns -1 when the counters are not there or not readable
+ * (other platforms, no RAPL, counters readable by root only) */
+double Energy_read(void)
+{
+    unsigned long long v;
+    double joules;
+    int d;
+#pragma omp critical (ccpi_energy)
+    {
+        if (energy_domains < 0) Energy_lookup();
+        for(d=0; d<energy_domains; d++) {
+            if (!Energy_value(energy_path[d], &v)) continue;
+            if (v >= energy_last[d]) energy_total += 1.0e-6*(double)(v - energy_last[d]);
+            else if (energy_range[d] > energy_last[d]) energy_total += 1.0e-6*(double)(v + (energy_range[d] - energy_last[d]));
+            energy_last[d] = v;
+        }
+        joules = (energy_domains > 0) ? energy_total : -1.0;
+    }
+    return joules;
+}
+
+/* Looks the RAPL domains up again under the powercap directory root (NULL - /sys/class/powercap,
+ * at most ENERGY_PATH/2 - 1 characters) and restarts the count of Energy_read; the number of
+ * domains found */
+int Energy_source(const char *root)
+{
+    int domains;
+#pragma omp critical (ccpi_energy)
+    {
+        snprintf(energy_root, sizeof(energy_root), "%s", (root != NULL) ? root : "/sys/class/powercap");
+        Energy_lookup();
+        domains = energy_domains;
+    }
+    return domains;
+}
+
+/* the 64-bit finaliser of splitmix64 */
+static unsigned long long Hash_mix(unsigned long long z)
+{
+    z = (z ^ (z >> 30))*0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27))*0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+/* one block of Vol_hash: HASH_LANES independent multiply-rotate accumulators over consecutive
+ * 32-bit words, a loop the compilers vectorise; the tail is padded with zeros */
+static unsigned long long Hash_block(const unsigned char *data, long bytes, long block)
+{
+    unsigned int acc[HASH_LANES], w[HASH_LANES];
+    unsigned long long h;
+    long n, l;
+    for(l=0; l<HASH_LANES; l++) acc[l] = 0x9E3779B1u*(unsigned int)(l + 1) + (unsigned int)(block);
+    for(n=0; n<bytes; n+=HASH_LANES*4) {
+        if (n + HASH_LANES*4 <= bytes) memcpy(w, data + n, sizeof(w));
+        else {
+            memset(w, 0, sizeof(w));
+            memcpy(w, data + n, bytes - n);
+        }
+        for(l=0; l<HASH_LANES; l++) {
+            acc[l] += w[l]*0x85EBCA77u;
+            acc[l] = (acc[l] << 13) | (acc[l] >> 19);
+            acc[l] *= 0x9E3779B1u;
+        }
+    }
+    h = Hash_mix((unsigned long long)(bytes) + ((unsigned long long)(block) << 32));
+    for(l=0; l<HASH_LANES; l+=2) h = Hash_mix(h ^ (((unsigned long long)(acc[l]) << 32) | acc[l+1]));
+    return h;
+}
+
+/* 64-bit hash of the bytes at data (not a cryptographic one): the blocks of HASH_BLOCK bytes are
+ * hashed in parallel, their hashes combined in order. The same bytes give the same hash for any
+ * number of threads on one platform (byte order) */
+unsigned long long Vol_hash(const unsigned char *data, long bytes)
+{
+    unsigned long long *H, h;
+    long b, blocks;
+    blocks = (bytes + HASH_BLOCK - 1)/HASH_BLOCK;
+    if (blocks <= 1) return Hash_block(data, bytes, 0l);
+    H = (unsigned long long*) malloc(blocks*sizeof(unsigned long long));
+#pragma omp parallel for shared(H, data) private(b)
+    for(b=0; b<blocks; b++) H[b] = Hash_block(data + b*HASH_BLOCK, (b == blocks-1) ? bytes - b*HASH_BLOCK : HASH_BLOCK, b);
+    h = Hash_mix((unsigned long long)(bytes));
+    for(b=0; b<blocks; b++) h = Hash_mix(h ^ H[b]);
+    free(H);
+    return h;
+}
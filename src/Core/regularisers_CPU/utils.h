@@ -17,10 +17,109 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 
+#ifndef __UTILS_H__
+#define __UTILS_H__
 #include <stdlib.h>
 #include <memory.h>
 #include "CCPiDefines.h"
 #include "omp.h"
+
+/* storage of the 3D work arrays, selected with the 'layout' argument of the cores */
+#define LAYOUT_PLANAR 0
+#define LAYOUT_INTERLEAVED 1
+#define LAYOUT_BRICKED 2
+
+/* primal-dual schemes of the PD-TV and TGV cores, selected with the 'algorithm' argument: fixed
+ * steps and theta = 1, or steps and theta updated every iteration from the strong convexity of
+ * the L2 fidelity (O(1/k^2) rate) */
+#define PD_STANDARD 0
+#define PD_ACCELERATED 1
+
+/* LAYOUT_BRICKED keeps a volume as 8x8x8 bricks (X fastest inside a brick, bricks ordered X,Y,Z),
+ * the volume is padded up to a whole number of bricks; nbX, nbY are the numbers of bricks along X and Y */
+#define BRICK 8
+#define BIDX(i,j,k,nbX,nbY) (((((long)(k)>>3)*(nbY) + ((long)(j)>>3))*(nbX) + ((long)(i)>>3))*512 + ((((long)(k)&7)<<6) | (((long)(j)&7)<<3) | ((long)(i)&7)))
+
+/* strided views: a dimX x dimY x dimZ region inside a larger array, rows pitchY floats and slices
+ * pitchZ floats apart (X contiguous); pitchY = dimX and pitchZ = dimX*dimY is the dense volume.
+ * The cores gather a view into a planar copy with Strided_to_planar and scatter the result back
+ * with Planar_to_strided. The copies are allocated with calloc, not huge-page aligned like the
+ * work arrays (Vol_calloc), which they would evict from the caches at the same offsets. */
+#define STRIDED_DENSE(pitchY, pitchZ, dimX, dimY, dimZ) (((pitchY) == (dimX)) && (((dimZ) <= 1) || ((pitchZ) == (long)(dimX)*(dimY))))
+
+/* vectorisation of the lane loops of the lockstep (multi-lambda) solvers, needs OpenMP 4.0 and
+ * is left out by compilers with an older OpenMP (MSVC) */
+#if defined(_OPENMP) && (_OPENMP >= 201307)
+#define OMP_SIMD _Pragma("omp simd")
+#else
+#define OMP_SIMD
+#endif
+
+/* non-temporal (streaming) stores for arrays that are written once and not read again soon,
+ * they bypass the cache and save the read-for-ownership; used when Vol_stream says the array is
+ * large enough, the writing thread calls Stream_fence before others read the array */
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define STREAM_STORE(p, v) do { union {float f; int i;} s_; s_.f = (v); _mm_stream_si32((int*)(p), s_.i); } while (0)
+#else
+#define STREAM_STORE(p, v) (*(p) = (v))
+#endif
+
+/* work arrays of at least HUGE_PAGE bytes are aligned and advised for transparent huge pages by Vol_calloc */
+#define HUGE_PAGE (2l*1024l*1024l)
+
+/* alignment in bytes of the arrays Vol_calloc takes from a workspace (Vol_workspace), and the
+ * size of the header before its other arrays */
+#define WS_ALIGN 64l
+
+/* Vol_hash: bytes hashed per parallel block and lanes of 32-bit words of its inner loop */
+#define HASH_BLOCK 65536l
+#define HASH_LANES 16
+
+/* RAPL package domains (intel-rapl:N) summed by Energy_read, the longest path of their files */
+#define ENERGY_DOMAINS 8
+#define ENERGY_PATH 256
+
+/* progress record of Progress_bind: [iterations done, last relative change, cancel] */
+#define PROGRESS_SIZE 3
+
+/* output pass of Output_bind: up to OUTPUT_OPS pointwise operations with the parameters p0, p1,
+ * OUTPUT_CLAMP U = min(max(U, p0), p1) and OUTPUT_SCALE U = p0*U + p1, then the statistics of
+ * Output_stats of the result */
+#define OUTPUT_OPS 8
+/* elements a pointwise last update writes before it applies the pass to them, still in the cache */
+#define OUTPUT_CHUNK 4096l
+#define OUTPUT_CLAMP 0
+#define OUTPUT_SCALE 1
+typedef struct {
+    long DimTotal;      /* size of the output the pass is for */
+    int nops;
+    int ops[OUTPUT_OPS];
+    float params[2*OUTPUT_OPS];
+    float *stats;       /* [min, max, mean, lo, hi] as Output_stats, NULL - none */
+    long long *hist;    /* nbins counts over [lo, hi], the data range if lo >= hi */
+    int nbins;
+    float lo, hi;
+    float vmin, vmax;   /* merged from the bodies (Output_close) */
+    double sum;
+    int taken;          /* a core took the pass (Output_take) */
+    int applied;        /* and applied it to its output (Output_done) */
+} output_pass;
+
+/* the part of an output pass accumulated by one body, merged by Output_close */
+typedef struct {
+    float vmin, vmax;
+    double sum, scale;
+    long long *hist;
+} output_acc;
+
+/* variables with one instance per thread */
+#if defined(_MSC_VER)
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -32,7 +131,44 @@ CCPI_EXPORT float TV_energy3D(float *U, float *U0, float *E_val, float lambda, i
 CCPI_EXPORT float TV_energy3D(float *U, float *U0, float *E_val, float lambda, int type, int dimX, int dimY, int dimZ);
 CCPI_EXPORT float Im_scale2D(float *Input, float *Scaled, int w, int h, int w2, int h2);
 CCPI_EXPORT float Proj_func2D(float *P1, float *P2, int methTV, long DimTotal);
+CCPI_EXPORT float copyIm_ws(float *A, float *U, long DimTotal);
+CCPI_EXPORT float Nonneg_ws(float *A, long DimTotal);
+CCPI_EXPORT float Proj_func2D_ws(float *P1, float *P2, int methTV, long DimTotal);
+CCPI_EXPORT float Proj_func3D_ws(float *P1, float *P2, float *P3, int methTV, long DimTotal);
 CCPI_EXPORT float Proj_func3D(float *P1, float *P2, float *P3, int methTV, long DimTotal);
+CCPI_EXPORT float Proj_func3D_il(float *P, int methTV, long DimTotal);
+CCPI_EXPORT float PD_steps(float gamma, float *tau, float *sigma);
+CCPI_EXPORT long Bricked_size(long dimX, long dimY, long dimZ);
+CCPI_EXPORT float Planar_to_bricked(float *A, float *B1, float *B2, long dimX, long dimY, long dimZ);
+CCPI_EXPORT float *Vol_calloc(long DimTotal);
+CCPI_EXPORT void Vol_free(float *A);
+CCPI_EXPORT long Vol_workspace(long bytes);
+CCPI_EXPORT void Vol_workspace_info(long *info);
+CCPI_EXPORT void Vol_huge_pages(int enable);
+CCPI_EXPORT void Vol_huge_pages_info(long *info);
+CCPI_EXPORT int Vol_stream(long DimTotal);
+CCPI_EXPORT long Vol_streaming(long bytes);
+CCPI_EXPORT long Vol_streaming_bytes(void);
+CCPI_EXPORT void Stream_fence(void);
+CCPI_EXPORT float Bricked_to_planar(float *B, float *A, long dimX, long dimY, long dimZ);
+CCPI_EXPORT float Strided_to_planar(float *S, long pitchY, long pitchZ, float *A1, float *A2, long dimX, long dimY, long dimZ);
+CCPI_EXPORT float Planar_to_strided(float *A, float *S, long pitchY, long pitchZ, long dimX, long dimY, long dimZ);
+CCPI_EXPORT unsigned long long Vol_hash(const unsigned char *data, long bytes);
+CCPI_EXPORT double Energy_read(void);
+CCPI_EXPORT int Energy_source(const char *root);
+CCPI_EXPORT void Progress_bind(float *record);
+CCPI_EXPORT int Progress_step(long iteration, float residual);
+CCPI_EXPORT int Progress_active(void);
+CCPI_EXPORT void Output_init(output_pass *pass, long DimTotal);
+CCPI_EXPORT output_pass *Output_bind(output_pass *pass);
+CCPI_EXPORT output_pass *Output_take(long DimTotal, int ops);
+CCPI_EXPORT void Output_open(output_pass *pass, output_acc *acc);
+CCPI_EXPORT void Output_rows(output_pass *pass, output_acc *acc, float *U, long n);
+CCPI_EXPORT void Output_close(output_pass *pass, output_acc *acc);
+CCPI_EXPORT void Output_done(output_pass *pass, float *U);
+CCPI_EXPORT float Output_stats(float *A, float *stats, long long *hist, int nbins, float lo, float hi, long DimTotal);
+CCPI_EXPORT int Output_stats_bind(float *stats, long long *hist, int nbins, float lo, float hi, long DimTotal);
 #ifdef __cplusplus
 }
 #endif
+#endif
@@ -0,0 +1,39 @@
+/*
+ * This work is part of the Core Imaging Library developed by
+ * Visual Analytics and Imaging System Group of the Science Technology
+ * Facilities Council, STFC
+ *
+ * Copyright 2017 Daniil Kazantsev
+ * Copyright 2017 Srikanth Nagella, Edoardo Pasca
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "vec_math.h"
+#include "utils.h"
+
+/* exp of the n floats of A in place */
+float Vec_exp(float *A, long n)
+{
+    long j;
+    OMP_SIMD
+    for(j=0; j<n; j++) VEXP(A[j], A[j]);
+    return 1;
+}
+
+/* 1/sqrt of the n (positive) floats of A in place */
+float Vec_rsqrt(float *A, long n)
+{
+    long j;
+    OMP_SIMD
+    for(j=0; j<n; j++) VRSQRT(A[j], A[j]);
+    return 1;
+}
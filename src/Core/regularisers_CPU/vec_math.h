@@ -0,0 +1,77 @@
+/*
+This work is part of the Core Imaging Library developed by
+Visual Analytics and Imaging System Group of the Science Technology
+Facilities Council, STFC
+
+Copyright 2017 Daniil Kazantsev
+Copyright 2017 Srikanth Nagella, Edoardo Pasca
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "CCPiDefines.h"
+
+/* Vectorisable float math of the kernels: macros the compilers unroll into plain arithmetic and
+ * integer operations, so loops calling them vectorise (the libm expf/powf calls they replace are
+ * opaque to the vectoriser) and the scalar code of a kernel gives the same bits as its vector loops.
+ *
+ * POW2, POW4 - integer powers by multiplication, equal to powf(x, 2) (4 - up to rounding),
+ * the argument is evaluated more than once
+ * VEXP(y, x) - y = exp(x): rounding to n = x/ln2, Cody-Waite reduction to |r| <= ln2/2, a degree 6
+ * polynomial of exp(r) (Cephes) and a scaling by 2^n in two steps, so subnormal results and the
+ * overflow to inf come out as in libm; relative error below VEXP_ERROR for normal results, x is
+ * clamped to [-104, 89] (exp 0 and inf beyond) and NaN gives NaN
+ * VRSQRT(y, x) - y = 1/sqrt(x) for x > 0: the bit estimate refined by three Newton steps,
+ * relative error below VRSQRT_ERROR; 0, subnormal and negative x give no meaningful result. With
+ * -fno-math-errno the exact 1.0f/sqrtf vectorises as well (sqrt and division instructions) and is
+ * faster on x86-64, the kernels keep it; VRSQRT is for the targets without a vector sqrt
+ *
+ * Vec_exp and Vec_rsqrt apply them to an array in place (one vectorised loop). */
+
+#define VEXP_ERROR 1.5e-7f
+#define VRSQRT_ERROR 2.5e-7f
+
+#define POW2(x) ((x)*(x))
+#define POW4(x) (((x)*(x))*((x)*(x)))
+
+#define VEXP(y, x) do { \
+    union {float f; int i;} ve_n_, ve_a_, ve_b_; \
+    float ve_x_ = (x), ve_r_, ve_p_; \
+    ve_x_ = (ve_x_ < -104.0f) ? -104.0f : ((ve_x_ > 89.0f) ? 89.0f : ve_x_); \
+    ve_n_.f = ve_x_*1.44269504088896341f + 12582912.0f; \
+    ve_r_ = ve_n_.f - 12582912.0f; \
+    ve_n_.i -= 0x4B400000; \
+    ve_r_ = (ve_x_ - ve_r_*0.693359375f) + ve_r_*2.12194440e-4f; \
+    ve_p_ = (((((1.9875691500e-4f*ve_r_ + 1.3981999507e-3f)*ve_r_ + 8.3334519073e-3f)*ve_r_ + \
+             4.1665795894e-2f)*ve_r_ + 1.6666665459e-1f)*ve_r_ + 5.0000001201e-1f)*ve_r_*ve_r_ + ve_r_ + 1.0f; \
+    ve_a_.i = ((ve_n_.i >> 1) + 127) << 23; \
+    ve_b_.i = ((ve_n_.i - (ve_n_.i >> 1)) + 127) << 23; \
+    (y) = (ve_x_ != ve_x_) ? ve_x_ : (ve_p_*ve_a_.f)*ve_b_.f; \
+} while (0)
+
+#define VRSQRT(y, x) do { \
+    union {float f; int i;} vr_e_; \
+    float vr_x_ = (x); \
+    vr_e_.f = vr_x_; \
+    vr_e_.i = 0x5F375A86 - (vr_e_.i >> 1); \
+    vr_e_.f = vr_e_.f*(1.5f - 0.5f*vr_x_*vr_e_.f*vr_e_.f); \
+    vr_e_.f = vr_e_.f*(1.5f - 0.5f*vr_x_*vr_e_.f*vr_e_.f); \
+    (y) = vr_e_.f*(1.5f - 0.5f*vr_x_*vr_e_.f*vr_e_.f); \
+} while (0)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+CCPI_EXPORT float Vec_exp(float *A, long n);
+CCPI_EXPORT float Vec_rsqrt(float *A, long n);
+#ifdef __cplusplus
+}
+#endif
@@ -82,5 +82,5 @@ void mexFunction(
     vecdim[0] = 2;
     infovec = (float*)mxGetPr(plhs[1] = mxCreateNumericArray(1, vecdim, mxSINGLE_CLASS, mxREAL));    
     
-    Diffus4th_CPU_main(Input, Output, infovec, lambda, sigma, iter_numb, tau, epsil, dimX, dimY, dimZ);
+    Diffus4th_CPU_main(Input, Output, infovec, lambda, sigma, iter_numb, tau, epsil, DIFF4TH_EXPLICIT, LAYOUT_PLANAR, dimX, dimY, dimZ);
 }
@@ -94,5 +94,5 @@ void mexFunction(
     infovec = (float*)mxGetPr(plhs[1] = mxCreateNumericArray(1, vecdim, mxSINGLE_CLASS, mxREAL));
     
     /* running the function */
-    TV_FGP_CPU_main(Input, Output, infovec, lambda, iter, epsil, methTV, nonneg, dimX, dimY, dimZ);
+    TV_FGP_CPU_main(Input, Output, infovec, lambda, iter, epsil, methTV, nonneg, LAYOUT_PLANAR, dimX, dimY, dimZ);
 }
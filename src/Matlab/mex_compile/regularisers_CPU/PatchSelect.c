@@ -44,6 +44,10 @@
  * 2. AR_j - indeces of j neighbours
  * 3. AR_k - indeces of j neighbours
  * 4. Weights_ijk - associated weights
+ *
+ * Time series: the previous frame (6), a threshold (7) and the outputs for the previous
+ * frame (8-10 in 2D, 8-11 in 3D) search the neighbours again only near the voxels that
+ * changed by more than the threshold, elsewhere only their weights are recomputed
  */
 /**************************************************/
 void mexFunction(
@@ -54,7 +58,8 @@ void mexFunction(
     mwSize dimX, dimY, dimZ;
     const mwSize *dim_array;
     unsigned short *H_i=NULL, *H_j=NULL, *H_k=NULL;
-    float *A, *Weights = NULL, h;
+    float *A, *Weights = NULL, h, threshold;
+    mwSize numel;
     mwSize dim_array2[3]; /* for 2D data */
     mwSize dim_array3[4]; /* for 3D data */
 
@@ -87,6 +92,17 @@ void mexFunction(
         Weights = (float*)mxGetPr(plhs[3] = mxCreateNumericArray(4, dim_array3, mxSINGLE_CLASS, mxREAL));
     }
 
-    PatchSelect_CPU_main(A, H_i, H_j, H_k, Weights, (long)(dimX), (long)(dimY), (long)(dimZ), SearchWindow, SimilarWin, NumNeighb, h); 
+    if (nrhs > 5) {
+        if (nrhs != ((number_of_dims == 2) ? 10 : 11)) mexErrMsgTxt("The previous frame, a threshold and the outputs for the previous frame are expected");
+        if (mxGetNumberOfElements(prhs[5]) != mxGetNumberOfElements(prhs[0])) mexErrMsgTxt("The previous frame must have the size of the input");
+        threshold = (float) mxGetScalar(prhs[6]);
+        numel = mxGetNumberOfElements(prhs[0])*NumNeighb;
+        memcpy(H_i, mxGetData(prhs[7]), numel*sizeof(unsigned short));
+        memcpy(H_j, mxGetData(prhs[8]), numel*sizeof(unsigned short));
+        if (number_of_dims == 3) memcpy(H_k, mxGetData(prhs[9]), numel*sizeof(unsigned short));
+        memcpy(Weights, mxGetData(prhs[nrhs-1]), numel*sizeof(float));
+        PatchSelect_CPU_update(A, (float *) mxGetData(prhs[5]), H_i, H_j, H_k, Weights, (long)(dimX), (long)(dimY), (long)(dimZ), SearchWindow, SimilarWin, NumNeighb, h, threshold);
+    }
+    else PatchSelect_CPU_main(A, H_i, H_j, H_k, Weights, (long)(dimX), (long)(dimY), (long)(dimZ), SearchWindow, SimilarWin, NumNeighb, h); 
 
  }
@@ -93,9 +93,9 @@ void mexFunction(
     infovec = (float*)mxGetPr(plhs[1] = mxCreateNumericArray(1, vecdim, mxSINGLE_CLASS, mxREAL));
     
     if (mrows==1 && ncols==1) {
-    TV_ROF_CPU_main(Input, Output, infovec, lambda, 0, iter_numb, tau, epsil, dimX, dimY, dimZ);    
+    TV_ROF_CPU_main(Input, Output, infovec, lambda, 0, iter_numb, tau, epsil, LAYOUT_PLANAR, dimX, dimY, dimZ);    
     free(lambda);
     }
-    else TV_ROF_CPU_main(Input, Output, infovec, lambda, 1, iter_numb, tau, epsil, dimX, dimY, dimZ);     
+    else TV_ROF_CPU_main(Input, Output, infovec, lambda, 1, iter_numb, tau, epsil, LAYOUT_PLANAR, dimX, dimY, dimZ);     
         
 }
@@ -87,5 +87,5 @@ void mexFunction(
     infovec = (float*)mxGetPr(plhs[1] = mxCreateNumericArray(1, vecdim, mxSINGLE_CLASS, mxREAL));    
     
     /* running the function */
-    SB_TV_CPU_main(Input, Output, infovec, lambda, iter, epsil, methTV, dimX, dimY, dimZ);
+    SB_TV_CPU_main(Input, Output, infovec, lambda, iter, epsil, methTV, SB_GAUSS_SEIDEL, dimX, dimY, dimZ);
 }
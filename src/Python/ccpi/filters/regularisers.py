@@ -2,21 +2,221 @@
 script which assigns a proper device core function based on a flag ('cpu' or 'gpu')
 """
 
-from ccpi.filters.cpu_regularisers import TV_ROF_CPU, TV_FGP_CPU, TV_PD_CPU, TV_SB_CPU, dTV_FGP_CPU, TNV_CPU, NDF_CPU, Diff4th_CPU, TGV_CPU, LLT_ROF_CPU, PATCHSEL_CPU, NLTV_CPU
+from ccpi.filters.cpu_regularisers import TV_ROF_CPU, TV_FGP_CPU, TV_PD_CPU, TV_SB_CPU, dTV_FGP_CPU, TNV_CPU, NDF_CPU, LinearDiff_MG_CPU, Diff4th_CPU, TGV_CPU, LLT_ROF_CPU, PATCHSEL_CPU, NLTV_CPU, CPU_peak_memory, HUGEPAGES_CPU, HUGEPAGES_INFO_CPU, OUTPUT_STATS_CPU, OUTPUT_STATS_RUN_CPU, POOL_CPU, POOL_THREADS_CPU, STREAMING_CPU, CHECKPOINT_ITERATIONS_CPU, NOISE_CPU, PIPELINE_CPU, PIPELINE_MEM_CPU, PROGRESS_RUN_CPU, HASH_CPU, ENERGY_CPU, COST_PREDICT_CPU, COST_THREADS_CPU
+import collections
+import concurrent.futures
+import functools
+import inspect
+import os
+import threading
+import timeit
+import numpy as np
 try:
     from ccpi.filters.gpu_regularisers import TV_ROF_GPU, TV_FGP_GPU, TV_PD_GPU, TV_SB_GPU, dTV_FGP_GPU, NDF_GPU, Diff4th_GPU, TGV_GPU, LLT_ROF_GPU, PATCHSEL_GPU
     gpu_enabled = True
 except ImportError:
     gpu_enabled = False
 
+def output_stats(regulariser):
+    """Adds the keywords stats (number of histogram bins, 0 - off) and stats_range
+    ((lo, hi) of the fixed bins, the data range when None) to a regulariser. With stats
+    set the call returns (output, infovector, statistics) where statistics is a dict with
+    min, max, mean, histogram and bin_edges of the output. The cpu ROF_TV, FGP_TV, PD_TV,
+    NDF and pipeline compute them in their last iteration, other calls by one parallel
+    pass over the output."""
+    @functools.wraps(regulariser)
+    def wrapper(*args, **kwargs):
+        bins = kwargs.pop('stats', 0)
+        stats_range = kwargs.pop('stats_range', None)
+        (result, statistics) = OUTPUT_STATS_RUN_CPU(bins, stats_range, regulariser, args, kwargs)
+        if bins == 0:
+            return result
+        if statistics is None:
+            statistics = OUTPUT_STATS_CPU(result[0], bins, stats_range)
+        return tuple(result) + (statistics,)
+    return wrapper
+
+def output_energy(regulariser):
+    """Adds the keyword energy to a regulariser: with energy set the joules the processor
+    packages used during the call (Linux powercap/RAPL counters, NaN when they cannot be
+    read) are appended to the infovector. The counters cover the whole packages, other
+    load running at the same time is included. A regulariser with an energy argument of
+    its own (pipeline) gets it too and appends the joules of its phases before them."""
+    phases = 'energy' in inspect.signature(regulariser).parameters
+    @functools.wraps(regulariser)
+    def wrapper(*args, **kwargs):
+        if not kwargs.get('energy', False):
+            kwargs.pop('energy', None)
+            return regulariser(*args, **kwargs)
+        if not phases:
+            del kwargs['energy']
+        start = ENERGY_CPU()
+        result = regulariser(*args, **kwargs)
+        joules = np.float32(ENERGY_CPU() - start)
+        return (result[0], np.append(result[1], joules)) + tuple(result[2:])
+    return wrapper
+
+def _cache_key(value):
+    # arrays by dtype, shape and the hash of their bytes, containers by their items
+    if isinstance(value, np.ndarray):
+        return ('ndarray', value.dtype.str, value.shape, HASH_CPU(value))
+    if isinstance(value, (list, tuple)):
+        return (type(value).__name__,) + tuple(_cache_key(v) for v in value)
+    if isinstance(value, dict):
+        return ('dict',) + tuple((k, _cache_key(value[k])) for k in sorted(value))
+    return repr(value)
+
+def _cache_map(function, value, kind=np.ndarray):
+    # applies function to the arrays (or the items of kind) of a result, keeping its tuples and lists
+    if isinstance(value, (list, tuple)):
+        return type(value)(_cache_map(function, v, kind) for v in value)
+    return function(value) if isinstance(value, kind) else value
+
+def _cache_nbytes(value):
+    if isinstance(value, (list, tuple)):
+        return sum(_cache_nbytes(v) for v in value)
+    return value.nbytes if isinstance(value, np.ndarray) else 0
+
+class _SpilledArray(object):
+    def __init__(self, path):
+        self.path = path
+
+class _ResultCache(object):
+    """LRU store of the results of the regularisers, bounded by the bytes of their arrays;
+    entries evicted from memory go to .npy files of the spill directory (its own LRU
+    bound) and are read back through a memory map when hit."""
+
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.memory = collections.OrderedDict()
+        self.spilled = collections.OrderedDict()
+        self.max_bytes = 0
+        self.spill = None
+        self.spill_bytes = None
+        self.bytes = 0
+        self.bytes_spilled = 0
+        self.hits = 0
+        self.misses = 0
+        self.files = 0
+
+    def configure(self, max_bytes, spill, spill_bytes):
+        with self.lock:
+            self.max_bytes = max_bytes
+            self.spill = spill
+            self.spill_bytes = spill_bytes
+            if max_bytes == 0 or spill is None:
+                while self.spilled:
+                    self._drop_spilled()
+            if max_bytes == 0:
+                self.memory.clear()
+                self.bytes = 0
+                self.hits = self.misses = 0
+            self._evict()
+
+    def get(self, key):
+        with self.lock:
+            if key in self.memory:
+                self.memory.move_to_end(key)
+                self.hits += 1
+                return _cache_map(np.copy, self.memory[key][0])
+            if key not in self.spilled:
+                self.misses += 1
+                return None
+            (skeleton, nbytes) = self.spilled.pop(key)
+            self.bytes_spilled -= nbytes
+            result = _cache_map(self._load_array, skeleton, _SpilledArray)
+            self.hits += 1
+            self._insert(key, result, nbytes)
+            return _cache_map(np.copy, result)
+
+    def put(self, key, result):
+        nbytes = _cache_nbytes(result)
+        with self.lock:
+            if key not in self.memory and key not in self.spilled:
+                self._insert(key, _cache_map(np.copy, result), nbytes)
+
+    def _insert(self, key, result, nbytes):
+        self.memory[key] = (result, nbytes)
+        self.bytes += nbytes
+        self._evict()
+
+    def _evict(self):
+        while self.memory and self.bytes > self.max_bytes:
+            (key, (result, nbytes)) = self.memory.popitem(last=False)
+            self.bytes -= nbytes
+            if self.spill is not None and (self.spill_bytes is None or nbytes <= self.spill_bytes):
+                self.spilled[key] = (_cache_map(self._spill_array, result), nbytes)
+                self.bytes_spilled += nbytes
+        while self.spilled and self.spill_bytes is not None and self.bytes_spilled > self.spill_bytes:
+            self._drop_spilled()
+
+    def _spill_array(self, array):
+        self.files += 1
+        path = os.path.join(self.spill, 'ccpi_result_{}_{}.npy'.format(os.getpid(), self.files))
+        np.save(path, array)
+        return _SpilledArray(path)
+
+    def _load_array(self, spilled):
+        array = np.array(np.load(spilled.path, mmap_mode='r'))
+        os.remove(spilled.path)
+        return array
+
+    def _drop_spilled(self):
+        (key, (skeleton, nbytes)) = self.spilled.popitem(last=False)
+        self.bytes_spilled -= nbytes
+        _cache_map(lambda spilled: os.remove(spilled.path), skeleton, _SpilledArray)
+
+_result_cache = _ResultCache()
+_cache_state = threading.local()
+
+def result_cached(regulariser):
+    """Looks the results of a regulariser up in the result cache when it is switched on
+    (result_cache): the key is the hash of the bytes of the array arguments with their
+    dtype and shape, the other arguments and the device (defaults filled in). Calls
+    writing into out or a checkpoint file, measuring the energy of their phases and runs
+    stopped by submit (RegulariserFuture.stop) are not cached."""
+    signature = inspect.signature(regulariser)
+    @functools.wraps(regulariser)
+    def wrapper(*args, **kwargs):
+        if _result_cache.max_bytes == 0:
+            return regulariser(*args, **kwargs)
+        bound = signature.bind(*args, **kwargs)
+        bound.apply_defaults()
+        if (bound.arguments.get('out') is not None or bound.arguments.get('checkpoint') is not None or
+                bound.arguments.get('energy', False)):
+            return regulariser(*args, **kwargs)
+        key = (regulariser.__name__, _cache_key(tuple(bound.arguments.items())))
+        result = _result_cache.get(key)
+        if result is not None:
+            return result
+        result = regulariser(*args, **kwargs)
+        record = getattr(_cache_state, 'record', None)
+        if record is None or record[2] == 0.0:
+            _result_cache.put(key, result)
+        return result
+    return wrapper
+
+@output_stats
+@output_energy
+@result_cached
 def ROF_TV(inputData, regularisation_parameter, iterations,
-                     time_marching_parameter,tolerance_param,device='cpu'):
+                     time_marching_parameter,tolerance_param,device='cpu', layout=0,
+                     tile=0, tile_sync=8, tile_accuracy=1.0, out=None):
+    """tile > 0 (cpu, 2D, tolerance 0) runs the iterations on tiles of tile x tile pixels
+    which stay in the cache, exchanging their halos every tile_sync iterations.
+    tile_accuracy 1 gives the untiled result, smaller values narrower halos and
+    faster sweeps with small errors at the tile boundaries.
+    out (cpu) is a float32 array the result is written to and returned. inputData and out
+    may be views into larger arrays with contiguous rows (a sub-volume, a padded buffer),
+    the core reads and writes them without contiguous copies; out may be inputData."""
     if device == 'cpu':
         return TV_ROF_CPU(inputData,
                      regularisation_parameter,
                      iterations,
                      time_marching_parameter,
-                     tolerance_param)
+                     tolerance_param,
+                     layout,
+                     tile, tile_sync, tile_accuracy, out)
     elif device == 'gpu' and gpu_enabled:
         return TV_ROF_GPU(inputData,
                      regularisation_parameter,
@@ -29,15 +229,23 @@ def ROF_TV(inputData, regularisation_parameter, iterations,
         raise ValueError('Unknown device {0}. Expecting gpu or cpu'\
                          .format(device))
 
+@output_stats
+@output_energy
+@result_cached
 def FGP_TV(inputData, regularisation_parameter,iterations,
-                     tolerance_param, methodTV, nonneg, device='cpu'):
+                     tolerance_param, methodTV, nonneg, device='cpu', layout=0,
+                     tile=0, tile_sync=8, tile_accuracy=1.0, out=None):
+    """tile, tile_sync and tile_accuracy: tiled 2D iterations as in ROF_TV. out: the
+    output array, views of larger arrays as in ROF_TV."""
     if device == 'cpu':
         return TV_FGP_CPU(inputData,
                      regularisation_parameter,
                      iterations,
                      tolerance_param,
                      methodTV,
-                     nonneg)
+                     nonneg,
+                     layout,
+                     tile, tile_sync, tile_accuracy, out)
     elif device == 'gpu' and gpu_enabled:
         return TV_FGP_GPU(inputData,
                      regularisation_parameter,
@@ -51,8 +259,14 @@ def FGP_TV(inputData, regularisation_parameter,iterations,
         raise ValueError('Unknown device {0}. Expecting gpu or cpu'\
                          .format(device))
 
+@output_stats
+@output_energy
+@result_cached
 def PD_TV(inputData, regularisation_parameter, iterations,
-                     tolerance_param, methodTV, nonneg, lipschitz_const, device='cpu'):
+                     tolerance_param, methodTV, nonneg, lipschitz_const, device='cpu', layout=0,
+                     accelerated=False):
+    """accelerated (cpu only) runs the accelerated primal-dual scheme: the steps and the
+    extrapolation are updated every iteration from the strong convexity of the fidelity."""
     if device == 'cpu':
         return TV_PD_CPU(inputData,
                      regularisation_parameter,
@@ -60,7 +274,9 @@ def PD_TV(inputData, regularisation_parameter, iterations,
                      tolerance_param,
                      methodTV,
                      nonneg,
-                     lipschitz_const)
+                     lipschitz_const,
+                     layout,
+                     accelerated)
     elif device == 'gpu' and gpu_enabled:
         return TV_PD_GPU(inputData,
                      regularisation_parameter,
@@ -75,14 +291,20 @@ def PD_TV(inputData, regularisation_parameter, iterations,
         raise ValueError('Unknown device {0}. Expecting gpu or cpu'\
                          .format(device))
 
+@output_stats
+@output_energy
+@result_cached
 def SB_TV(inputData, regularisation_parameter, iterations,
-                     tolerance_param, methodTV, device='cpu'):
+                     tolerance_param, methodTV, device='cpu', multigrid=False):
+    """multigrid (cpu only) solves the u-subproblem of every iteration with a multigrid
+    V-cycle instead of two Gauss-Seidel sweeps."""
     if device == 'cpu':
         return TV_SB_CPU(inputData,
                      regularisation_parameter,
                      iterations,
                      tolerance_param,
-                     methodTV)
+                     methodTV,
+                     multigrid)
     elif device == 'gpu' and gpu_enabled:
         return TV_SB_GPU(inputData,
                      regularisation_parameter,
@@ -94,10 +316,17 @@ def SB_TV(inputData, regularisation_parameter, iterations,
             raise ValueError ('GPU is not available')
         raise ValueError('Unknown device {0}. Expecting gpu or cpu'\
                          .format(device))
+
+@output_stats
+@output_energy
+@result_cached
 def LLT_ROF(inputData, regularisation_parameterROF, regularisation_parameterLLT, iterations,
-                     time_marching_parameter, tolerance_param, device='cpu'):
+                     time_marching_parameter, tolerance_param, device='cpu', primal_dual=False):
+    """primal_dual (cpu only) minimises the same energy with the accelerated primal-dual
+    solver instead of explicit time marching: far fewer iterations are needed and
+    time_marching_parameter is not used, the steps follow from the operator norm."""
     if device == 'cpu':
-        return LLT_ROF_CPU(inputData, regularisation_parameterROF, regularisation_parameterLLT, iterations, time_marching_parameter, tolerance_param)
+        return LLT_ROF_CPU(inputData, regularisation_parameterROF, regularisation_parameterLLT, iterations, time_marching_parameter, tolerance_param, primal_dual)
     elif device == 'gpu' and gpu_enabled:
         return LLT_ROF_GPU(inputData, regularisation_parameterROF, regularisation_parameterLLT, iterations, time_marching_parameter, tolerance_param)
     else:
@@ -105,8 +334,17 @@ def LLT_ROF(inputData, regularisation_parameterROF, regularisation_parameterLLT,
             raise ValueError ('GPU is not available')
         raise ValueError('Unknown device {0}. Expecting gpu or cpu'\
                          .format(device))
+
+@output_stats
+@output_energy
+@result_cached
 def TGV(inputData, regularisation_parameter, alpha1, alpha0, iterations,
-                     LipshitzConst, tolerance_param, device='cpu'):
+                     LipshitzConst, tolerance_param, device='cpu',
+                     checkpoint=None, checkpoint_interval=0, resume=False, accelerated=False):
+    """checkpoint (cpu only) names a file the state of the iterations is written to every
+    checkpoint_interval iterations (0 - after the last one only); with resume the run
+    continues from the checkpoint in the file and gives the output of an uninterrupted run.
+    accelerated (cpu only): the accelerated primal-dual scheme as in PD_TV."""
     if device == 'cpu':
         return TGV_CPU(inputData,
 					regularisation_parameter,
@@ -114,7 +352,11 @@ def TGV(inputData, regularisation_parameter, alpha1, alpha0, iterations,
 					alpha0,
 					iterations,
                     LipshitzConst,
-                    tolerance_param)
+                    tolerance_param,
+                    checkpoint,
+                    checkpoint_interval,
+                    resume,
+                    accelerated)
     elif device == 'gpu' and gpu_enabled:
         return TGV_GPU(inputData,
 					regularisation_parameter,
@@ -128,8 +370,15 @@ def TGV(inputData, regularisation_parameter, alpha1, alpha0, iterations,
             raise ValueError ('GPU is not available')
         raise ValueError('Unknown device {0}. Expecting gpu or cpu'\
                          .format(device))
+
+@output_stats
+@output_energy
+@result_cached
 def NDF(inputData, regularisation_parameter, edge_parameter, iterations,
-                     time_marching_parameter, penalty_type, tolerance_param, device='cpu'):
+                     time_marching_parameter, penalty_type, tolerance_param, device='cpu', layout=0,
+                     tile=0, tile_sync=8, tile_accuracy=1.0, out=None):
+    """tile, tile_sync and tile_accuracy: tiled 2D iterations as in ROF_TV. out: the
+    output array, views of larger arrays as in ROF_TV."""
     if device == 'cpu':
         return NDF_CPU(inputData,
                      regularisation_parameter,
@@ -137,7 +386,9 @@ def NDF(inputData, regularisation_parameter, edge_parameter, iterations,
                      iterations,
                      time_marching_parameter,
                      penalty_type,
-                     tolerance_param)
+                     tolerance_param,
+                     layout,
+                     tile, tile_sync, tile_accuracy, out)
     elif device == 'gpu' and gpu_enabled:
         return NDF_GPU(inputData,
                      regularisation_parameter,
@@ -151,15 +402,45 @@ def NDF(inputData, regularisation_parameter, edge_parameter, iterations,
     	    raise ValueError ('GPU is not available')
         raise ValueError('Unknown device {0}. Expecting gpu or cpu'\
                          .format(device))
+
+@output_stats
+@output_energy
+@result_cached
+def LinearDiff(inputData, regularisation_parameter, iterations, tolerance_param,
+                     weights=None, device='cpu'):
+    """Steady state of linear diffusion with a fidelity term, (W - lambda*Laplacian) u = W*f,
+    solved with multigrid V-cycles (iterations) until the relative residual is below
+    tolerance_param. weights W (None - 1) vary the regularisation over the image, 0 marks
+    voxels without data which are inpainted."""
+    if device == 'cpu':
+        return LinearDiff_MG_CPU(inputData,
+                     regularisation_parameter,
+                     iterations,
+                     tolerance_param,
+                     weights)
+    raise ValueError('Unknown device {0}. LinearDiff runs on the cpu only'\
+                         .format(device))
+
+@output_stats
+@output_energy
+@result_cached
 def Diff4th(inputData, regularisation_parameter, edge_parameter, iterations,
-                     time_marching_parameter, tolerance_param, device='cpu'):
+                     time_marching_parameter, tolerance_param, device='cpu', layout=0,
+                     tile=0, tile_sync=8, tile_accuracy=1.0, out=None, semi_implicit=False):
+    """tile, tile_sync and tile_accuracy: tiled 2D iterations as in ROF_TV. out: the
+    output array, views of larger arrays as in ROF_TV. semi_implicit (cpu only) treats
+    the biharmonic term implicitly with banded solves along every axis: time steps
+    orders of magnitude above the explicit limit (time_marching_parameter ~ 1) are
+    stable, the result is that of the explicit scheme run to convergence."""
     if device == 'cpu':
         return Diff4th_CPU(inputData,
                      regularisation_parameter,
                      edge_parameter,
                      iterations,
                      time_marching_parameter,
-                     tolerance_param)
+                     tolerance_param,
+                     layout,
+                     tile, tile_sync, tile_accuracy, out, semi_implicit)
     elif device == 'gpu' and gpu_enabled:
         return Diff4th_GPU(inputData,
                      regularisation_parameter,
@@ -172,8 +453,12 @@ def Diff4th(inputData, regularisation_parameter, edge_parameter, iterations,
             raise ValueError ('GPU is not available')
         raise ValueError('Unknown device {0}. Expecting gpu or cpu'\
                          .format(device))
+
+@output_stats
+@output_energy
+@result_cached
 def FGP_dTV(inputData, refdata, regularisation_parameter, iterations,
-                     tolerance_param, eta_const, methodTV, nonneg, device='cpu'):
+                     tolerance_param, eta_const, methodTV, nonneg, device='cpu', layout=0):
     if device == 'cpu':
         return dTV_FGP_CPU(inputData,
                      refdata,
@@ -182,7 +467,8 @@ def FGP_dTV(inputData, refdata, regularisation_parameter, iterations,
                      tolerance_param,
                      eta_const,
                      methodTV,
-                     nonneg)
+                     nonneg,
+                     layout)
     elif device == 'gpu' and gpu_enabled:
         return dTV_FGP_GPU(inputData,
                      refdata,
@@ -197,18 +483,35 @@ def FGP_dTV(inputData, refdata, regularisation_parameter, iterations,
             raise ValueError ('GPU is not available')
         raise ValueError('Unknown device {0}. Expecting gpu or cpu'\
                          .format(device))
+
+@result_cached
 def TNV(inputData, regularisation_parameter, iterations, tolerance_param):
         return TNV_CPU(inputData,
                      regularisation_parameter,
                      iterations,
                      tolerance_param)
-def PatchSelect(inputData, searchwindow, patchwindow, neighbours, edge_parameter, device='cpu'):
+
+@result_cached
+def PatchSelect(inputData, searchwindow, patchwindow, neighbours, edge_parameter, device='cpu',
+                     previous=None, graph=None, threshold=0.0, mass=None):
+    """previous (cpu only) is the preceding frame of a time series and graph the
+    (H_i, H_j, Weights) returned for it: the neighbours are searched again only near
+    voxels that changed by more than threshold, elsewhere they are kept and their
+    weights recomputed. With threshold 0 the result equals a full search.
+    mass (cpu only) returns the graph in the compressed (CSR) form (RowPtr, Neighbours,
+    Weights) instead: each voxel keeps its fewest largest weights making up that fraction
+    of the sum of its weights, mass 1 keeps all the non-zero ones. It is given to NLTV
+    in place of (H_i, H_j, Weights)."""
     if device == 'cpu':
         return PATCHSEL_CPU(inputData,
                      searchwindow,
                      patchwindow,
                      neighbours,
-                     edge_parameter)
+                     edge_parameter,
+                     previous,
+                     graph,
+                     threshold,
+                     mass)
     elif device == 'gpu' and gpu_enabled:
         return PATCHSEL_GPU(inputData,
                      searchwindow,
@@ -221,11 +524,331 @@ def PatchSelect(inputData, searchwindow, patchwindow, neighbours, edge_parameter
         raise ValueError('Unknown device {0}. Expecting gpu or cpu'\
                          .format(device))
 
-def NLTV(inputData, H_i, H_j, H_k, Weights, regularisation_parameter, iterations):
+@result_cached
+def NLTV(inputData, H_i, H_j, H_k, Weights, regularisation_parameter, iterations,
+                     checkpoint=None, checkpoint_interval=0, resume=False):
+    """checkpoint, checkpoint_interval and resume as for TGV, the same weights must be
+    given when resuming. H_i, H_j and Weights can be the RowPtr, Neighbours and Weights
+    of a CSR graph from PatchSelect with mass, H_k is then ignored."""
     return NLTV_CPU(inputData,
                      H_i,
                      H_j,
                      H_k,
                      Weights,
                      regularisation_parameter,
-                     iterations)
+                     iterations,
+                     checkpoint,
+                     checkpoint_interval,
+                     resume)
+
+def noise_level(inputData, per_slice=False):
+    """Standard deviation of the additive white Gaussian noise of inputData, estimated
+    in one parallel pass from the median absolute deviation of the finest diagonal Haar
+    wavelet coefficients. per_slice gives one estimate per slice of a volume."""
+    return NOISE_CPU(inputData, per_slice)
+
+# regularisation parameter over the noise standard deviation at which the removed part
+# of a Lena image matches the noise (discrepancy), for the default parameters below
+AUTO_LAMBDA = {'ROF_TV': 1.4, 'FGP_TV': 1.1, 'NDF': 1.05}
+
+def auto_lambda(method, inputData, iterations, noise=None, discrepancy=True, solves=2,
+                     per_slice=False, tau=1.0, device='cpu', **parameters):
+    """Runs the regulariser named method (ROF_TV, FGP_TV or NDF) with a regularisation
+    parameter picked from the noise level instead of a sweep. noise is the standard
+    deviation of the noise (None - noise_level of the input). The first solve uses
+    AUTO_LAMBDA[method]*noise; with discrepancy every further solve (solves in all)
+    rescales the parameter so that the rms of inputData - output matches tau*noise, the
+    secant of the last two solves in log-log giving the step. per_slice (ROF_TV on a
+    volume) picks one parameter per slice, run as a parameter volume. The other
+    parameters are given by name (time_marching_parameter, tolerance_param, methodTV,
+    nonneg, edge_parameter, penalty_type, layout), the defaults are those of the demos.
+    Returns (output, infovector, regularisation parameter)."""
+    if method not in AUTO_LAMBDA:
+        raise ValueError('No automatic regularisation parameter for {0}'.format(method))
+    if per_slice and (method != 'ROF_TV' or inputData.ndim != 3):
+        raise ValueError('per_slice needs ROF_TV on a volume')
+    p = dict(parameters)
+    def solve(lam):
+        if per_slice:
+            lam = np.ascontiguousarray(np.broadcast_to(
+                    lam[:,None,None], inputData.shape), dtype='float32')
+        if method == 'ROF_TV':
+            return ROF_TV(inputData, lam, iterations, p.get('time_marching_parameter', 0.001),
+                     p.get('tolerance_param', 0.0), device, p.get('layout', 0))
+        if method == 'FGP_TV':
+            return FGP_TV(inputData, lam, iterations, p.get('tolerance_param', 0.0),
+                     p.get('methodTV', 0), p.get('nonneg', 0), device, p.get('layout', 0))
+        return NDF(inputData, lam, p.get('edge_parameter', 0.015), iterations,
+                     p.get('time_marching_parameter', 0.025), p.get('penalty_type', 1),
+                     p.get('tolerance_param', 0.0), device, p.get('layout', 0))
+    def removed(output):
+        axes = (1, 2) if per_slice else None
+        return np.maximum(np.sqrt(np.mean((output - inputData)**2, axis=axes)), 1e-12)
+    if noise is None:
+        noise = noise_level(inputData, per_slice)
+    noise = np.asarray(noise, dtype='float64')
+    lam = AUTO_LAMBDA[method]*noise
+    last = None
+    for k in range(solves if discrepancy else 1):
+        if k > 0:
+            # near the discrepancy the removed part grows about as the parameter to the
+            # power 0.3 (ROF, FGP and NDF alike), the last two solves measure it from the
+            # third solve on
+            slope = 0.3
+            if last is not None:
+                with np.errstate(divide='ignore', invalid='ignore'):
+                    slope = np.log(r/last[1])/np.log(lam/last[0])
+                slope = np.clip(np.nan_to_num(slope, nan=0.3), 0.1, 2.0)
+            last = (lam, r)
+            lam = lam*(tau*noise/r)**(1.0/slope)
+        (output, info) = solve(lam if per_slice else float(lam))
+        r = removed(output)
+    return (output, info, lam if per_slice else float(lam))
+
+@output_stats
+@output_energy
+@result_cached
+def pipeline(inputData, stages, device='cpu', energy=False):
+    """Runs a chain of regularisers on inputData, each stage on the output of the previous
+    one. A stage is a tuple of the name of the regulariser (ROF_TV, FGP_TV, PD_TV, NDF,
+    Diff4th, LLT_ROF or TGV) and its arguments after inputData up to tolerance_param (the
+    cpu device, planar layout), with a dict of the options accelerated, semi_implicit or
+    primal_dual last if needed; ('clamp', lo, hi) clamps the values (None - no bound) and
+    ('scale', a, b) gives a*U + b. The stages share one workspace of work arrays sized
+    for the largest of them and two output arrays; the pointwise stages after ROF_TV,
+    FGP_TV, PD_TV or NDF are applied by its last iteration, otherwise a run of them is one
+    pass over the output.
+    Returns (output, infovector): [iterations, tolerance] of every stage, then the size
+    of the workspace and the number of work arrays which did not fit into it. energy
+    appends the joules of every stage (pointwise stages count on the regulariser before
+    them, a leading run on its first stage) and of the whole call."""
+    if device == 'cpu':
+        return PIPELINE_CPU(inputData, stages, energy)
+    else:
+        raise ValueError('Unknown device {0}. The pipeline runs on the cpu only'\
+                         .format(device))
+
+def peak_memory(method, shape, tolerance_param=0.0, layout=0, device='cpu',
+                     searchwindow=0, patchwindow=0, neighbours=0, lambdas=0, multigrid=False,
+                     tile=0, tile_sync=8, tile_accuracy=1.0, views=(False, False), semi_implicit=False,
+                     primal_dual=False, stages=None, mass=None):
+    """Peak number of bytes a call of the regulariser named method (ROF_TV, FGP_TV, ...)
+    allocates for float32 data of the given shape: the returned arrays and the work
+    arrays of the core. The input arrays are not included. lambdas > 0 gives the
+    peak of the lockstep solving of that many regularisation parameters, multigrid
+    the peak of SB_TV with the multigrid solver, tile > 0 that of the tiled 2D solving,
+    views the peak when the input and the output (a pair of flags) are views of larger
+    arrays or the output is the input, semi_implicit that of the semi-implicit Diff4th,
+    primal_dual that of the primal-dual LLT_ROF, mass that of PatchSelect building a CSR
+    graph when all neighbours are kept (an upper bound). method 'pipeline' gives the peak
+    of the pipeline of the given stages."""
+    if device == 'cpu' and method == 'pipeline':
+        return PIPELINE_MEM_CPU(tuple(shape), stages)
+    if device == 'cpu':
+        return CPU_peak_memory(method,
+                     tuple(shape),
+                     tolerance_param,
+                     layout,
+                     searchwindow,
+                     patchwindow,
+                     neighbours,
+                     lambdas,
+                     multigrid,
+                     tile, tile_sync, tile_accuracy,
+                     views, semi_implicit, primal_dual, mass is not None)
+    else:
+        raise ValueError('Unknown device {0}. Peak memory is predicted for the cpu only'\
+                         .format(device))
+
+def huge_pages(enable=None):
+    """Switches the huge-page allocation of the large CPU work arrays on or off
+    (on by default) when enable is given. Returns a pair with the bytes that took
+    that path since the previous call and the bytes of the arrays of that path in
+    use at the call the kernel backs with huge pages (-1 when it cannot be told), so
+    the backing of a run is seen by a call while it runs (see submit)."""
+    if enable is not None:
+        HUGEPAGES_CPU(enable)
+    return HUGEPAGES_INFO_CPU()
+
+def streaming_stores(threshold=None):
+    """Sets the size in bytes from which the CPU regularisers write their write-once
+    arrays (copies into Output_prev and P_prev, the initial output, the ROF differences
+    D1/D2/D3, the first touch of the work arrays) with non-temporal stores that bypass
+    the cache: 0 switches them off, -1 restores the default (a quarter of the last level
+    cache). Returns the size in use, 0 when off or not supported by the platform."""
+    return STREAMING_CPU(threshold)
+
+def checkpoint_iterations(checkpoint):
+    """Iterations done in the latest checkpoint of the file written by TGV or NLTV,
+    -1 when it holds none."""
+    return CHECKPOINT_ITERATIONS_CPU(checkpoint)
+
+def thread_pool(threads=None):
+    """Runs the kernels of the CPU regularisers that support it (ROF_TV, FGP_TV, PD_TV, TGV and
+    NDF with the planar layout) on one library-wide work-stealing pool shared by all calling
+    threads when threads is given: the number of workers, -1 for the OpenMP thread count, 0
+    stops the pool and the kernels go back to OpenMP. May be switched while regularisers are
+    running: the kernels already on the pool finish there, the following ones run on the new
+    setting. Returns the number of pool workers (0 - OpenMP)."""
+    if threads is None:
+        return POOL_THREADS_CPU()
+    return POOL_CPU(threads)
+
+# the calls timed by calibrate_cost_model: fixed iterations (no early stopping), past the result cache
+_COST_RUNS = {'ROF_TV': lambda u, it: inspect.unwrap(ROF_TV)(u, 0.02, it, 0.001, 0.0, 'cpu'),
+              'FGP_TV': lambda u, it: inspect.unwrap(FGP_TV)(u, 0.02, it, 0.0, 0, 0, 'cpu'),
+              'PD_TV': lambda u, it: inspect.unwrap(PD_TV)(u, 0.02, it, 0.0, 0, 0, 8.0, 'cpu'),
+              'SB_TV': lambda u, it: inspect.unwrap(SB_TV)(u, 0.02, it, 0.0, 0, 'cpu'),
+              'LLT_ROF': lambda u, it: inspect.unwrap(LLT_ROF)(u, 0.01, 0.0085, it, 0.0001, 0.0, 'cpu'),
+              'TGV': lambda u, it: inspect.unwrap(TGV)(u, 0.02, 1.0, 2.0, it, 12, 0.0, 'cpu'),
+              'NDF': lambda u, it: inspect.unwrap(NDF)(u, 0.02, 0.015, it, 0.025, 1, 0.0, 'cpu'),
+              'Diff4th': lambda u, it: inspect.unwrap(Diff4th)(u, 0.8, 0.02, it, 0.0001, 0.0, 'cpu'),
+              'FGP_dTV': lambda u, it: inspect.unwrap(FGP_dTV)(u, u, 0.02, it, 0.0, 0.2, 0, 0, 'cpu')}
+
+def _cost_time(run, data, iterations):
+    # the best of the runs made in at least 0.05 s
+    best = None
+    total = 0.0
+    while best is None or total < 0.05:
+        start = timeit.default_timer()
+        run(data, iterations)
+        seconds = timeit.default_timer() - start
+        best = seconds if best is None else min(best, seconds)
+        total += seconds
+    return best
+
+def calibrate_cost_model(calibration, methods=None, shapes=((256,256), (1024,1024), (16,128,128), (64,256,256)),
+                     iterations=(5, 25), threads=None):
+    """Fits the runtime model of the CPU regularisers (cost_model.h) on this machine and
+    writes it to the file calibration. Every method (ROF_TV, FGP_TV, PD_TV, SB_TV, LLT_ROF,
+    TGV, NDF, Diff4th, FGP_dTV; all when None) is timed on random data of the given
+    shapes with both iteration counts, on one thread and on threads (the OpenMP thread
+    count when None): the costs per voxel come from the one-thread timings, the parallel
+    fraction from the largest shape of each dimensionality. Takes a few minutes with the
+    default shapes. Returns {(method, ndim): (fraction, threads, [(voxels, set-up,
+    per iteration), ...])}, the costs in seconds per voxel of one thread."""
+    methods = sorted(_COST_RUNS) if methods is None else methods
+    threads = COST_THREADS_CPU(0) if threads is None else threads
+    (low, high) = iterations
+    model = {}
+    previous = COST_THREADS_CPU(1)
+    try:
+        for method in methods:
+            run = _COST_RUNS[method]
+            for ndim in (2, 3):
+                sized = sorted((s for s in shapes if len(s) == ndim), key=np.prod)
+                points = []
+                for shape in sized:
+                    data = np.random.rand(*shape).astype('float32')
+                    voxels = float(np.prod(shape))
+                    (t_low, t_high) = (_cost_time(run, data, low), _cost_time(run, data, high))
+                    per_iteration = max(t_high - t_low, 0.0)/(high - low)/voxels
+                    points.append((voxels, max(t_low/voxels - low*per_iteration, 0.0), per_iteration))
+                if not points:
+                    continue
+                fraction = 1.0
+                if threads > 1:
+                    COST_THREADS_CPU(threads)
+                    ratio = _cost_time(run, data, high)/t_high
+                    COST_THREADS_CPU(1)
+                    fraction = min(max((1.0 - ratio)/(1.0 - 1.0/threads), 0.0), 1.0)
+                model[(method, ndim)] = (fraction, threads, points)
+    finally:
+        COST_THREADS_CPU(previous)
+    with open(calibration, 'w') as f:
+        f.write('# name ndim parallel_fraction threads points [voxels setup_s_per_voxel s_per_voxel_iteration]...\n')
+        for ((method, ndim), (fraction, timed, points)) in sorted(model.items()):
+            f.write('{} {} {:.6g} {} {} {}\n'.format(method, ndim, fraction, timed, len(points),
+                    ' '.join('{:.6g} {:.6g} {:.6g}'.format(*p) for p in points)))
+    return model
+
+def predict_runtime(calibration, method, shape, iterations, threads=0):
+    """Predicted wall time in seconds of the CPU regulariser named method (as in
+    calibrate_cost_model) on float32 data of the given shape with a fixed number of
+    iterations and threads OpenMP threads (0 - the current count), from the model in the
+    file calibration. Early stopping by a tolerance is not predicted."""
+    seconds = COST_PREDICT_CPU(calibration, method, tuple(shape), iterations, threads)
+    if seconds < 0.0:
+        raise ValueError('No calibration of {0} on {1}D data in {2}'.format(method, len(shape), calibration))
+    return seconds
+
+def energy_counter():
+    """Joules the processor packages used since the first reading, from the Linux
+    powercap/RAPL counters; None when they cannot be read (no RAPL, counters readable
+    by root only). The difference of two readings measures a region of a script."""
+    joules = ENERGY_CPU()
+    return None if np.isnan(joules) else joules
+
+def result_cache(max_bytes=None, spill=None, spill_bytes=None):
+    """Opt-in cache of the results of the regularisers, off by default. max_bytes > 0
+    switches it on and bounds the bytes of the cached outputs held in memory (least
+    recently used evicted first), 0 switches it off and empties it. spill names a
+    directory the evicted results are written to as .npy files, up to spill_bytes (None -
+    no bound), and read back through a memory map when hit. A hit returns copies of the
+    cached outputs without running the regulariser. Returns (hits, misses, bytes in
+    memory, bytes spilled)."""
+    if max_bytes is not None:
+        _result_cache.configure(max_bytes, spill, spill_bytes)
+    return (_result_cache.hits, _result_cache.misses, _result_cache.bytes, _result_cache.bytes_spilled)
+
+class RegulariserFuture(concurrent.futures.Future):
+    """Future of a regulariser started by submit. progress() reads the iterations done
+    and the last relative change of the early stopping check (0 until one is computed)
+    of the running CPU core without locking. cancel() only cancels a call which has not
+    started, as for any future. stop() also asks a running core to stop at the end of
+    its current iteration: it returns at once, the future is done and cancelled (raises
+    CancelledError) when the core has stopped."""
+
+    def __init__(self):
+        super().__init__()
+        self._record = np.zeros([3], dtype='float32')
+        self._stopped = False
+
+    def progress(self):
+        return (int(self._record[0]), float(self._record[1]))
+
+    def stop(self):
+        # True if the call was cancelled before it started or the running core was asked to stop
+        if self.cancel():
+            return True
+        if self.done():
+            return False
+        self._record[2] = 1.0
+        return True
+
+    def cancelled(self):
+        return super().cancelled() or self._stopped
+
+def _run_future(future, regulariser, args, kwargs):
+    if not future.set_running_or_notify_cancel():
+        return
+    _cache_state.record = future._record
+    try:
+        result = PROGRESS_RUN_CPU(future._record, regulariser, args, kwargs)
+    except BaseException as error:
+        future.set_exception(error)
+        return
+    finally:
+        _cache_state.record = None
+    if future._record[2] != 0.0:
+        future._stopped = True
+        future.set_exception(concurrent.futures.CancelledError())
+    else:
+        future.set_result(result)
+
+# the one thread of submit, created by the first call
+_submit_executor = None
+_submit_lock = threading.Lock()
+
+def submit(regulariser, *args, **kwargs):
+    """Starts regulariser(*args, **kwargs) (ROF_TV, FGP_TV, ..., pipeline) in the
+    background and returns a RegulariserFuture at once. The submitted calls run one
+    after another on one thread (the cores use all the OpenMP threads each), the CPU
+    cores release the GIL while they iterate."""
+    global _submit_executor
+    with _submit_lock:
+        if _submit_executor is None:
+            _submit_executor = concurrent.futures.ThreadPoolExecutor(max_workers=1)
+    future = RegulariserFuture()
+    _submit_executor.submit(_run_future, future, regulariser, args, kwargs)
+    return future
@@ -15,32 +15,256 @@ Author: Edoardo Pasca, Daniil Kazantsev
 """
 
 import cython
+import os
+import threading
 import numpy as np
 cimport numpy as np
 
-cdef extern float TV_ROF_CPU_main(float *Input, float *Output, float *infovector, float *lambdaPar, int lambda_is_arr, int iterationsNumb, float tau, float epsil, int dimX, int dimY, int dimZ);
-cdef extern float TV_FGP_CPU_main(float *Input, float *Output, float *infovector, float lambdaPar, int iterationsNumb, float epsil, int methodTV, int nonneg, int dimX, int dimY, int dimZ);
-cdef extern float PDTV_CPU_main(float *Input, float *U, float *infovector, float lambdaPar, int iterationsNumb, float epsil, float lipschitz_const, int methodTV, int nonneg, int dimX, int dimY, int dimZ);
-cdef extern float SB_TV_CPU_main(float *Input, float *Output, float *infovector, float mu, int iter, float epsil, int methodTV, int dimX, int dimY, int dimZ);
-cdef extern float LLT_ROF_CPU_main(float *Input, float *Output, float *infovector, float lambdaROF, float lambdaLLT, int iterationsNumb, float tau, float epsil, int dimX, int dimY, int dimZ);
+cdef extern float TV_ROF_CPU_main(float *Input, float *Output, float *infovector, float *lambdaPar, int lambda_is_arr, int iterationsNumb, float tau, float epsil, int layout, int dimX, int dimY, int dimZ) nogil
+cdef extern float TV_FGP_CPU_main(float *Input, float *Output, float *infovector, float lambdaPar, int iterationsNumb, float epsil, int methodTV, int nonneg, int layout, int dimX, int dimY, int dimZ) nogil
+cdef extern float PDTV_CPU_main(float *Input, float *U, float *infovector, float lambdaPar, int iterationsNumb, float epsil, float lipschitz_const, int methodTV, int nonneg, int algorithm, int layout, int dimX, int dimY, int dimZ) nogil
+cdef extern float SB_TV_CPU_main(float *Input, float *Output, float *infovector, float mu, int iter, float epsil, int methodTV, int solver, int dimX, int dimY, int dimZ) nogil
+cdef extern float LLT_ROF_CPU_main(float *Input, float *Output, float *infovector, float lambdaROF, float lambdaLLT, int iterationsNumb, float tau, float epsil, int algorithm, int dimX, int dimY, int dimZ) nogil
 cdef extern float TGV_main(float *Input, float *Output, float *infovector, float lambdaPar, float alpha1, float alpha0, int iterationsNumb, float L2, float epsil, int dimX, int dimY, int dimZ);
-cdef extern float Diffusion_CPU_main(float *Input, float *Output, float *infovector, float lambdaPar, float sigmaPar, int iterationsNumb, float tau, int penaltytype, float epsil, int dimX, int dimY, int dimZ);
-cdef extern float Diffus4th_CPU_main(float *Input, float *Output,  float *infovector, float lambdaPar, float sigmaPar, int iterationsNumb, float tau, float epsil, int dimX, int dimY, int dimZ);
-cdef extern float dTV_FGP_CPU_main(float *Input, float *InputRef, float *Output, float *infovector, float lambdaPar, int iterationsNumb, float epsil, float eta, int methodTV, int nonneg, int dimX, int dimY, int dimZ);
-cdef extern float TNV_CPU_main(float *Input, float *u, float lambdaPar, int maxIter, float tol, int dimX, int dimY, int dimZ);
+cdef extern float Diffusion_CPU_main(float *Input, float *Output, float *infovector, float lambdaPar, float sigmaPar, int iterationsNumb, float tau, int penaltytype, float epsil, int layout, int dimX, int dimY, int dimZ) nogil
+cdef extern float LinearDiff_MG_CPU_main(float *Input, float *Output, float *infovector, float *Weights, float lambdaPar, int cycles, float epsil, int dimX, int dimY, int dimZ) nogil
+cdef extern float TV_ROF_CPU_multi(float *Input, float *Output, float *infovector, float *lambdas, int K, int iterationsNumb, float tau, int dimX, int dimY, int dimZ) nogil
+cdef extern float TV_FGP_CPU_multi(float *Input, float *Output, float *infovector, float *lambdas, int K, int iterationsNumb, int methodTV, int nonneg, int dimX, int dimY, int dimZ) nogil
+cdef extern float Diffusion_CPU_multi(float *Input, float *Output, float *infovector, float *lambdas, int K, float sigmaPar, int iterationsNumb, float tau, int penaltytype, int dimX, int dimY, int dimZ) nogil
+cdef extern float TV_ROF_CPU_strided(float *Input, long inPitchY, long inPitchZ, float *Output, long outPitchY, long outPitchZ, float *infovector, float *lambdaPar, int lambda_is_arr, int iterationsNumb, float tau, float epsil, int dimX, int dimY, int dimZ) nogil
+cdef extern float TV_FGP_CPU_strided(float *Input, long inPitchY, long inPitchZ, float *Output, long outPitchY, long outPitchZ, float *infovector, float lambdaPar, int iterationsNumb, float epsil, int methodTV, int nonneg, int dimX, int dimY, int dimZ) nogil
+cdef extern float Diffusion_CPU_strided(float *Input, long inPitchY, long inPitchZ, float *Output, long outPitchY, long outPitchZ, float *infovector, float lambdaPar, float sigmaPar, int iterationsNumb, float tau, int penaltytype, float epsil, int dimX, int dimY, int dimZ) nogil
+cdef extern float Diffus4th_CPU_strided(float *Input, long inPitchY, long inPitchZ, float *Output, long outPitchY, long outPitchZ, float *infovector, float lambdaPar, float sigmaPar, int iterationsNumb, float tau, float epsil, int scheme, int dimX, int dimY, int dimZ) nogil
+cdef extern float TV_ROF_CPU_tiled(float *Input, float *Output, float *infovector, float lambdaPar, int iterationsNumb, float tau, int tile, int sync, float accuracy, int dimX, int dimY) nogil
+cdef extern float TV_FGP_CPU_tiled(float *Input, float *Output, float *infovector, float lambdaPar, int iterationsNumb, int methodTV, int nonneg, int tile, int sync, float accuracy, int dimX, int dimY) nogil
+cdef extern float Diffusion_CPU_tiled(float *Input, float *Output, float *infovector, float lambdaPar, float sigmaPar, int iterationsNumb, float tau, int penaltytype, int tile, int sync, float accuracy, int dimX, int dimY) nogil
+cdef extern float Diffus4th_CPU_tiled(float *Input, float *Output, float *infovector, float lambdaPar, float sigmaPar, int iterationsNumb, float tau, int tile, int sync, float accuracy, int dimX, int dimY) nogil
+cdef extern float Diffus4th_CPU_main(float *Input, float *Output,  float *infovector, float lambdaPar, float sigmaPar, int iterationsNumb, float tau, float epsil, int scheme, int layout, int dimX, int dimY, int dimZ) nogil
+cdef extern float dTV_FGP_CPU_main(float *Input, float *InputRef, float *Output, float *infovector, float lambdaPar, int iterationsNumb, float epsil, float eta, int methodTV, int nonneg, int layout, int dimX, int dimY, int dimZ) nogil
+cdef extern float TNV_CPU_main(float *Input, float *u, float lambdaPar, int maxIter, float tol, int dimX, int dimY, int dimZ) nogil
 cdef extern float PatchSelect_CPU_main(float *Input, unsigned short *H_i, unsigned short *H_j, unsigned short *H_k, float *Weights, int dimX, int dimY, int dimZ, int SearchWindow, int SimilarWin, int NumNeighb, float h);
 cdef extern float Nonlocal_TV_CPU_main(float *A_orig, float *Output, unsigned short *H_i, unsigned short *H_j, unsigned short *H_k, float *Weights, int dimX, int dimY, int dimZ, int NumNeighb, float lambdaReg, int IterNumb, int switchM);
+cdef extern float TGV_main_ckpt(float *Input, float *Output, float *infovector, float lambdaPar, float alpha1, float alpha0, int iterationsNumb, float L2, float epsil, int algorithm, int dimX, int dimY, int dimZ, const char *checkpoint, int interval, int resume) nogil
+cdef extern float Nonlocal_TV_CPU_ckpt(float *A_orig, float *Output, unsigned short *H_i, unsigned short *H_j, unsigned short *H_k, float *Weights, int dimX, int dimY, int dimZ, int NumNeighb, float lambdaReg, int IterNumb, int switchM, const char *checkpoint, int interval, int resume) nogil
+
+cdef extern long TV_ROF_CPU_mem(float epsil, int layout, int dimX, int dimY, int dimZ);
+cdef extern long TV_FGP_CPU_mem(float epsil, int layout, int dimX, int dimY, int dimZ);
+cdef extern long PDTV_CPU_mem(int layout, int dimX, int dimY, int dimZ);
+cdef extern long SB_TV_CPU_mem(int solver, int dimX, int dimY, int dimZ);
+cdef extern long LLT_ROF_CPU_mem(float epsil, int algorithm, int dimX, int dimY, int dimZ);
+cdef extern long TGV_mem(int dimX, int dimY, int dimZ);
+cdef extern long Diffusion_CPU_mem(float epsil, int layout, int dimX, int dimY, int dimZ);
+cdef extern long LinearDiff_MG_CPU_mem(int weights, int dimX, int dimY, int dimZ);
+cdef extern long TV_ROF_CPU_multi_mem(int K, int dimX, int dimY, int dimZ);
+cdef extern long TV_FGP_CPU_multi_mem(int K, int dimX, int dimY, int dimZ);
+cdef extern long Diffusion_CPU_multi_mem(int K, int dimX, int dimY, int dimZ);
+cdef extern long TV_ROF_CPU_strided_mem(float epsil, int in_strided, int out_strided, int dimX, int dimY, int dimZ);
+cdef extern long TV_FGP_CPU_strided_mem(float epsil, int in_strided, int out_strided, int dimX, int dimY, int dimZ);
+cdef extern long Diffusion_CPU_strided_mem(float epsil, int in_strided, int out_strided, int dimX, int dimY, int dimZ);
+cdef extern long Diffus4th_CPU_strided_mem(float epsil, int scheme, int in_strided, int out_strided, int dimX, int dimY, int dimZ);
+cdef extern long TV_ROF_CPU_tiled_mem(int tile, int sync, float accuracy, int dimX, int dimY);
+cdef extern long TV_FGP_CPU_tiled_mem(int tile, int sync, float accuracy, int dimX, int dimY);
+cdef extern long Diffusion_CPU_tiled_mem(int tile, int sync, float accuracy, int dimX, int dimY);
+cdef extern long Diffus4th_CPU_tiled_mem(int tile, int sync, float accuracy, int dimX, int dimY);
+cdef extern long Diffus4th_CPU_mem(float epsil, int scheme, int layout, int dimX, int dimY, int dimZ);
+cdef extern long dTV_FGP_CPU_mem(float epsil, int layout, int dimX, int dimY, int dimZ);
+cdef extern long TNV_CPU_mem(int dimX, int dimY, int dimZ);
+cdef extern float PatchSelect_CPU_update(float *A, float *A_prev, unsigned short *H_i, unsigned short *H_j, unsigned short *H_k, float *Weights, int dimX, int dimY, int dimZ, int SearchWindow, int SimilarWin, int NumNeighb, float h, float threshold);
+cdef extern long PatchSelect_CPU_mem(int dimZ, int SearchWindow, int SimilarWin);
+cdef extern long PatchSelect_CPU_csr(unsigned short *H_i, unsigned short *H_j, unsigned short *H_k, float *Weights, long long *RowPtr, int *Neighb, float *WeightsCSR, int dimX, int dimY, int dimZ, int NumNeighb, float mass);
+cdef extern float Nonlocal_TV_CPU_csr(float *A_orig, float *Output, long long *RowPtr, int *Neighb, float *WeightsCSR, int dimX, int dimY, int dimZ, float lambdaReg, int IterNumb, const char *checkpoint, int interval, int resume) nogil
+cdef extern long Nonlocal_TV_CPU_mem(int dimX, int dimY, int dimZ);
+
+cdef extern void Vol_huge_pages(int enable);
+cdef extern void Vol_huge_pages_info(long *info);
+cdef extern long Vol_streaming(long bytes);
+cdef extern long Vol_streaming_bytes();
+cdef extern int Pool_start(int threads);
+cdef extern void Pool_stop();
+cdef extern int Pool_threads();
+cdef extern int Ckpt_iterations(const char *path);
+cdef extern void Progress_bind(float *record);
+cdef extern unsigned long long Vol_hash(const unsigned char *data, long bytes) nogil
+cdef extern double Energy_read()
+cdef extern int Energy_source(const char *root)
+cdef extern float Cost_predict(const char *path, const char *method, long dimX, long dimY, long dimZ, int iterations, int threads)
+cdef extern int Cost_threads(int threads)
+cdef extern float Vec_exp(float *A, long n) nogil
+cdef extern float Vec_rsqrt(float *A, long n) nogil
+cdef extern float Noise_estimate(float *Input, float *sigma, int perslice, int dimX, int dimY, int dimZ);
+cdef extern float Output_stats(float *A, float *stats, long long *hist, int nbins, float lo, float hi, long DimTotal);
+cdef extern int Output_stats_bind(float *stats, long long *hist, int nbins, float lo, float hi, long DimTotal);
+cdef extern float Pipeline_run(float *Input, float *Output, float *infovector, float *energy, int nstages, int *methods, int *iterations, float *params, int dimX, int dimY, int dimZ) nogil
+cdef extern long Pipeline_mem(int nstages, int *methods, float *params, int dimX, int dimY, int dimZ);
 
 cdef extern float TV_energy2D(float *U, float *U0, float *E_val, float lambdaPar, int type, int dimX, int dimY);
 cdef extern float TV_energy3D(float *U, float *U0, float *E_val, float lambdaPar, int type, int dimX, int dimY, int dimZ);
+#****************************************************************#
+#****************** Lockstep multi-lambda solving ***************#
+#****************************************************************#
+# A list, tuple or 1D array of K regularisation parameters runs the ROF, FGP and NDF
+# solvers for all of them in lockstep; the output has the shape (K,) + inputData.shape
+def lockstep_lambdas(regularisation_parameter):
+    if isinstance(regularisation_parameter, (list, tuple)) or \
+       (isinstance(regularisation_parameter, np.ndarray) and regularisation_parameter.ndim == 1):
+        return np.ascontiguousarray(regularisation_parameter, dtype='float32')
+    return None
+
+def lockstep_check(inputData, lambdas, tolerance_param):
+    if inputData.ndim not in (2, 3):
+        raise ValueError('lockstep solving needs a 2D or 3D input')
+    if lambdas.size == 0:
+        raise ValueError('lockstep solving needs at least one regularisation parameter')
+    if tolerance_param != 0.0:
+        raise ValueError('lockstep solving runs a fixed number of iterations, set the tolerance to 0')
+    if inputData.ndim == 2:
+        dims = (inputData.shape[1], inputData.shape[0], 1)
+    else:
+        dims = (inputData.shape[2], inputData.shape[1], inputData.shape[0])
+    return np.ascontiguousarray(inputData, dtype='float32'), dims
+
+#****************************************************************#
+#********************** Tiled 2D solving ************************#
+#****************************************************************#
+# tile > 0 runs the ROF, FGP, NDF and Diff4th iterations of a 2D image on tiles of
+# tile x tile pixels, with halo exchanges every 'sync' iterations; accuracy 1 gives the
+# untiled result, smaller values narrower halos
+def tile_check(inputData, regularisation_parameter, tolerance_param, out):
+    if out is not None:
+        raise ValueError('tiled solving returns a new array, out cannot be given')
+    if inputData.ndim != 2:
+        raise ValueError('tiled solving needs a 2D input')
+    if isinstance(regularisation_parameter, np.ndarray):
+        raise ValueError('tiled solving needs a scalar regularisation parameter')
+    if tolerance_param != 0.0:
+        raise ValueError('tiled solving runs a fixed number of iterations, set the tolerance to 0')
+    return np.ascontiguousarray(inputData, dtype='float32')
+
+def TILED_2D(int method, np.ndarray[np.float32_t, ndim=2, mode="c"] inputData,
+                     float regularisation_parameter,
+                     float edge_parameter,
+                     int iterationsNumb,
+                     float time_marching_parameter,
+                     int penalty_type,
+                     int tile,
+                     int sync,
+                     float accuracy):
+    # method: 0 - ROF, 1 - FGP (edge_parameter - methodTV, penalty_type - nonneg), 2 - NDF,
+    # 3 - Diff4th (penalty_type - scheme)
+    cdef int dimX = inputData.shape[1], dimY = inputData.shape[0]
+    cdef int methodTV = <int>edge_parameter
+    cdef np.ndarray[np.float32_t, ndim=2, mode="c"] outputData = \
+            np.zeros([dimY, dimX], dtype='float32')
+    cdef np.ndarray[np.float32_t, ndim=1, mode="c"] infovec = \
+            np.zeros([2], dtype='float32')
+    with nogil:
+        if method == 0:
+            TV_ROF_CPU_tiled(&inputData[0,0], &outputData[0,0], &infovec[0], regularisation_parameter, iterationsNumb, time_marching_parameter, tile, sync, accuracy, dimX, dimY)
+        elif method == 1:
+            TV_FGP_CPU_tiled(&inputData[0,0], &outputData[0,0], &infovec[0], regularisation_parameter, iterationsNumb, methodTV, penalty_type, tile, sync, accuracy, dimX, dimY)
+        elif method == 2:
+            Diffusion_CPU_tiled(&inputData[0,0], &outputData[0,0], &infovec[0], regularisation_parameter, edge_parameter, iterationsNumb, time_marching_parameter, penalty_type, tile, sync, accuracy, dimX, dimY)
+        else:
+            Diffus4th_CPU_tiled(&inputData[0,0], &outputData[0,0], &infovec[0], regularisation_parameter, edge_parameter, iterationsNumb, time_marching_parameter, tile, sync, accuracy, dimX, dimY)
+    return (outputData,infovec)
+
+#****************************************************************#
+#************************ Strided views *************************#
+#****************************************************************#
+# inputData and out may be views into larger arrays (sub-images, sub-volumes, padded
+# buffers) with contiguous rows, the ROF, FGP, NDF and Diff4th cores read and write them
+# without contiguous copies; out may be inputData (in place), None gives a new array
+def strided_check(inputData, out):
+    if inputData.ndim not in (2, 3) or inputData.dtype != np.float32:
+        raise ValueError('strided views need a 2D or 3D float32 input')
+    if inputData.strides[-1] != 4 or any(st % 4 for st in inputData.strides):
+        inputData = np.ascontiguousarray(inputData)
+    if out is None:
+        out = np.zeros(inputData.shape, dtype='float32')
+    elif not isinstance(out, np.ndarray) or out.shape != inputData.shape or out.dtype != np.float32 or \
+         out.strides[-1] != 4 or any(st % 4 for st in out.strides):
+        raise ValueError('out must be a float32 array of the input shape with contiguous rows')
+    return inputData, out
+
+def view_pitches(a):
+    # floats between the rows and between the slices of a view
+    if a.ndim == 2:
+        return (a.strides[0]//4, (a.strides[0]//4)*a.shape[0])
+    return (a.strides[1]//4, a.strides[0]//4)
+
+def STRIDED(int method, np.ndarray inputData, np.ndarray out,
+                     regularisation_parameter,
+                     float edge_parameter,
+                     int iterationsNumb,
+                     float time_marching_parameter,
+                     int penalty_type,
+                     float tolerance_param):
+    # method: 0 - ROF, 1 - FGP (edge_parameter - methodTV, penalty_type - nonneg), 2 - NDF,
+    # 3 - Diff4th (penalty_type - scheme)
+    cdef long inY, inZ, outY, outZ
+    cdef int dimX = inputData.shape[inputData.ndim-1], dimY = inputData.shape[inputData.ndim-2]
+    cdef int dimZ = inputData.shape[0] if inputData.ndim == 3 else 1
+    cdef int methodTV = <int>edge_parameter, lambda_is_arr = 0
+    cdef float lambdareg = 0.0
+    cdef float *inp = <float*>inputData.data
+    cdef float *outp = <float*>out.data
+    cdef float *lam = &lambdareg
+    cdef np.ndarray[np.float32_t, ndim=1, mode="c"] reg
+    cdef np.ndarray[np.float32_t, ndim=1, mode="c"] infovec = \
+            np.zeros([2], dtype='float32')
+    (inY, inZ) = view_pitches(inputData)
+    (outY, outZ) = view_pitches(out)
+    if isinstance(regularisation_parameter, np.ndarray):
+        if method != 0 or np.shape(regularisation_parameter) != np.shape(inputData):
+            raise ValueError('a regularisation parameter array needs ROF and the input shape')
+        reg = np.ascontiguousarray(regularisation_parameter, dtype='float32').ravel()
+        lam = &reg[0]
+        lambda_is_arr = 1
+    else:
+        lambdareg = regularisation_parameter
+    with nogil:
+        if method == 0:
+            TV_ROF_CPU_strided(inp, inY, inZ, outp, outY, outZ, &infovec[0], lam, lambda_is_arr, iterationsNumb, time_marching_parameter, tolerance_param, dimX, dimY, dimZ)
+        elif method == 1:
+            TV_FGP_CPU_strided(inp, inY, inZ, outp, outY, outZ, &infovec[0], lambdareg, iterationsNumb, tolerance_param, methodTV, penalty_type, dimX, dimY, dimZ)
+        elif method == 2:
+            Diffusion_CPU_strided(inp, inY, inZ, outp, outY, outZ, &infovec[0], lambdareg, edge_parameter, iterationsNumb, time_marching_parameter, penalty_type, tolerance_param, dimX, dimY, dimZ)
+        else:
+            Diffus4th_CPU_strided(inp, inY, inZ, outp, outY, outZ, &infovec[0], lambdareg, edge_parameter, iterationsNumb, time_marching_parameter, tolerance_param, penalty_type, dimX, dimY, dimZ)
+    return (out,infovec)
+
+def checkpoint_path(checkpoint):
+    # file name of the checkpoint as bytes for the cores, None when the run is not checkpointed
+    if checkpoint is None:
+        return None
+    return os.fsencode(checkpoint)
+
+cdef const char *checkpoint_ptr(bytes checkpoint):
+    if checkpoint is None:
+        return NULL
+    return checkpoint
+
+def checkpoint_status(float status, bytes checkpoint):
+    if status < 0:
+        raise IOError('cannot use the checkpoint file {}, it may hold a checkpoint of another run'.format(os.fsdecode(checkpoint)))
+
 #****************************************************************#
 #********************** Total-variation ROF *********************#
 #****************************************************************#
-def TV_ROF_CPU(inputData, regularisation_parameter, iterationsNumb, marching_step_parameter,tolerance_param):
+def TV_ROF_CPU(inputData, regularisation_parameter, iterationsNumb, marching_step_parameter,tolerance_param, layout=0, tile=0, sync=8, accuracy=1.0, out=None):
+    lambdas = lockstep_lambdas(regularisation_parameter)
+    if lambdas is not None:
+        return TV_ROF_MULTI(inputData, lambdas, iterationsNumb, marching_step_parameter, tolerance_param)
+    if tile > 0:
+        inputData = tile_check(inputData, regularisation_parameter, tolerance_param, out)
+        return TILED_2D(0, inputData, regularisation_parameter, 0.0, iterationsNumb, marching_step_parameter, 0, tile, sync, accuracy)
+    if (out is not None) or not inputData.flags.c_contiguous:
+        inputData, out = strided_check(inputData, out)
+        return STRIDED(0, inputData, out, regularisation_parameter, 0.0, iterationsNumb, marching_step_parameter, 0, tolerance_param)
     if inputData.ndim == 2:
         return TV_ROF_2D(inputData, regularisation_parameter, iterationsNumb, marching_step_parameter,tolerance_param)
     elif inputData.ndim == 3:
-        return TV_ROF_3D(inputData, regularisation_parameter, iterationsNumb, marching_step_parameter,tolerance_param)
+        return TV_ROF_3D(inputData, regularisation_parameter, iterationsNumb, marching_step_parameter,tolerance_param, layout)
 
 def TV_ROF_2D(np.ndarray[np.float32_t, ndim=2, mode="c"] inputData,
                      regularisation_parameter,
@@ -59,17 +283,23 @@ def TV_ROF_2D(np.ndarray[np.float32_t, ndim=2, mode="c"] inputData,
 
     if isinstance (regularisation_parameter, np.ndarray):
         reg = regularisation_parameter.copy()
-        TV_ROF_CPU_main(&inputData[0,0], &outputData[0,0], &infovec[0], &reg[0,0],  1, iterationsNumb, marching_step_parameter, tolerance_param, dims[1], dims[0], 1)
+        bound = output_stats_bind(outputData.size)
+        with nogil:
+            TV_ROF_CPU_main(&inputData[0,0], &outputData[0,0], &infovec[0], &reg[0,0],  1, iterationsNumb, marching_step_parameter, tolerance_param, 0, dims[1], dims[0], 1)
     else: # supposedly this would be a float
         lambdareg = regularisation_parameter;
-        TV_ROF_CPU_main(&inputData[0,0], &outputData[0,0], &infovec[0], &lambdareg,  0, iterationsNumb, marching_step_parameter, tolerance_param, dims[1], dims[0], 1)
+        bound = output_stats_bind(outputData.size)
+        with nogil:
+            TV_ROF_CPU_main(&inputData[0,0], &outputData[0,0], &infovec[0], &lambdareg,  0, iterationsNumb, marching_step_parameter, tolerance_param, 0, dims[1], dims[0], 1)
+    output_stats_unbind(bound)
     return (outputData,infovec)
 
 def TV_ROF_3D(np.ndarray[np.float32_t, ndim=3, mode="c"] inputData,
                      regularisation_parameter,
                      int iterationsNumb,
                      float marching_step_parameter,
-                     float tolerance_param):
+                     float tolerance_param,
+                     int layout):
     cdef long dims[3]
     dims[0] = inputData.shape[0]
     dims[1] = inputData.shape[1]
@@ -85,21 +315,53 @@ def TV_ROF_3D(np.ndarray[np.float32_t, ndim=3, mode="c"] inputData,
     #TV_ROF_CPU_main(&inputData[0,0,0], &outputData[0,0,0], &infovec[0], regularisation_parameter, iterationsNumb, marching_step_parameter, tolerance_param, dims[2], dims[1], dims[0])
     if isinstance (regularisation_parameter, np.ndarray):
         reg = regularisation_parameter.copy()
-        TV_ROF_CPU_main(&inputData[0,0,0], &outputData[0,0,0], &infovec[0], &reg[0,0,0], 1, iterationsNumb, marching_step_parameter, tolerance_param, dims[2], dims[1], dims[0])
+        bound = output_stats_bind(outputData.size)
+        with nogil:
+            TV_ROF_CPU_main(&inputData[0,0,0], &outputData[0,0,0], &infovec[0], &reg[0,0,0], 1, iterationsNumb, marching_step_parameter, tolerance_param, layout, dims[2], dims[1], dims[0])
     else: # supposedly this would be a float
         lambdareg = regularisation_parameter
-        TV_ROF_CPU_main(&inputData[0,0,0], &outputData[0,0,0], &infovec[0], &lambdareg, 0, iterationsNumb, marching_step_parameter, tolerance_param, dims[2], dims[1], dims[0])
+        bound = output_stats_bind(outputData.size)
+        with nogil:
+            TV_ROF_CPU_main(&inputData[0,0,0], &outputData[0,0,0], &infovec[0], &lambdareg, 0, iterationsNumb, marching_step_parameter, tolerance_param, layout, dims[2], dims[1], dims[0])
+    output_stats_unbind(bound)
+    return (outputData,infovec)
+
+def TV_ROF_MULTI(inputData, np.ndarray[np.float32_t, ndim=1, mode="c"] lambdas,
+                     int iterationsNumb,
+                     float marching_step_parameter,
+                     float tolerance_param):
+    cdef np.ndarray[np.float32_t, ndim=1, mode="c"] inp
+    cdef np.ndarray[np.float32_t, ndim=1, mode="c"] out
+    cdef np.ndarray[np.float32_t, ndim=1, mode="c"] infovec = \
+            np.zeros([2], dtype='float32')
+    cdef int K = lambdas.size
+    cdef int dimX, dimY, dimZ
+    inputData, (dimX, dimY, dimZ) = lockstep_check(inputData, lambdas, tolerance_param)
+    inp = inputData.ravel()
+    outputData = np.zeros((K,) + inputData.shape, dtype='float32')
+    out = outputData.reshape(-1)
+    with nogil:
+        TV_ROF_CPU_multi(&inp[0], &out[0], &infovec[0], &lambdas[0], K, iterationsNumb, marching_step_parameter, dimX, dimY, dimZ)
     return (outputData,infovec)
 
 #****************************************************************#
 #********************** Total-variation FGP *********************#
 #****************************************************************#
 #******** Total-variation Fast-Gradient-Projection (FGP)*********#
-def TV_FGP_CPU(inputData, regularisation_parameter, iterationsNumb, tolerance_param, methodTV, nonneg):
+def TV_FGP_CPU(inputData, regularisation_parameter, iterationsNumb, tolerance_param, methodTV, nonneg, layout=0, tile=0, sync=8, accuracy=1.0, out=None):
+    lambdas = lockstep_lambdas(regularisation_parameter)
+    if lambdas is not None:
+        return TV_FGP_MULTI(inputData, lambdas, iterationsNumb, tolerance_param, methodTV, nonneg)
+    if tile > 0:
+        inputData = tile_check(inputData, regularisation_parameter, tolerance_param, out)
+        return TILED_2D(1, inputData, regularisation_parameter, methodTV, iterationsNumb, 0.0, nonneg, tile, sync, accuracy)
+    if (out is not None) or not inputData.flags.c_contiguous:
+        inputData, out = strided_check(inputData, out)
+        return STRIDED(1, inputData, out, regularisation_parameter, methodTV, iterationsNumb, 0.0, nonneg, tolerance_param)
     if inputData.ndim == 2:
         return TV_FGP_2D(inputData, regularisation_parameter, iterationsNumb, tolerance_param, methodTV, nonneg)
     elif inputData.ndim == 3:
-        return TV_FGP_3D(inputData, regularisation_parameter, iterationsNumb, tolerance_param, methodTV, nonneg)
+        return TV_FGP_3D(inputData, regularisation_parameter, iterationsNumb, tolerance_param, methodTV, nonneg, layout)
 
 def TV_FGP_2D(np.ndarray[np.float32_t, ndim=2, mode="c"] inputData,
                      float regularisation_parameter,
@@ -119,13 +381,17 @@ def TV_FGP_2D(np.ndarray[np.float32_t, ndim=2, mode="c"] inputData,
             np.ones([2], dtype='float32')
 
     #/* Run FGP-TV iterations for 2D data */
-    TV_FGP_CPU_main(&inputData[0,0], &outputData[0,0], &infovec[0], regularisation_parameter,
-                       iterationsNumb,
-                       tolerance_param,
-                       methodTV,
-                       nonneg,
-                       dims[1],dims[0],1)
-
+    bound = output_stats_bind(outputData.size)
+    with nogil:
+        TV_FGP_CPU_main(&inputData[0,0], &outputData[0,0], &infovec[0], regularisation_parameter,
+                           iterationsNumb,
+                           tolerance_param,
+                           methodTV,
+                           nonneg,
+                           0,
+                           dims[1],dims[0],1)
+
+    output_stats_unbind(bound)
     return (outputData,infovec)
 
 def TV_FGP_3D(np.ndarray[np.float32_t, ndim=3, mode="c"] inputData,
@@ -133,7 +399,8 @@ def TV_FGP_3D(np.ndarray[np.float32_t, ndim=3, mode="c"] inputData,
                      int iterationsNumb,
                      float tolerance_param,
                      int methodTV,
-                     int nonneg):
+                     int nonneg,
+                     int layout):
 
     cdef long dims[3]
     dims[0] = inputData.shape[0]
@@ -146,22 +413,46 @@ def TV_FGP_3D(np.ndarray[np.float32_t, ndim=3, mode="c"] inputData,
             np.zeros([2], dtype='float32')
 
     #/* Run FGP-TV iterations for 3D data */
-    TV_FGP_CPU_main(&inputData[0,0,0], &outputData[0,0,0], &infovec[0], regularisation_parameter,
-                       iterationsNumb,
-                       tolerance_param,
-                       methodTV,
-                       nonneg,
-                       dims[2], dims[1], dims[0])
+    bound = output_stats_bind(outputData.size)
+    with nogil:
+        TV_FGP_CPU_main(&inputData[0,0,0], &outputData[0,0,0], &infovec[0], regularisation_parameter,
+                           iterationsNumb,
+                           tolerance_param,
+                           methodTV,
+                           nonneg,
+                           layout,
+                           dims[2], dims[1], dims[0])
+    output_stats_unbind(bound)
+    return (outputData,infovec)
+
+def TV_FGP_MULTI(inputData, np.ndarray[np.float32_t, ndim=1, mode="c"] lambdas,
+                     int iterationsNumb,
+                     float tolerance_param,
+                     int methodTV,
+                     int nonneg):
+    cdef np.ndarray[np.float32_t, ndim=1, mode="c"] inp
+    cdef np.ndarray[np.float32_t, ndim=1, mode="c"] out
+    cdef np.ndarray[np.float32_t, ndim=1, mode="c"] infovec = \
+            np.zeros([2], dtype='float32')
+    cdef int K = lambdas.size
+    cdef int dimX, dimY, dimZ
+    inputData, (dimX, dimY, dimZ) = lockstep_check(inputData, lambdas, tolerance_param)
+    inp = inputData.ravel()
+    outputData = np.zeros((K,) + inputData.shape, dtype='float32')
+    out = outputData.reshape(-1)
+    with nogil:
+        TV_FGP_CPU_multi(&inp[0], &out[0], &infovec[0], &lambdas[0], K, iterationsNumb, methodTV, nonneg, dimX, dimY, dimZ)
     return (outputData,infovec)
 
 #****************************************************************#
 #****************** Total-variation Primal-dual *****************#
 #****************************************************************#
-def TV_PD_CPU(inputData, regularisation_parameter, iterationsNumb, tolerance_param, methodTV, nonneg, lipschitz_const):
+def TV_PD_CPU(inputData, regularisation_parameter, iterationsNumb, tolerance_param, methodTV, nonneg, lipschitz_const, layout=0, accelerated=False):
+    # primal-dual scheme: 0 - fixed steps, 1 - accelerated (steps updated every iteration)
     if inputData.ndim == 2:
-        return TV_PD_2D(inputData, regularisation_parameter, iterationsNumb, tolerance_param, methodTV, nonneg, lipschitz_const)
+        return TV_PD_2D(inputData, regularisation_parameter, iterationsNumb, tolerance_param, methodTV, nonneg, lipschitz_const, 1 if accelerated else 0)
     elif inputData.ndim == 3:
-        return TV_PD_3D(inputData, regularisation_parameter, iterationsNumb, tolerance_param, methodTV, nonneg, lipschitz_const)
+        return TV_PD_3D(inputData, regularisation_parameter, iterationsNumb, tolerance_param, methodTV, nonneg, lipschitz_const, layout, 1 if accelerated else 0)
 
 def TV_PD_2D(np.ndarray[np.float32_t, ndim=2, mode="c"] inputData,
                      float regularisation_parameter,
@@ -169,7 +460,8 @@ def TV_PD_2D(np.ndarray[np.float32_t, ndim=2, mode="c"] inputData,
                      float tolerance_param,
                      int methodTV,
                      int nonneg,
-                     float lipschitz_const):
+                     float lipschitz_const,
+                     int algorithm):
 
     cdef long dims[2]
     dims[0] = inputData.shape[0]
@@ -182,13 +474,18 @@ def TV_PD_2D(np.ndarray[np.float32_t, ndim=2, mode="c"] inputData,
             np.ones([2], dtype='float32')
 
     #/* Run FGP-TV iterations for 2D data */
-    PDTV_CPU_main(&inputData[0,0], &outputData[0,0], &infovec[0], regularisation_parameter,
-                       iterationsNumb,
-                       tolerance_param,
-                       lipschitz_const,
-                       methodTV,
-                       nonneg,
-                       dims[1],dims[0], 1)
+    bound = output_stats_bind(outputData.size)
+    with nogil:
+        PDTV_CPU_main(&inputData[0,0], &outputData[0,0], &infovec[0], regularisation_parameter,
+                           iterationsNumb,
+                           tolerance_param,
+                           lipschitz_const,
+                           methodTV,
+                           nonneg,
+                           algorithm,
+                           0,
+                           dims[1],dims[0], 1)
+    output_stats_unbind(bound)
     return (outputData,infovec)
 
 def TV_PD_3D(np.ndarray[np.float32_t, ndim=3, mode="c"] inputData,
@@ -197,7 +494,9 @@ def TV_PD_3D(np.ndarray[np.float32_t, ndim=3, mode="c"] inputData,
                      float tolerance_param,
                      int methodTV,
                      int nonneg,
-                     float lipschitz_const):
+                     float lipschitz_const,
+                     int layout,
+                     int algorithm):
 
     cdef long dims[3]
     dims[0] = inputData.shape[0]
@@ -210,30 +509,37 @@ def TV_PD_3D(np.ndarray[np.float32_t, ndim=3, mode="c"] inputData,
             np.zeros([2], dtype='float32')
 
     #/* Run FGP-TV iterations for 3D data */
-    PDTV_CPU_main(&inputData[0,0,0], &outputData[0,0,0], &infovec[0], regularisation_parameter,
-                       iterationsNumb,
-                       tolerance_param,
-                       lipschitz_const,
-                       methodTV,
-                       nonneg,
-                       dims[2], dims[1], dims[0])
+    bound = output_stats_bind(outputData.size)
+    with nogil:
+        PDTV_CPU_main(&inputData[0,0,0], &outputData[0,0,0], &infovec[0], regularisation_parameter,
+                           iterationsNumb,
+                           tolerance_param,
+                           lipschitz_const,
+                           methodTV,
+                           nonneg,
+                           algorithm,
+                           layout,
+                           dims[2], dims[1], dims[0])
+    output_stats_unbind(bound)
     return (outputData,infovec)
 
 #***************************************************************#
 #********************** Total-variation SB *********************#
 #***************************************************************#
 #*************** Total-variation Split Bregman (SB)*************#
-def TV_SB_CPU(inputData, regularisation_parameter, iterationsNumb, tolerance_param, methodTV):
+def TV_SB_CPU(inputData, regularisation_parameter, iterationsNumb, tolerance_param, methodTV, multigrid=False):
+    # solver of the u-subproblem: 0 - two Gauss-Seidel sweeps, 1 - a multigrid V-cycle
     if inputData.ndim == 2:
-        return TV_SB_2D(inputData, regularisation_parameter, iterationsNumb, tolerance_param, methodTV)
+        return TV_SB_2D(inputData, regularisation_parameter, iterationsNumb, tolerance_param, methodTV, 1 if multigrid else 0)
     elif inputData.ndim == 3:
-        return TV_SB_3D(inputData, regularisation_parameter, iterationsNumb, tolerance_param, methodTV)
+        return TV_SB_3D(inputData, regularisation_parameter, iterationsNumb, tolerance_param, methodTV, 1 if multigrid else 0)
 
 def TV_SB_2D(np.ndarray[np.float32_t, ndim=2, mode="c"] inputData,
                      float regularisation_parameter,
                      int iterationsNumb,
                      float tolerance_param,
-                     int methodTV):
+                     int methodTV,
+                     int solver=0):
 
     cdef long dims[2]
     dims[0] = inputData.shape[0]
@@ -245,12 +551,14 @@ def TV_SB_2D(np.ndarray[np.float32_t, ndim=2, mode="c"] inputData,
             np.zeros([2], dtype='float32')
 
     #/* Run SB-TV iterations for 2D data */
-    SB_TV_CPU_main(&inputData[0,0], &outputData[0,0], &infovec[0],
-                       regularisation_parameter,
-                       iterationsNumb,
-                       tolerance_param,
-                       methodTV,
-                       dims[1],dims[0], 1)
+    with nogil:
+        SB_TV_CPU_main(&inputData[0,0], &outputData[0,0], &infovec[0],
+                           regularisation_parameter,
+                           iterationsNumb,
+                           tolerance_param,
+                           methodTV,
+                           solver,
+                           dims[1],dims[0], 1)
 
     return (outputData,infovec)
 
@@ -258,7 +566,8 @@ def TV_SB_3D(np.ndarray[np.float32_t, ndim=3, mode="c"] inputData,
                      float regularisation_parameter,
                      int iterationsNumb,
                      float tolerance_param,
-                     int methodTV):
+                     int methodTV,
+                     int solver=0):
     cdef long dims[3]
     dims[0] = inputData.shape[0]
     dims[1] = inputData.shape[1]
@@ -270,28 +579,33 @@ def TV_SB_3D(np.ndarray[np.float32_t, ndim=3, mode="c"] inputData,
             np.zeros([2], dtype='float32')
 
     #/* Run SB-TV iterations for 3D data */
-    SB_TV_CPU_main(&inputData[0,0,0], &outputData[0,0,0], &infovec[0],
-                       regularisation_parameter,
-                       iterationsNumb,
-                       tolerance_param,
-                       methodTV,
-                       dims[2], dims[1], dims[0])
+    with nogil:
+        SB_TV_CPU_main(&inputData[0,0,0], &outputData[0,0,0], &infovec[0],
+                           regularisation_parameter,
+                           iterationsNumb,
+                           tolerance_param,
+                           methodTV,
+                           solver,
+                           dims[2], dims[1], dims[0])
     return (outputData,infovec)
 #***************************************************************#
 #******************* ROF - LLT regularisation ******************#
 #***************************************************************#
-def LLT_ROF_CPU(inputData, regularisation_parameterROF, regularisation_parameterLLT, iterations, time_marching_parameter, tolerance_param):
+def LLT_ROF_CPU(inputData, regularisation_parameterROF, regularisation_parameterLLT, iterations, time_marching_parameter, tolerance_param, primal_dual=False):
+    # explicit time marching (0) or the primal-dual solver (1)
+    cdef int algorithm = 1 if primal_dual else 0
     if inputData.ndim == 2:
-        return LLT_ROF_2D(inputData, regularisation_parameterROF, regularisation_parameterLLT, iterations, time_marching_parameter, tolerance_param)
+        return LLT_ROF_2D(inputData, regularisation_parameterROF, regularisation_parameterLLT, iterations, time_marching_parameter, tolerance_param, algorithm)
     elif inputData.ndim == 3:
-        return LLT_ROF_3D(inputData, regularisation_parameterROF, regularisation_parameterLLT, iterations, time_marching_parameter, tolerance_param)
+        return LLT_ROF_3D(inputData, regularisation_parameterROF, regularisation_parameterLLT, iterations, time_marching_parameter, tolerance_param, algorithm)
 
 def LLT_ROF_2D(np.ndarray[np.float32_t, ndim=2, mode="c"] inputData,
                      float regularisation_parameterROF,
                      float regularisation_parameterLLT,
                      int iterations,
                      float time_marching_parameter,
-                     float tolerance_param):
+                     float tolerance_param,
+                     int algorithm):
 
     cdef long dims[2]
     dims[0] = inputData.shape[0]
@@ -303,9 +617,10 @@ def LLT_ROF_2D(np.ndarray[np.float32_t, ndim=2, mode="c"] inputData,
             np.zeros([2], dtype='float32')
 
     #/* Run ROF-LLT iterations for 2D data */
-    LLT_ROF_CPU_main(&inputData[0,0], &outputData[0,0], &infovec[0], regularisation_parameterROF, regularisation_parameterLLT, iterations, time_marching_parameter,
-                     tolerance_param,
-                     dims[1],dims[0],1)
+    with nogil:
+        LLT_ROF_CPU_main(&inputData[0,0], &outputData[0,0], &infovec[0], regularisation_parameterROF, regularisation_parameterLLT, iterations, time_marching_parameter,
+                         tolerance_param, algorithm,
+                         dims[1],dims[0],1)
     return (outputData,infovec)
 
 def LLT_ROF_3D(np.ndarray[np.float32_t, ndim=3, mode="c"] inputData,
@@ -313,7 +628,8 @@ def LLT_ROF_3D(np.ndarray[np.float32_t, ndim=3, mode="c"] inputData,
                      float regularisation_parameterLLT,
                      int iterations,
                      float time_marching_parameter,
-                     float tolerance_param):
+                     float tolerance_param,
+                     int algorithm):
 
     cdef long dims[3]
     dims[0] = inputData.shape[0]
@@ -326,21 +642,25 @@ def LLT_ROF_3D(np.ndarray[np.float32_t, ndim=3, mode="c"] inputData,
             np.zeros([2], dtype='float32')
 
     #/* Run ROF-LLT iterations for 3D data */
-    LLT_ROF_CPU_main(&inputData[0,0,0], &outputData[0,0,0], &infovec[0], regularisation_parameterROF, regularisation_parameterLLT, iterations,
-                     time_marching_parameter,
-                     tolerance_param,
-                     dims[2], dims[1], dims[0])
+    with nogil:
+        LLT_ROF_CPU_main(&inputData[0,0,0], &outputData[0,0,0], &infovec[0], regularisation_parameterROF, regularisation_parameterLLT, iterations,
+                         time_marching_parameter,
+                         tolerance_param, algorithm,
+                         dims[2], dims[1], dims[0])
     return (outputData,infovec)
 #***************************************************************#
 #***************** Total Generalised Variation *****************#
 #***************************************************************#
-def TGV_CPU(inputData, regularisation_parameter, alpha1, alpha0, iterations, LipshitzConst, tolerance_param):
+def TGV_CPU(inputData, regularisation_parameter, alpha1, alpha0, iterations, LipshitzConst, tolerance_param,
+            checkpoint=None, checkpoint_interval=0, resume=False, accelerated=False):
     if inputData.ndim == 2:
         return TGV_2D(inputData, regularisation_parameter, alpha1, alpha0,
-                      iterations, LipshitzConst, tolerance_param)
+                      iterations, LipshitzConst, tolerance_param, 1 if accelerated else 0,
+                      checkpoint_path(checkpoint), checkpoint_interval, resume)
     elif inputData.ndim == 3:
         return TGV_3D(inputData, regularisation_parameter, alpha1, alpha0,
-                      iterations, LipshitzConst, tolerance_param)
+                      iterations, LipshitzConst, tolerance_param, 1 if accelerated else 0,
+                      checkpoint_path(checkpoint), checkpoint_interval, resume)
 
 def TGV_2D(np.ndarray[np.float32_t, ndim=2, mode="c"] inputData,
                      float regularisation_parameter,
@@ -348,7 +668,11 @@ def TGV_2D(np.ndarray[np.float32_t, ndim=2, mode="c"] inputData,
                      float alpha0,
                      int iterationsNumb,
                      float LipshitzConst,
-                     float tolerance_param):
+                     float tolerance_param,
+                     int algorithm,
+                     bytes checkpoint=None,
+                     int checkpoint_interval=0,
+                     int resume=0):
 
     cdef long dims[2]
     dims[0] = inputData.shape[0]
@@ -360,13 +684,19 @@ def TGV_2D(np.ndarray[np.float32_t, ndim=2, mode="c"] inputData,
                 np.zeros([2], dtype='float32')
 
     #/* Run TGV iterations for 2D data */
-    TGV_main(&inputData[0,0], &outputData[0,0],  &infovec[0],  regularisation_parameter,
-                       alpha1,
-                       alpha0,
-                       iterationsNumb,
-                       LipshitzConst,
-                       tolerance_param,
-                       dims[1],dims[0],1)
+    cdef const char *path = checkpoint_ptr(checkpoint)
+    cdef float status
+    with nogil:
+        status = TGV_main_ckpt(&inputData[0,0], &outputData[0,0],  &infovec[0],  regularisation_parameter,
+                           alpha1,
+                           alpha0,
+                           iterationsNumb,
+                           LipshitzConst,
+                           tolerance_param,
+                           algorithm,
+                           dims[1],dims[0],1,
+                           path, checkpoint_interval, resume)
+    checkpoint_status(status, checkpoint)
     return (outputData,infovec)
 def TGV_3D(np.ndarray[np.float32_t, ndim=3, mode="c"] inputData,
                      float regularisation_parameter,
@@ -374,7 +704,11 @@ def TGV_3D(np.ndarray[np.float32_t, ndim=3, mode="c"] inputData,
                      float alpha0,
                      int iterationsNumb,
                      float LipshitzConst,
-                     float tolerance_param):
+                     float tolerance_param,
+                     int algorithm,
+                     bytes checkpoint=None,
+                     int checkpoint_interval=0,
+                     int resume=0):
 
     cdef long dims[3]
     dims[0] = inputData.shape[0]
@@ -387,23 +721,38 @@ def TGV_3D(np.ndarray[np.float32_t, ndim=3, mode="c"] inputData,
                 np.zeros([2], dtype='float32')
 
     #/* Run TGV iterations for 3D data */
-    TGV_main(&inputData[0,0,0], &outputData[0,0,0], &infovec[0], regularisation_parameter,
-                       alpha1,
-                       alpha0,
-                       iterationsNumb,
-                       LipshitzConst,
-                       tolerance_param,
-                       dims[2], dims[1], dims[0])
+    cdef const char *path = checkpoint_ptr(checkpoint)
+    cdef float status
+    with nogil:
+        status = TGV_main_ckpt(&inputData[0,0,0], &outputData[0,0,0], &infovec[0], regularisation_parameter,
+                           alpha1,
+                           alpha0,
+                           iterationsNumb,
+                           LipshitzConst,
+                           tolerance_param,
+                           algorithm,
+                           dims[2], dims[1], dims[0],
+                           path, checkpoint_interval, resume)
+    checkpoint_status(status, checkpoint)
     return (outputData,infovec)
 
 #****************************************************************#
 #***************Nonlinear (Isotropic) Diffusion******************#
 #****************************************************************#
-def NDF_CPU(inputData, regularisation_parameter, edge_parameter, iterationsNumb,time_marching_parameter, penalty_type,tolerance_param):
+def NDF_CPU(inputData, regularisation_parameter, edge_parameter, iterationsNumb,time_marching_parameter, penalty_type,tolerance_param, layout=0, tile=0, sync=8, accuracy=1.0, out=None):
+    lambdas = lockstep_lambdas(regularisation_parameter)
+    if lambdas is not None:
+        return NDF_MULTI(inputData, lambdas, edge_parameter, iterationsNumb, time_marching_parameter, penalty_type, tolerance_param)
+    if tile > 0:
+        inputData = tile_check(inputData, regularisation_parameter, tolerance_param, out)
+        return TILED_2D(2, inputData, regularisation_parameter, edge_parameter, iterationsNumb, time_marching_parameter, penalty_type, tile, sync, accuracy)
+    if (out is not None) or not inputData.flags.c_contiguous:
+        inputData, out = strided_check(inputData, out)
+        return STRIDED(2, inputData, out, regularisation_parameter, edge_parameter, iterationsNumb, time_marching_parameter, penalty_type, tolerance_param)
     if inputData.ndim == 2:
         return NDF_2D(inputData, regularisation_parameter, edge_parameter, iterationsNumb, time_marching_parameter, penalty_type, tolerance_param)
     elif inputData.ndim == 3:
-        return NDF_3D(inputData, regularisation_parameter, edge_parameter, iterationsNumb, time_marching_parameter, penalty_type, tolerance_param)
+        return NDF_3D(inputData, regularisation_parameter, edge_parameter, iterationsNumb, time_marching_parameter, penalty_type, tolerance_param, layout)
 
 def NDF_2D(np.ndarray[np.float32_t, ndim=2, mode="c"] inputData,
                      float regularisation_parameter,
@@ -421,12 +770,15 @@ def NDF_2D(np.ndarray[np.float32_t, ndim=2, mode="c"] inputData,
     cdef np.ndarray[np.float32_t, ndim=1, mode="c"] infovec = \
                 np.zeros([2], dtype='float32')
 
+    bound = output_stats_bind(outputData.size)
     # Run Nonlinear Diffusion iterations for 2D data
-    Diffusion_CPU_main(&inputData[0,0], &outputData[0,0], &infovec[0],
-    regularisation_parameter, edge_parameter, iterationsNumb,
-    time_marching_parameter, penalty_type,
-    tolerance_param,
-    dims[1], dims[0], 1)
+    with nogil:
+        Diffusion_CPU_main(&inputData[0,0], &outputData[0,0], &infovec[0],
+        regularisation_parameter, edge_parameter, iterationsNumb,
+        time_marching_parameter, penalty_type,
+        tolerance_param, 0,
+        dims[1], dims[0], 1)
+    output_stats_unbind(bound)
     return (outputData,infovec)
 
 def NDF_3D(np.ndarray[np.float32_t, ndim=3, mode="c"] inputData,
@@ -435,7 +787,8 @@ def NDF_3D(np.ndarray[np.float32_t, ndim=3, mode="c"] inputData,
                      int iterationsNumb,
                      float time_marching_parameter,
                      int penalty_type,
-                     float tolerance_param):
+                     float tolerance_param,
+                     int layout):
     cdef long dims[3]
     dims[0] = inputData.shape[0]
     dims[1] = inputData.shape[1]
@@ -446,29 +799,93 @@ def NDF_3D(np.ndarray[np.float32_t, ndim=3, mode="c"] inputData,
     cdef np.ndarray[np.float32_t, ndim=1, mode="c"] infovec = \
                 np.zeros([2], dtype='float32')
 
+    bound = output_stats_bind(outputData.size)
     # Run Nonlinear Diffusion iterations for  3D data
-    Diffusion_CPU_main(&inputData[0,0,0], &outputData[0,0,0], &infovec[0],
-    regularisation_parameter, edge_parameter, iterationsNumb,
-    time_marching_parameter, penalty_type,
-    tolerance_param,
-    dims[2], dims[1], dims[0])
+    with nogil:
+        Diffusion_CPU_main(&inputData[0,0,0], &outputData[0,0,0], &infovec[0],
+        regularisation_parameter, edge_parameter, iterationsNumb,
+        time_marching_parameter, penalty_type,
+        tolerance_param, layout,
+        dims[2], dims[1], dims[0])
+    output_stats_unbind(bound)
     return (outputData,infovec)
 
+def NDF_MULTI(inputData, np.ndarray[np.float32_t, ndim=1, mode="c"] lambdas,
+                     float edge_parameter,
+                     int iterationsNumb,
+                     float time_marching_parameter,
+                     int penalty_type,
+                     float tolerance_param):
+    cdef np.ndarray[np.float32_t, ndim=1, mode="c"] inp
+    cdef np.ndarray[np.float32_t, ndim=1, mode="c"] out
+    cdef np.ndarray[np.float32_t, ndim=1, mode="c"] infovec = \
+            np.zeros([2], dtype='float32')
+    cdef int K = lambdas.size
+    cdef int dimX, dimY, dimZ
+    inputData, (dimX, dimY, dimZ) = lockstep_check(inputData, lambdas, tolerance_param)
+    inp = inputData.ravel()
+    outputData = np.zeros((K,) + inputData.shape, dtype='float32')
+    out = outputData.reshape(-1)
+    with nogil:
+        Diffusion_CPU_multi(&inp[0], &out[0], &infovec[0], &lambdas[0], K, edge_parameter, iterationsNumb, time_marching_parameter, penalty_type, dimX, dimY, dimZ)
+    return (outputData,infovec)
+
+#****************************************************************#
+#*********Linear diffusion steady state (multigrid)**************#
+#****************************************************************#
+def LinearDiff_MG_CPU(inputData, regularisation_parameter, cycles, tolerance_param, weights=None):
+    # (W - lambda*Laplacian) u = W*f by multigrid V-cycles, W - fidelity weights (None - 1)
+    cdef int dimX, dimY, dimZ, ncycles = cycles
+    cdef float lam = regularisation_parameter, tol = tolerance_param
+    if inputData.ndim not in (2, 3):
+        raise ValueError('LinearDiff needs a 2D or 3D input')
+    if inputData.ndim == 2:
+        dimX, dimY, dimZ = inputData.shape[1], inputData.shape[0], 1
+    else:
+        dimX, dimY, dimZ = inputData.shape[2], inputData.shape[1], inputData.shape[0]
+    cdef np.ndarray[np.float32_t, ndim=1, mode="c"] inp = \
+            np.ascontiguousarray(inputData, dtype='float32').ravel()
+    cdef np.ndarray[np.float32_t, ndim=1, mode="c"] out = \
+            np.zeros([inp.size], dtype='float32')
+    cdef np.ndarray[np.float32_t, ndim=1, mode="c"] infovec = \
+            np.zeros([2], dtype='float32')
+    cdef np.ndarray[np.float32_t, ndim=1, mode="c"] W
+    cdef float *wptr = NULL
+    if weights is not None:
+        if np.shape(weights) != np.shape(inputData):
+            raise ValueError('the weights must have the shape of the input')
+        W = np.ascontiguousarray(weights, dtype='float32').ravel()
+        wptr = &W[0]
+    with nogil:
+        LinearDiff_MG_CPU_main(&inp[0], &out[0], &infovec[0], wptr, lam, ncycles, tol, dimX, dimY, dimZ)
+    return (out.reshape(inputData.shape), infovec)
+
 #****************************************************************#
 #*************Anisotropic Fourth-Order diffusion*****************#
 #****************************************************************#
-def Diff4th_CPU(inputData, regularisation_parameter, edge_parameter, iterationsNumb, time_marching_parameter,tolerance_param):
+def Diff4th_CPU(inputData, regularisation_parameter, edge_parameter, iterationsNumb, time_marching_parameter,tolerance_param, layout=0, tile=0, sync=8, accuracy=1.0, out=None, semi_implicit=False):
+    # scheme: 0 - explicit, 1 - semi-implicit (banded solves of the biharmonic term)
+    cdef int scheme = 1 if semi_implicit else 0
+    if tile > 0:
+        if semi_implicit:
+            raise ValueError('the tiled solver runs the explicit scheme')
+        inputData = tile_check(inputData, regularisation_parameter, tolerance_param, out)
+        return TILED_2D(3, inputData, regularisation_parameter, edge_parameter, iterationsNumb, time_marching_parameter, 0, tile, sync, accuracy)
+    if (out is not None) or not inputData.flags.c_contiguous:
+        inputData, out = strided_check(inputData, out)
+        return STRIDED(3, inputData, out, regularisation_parameter, edge_parameter, iterationsNumb, time_marching_parameter, scheme, tolerance_param)
     if inputData.ndim == 2:
-        return Diff4th_2D(inputData, regularisation_parameter, edge_parameter, iterationsNumb, time_marching_parameter,tolerance_param)
+        return Diff4th_2D(inputData, regularisation_parameter, edge_parameter, iterationsNumb, time_marching_parameter,tolerance_param, scheme)
     elif inputData.ndim == 3:
-        return Diff4th_3D(inputData, regularisation_parameter, edge_parameter, iterationsNumb, time_marching_parameter,tolerance_param)
+        return Diff4th_3D(inputData, regularisation_parameter, edge_parameter, iterationsNumb, time_marching_parameter,tolerance_param, scheme, layout)
 
 def Diff4th_2D(np.ndarray[np.float32_t, ndim=2, mode="c"] inputData,
                      float regularisation_parameter,
                      float edge_parameter,
                      int iterationsNumb,
                      float time_marching_parameter,
-                     float tolerance_param):
+                     float tolerance_param,
+                     int scheme):
     cdef long dims[2]
     dims[0] = inputData.shape[0]
     dims[1] = inputData.shape[1]
@@ -479,12 +896,13 @@ def Diff4th_2D(np.ndarray[np.float32_t, ndim=2, mode="c"] inputData,
                 np.zeros([2], dtype='float32')
 
     # Run Anisotropic Fourth-Order diffusion for 2D data
-    Diffus4th_CPU_main(&inputData[0,0], &outputData[0,0], &infovec[0],
-    regularisation_parameter,
-    edge_parameter, iterationsNumb,
-    time_marching_parameter,
-    tolerance_param,
-    dims[1], dims[0], 1)
+    with nogil:
+        Diffus4th_CPU_main(&inputData[0,0], &outputData[0,0], &infovec[0],
+        regularisation_parameter,
+        edge_parameter, iterationsNumb,
+        time_marching_parameter,
+        tolerance_param, scheme, 0,
+        dims[1], dims[0], 1)
     return (outputData,infovec)
 
 def Diff4th_3D(np.ndarray[np.float32_t, ndim=3, mode="c"] inputData,
@@ -492,7 +910,9 @@ def Diff4th_3D(np.ndarray[np.float32_t, ndim=3, mode="c"] inputData,
                      float edge_parameter,
                      int iterationsNumb,
                      float time_marching_parameter,
-                     float tolerance_param):
+                     float tolerance_param,
+                     int scheme,
+                     int layout):
     cdef long dims[3]
     dims[0] = inputData.shape[0]
     dims[1] = inputData.shape[1]
@@ -504,21 +924,22 @@ def Diff4th_3D(np.ndarray[np.float32_t, ndim=3, mode="c"] inputData,
                     np.zeros([2], dtype='float32')
 
     # Run Anisotropic Fourth-Order diffusion for  3D data
-    Diffus4th_CPU_main(&inputData[0,0,0], &outputData[0,0,0], &infovec[0],
-    regularisation_parameter, edge_parameter,
-    iterationsNumb, time_marching_parameter,
-    tolerance_param,
-    dims[2], dims[1], dims[0])
+    with nogil:
+        Diffus4th_CPU_main(&inputData[0,0,0], &outputData[0,0,0], &infovec[0],
+        regularisation_parameter, edge_parameter,
+        iterationsNumb, time_marching_parameter,
+        tolerance_param, scheme, layout,
+        dims[2], dims[1], dims[0])
     return (outputData,infovec)
 #****************************************************************#
 #**************Directional Total-variation FGP ******************#
 #****************************************************************#
 #******** Directional TV Fast-Gradient-Projection (FGP)*********#
-def dTV_FGP_CPU(inputData, refdata, regularisation_parameter, iterationsNumb, tolerance_param, eta_const, methodTV, nonneg):
+def dTV_FGP_CPU(inputData, refdata, regularisation_parameter, iterationsNumb, tolerance_param, eta_const, methodTV, nonneg, layout=0):
     if inputData.ndim == 2:
         return dTV_FGP_2D(inputData, refdata, regularisation_parameter, iterationsNumb, tolerance_param, eta_const, methodTV, nonneg)
     elif inputData.ndim == 3:
-        return dTV_FGP_3D(inputData, refdata, regularisation_parameter, iterationsNumb, tolerance_param, eta_const, methodTV, nonneg)
+        return dTV_FGP_3D(inputData, refdata, regularisation_parameter, iterationsNumb, tolerance_param, eta_const, methodTV, nonneg, layout)
 
 def dTV_FGP_2D(np.ndarray[np.float32_t, ndim=2, mode="c"] inputData,
                np.ndarray[np.float32_t, ndim=2, mode="c"] refdata,
@@ -539,14 +960,16 @@ def dTV_FGP_2D(np.ndarray[np.float32_t, ndim=2, mode="c"] inputData,
                     np.zeros([2], dtype='float32')
 
     #/* Run FGP-dTV iterations for 2D data */
-    dTV_FGP_CPU_main(&inputData[0,0], &refdata[0,0], &outputData[0,0], &infovec[0],
-                       regularisation_parameter,
-                       iterationsNumb,
-                       tolerance_param,
-                       eta_const,
-                       methodTV,
-                       nonneg,
-                       dims[1], dims[0], 1)
+    with nogil:
+        dTV_FGP_CPU_main(&inputData[0,0], &refdata[0,0], &outputData[0,0], &infovec[0],
+                           regularisation_parameter,
+                           iterationsNumb,
+                           tolerance_param,
+                           eta_const,
+                           methodTV,
+                           nonneg,
+                           0,
+                           dims[1], dims[0], 1)
     return (outputData,infovec)
 
 def dTV_FGP_3D(np.ndarray[np.float32_t, ndim=3, mode="c"] inputData,
@@ -556,7 +979,8 @@ def dTV_FGP_3D(np.ndarray[np.float32_t, ndim=3, mode="c"] inputData,
                      float tolerance_param,
                      float eta_const,
                      int methodTV,
-                     int nonneg):
+                     int nonneg,
+                     int layout):
     cdef long dims[3]
     dims[0] = inputData.shape[0]
     dims[1] = inputData.shape[1]
@@ -568,14 +992,16 @@ def dTV_FGP_3D(np.ndarray[np.float32_t, ndim=3, mode="c"] inputData,
                     np.zeros([2], dtype='float32')
 
     #/* Run FGP-dTV iterations for 3D data */
-    dTV_FGP_CPU_main(&inputData[0,0,0], &refdata[0,0,0], &outputData[0,0,0], &infovec[0],
-                       regularisation_parameter,
-                       iterationsNumb,
-                       tolerance_param,
-                       eta_const,
-                       methodTV,
-                       nonneg,
-                       dims[2], dims[1], dims[0])
+    with nogil:
+        dTV_FGP_CPU_main(&inputData[0,0,0], &refdata[0,0,0], &outputData[0,0,0], &infovec[0],
+                           regularisation_parameter,
+                           iterationsNumb,
+                           tolerance_param,
+                           eta_const,
+                           methodTV,
+                           nonneg,
+                           layout,
+                           dims[2], dims[1], dims[0])
     return (outputData,infovec)
 
 #****************************************************************#
@@ -600,12 +1026,19 @@ def TNV_3D(np.ndarray[np.float32_t, ndim=3, mode="c"] inputData,
             np.zeros([dims[0],dims[1],dims[2]], dtype='float32')
 
     # Run TNV iterations for 3D (X,Y,Channels) data
-    TNV_CPU_main(&inputData[0,0,0], &outputData[0,0,0], regularisation_parameter, iterationsNumb, tolerance_param, dims[2], dims[1], dims[0])
+    with nogil:
+        TNV_CPU_main(&inputData[0,0,0], &outputData[0,0,0], regularisation_parameter, iterationsNumb, tolerance_param, dims[2], dims[1], dims[0])
     return outputData
 #****************************************************************#
 #***************Patch-based weights calculation******************#
 #****************************************************************#
-def PATCHSEL_CPU(inputData, searchwindow, patchwindow, neighbours, edge_parameter):
+def PATCHSEL_CPU(inputData, searchwindow, patchwindow, neighbours, edge_parameter, previous=None, graph=None, threshold=0.0, mass=None):
+    if mass is not None and previous is not None:
+        raise ValueError('the CSR graph is given by the full search only')
+    if inputData.ndim == 2 and previous is not None:
+        return PatchSel_2D_update(inputData, previous, graph, searchwindow, patchwindow, neighbours, edge_parameter, threshold)
+    if inputData.ndim == 2 and mass is not None:
+        return PatchSel_2D_csr(inputData, searchwindow, patchwindow, neighbours, edge_parameter, mass)
     if inputData.ndim == 2:
         return PatchSel_2D(inputData, searchwindow, patchwindow, neighbours, edge_parameter)
     elif inputData.ndim == 3:
@@ -633,6 +1066,53 @@ def PatchSel_2D(np.ndarray[np.float32_t, ndim=2, mode="c"] inputData,
     # Run patch-based weight selection function
     PatchSelect_CPU_main(&inputData[0,0], &H_j[0,0,0], &H_i[0,0,0], &H_i[0,0,0], &Weights[0,0,0], dims[2], dims[1], 0, searchwindow, patchwindow,  neighbours,  edge_parameter)
     return H_i, H_j, Weights
+
+def PatchSel_2D_csr(np.ndarray[np.float32_t, ndim=2, mode="c"] inputData,
+                     int searchwindow,
+                     int patchwindow,
+                     int neighbours,
+                     float edge_parameter,
+                     float mass):
+    # the dense graph is compressed and dropped, (RowPtr, Neighbours, Weights) are returned
+    H_i, H_j, Weights = PatchSel_2D(inputData, searchwindow, patchwindow, neighbours, edge_parameter)
+    cdef np.ndarray[np.uint16_t, ndim=3, mode="c"] H_i_c = H_i
+    cdef np.ndarray[np.uint16_t, ndim=3, mode="c"] H_j_c = H_j
+    cdef np.ndarray[np.float32_t, ndim=3, mode="c"] Weights_c = Weights
+    cdef np.ndarray[np.int64_t, ndim=1, mode="c"] RowPtr = \
+            np.zeros([inputData.size + 1], dtype='int64')
+    entries = PatchSelect_CPU_csr(&H_j_c[0,0,0], &H_i_c[0,0,0], &H_i_c[0,0,0], &Weights_c[0,0,0], <long long*>&RowPtr[0], NULL, NULL, inputData.shape[1], inputData.shape[0], 0, neighbours, mass)
+    # one spare entry keeps the pointers valid for an empty graph
+    cdef np.ndarray[np.int32_t, ndim=1, mode="c"] Neighb = \
+            np.zeros([entries + 1], dtype='int32')
+    cdef np.ndarray[np.float32_t, ndim=1, mode="c"] WeightsCSR = \
+            np.zeros([entries + 1], dtype='float32')
+    PatchSelect_CPU_csr(&H_j_c[0,0,0], &H_i_c[0,0,0], &H_i_c[0,0,0], &Weights_c[0,0,0], <long long*>&RowPtr[0], <int*>&Neighb[0], &WeightsCSR[0], inputData.shape[1], inputData.shape[0], 0, neighbours, mass)
+    return RowPtr, Neighb[:entries], WeightsCSR[:entries]
+
+def PatchSel_2D_update(np.ndarray[np.float32_t, ndim=2, mode="c"] inputData,
+                     np.ndarray[np.float32_t, ndim=2, mode="c"] previous,
+                     graph,
+                     int searchwindow,
+                     int patchwindow,
+                     int neighbours,
+                     float edge_parameter,
+                     float threshold):
+    # the graph (H_i, H_j, Weights) of the previous frame is updated in copies
+    if previous.shape[0] != inputData.shape[0] or previous.shape[1] != inputData.shape[1]:
+        raise ValueError('the previous frame must have the shape of the input')
+    cdef np.ndarray[np.uint16_t, ndim=3, mode="c"] H_i = \
+            np.array(graph[0], dtype='uint16', order='C')
+    cdef np.ndarray[np.uint16_t, ndim=3, mode="c"] H_j = \
+            np.array(graph[1], dtype='uint16', order='C')
+    cdef np.ndarray[np.float32_t, ndim=3, mode="c"] Weights = \
+            np.array(graph[2], dtype='float32', order='C')
+    if Weights.shape[0] != neighbours or Weights.shape[1] != inputData.shape[0] or Weights.shape[2] != inputData.shape[1] or \
+       H_i.shape[0] != Weights.shape[0] or H_i.shape[1] != Weights.shape[1] or H_i.shape[2] != Weights.shape[2] or \
+       H_j.shape[0] != Weights.shape[0] or H_j.shape[1] != Weights.shape[1] or H_j.shape[2] != Weights.shape[2]:
+        raise ValueError('the graph does not match the input and the number of neighbours')
+
+    PatchSelect_CPU_update(&inputData[0,0], &previous[0,0], &H_j[0,0,0], &H_i[0,0,0], &H_i[0,0,0], &Weights[0,0,0], inputData.shape[1], inputData.shape[0], 0, searchwindow, patchwindow, neighbours, edge_parameter, threshold)
+    return H_i, H_j, Weights
 """
 def PatchSel_3D(np.ndarray[np.float32_t, ndim=3, mode="c"] inputData,
                      int searchwindow,
@@ -665,9 +1145,15 @@ def PatchSel_3D(np.ndarray[np.float32_t, ndim=3, mode="c"] inputData,
 #****************************************************************#
 #***************Non-local Total Variation******************#
 #****************************************************************#
-def NLTV_CPU(inputData, H_i, H_j, H_k, Weights, regularisation_parameter, iterations):
+def NLTV_CPU(inputData, H_i, H_j, H_k, Weights, regularisation_parameter, iterations,
+             checkpoint=None, checkpoint_interval=0, resume=False):
+    if H_i.ndim == 1:
+        # the CSR graph (RowPtr, Neighbours, Weights), any dimension
+        return NLTV_csr(inputData, H_i, H_j, Weights, regularisation_parameter, iterations,
+                        checkpoint_path(checkpoint), checkpoint_interval, resume)
     if inputData.ndim == 2:
-        return NLTV_2D(inputData, H_i, H_j, Weights, regularisation_parameter, iterations)
+        return NLTV_2D(inputData, H_i, H_j, Weights, regularisation_parameter, iterations,
+                       checkpoint_path(checkpoint), checkpoint_interval, resume)
     elif inputData.ndim == 3:
         return 1
 def NLTV_2D(np.ndarray[np.float32_t, ndim=2, mode="c"] inputData,
@@ -675,7 +1161,10 @@ def NLTV_2D(np.ndarray[np.float32_t, ndim=2, mode="c"] inputData,
                      np.ndarray[np.uint16_t, ndim=3, mode="c"] H_j,
                      np.ndarray[np.float32_t, ndim=3, mode="c"] Weights,
                      float regularisation_parameter,
-                     int iterations):
+                     int iterations,
+                     bytes checkpoint=None,
+                     int checkpoint_interval=0,
+                     int resume=0):
 
     cdef long dims[2]
     dims[0] = inputData.shape[0]
@@ -686,9 +1175,53 @@ def NLTV_2D(np.ndarray[np.float32_t, ndim=2, mode="c"] inputData,
             np.zeros([dims[0],dims[1]], dtype='float32')
 
     # Run nonlocal TV regularisation
-    Nonlocal_TV_CPU_main(&inputData[0,0], &outputData[0,0], &H_i[0,0,0], &H_j[0,0,0], &H_i[0,0,0], &Weights[0,0,0], dims[1], dims[0], 0, neighbours, regularisation_parameter, iterations, 1)
+    cdef const char *path = checkpoint_ptr(checkpoint)
+    cdef float status
+    with nogil:
+        status = Nonlocal_TV_CPU_ckpt(&inputData[0,0], &outputData[0,0], &H_i[0,0,0], &H_j[0,0,0], &H_i[0,0,0], &Weights[0,0,0], dims[1], dims[0], 0, neighbours, regularisation_parameter, iterations, 1,
+                             path, checkpoint_interval, resume)
+    checkpoint_status(status, checkpoint)
     return outputData
 
+def NLTV_csr(inputData,
+                     np.ndarray[np.int64_t, ndim=1, mode="c"] RowPtr,
+                     np.ndarray[np.int32_t, ndim=1, mode="c"] Neighb,
+                     np.ndarray[np.float32_t, ndim=1, mode="c"] WeightsCSR,
+                     float regularisation_parameter,
+                     int iterations,
+                     bytes checkpoint=None,
+                     int checkpoint_interval=0,
+                     int resume=0):
+    cdef np.ndarray[np.float32_t, ndim=1, mode="c"] data = \
+            np.ascontiguousarray(inputData, dtype='float32').ravel()
+    if RowPtr.shape[0] != data.shape[0] + 1 or Neighb.shape[0] != WeightsCSR.shape[0] or \
+       RowPtr[0] != 0 or RowPtr[data.shape[0]] != Neighb.shape[0]:
+        raise ValueError('the CSR graph does not match the input')
+    if Neighb.shape[0] > 0 and (Neighb.min() < 0 or Neighb.max() >= data.shape[0]):
+        raise ValueError('the CSR graph does not match the input')
+    cdef int dimX, dimY, dimZ
+    if inputData.ndim == 2:
+        dimZ = 0
+        dimY, dimX = inputData.shape
+    else:
+        dimZ, dimY, dimX = inputData.shape
+    # an empty graph is given a spare entry to point at
+    if Neighb.shape[0] == 0:
+        Neighb = np.zeros([1], dtype='int32')
+        WeightsCSR = np.zeros([1], dtype='float32')
+
+    cdef np.ndarray[np.float32_t, ndim=1, mode="c"] outputData = \
+            np.zeros([data.shape[0]], dtype='float32')
+
+    # Run nonlocal TV regularisation
+    cdef const char *path = checkpoint_ptr(checkpoint)
+    cdef float status
+    with nogil:
+        status = Nonlocal_TV_CPU_csr(&data[0], &outputData[0], <long long*>&RowPtr[0], <int*>&Neighb[0], &WeightsCSR[0], dimX, dimY, dimZ, regularisation_parameter, iterations,
+                             path, checkpoint_interval, resume)
+    checkpoint_status(status, checkpoint)
+    return outputData.reshape(inputData.shape)
+
 #****************************************************************#
 #***************Calculation of TV-energy functional**************#
 #****************************************************************#
@@ -732,3 +1265,336 @@ def TV_ENERGY_3D(np.ndarray[np.float32_t, ndim=3, mode="c"] inputData,
     TV_energy3D(&inputData[0,0,0], &inputData0[0,0,0], &outputData[0], regularisation_parameter, typeFunctional, dims[2], dims[1], dims[0])
 
     return outputData
+
+#****************************************************************#
+#****************Peak memory of the CPU regularisers*************#
+#****************************************************************#
+def CPU_peak_memory(method, shape, float tolerance_param, int layout, int searchwindow, int patchwindow, int neighbours, int lambdas=0, multigrid=False, int tile=0, int sync=8, float accuracy=1.0, views=(False, False), semi_implicit=False, primal_dual=False, csr=False):
+    # bytes of the arrays allocated by the wrappers above plus the work arrays of the C core
+    cdef int dimX, dimY, dimZ
+    if len(shape) == 2:
+        dimZ = 1
+        dimY, dimX = shape
+    elif len(shape) == 3:
+        dimZ, dimY, dimX = shape
+    else:
+        raise ValueError('Expecting 2D or 3D data, got shape {0}'.format(shape))
+    cdef long voxels = <long>dimX*dimY*dimZ
+    if dimZ == 1:
+        # 2D wrappers always run the planar layout
+        layout = 0
+    # output and information vector
+    cdef long out = voxels*4 + 2*4
+
+    if lambdas > 0:
+        # lockstep solving of the given number of lambdas, the K outputs and the float32 lambdas
+        out = lambdas*voxels*4 + 2*4 + lambdas*4
+        if method == 'ROF_TV':
+            return out + TV_ROF_CPU_multi_mem(lambdas, dimX, dimY, dimZ)
+        elif method == 'FGP_TV':
+            return out + TV_FGP_CPU_multi_mem(lambdas, dimX, dimY, dimZ)
+        elif method == 'NDF':
+            return out + Diffusion_CPU_multi_mem(lambdas, dimX, dimY, dimZ)
+        raise ValueError('No lockstep solver for {0}'.format(method))
+    if tile > 0:
+        # tiled solving of a 2D image
+        if dimZ > 1:
+            raise ValueError('tiled solving needs a 2D input')
+        if method == 'ROF_TV':
+            return out + TV_ROF_CPU_tiled_mem(tile, sync, accuracy, dimX, dimY)
+        elif method == 'FGP_TV':
+            return out + TV_FGP_CPU_tiled_mem(tile, sync, accuracy, dimX, dimY)
+        elif method == 'NDF':
+            return out + Diffusion_CPU_tiled_mem(tile, sync, accuracy, dimX, dimY)
+        elif method == 'Diff4th':
+            return out + Diffus4th_CPU_tiled_mem(tile, sync, accuracy, dimX, dimY)
+        raise ValueError('No tiled solver for {0}'.format(method))
+    if views[0] or views[1]:
+        # strided views of larger arrays, the output is not allocated
+        if views[1]:
+            out = 2*4
+        if method == 'ROF_TV':
+            return out + TV_ROF_CPU_strided_mem(tolerance_param, 1 if views[0] else 0, 1 if views[1] else 0, dimX, dimY, dimZ)
+        elif method == 'FGP_TV':
+            return out + TV_FGP_CPU_strided_mem(tolerance_param, 1 if views[0] else 0, 1 if views[1] else 0, dimX, dimY, dimZ)
+        elif method == 'NDF':
+            return out + Diffusion_CPU_strided_mem(tolerance_param, 1 if views[0] else 0, 1 if views[1] else 0, dimX, dimY, dimZ)
+        elif method == 'Diff4th':
+            return out + Diffus4th_CPU_strided_mem(tolerance_param, 1 if semi_implicit else 0, 1 if views[0] else 0, 1 if views[1] else 0, dimX, dimY, dimZ)
+        raise ValueError('No strided views for {0}'.format(method))
+    if method == 'ROF_TV':
+        return out + TV_ROF_CPU_mem(tolerance_param, layout, dimX, dimY, dimZ)
+    elif method == 'FGP_TV':
+        return out + TV_FGP_CPU_mem(tolerance_param, layout, dimX, dimY, dimZ)
+    elif method == 'PD_TV':
+        return out + PDTV_CPU_mem(layout, dimX, dimY, dimZ)
+    elif method == 'SB_TV':
+        return out + SB_TV_CPU_mem(1 if multigrid else 0, dimX, dimY, dimZ)
+    elif method == 'LLT_ROF':
+        return out + LLT_ROF_CPU_mem(tolerance_param, 1 if primal_dual else 0, dimX, dimY, dimZ)
+    elif method == 'TGV':
+        return out + TGV_mem(dimX, dimY, dimZ)
+    elif method == 'NDF':
+        return out + Diffusion_CPU_mem(tolerance_param, layout, dimX, dimY, dimZ)
+    elif method == 'LinearDiff':
+        # with fidelity weights, their float32 copy included
+        return out + voxels*4 + LinearDiff_MG_CPU_mem(1, dimX, dimY, dimZ)
+    elif method == 'Diff4th':
+        return out + Diffus4th_CPU_mem(tolerance_param, 1 if semi_implicit else 0, layout, dimX, dimY, dimZ)
+    elif method == 'FGP_dTV':
+        return out + dTV_FGP_CPU_mem(tolerance_param, layout, dimX, dimY, dimZ)
+    elif method == 'TNV' and dimZ > 1:
+        return voxels*4 + TNV_CPU_mem(dimX, dimY, dimZ)
+    elif method == 'PatchSelect' and dimZ == 1 and csr:
+        # H_i, H_j and Weights, then RowPtr and at most all of the neighbours
+        return neighbours*voxels*(2*2 + 4) + max(PatchSelect_CPU_mem(0, searchwindow, patchwindow),
+                                                 (voxels + 1)*8 + (neighbours*voxels + 1)*(4 + 4))
+    elif method == 'PatchSelect' and dimZ == 1:
+        # H_i, H_j and Weights
+        return neighbours*voxels*(2*2 + 4) + PatchSelect_CPU_mem(0, searchwindow, patchwindow)
+    elif method == 'NLTV' and dimZ == 1:
+        return voxels*4 + Nonlocal_TV_CPU_mem(dimX, dimY, 0)
+    raise ValueError('No CPU memory model for {0} on {1}D data'.format(method, len(shape)))
+
+#****************************************************************#
+#*************Huge pages for the volume work arrays**************#
+#****************************************************************#
+def HUGEPAGES_CPU(enable):
+    # switch the 2 MB aligned, MADV_HUGEPAGE advised path for large work arrays on or off
+    Vol_huge_pages(1 if enable else 0)
+
+def HUGEPAGES_INFO_CPU():
+    # (bytes that took the huge-page path since the previous query, bytes of the huge-page path arrays in use backed by huge pages or -1 if unknown)
+    cdef long info[2]
+    Vol_huge_pages_info(&info[0])
+    return (info[0], info[1])
+
+def STREAMING_CPU(threshold):
+    # streaming stores for write-once arrays of at least threshold bytes (0 - off, -1 - default), None only queries
+    if threshold is None:
+        return Vol_streaming_bytes()
+    return Vol_streaming(threshold)
+
+def POOL_CPU(int threads):
+    # start the shared work-stealing pool with threads workers (< 0 - the OpenMP thread count) or stop it (0)
+    if threads == 0:
+        Pool_stop()
+    else:
+        Pool_start(max(threads, 0))
+    return Pool_threads()
+
+def POOL_THREADS_CPU():
+    return Pool_threads()
+
+#****************************************************************#
+#******************* Progress of a running core *****************#
+#****************************************************************#
+def PROGRESS_RUN_CPU(np.ndarray[np.float32_t, ndim=1, mode="c"] record, regulariser, args, kwargs):
+    # runs the regulariser on this thread with the cores publishing [iterations, relative change]
+    # into record while they run and stopping when record[2] is set
+    if record.shape[0] < 3:
+        raise ValueError('the progress record needs 3 entries')
+    Progress_bind(&record[0])
+    try:
+        return regulariser(*args, **kwargs)
+    finally:
+        Progress_bind(NULL)
+
+def CHECKPOINT_ITERATIONS_CPU(checkpoint):
+    # iterations done in the latest checkpoint of the file, -1 when it holds none
+    return Ckpt_iterations(os.fsencode(checkpoint))
+
+def NOISE_CPU(inputData, per_slice):
+    # MAD estimate of the noise standard deviation, one per slice of a volume when per_slice
+    cdef np.ndarray[np.float32_t, ndim=1, mode="c"] data = \
+            np.ascontiguousarray(inputData, dtype='float32').ravel()
+    shape = inputData.shape if inputData.ndim == 3 else (1,) + tuple(inputData.shape)
+    cdef np.ndarray[np.float32_t, ndim=1, mode="c"] sigma = \
+            np.zeros([shape[0]], dtype='float32')
+    Noise_estimate(&data[0], &sigma[0], 1 if per_slice else 0, shape[2], shape[1], shape[0])
+    if per_slice and inputData.ndim == 3:
+        return sigma
+    return float(sigma[0])
+
+def OUTPUT_STATS_CPU(outputData, int bins, stats_range):
+    # min, max, mean and a fixed-bin histogram of the output in one parallel pass
+    cdef np.ndarray[np.float32_t, ndim=1, mode="c"] data = \
+            np.ascontiguousarray(outputData, dtype='float32').ravel()
+    cdef np.ndarray[np.float32_t, ndim=1, mode="c"] stats = \
+            np.zeros([5], dtype='float32')
+    cdef np.ndarray[np.int64_t, ndim=1, mode="c"] hist = \
+            np.zeros([bins], dtype='int64')
+    cdef float lo = 0.0
+    cdef float hi = 0.0
+    if stats_range is not None:
+        (lo, hi) = stats_range
+    Output_stats(&data[0] if data.shape[0] > 0 else NULL, &stats[0], <long long*>&hist[0], bins, lo, hi, data.shape[0])
+    return output_stats_dict(stats, hist)
+
+def output_stats_dict(stats, hist):
+    return {'min': stats[0], 'max': stats[1], 'mean': stats[2], 'histogram': hist,
+            'bin_edges': np.linspace(stats[3], stats[4], hist.shape[0]+1, dtype='float32')}
+
+# [bins, stats_range] the next ROF, FGP, PD, NDF or pipeline call of this thread computes
+# the statistics of its output in, None - no request
+_output_request = threading.local()
+
+def OUTPUT_STATS_RUN_CPU(int bins, stats_range, regulariser, args, kwargs):
+    # runs the regulariser on this thread asking the core it ends in for the statistics
+    # of the output; returns (result, statistics), None when no core computed them
+    previous = getattr(_output_request, 'request', None)
+    request = [bins, stats_range] if bins > 0 else None
+    _output_request.request = request
+    try:
+        result = regulariser(*args, **kwargs)
+    finally:
+        _output_request.request = previous
+    return (result, request[2] if (request is not None) and (len(request) > 2) else None)
+
+def output_stats_bind(long size):
+    # hands the request of this thread to the core about to run on size values
+    request = getattr(_output_request, 'request', None)
+    _output_request.request = None
+    if (request is None) or (size == 0):
+        return None
+    cdef int bins = request[0]
+    cdef np.ndarray[np.float32_t, ndim=1, mode="c"] stats = \
+            np.zeros([5], dtype='float32')
+    cdef np.ndarray[np.int64_t, ndim=1, mode="c"] hist = \
+            np.zeros([bins], dtype='int64')
+    cdef float lo = 0.0
+    cdef float hi = 0.0
+    if request[1] is not None:
+        (lo, hi) = request[1]
+    Output_stats_bind(&stats[0], <long long*>&hist[0], bins, lo, hi, size)
+    return (request, stats, hist)
+
+def output_stats_unbind(bound):
+    if bound is None:
+        return
+    (request, stats, hist) = bound
+    if Output_stats_bind(NULL, NULL, 0, 0.0, 0.0, 0):
+        request.append(output_stats_dict(stats, hist))
+
+def HASH_CPU(inputData):
+    # 64-bit hash of the bytes of the array (of any dtype) computed in parallel blocks
+    cdef np.ndarray[np.uint8_t, ndim=1, mode="c"] data = \
+            np.ascontiguousarray(inputData).reshape(-1).view(np.uint8)
+    cdef long nbytes = data.shape[0]
+    cdef unsigned long long h
+    if nbytes == 0:
+        return Vol_hash(NULL, 0)
+    with nogil:
+        h = Vol_hash(&data[0], nbytes)
+    return h
+
+def ENERGY_CPU():
+    # joules used by the processor packages since the first reading (RAPL), NaN when not readable
+    cdef double joules = Energy_read()
+    return float('nan') if joules < 0.0 else joules
+
+def ENERGY_SOURCE_CPU(root=None):
+    # looks the RAPL domains up under the powercap directory root (None - /sys/class/powercap)
+    # and restarts the count of ENERGY_CPU, the number of domains found
+    if root is None:
+        return Energy_source(NULL)
+    return Energy_source(os.fsencode(root))
+
+def COST_PREDICT_CPU(calibration, method, shape, int iterations, int threads):
+    # predicted seconds of the calibrated runtime model (cost_model.h), -1 when not calibrated
+    shape = (1,) + tuple(shape) if len(shape) == 2 else tuple(shape)
+    return Cost_predict(os.fsencode(calibration), method.encode(), shape[2], shape[1], shape[0], iterations, threads)
+
+def COST_THREADS_CPU(int threads):
+    # OpenMP thread count of the following cores called from this thread (<= 0 - query), the previous one
+    return Cost_threads(threads)
+
+def VEC_MATH_CPU(function, inputData):
+    # the vectorised exp or rsqrt of the kernels (vec_math.h) of a float32 copy of the data
+    cdef np.ndarray[np.float32_t, ndim=1, mode="c"] data = \
+            np.array(inputData, dtype='float32').ravel()
+    cdef long n = data.shape[0]
+    if function not in ('exp', 'rsqrt'):
+        raise ValueError('Unknown function {0}. Expecting exp or rsqrt'.format(function))
+    if n > 0:
+        with nogil:
+            if function == 'exp':
+                Vec_exp(&data[0], n)
+            else:
+                Vec_rsqrt(&data[0], n)
+    return data.reshape(np.shape(inputData))
+
+#***************************************************************#
+#******************** Chained regularisers *********************#
+#***************************************************************#
+# method number (pipeline.h) and the parameters of the core in the order of the arguments
+# of the Python function after inputData: (parameter positions, iterations position)
+PIPELINE_STAGES = {'ROF_TV': (0, (0, 2, 3), 1),
+                   'FGP_TV': (1, (0, 2, 3, 4), 1),
+                   'PD_TV': (2, (0, 2, 5, 3, 4, 'accelerated'), 1),
+                   'NDF': (3, (0, 1, 3, 4, 5), 2),
+                   'Diff4th': (4, (0, 1, 3, 4, 'semi_implicit'), 2),
+                   'LLT_ROF': (5, (0, 1, 3, 4, 'primal_dual'), 2),
+                   'TGV': (6, (0, 1, 2, 4, 5, 'accelerated'), 3),
+                   'clamp': (7, (0, 1), None),
+                   'scale': (8, (0, 1), None)}
+
+def PIPELINE_ARRAYS(stages):
+    # the methods, iterations and parameters (8 per stage) of Pipeline_run
+    methods = np.zeros([len(stages)], dtype='int32')
+    iterations = np.zeros([len(stages)], dtype='int32')
+    params = np.zeros([len(stages), 8], dtype='float32')
+    for (s, stage) in enumerate(stages):
+        if stage[0] not in PIPELINE_STAGES:
+            raise ValueError('Unknown pipeline stage {0}'.format(stage[0]))
+        (method, order, it) = PIPELINE_STAGES[stage[0]]
+        args = list(stage[1:])
+        options = args.pop() if (len(args) > 0 and isinstance(args[-1], dict)) else {}
+        methods[s] = method
+        if it is not None:
+            iterations[s] = args[it]
+        for (q, a) in enumerate(order):
+            if isinstance(a, str):
+                params[s, q] = 1.0 if options.get(a, False) else 0.0
+            elif stage[0] == 'clamp':
+                params[s, q] = (-np.inf, np.inf)[q] if args[a] is None else args[a]
+            else:
+                params[s, q] = args[a]
+    return (methods, iterations, params)
+
+def PIPELINE_CPU(inputData, stages, energy=False):
+    cdef np.ndarray[np.float32_t, ndim=1, mode="c"] data = \
+            np.ascontiguousarray(inputData, dtype='float32').ravel()
+    cdef np.ndarray[np.int32_t, ndim=1, mode="c"] methods
+    cdef np.ndarray[np.int32_t, ndim=1, mode="c"] iterations
+    cdef np.ndarray[np.float32_t, ndim=2, mode="c"] params
+    (methods, iterations, params) = PIPELINE_ARRAYS(stages)
+    shape = (1,) + tuple(inputData.shape) if inputData.ndim == 2 else tuple(inputData.shape)
+    cdef int nstages = len(stages), dimX = shape[2], dimY = shape[1], dimZ = shape[0]
+    cdef np.ndarray[np.float32_t, ndim=1, mode="c"] outputData = \
+            np.zeros([data.shape[0]], dtype='float32')
+    cdef np.ndarray[np.float32_t, ndim=1, mode="c"] infovec = \
+            np.zeros([2*len(stages) + 2], dtype='float32')
+    cdef np.ndarray[np.float32_t, ndim=1, mode="c"] joules = \
+            np.zeros([max(len(stages), 1)], dtype='float32')
+    cdef float *joules_ptr = &joules[0] if energy else NULL
+    if len(stages) == 0:
+        raise ValueError('Expecting at least one stage')
+    bound = output_stats_bind(outputData.size)
+    with nogil:
+        Pipeline_run(&data[0], &outputData[0], &infovec[0], joules_ptr, nstages, <int*>&methods[0], <int*>&iterations[0], &params[0,0],
+                     dimX, dimY, dimZ)
+    output_stats_unbind(bound)
+    if energy:
+        infovec = np.concatenate((infovec, np.where(joules < 0.0, np.nan, joules).astype('float32')))
+    return (outputData.reshape(inputData.shape), infovec)
+
+def PIPELINE_MEM_CPU(shape, stages):
+    cdef np.ndarray[np.int32_t, ndim=1, mode="c"] methods
+    cdef np.ndarray[np.int32_t, ndim=1, mode="c"] iterations
+    cdef np.ndarray[np.float32_t, ndim=2, mode="c"] params
+    (methods, iterations, params) = PIPELINE_ARRAYS(stages)
+    shape = (1,) + tuple(shape) if len(shape) == 2 else tuple(shape)
+    # the output and the arrays of the core
+    return 4*shape[0]*shape[1]*shape[2] + Pipeline_mem(len(stages), <int*>&methods[0], &params[0,0], shape[2], shape[1], shape[0])
+
@@ -1,9 +1,17 @@
 import unittest
 #import math
 import os
-#import timeit
+import ctypes
+import resource
+import multiprocessing
+import timeit
+import time
 import numpy as np
-from ccpi.filters.regularisers import FGP_TV, SB_TV, TGV, LLT_ROF, FGP_dTV, NDF, Diff4th, ROF_TV, PD_TV
+from ccpi.filters.regularisers import FGP_TV, SB_TV, TGV, LLT_ROF, FGP_dTV, NDF, LinearDiff, Diff4th, ROF_TV, PD_TV, peak_memory, huge_pages, thread_pool, streaming_stores, checkpoint_iterations, noise_level, auto_lambda, PatchSelect, NLTV, pipeline, submit, result_cache, energy_counter, calibrate_cost_model, predict_runtime
+from ccpi.filters.cpu_regularisers import VEC_MATH_CPU, ENERGY_CPU, ENERGY_SOURCE_CPU, OUTPUT_STATS_CPU, COST_THREADS_CPU
+import concurrent.futures
+import tempfile
+import threading
 from testroutines import BinReader, rmse 
 ###############################################################################
 
@@ -125,5 +133,581 @@ class TestRegularisers(unittest.TestCase):
         # now test that it generates some expected output
         self.assertAlmostEqual(rms, 0.02, delta=0.01)
 
+    def test_interleaved_layout_3D_CPU(self):
+        # interleaved storage of the dual fields must reproduce the planar results
+        Im, input,ref = self.getPars()
+        vol = np.ascontiguousarray(np.stack([input[200:264,200:264]]*8))
+        vol_ref = np.ascontiguousarray(np.stack([ref[200:264,200:264]]*8))
+
+        fgp_planar,info = FGP_TV(vol,0.02,50,0.0,0,0,'cpu',layout=0)
+        fgp_interl,info = FGP_TV(vol,0.02,50,0.0,0,0,'cpu',layout=1)
+        np.testing.assert_allclose(fgp_planar, fgp_interl, atol=1e-5)
+
+        pd_planar,info = PD_TV(vol,0.02,50,0.0,0,0,8,'cpu',layout=0)
+        pd_interl,info = PD_TV(vol,0.02,50,0.0,0,0,8,'cpu',layout=1)
+        np.testing.assert_allclose(pd_planar, pd_interl, atol=1e-5)
+
+        dtv_planar,info = FGP_dTV(vol,vol_ref,0.02,50,0.0,0.2,0,0,'cpu',layout=0)
+        dtv_interl,info = FGP_dTV(vol,vol_ref,0.02,50,0.0,0.2,0,0,'cpu',layout=1)
+        np.testing.assert_allclose(dtv_planar, dtv_interl, atol=1e-5)
+
+    def test_bricked_layout_3D_CPU(self):
+        # bricked storage must reproduce the planar results, sizes are not multiples of the brick
+        Im, input,ref = self.getPars()
+        vol = np.ascontiguousarray(np.stack([input[200+3*k:270+3*k,190:251] for k in range(10)]))
+
+        rof_planar,info = ROF_TV(vol,0.02,50,0.001,0.0,'cpu',layout=0)
+        rof_brick,info = ROF_TV(vol,0.02,50,0.001,0.0,'cpu',layout=2)
+        np.testing.assert_allclose(rof_planar, rof_brick, atol=1e-5)
+
+        fgp_planar,info = FGP_TV(vol,0.02,50,0.0,0,1,'cpu',layout=0)
+        fgp_brick,info = FGP_TV(vol,0.02,50,0.0,0,1,'cpu',layout=2)
+        np.testing.assert_allclose(fgp_planar, fgp_brick, atol=1e-5)
+
+        diff4_planar,info = Diff4th(vol,0.8,0.02,50,0.0001,0.0,'cpu',layout=0)
+        diff4_brick,info = Diff4th(vol,0.8,0.02,50,0.0001,0.0,'cpu',layout=2)
+        np.testing.assert_allclose(diff4_planar, diff4_brick, atol=1e-5)
+
+        ndf_planar,info = NDF(vol,0.02,0.015,50,0.01,1,0.0,'cpu',layout=0)
+        ndf_brick,info = NDF(vol,0.02,0.015,50,0.01,1,0.0,'cpu',layout=2)
+        np.testing.assert_allclose(ndf_planar, ndf_brick, atol=1e-5)
+
+    def test_peak_memory_CPU(self):
+        # the predicted peak must match the memory touched by the call, measured in a forked process
+        def measure(run, queue):
+            # serve every buffer from mmap so that memory freed earlier is not reused
+            ctypes.CDLL(None).mallopt(-3, 64*1024) # M_MMAP_THRESHOLD
+            run(np.ones((8,8,8), dtype='float32')) # start the OpenMP threads
+            base = resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+            run(vol)
+            queue.put((resource.getrusage(resource.RUSAGE_SELF).ru_maxrss - base)*1024)
+        ctx = multiprocessing.get_context('fork')
+        vol = np.random.rand(24,256,256).astype('float32')
+        cases = [('ROF_TV', dict(tolerance_param=1e-6), lambda v: ROF_TV(v,0.02,10,0.001,1e-6,'cpu')),
+                 ('ROF_TV', dict(layout=2), lambda v: ROF_TV(v,0.02,10,0.001,0.0,'cpu',layout=2)),
+                 ('FGP_TV', dict(layout=1), lambda v: FGP_TV(v,0.02,10,0.0,0,0,'cpu',layout=1)),
+                 ('TGV', dict(), lambda v: TGV(v,0.02,1.0,2.0,10,12,0.0,'cpu'))]
+        for method, options, run in cases:
+            queue = ctx.Queue()
+            proc = ctx.Process(target=measure, args=(run, queue))
+            proc.start()
+            measured = queue.get()
+            proc.join()
+            predicted = peak_memory(method, vol.shape, **options)
+            self.assertAlmostEqual(measured, predicted, delta=0.01*predicted + 2**20)
+
+    def test_huge_pages_CPU(self):
+        # work arrays above 2 MB go through the huge page path, results must not change
+        vol = np.random.rand(10,256,256).astype('float32')
+        huge_pages(False)
+        fgp_small,info = FGP_TV(vol,0.02,20,0.0,0,0,'cpu')
+        huge_pages()
+        huge_pages(True)
+        fgp_huge,info = FGP_TV(vol,0.02,20,0.0,0,0,'cpu')
+        (requested, obtained) = huge_pages()
+        np.testing.assert_array_equal(fgp_small, fgp_huge)
+        self.assertEqual(requested, peak_memory('FGP_TV', vol.shape) - vol.nbytes - 8)
+        self.assertLessEqual(obtained, requested)
+        # the backing is told for the arrays in use, those of a run while it runs
+        future = submit(FGP_TV, vol, 0.02, 100000, 0.0, 0, 0, 'cpu')
+        while future.progress()[0] < 1:
+            concurrent.futures.wait([future], timeout=0.01)
+        (requested, obtained) = huge_pages()
+        future.stop()
+        concurrent.futures.wait([future])
+        self.assertEqual(requested, peak_memory('FGP_TV', vol.shape) - vol.nbytes - 8)
+        self.assertLessEqual(obtained, requested)
+        self.assertEqual(huge_pages(), (0, 0 if obtained >= 0 else -1))
+
+    def test_output_stats_CPU(self):
+        # the statistics block must agree with numpy on the returned output
+        vol = np.random.rand(6,64,80).astype('float32')
+        out,info,stats = ROF_TV(vol,0.02,20,0.001,0.0,'cpu',stats=64)
+        self.assertEqual(stats['min'], out.min())
+        self.assertEqual(stats['max'], out.max())
+        self.assertAlmostEqual(stats['mean'], out.mean(dtype='float64'), places=5)
+        self.assertEqual(stats['histogram'].sum(), out.size)
+        hist,edges = np.histogram(out, bins=stats['bin_edges'])
+        self.assertLessEqual(np.abs(stats['histogram'] - hist).sum(), 4)
+        out,info,stats = FGP_TV(vol,0.02,20,0.0,0,0,'cpu',stats=16,stats_range=(0.25,0.75))
+        hist,edges = np.histogram(out, bins=16, range=(0.25,0.75))
+        self.assertLessEqual(np.abs(stats['histogram'] - hist).sum(), 4)
+
+    def test_output_stats_fused_CPU(self):
+        # the statistics of the last iteration must be those of a pass over the output
+        vol = np.random.rand(5,47,61).astype('float32')
+        runs = [(ROF_TV, (0.02,30,0.001,0.0,'cpu')), (FGP_TV, (0.02,30,0.0,0,1,'cpu')),
+                (PD_TV, (0.02,30,0.0,0,1,8.0,'cpu')), (NDF, (0.02,0.015,30,0.01,1,0.0,'cpu')),
+                (pipeline, ([('FGP_TV',0.02,20,0.0,0,0), ('clamp',0.3,0.7)],))]
+        for data in (vol, vol[2]):
+            for (regulariser, args) in runs:
+                for stats_range in (None, (0.25,0.75)):
+                    out,info,stats = regulariser(data, *args, stats=32, stats_range=stats_range)
+                    ref = OUTPUT_STATS_CPU(out, 32, stats_range)
+                    self.assertEqual(stats['min'], ref['min'])
+                    self.assertEqual(stats['max'], ref['max'])
+                    self.assertAlmostEqual(stats['mean'], ref['mean'], places=5)
+                    np.testing.assert_array_equal(stats['bin_edges'], ref['bin_edges'])
+                    np.testing.assert_array_equal(stats['histogram'], ref['histogram'])
+        stats = OUTPUT_STATS_CPU(np.zeros((0,8), dtype='float32'), 4, (0.0,1.0))
+        self.assertEqual(stats['histogram'].sum(), 0)
+        np.testing.assert_array_equal(stats['bin_edges'], [0.0, 0.25, 0.5, 0.75, 1.0])
+
+    def test_thread_pool_CPU(self):
+        # concurrent calls on the shared pool must give the OpenMP results
+        vols = [np.random.rand(12,67,59).astype('float32'), np.random.rand(101,77).astype('float32'),
+                np.random.rand(9,40,33).astype('float32'), np.random.rand(64,64).astype('float32')]
+        runs = [lambda v: ROF_TV(v,0.02,30,0.001,0.0,'cpu')[0],
+                lambda v: FGP_TV(v,0.02,30,0.0,0,1,'cpu')[0],
+                lambda v: PD_TV(v,0.02,30,0.0,1,0,8,'cpu')[0],
+                lambda v: TGV(v,0.02,1.0,2.0,30,12,0.0,'cpu')[0]]
+        omp = [[run(v) for run in runs] for v in vols]
+        self.assertEqual(thread_pool(3), 3)
+        pool = [None]*len(vols)
+        def client(c):
+            pool[c] = [run(vols[c]) for run in runs]
+        clients = [threading.Thread(target=client, args=(c,)) for c in range(len(vols))]
+        for t in clients:
+            t.start()
+        for t in clients:
+            t.join()
+        for a,b in zip(omp, pool):
+            for x,y in zip(a, b):
+                np.testing.assert_array_equal(x, y)
+        # the pool is stopped while the clients are running, the kernels in flight finish on it
+        pool = [None]*len(vols)
+        clients = [threading.Thread(target=client, args=(c,)) for c in range(len(vols))]
+        for t in clients:
+            t.start()
+        time.sleep(0.02)
+        self.assertEqual(thread_pool(0), 0)
+        for t in clients:
+            t.join()
+        for a,b in zip(omp, pool):
+            for x,y in zip(a, b):
+                np.testing.assert_array_equal(x, y)
+
+    def test_lockstep_lambdas_CPU(self):
+        # K lambdas solved in lockstep must give the results of K separate calls, for any
+        # number of threads
+        lambdas = [0.01, 0.02, 0.05, 0.1, 0.3]
+        previous = COST_THREADS_CPU(0)
+        try:
+            for threads in (1, max(4, os.cpu_count() or 1)):
+                COST_THREADS_CPU(threads)
+                for vol in (np.random.rand(61,53).astype('float32'), np.random.rand(7,33,29).astype('float32')):
+                    runs = [(lambda lam: ROF_TV(vol,lam,40,0.001,0.0,'cpu'), 1e-6),
+                            (lambda lam: FGP_TV(vol,lam,40,0.0,0,1,'cpu'), 1e-5),
+                            (lambda lam: FGP_TV(vol,lam,40,0.0,1,0,'cpu'), 1e-5),
+                            (lambda lam: NDF(vol,lam,0.05,40,0.01,1,0.0,'cpu'), 1e-6),
+                            (lambda lam: NDF(vol,lam,0.0,40,0.01,1,0.0,'cpu'), 1e-6)]
+                    for run, tol in runs:
+                        out, info = run(np.array(lambdas))
+                        self.assertEqual(out.shape, (len(lambdas),) + vol.shape)
+                        self.assertEqual(info[0], 40)
+                        for l, lam in enumerate(lambdas):
+                            np.testing.assert_allclose(out[l], run(lam)[0], rtol=0, atol=tol)
+        finally:
+            COST_THREADS_CPU(previous)
+        self.assertEqual(peak_memory('NDF', (7,33,29), lambdas=5), 3*5*7*33*29*4 + 8 + 5*4)
+        with self.assertRaises(ValueError):
+            ROF_TV(vol, lambdas, 40, 0.001, 1e-6, 'cpu')
+
+    def test_streaming_stores_CPU(self):
+        # streaming stores change where the data goes, not the results
+        vol = np.random.rand(10,64,48).astype('float32')
+        runs = [lambda: ROF_TV(vol,0.02,20,0.001,1e-8,'cpu')[0],
+                lambda: ROF_TV(vol,0.02,20,0.001,1e-8,'cpu',layout=2)[0],
+                lambda: FGP_TV(vol,0.02,20,1e-8,0,0,'cpu')[0],
+                lambda: NDF(vol,0.02,0.05,20,0.01,1,1e-8,'cpu')[0]]
+        default = streaming_stores()
+        self.assertEqual(streaming_stores(0), 0)
+        plain = [run() for run in runs]
+        # every array from 1 kB on is streamed
+        self.assertEqual(streaming_stores(1024), 1024)
+        streamed = [run() for run in runs]
+        self.assertEqual(streaming_stores(-1), default)
+        for a,b in zip(plain, streamed):
+            np.testing.assert_array_equal(a, b)
+
+    def test_checkpoint_resume_CPU(self):
+        # a run stopped at a checkpoint and resumed gives the output of an uninterrupted run
+        img = np.random.rand(48,40).astype('float32')
+        vol = np.random.rand(6,32,24).astype('float32')
+        with tempfile.TemporaryDirectory() as tmp:
+            ckpt = os.path.join(tmp, 'tgv.ckpt')
+            for data in (img, vol):
+                ref,info_ref = TGV(data,0.05,1.0,2.0,40,12,1e-4,'cpu')
+                TGV(data,0.05,1.0,2.0,17,12,1e-4,'cpu',checkpoint=ckpt,checkpoint_interval=5)
+                self.assertEqual(checkpoint_iterations(ckpt), 17)
+                out,info = TGV(data,0.05,1.0,2.0,40,12,1e-4,'cpu',checkpoint=ckpt,checkpoint_interval=5,resume=True)
+                np.testing.assert_array_equal(ref, out)
+                np.testing.assert_array_equal(info_ref, info)
+            # a checkpoint of another run is not resumed
+            self.assertRaises(IOError, TGV, vol,0.06,1.0,2.0,40,12,1e-4,'cpu',checkpoint=ckpt,resume=True)
+        self.assertEqual(checkpoint_iterations(ckpt), -1)
+
+    def test_multigrid_CPU(self):
+        Im, input,ref = self.getPars()
+        # SB-TV with a V-cycle for the u-subproblem
+        sb_cpu,info = SB_TV(input,0.02,150,0.0,0,'cpu',multigrid=True)
+        self.assertAlmostEqual(rmse(Im, sb_cpu),0.02,delta=0.01)
+        # steady state of the explicit linear diffusion, with a grid-size independent number of V-cycles
+        img = np.random.rand(40,56).astype('float32')
+        explicit,info = NDF(img,2.0,0.0,20000,0.1,1,0.0,'cpu')
+        mg,info = LinearDiff(img,2.0,50,1e-6)
+        self.assertLessEqual(info[0], 10)
+        self.assertLess(info[1], 1e-6)
+        np.testing.assert_allclose(mg, explicit, atol=1e-5)
+        vol = np.random.rand(33,64,80).astype('float32')
+        mg,info = LinearDiff(vol,2.0,50,1e-6)
+        self.assertLessEqual(info[0], 10)
+        # a masked region is filled in from its surroundings
+        W = np.ones_like(Im)
+        W[100:140,100:140] = 0.0
+        inpainted,info = LinearDiff(Im,1.0,100,1e-5,weights=W)
+        self.assertLess(info[1], 1e-5)
+        self.assertLess(rmse(Im[100:140,100:140], inpainted[100:140,100:140]), rmse(Im[100:140,100:140], 0.0*Im[100:140,100:140]))
+
+    def test_noise_auto_lambda_CPU(self):
+        Im, input,ref = self.getPars()
+        u0 = (Im + np.random.normal(0, 0.05, np.shape(Im))).astype('float32')
+        self.assertAlmostEqual(noise_level(u0), 0.05, delta=0.005)
+        vol = np.stack([Im[:128,:128] + np.random.normal(0, s, (128,128)) for s in (0.02,0.05,0.1)]).astype('float32')
+        sigma = noise_level(vol, per_slice=True)
+        np.testing.assert_allclose(sigma, [0.02,0.05,0.1], rtol=0.2)
+        self.assertAlmostEqual(noise_level(vol), float(np.median(sigma)), delta=0.02)
+        # two solves reach the discrepancy principle
+        fgp_cpu,info,lam = auto_lambda('FGP_TV', u0, 300)
+        self.assertAlmostEqual(rmse(u0, fgp_cpu)/noise_level(u0), 1.0, delta=0.05)
+        self.assertAlmostEqual(rmse(Im, fgp_cpu), 0.025, delta=0.01)
+        rof_cpu,info,lam = auto_lambda('ROF_TV', vol, 200, per_slice=True)
+        self.assertEqual(lam.shape, (3,))
+        self.assertTrue(lam[0] < lam[1] < lam[2])
+
+    def test_patchselect_update_CPU(self):
+        Im, input,ref = self.getPars()
+        frame0 = input[:128,:128].copy()
+        frame1 = frame0.copy()
+        frame1[40:60,20:50] += 0.2
+        graph0 = PatchSelect(frame0, 3, 2, 8, 0.06, 'cpu')
+        full = PatchSelect(frame1, 3, 2, 8, 0.06, 'cpu')
+        # exact with threshold 0, the graph of the previous frame is left as it was
+        update = PatchSelect(frame1, 3, 2, 8, 0.06, 'cpu', previous=frame0, graph=graph0)
+        for a, b in zip(full, update):
+            np.testing.assert_array_equal(a, b)
+        np.testing.assert_array_equal(graph0[2], PatchSelect(frame0, 3, 2, 8, 0.06, 'cpu')[2])
+        # small changes keep the neighbours and update the weights
+        frame2 = frame1 + np.random.normal(0, 1e-3, np.shape(frame1)).astype('float32')
+        update = PatchSelect(frame2, 3, 2, 8, 0.06, 'cpu', previous=frame1, graph=full, threshold=0.01)
+        np.testing.assert_array_equal(update[0], full[0])
+        np.testing.assert_allclose(update[2], PatchSelect(frame2, 3, 2, 8, 0.06, 'cpu')[2], atol=0.05)
+        with self.assertRaises(ValueError):
+            PatchSelect(frame1, 3, 2, 4, 0.06, 'cpu', previous=frame0, graph=graph0)
+
+    def test_csr_NLTV_CPU(self):
+        Im, input,ref = self.getPars()
+        u0 = input[:96,:128].copy()
+        H_i, H_j, Weights = PatchSelect(u0, 4, 1, 12, 0.02, 'cpu')
+        dense = NLTV(u0, H_i, H_j, H_i, Weights, 0.05, 3)
+        # all the non-zero weights kept give the result of the dense graph
+        RowPtr, Neighb, W = PatchSelect(u0, 4, 1, 12, 0.02, 'cpu', mass=1.0)
+        self.assertEqual(Neighb.size, np.count_nonzero(Weights))
+        np.testing.assert_array_equal(NLTV(u0, RowPtr, Neighb, RowPtr, W, 0.05, 3), dense)
+        # fewer neighbours, close to the dense result
+        RowPtr, Neighb, W = PatchSelect(u0, 4, 1, 12, 0.02, 'cpu', mass=0.95)
+        self.assertTrue(np.all(np.diff(RowPtr) >= 1))
+        self.assertLess(Neighb.size, 0.7*Weights.size)
+        self.assertLess(rmse(NLTV(u0, RowPtr, Neighb, RowPtr, W, 0.05, 3), dense), 0.002)
+        with self.assertRaises(ValueError):
+            NLTV(u0[:48], RowPtr, Neighb, RowPtr, W, 0.05, 3)
+        with self.assertRaises(ValueError):
+            PatchSelect(u0, 4, 1, 12, 0.02, 'cpu', previous=u0, graph=(H_i, H_j, Weights), mass=0.95)
+
+    def test_tiled_CPU(self):
+        Im, input,ref = self.getPars()
+        u0 = input[:200,:150].copy()
+        # accuracy 1 gives the untiled result, the tiles do not divide the image
+        for (tile, sync) in ((64, 8), (48, 3)):
+            np.testing.assert_array_equal(ROF_TV(u0, 0.04, 60, 0.001, 0.0, 'cpu')[0],
+                ROF_TV(u0, 0.04, 60, 0.001, 0.0, 'cpu', tile=tile, tile_sync=sync)[0])
+            np.testing.assert_array_equal(FGP_TV(u0, 0.04, 60, 0.0, 0, 1, 'cpu')[0],
+                FGP_TV(u0, 0.04, 60, 0.0, 0, 1, 'cpu', tile=tile, tile_sync=sync)[0])
+            np.testing.assert_array_equal(Diff4th(u0, 0.5, 0.05, 60, 0.001, 0.0, 'cpu')[0],
+                Diff4th(u0, 0.5, 0.05, 60, 0.001, 0.0, 'cpu', tile=tile, tile_sync=sync)[0])
+            np.testing.assert_array_equal(NDF(u0, 0.02, 0.05, 60, 0.01, 1, 0.0, 'cpu')[0],
+                NDF(u0, 0.02, 0.05, 60, 0.01, 1, 0.0, 'cpu', tile=tile, tile_sync=sync)[0])
+        # narrower halos stay close
+        (output, info) = FGP_TV(u0, 0.04, 60, 0.0, 0, 1, 'cpu', tile=48, tile_sync=3, tile_accuracy=0.5)
+        self.assertEqual(info[0], 60)
+        np.testing.assert_allclose(output, FGP_TV(u0, 0.04, 60, 0.0, 0, 1, 'cpu')[0], atol=0.01)
+        self.assertGreater(peak_memory('FGP_TV', u0.shape, tile=48), 0)
+        with self.assertRaises(ValueError):
+            ROF_TV(np.stack([u0, u0]), 0.04, 60, 0.001, 0.0, 'cpu', tile=64)
+        with self.assertRaises(ValueError):
+            ROF_TV(u0, 0.04, 60, 0.001, 1e-4, 'cpu', tile=64)
+
+    def test_strided_views_CPU(self):
+        Im, input,ref = self.getPars()
+        vol = np.stack([input[:160,:180]]*6)
+        view = vol[1:5, 10:150, 20:170]
+        lam = np.full(view.shape, 0.03, dtype='float32')
+        for run in (lambda x, **kw: ROF_TV(x, lam, 30, 0.001, 0.0, 'cpu', **kw),
+                    lambda x, **kw: FGP_TV(x, 0.03, 30, 0.0, 0, 1, 'cpu', **kw),
+                    lambda x, **kw: NDF(x, 0.02, 0.05, 30, 0.01, 1, 0.0, 'cpu', **kw),
+                    lambda x, **kw: Diff4th(x[2], 0.5, 0.05, 30, 0.001, 0.0, 'cpu', **kw)):
+            expected = run(np.ascontiguousarray(view))[0]
+            # a view as the input, a view of a padded buffer as the output
+            np.testing.assert_array_equal(run(view)[0], expected)
+            padded = np.zeros((6, 150, 160), dtype='float32')
+            out = padded[1:5, 5:145, 5:155] if expected.ndim == 3 else padded[0, 5:145, 5:155]
+            self.assertIs(run(view, out=out)[0], out)
+            np.testing.assert_array_equal(out, expected)
+            self.assertEqual(np.count_nonzero(padded), np.count_nonzero(out))
+            # in place in the larger array
+            inplace = vol.copy()[1:5, 10:150, 20:170]
+            run(inplace, out=inplace if expected.ndim == 3 else inplace[2])
+            np.testing.assert_array_equal(inplace if expected.ndim == 3 else inplace[2], expected)
+        self.assertGreater(peak_memory('ROF_TV', view.shape, views=(True, True)), peak_memory('ROF_TV', view.shape) - view.size*4)
+        with self.assertRaises(ValueError):
+            ROF_TV(view, 0.03, 30, 0.001, 0.0, 'cpu', out=np.zeros((4, 140, 149), dtype='float32'))
+
+    def test_accelerated_PD_CPU(self):
+        # the accelerated primal-dual scheme gets closer to the solution in the same iterations
+        Im, input,ref = self.getPars()
+        img = np.ascontiguousarray(input[100:228, 100:228])
+        vol = np.stack([img[:64,:64]]*4)
+        for run in (lambda x, it, acc: PD_TV(x, 0.1, it, 0.0, 0, 0, 8, 'cpu', accelerated=acc)[0],
+                    lambda x, it, acc: TGV(x, 0.1, 1.0, 2.0, it, 12, 0.0, 'cpu', accelerated=acc)[0]):
+            for data in (img, vol):
+                solution = run(data, 3000, True)
+                self.assertLess(rmse(run(data, 150, True), solution), 0.5*rmse(run(data, 150, False), solution))
+        # the steps are part of the checkpoint
+        with tempfile.TemporaryDirectory() as tmp:
+            ckpt = os.path.join(tmp, 'tgv.ckpt')
+            expected = TGV(img, 0.1, 1.0, 2.0, 40, 12, 0.0, 'cpu', accelerated=True)[0]
+            TGV(img, 0.1, 1.0, 2.0, 17, 12, 0.0, 'cpu', checkpoint=ckpt, accelerated=True)
+            self.assertRaises(IOError, TGV, img, 0.1, 1.0, 2.0, 40, 12, 0.0, 'cpu', checkpoint=ckpt, resume=True)
+            out = TGV(img, 0.1, 1.0, 2.0, 40, 12, 0.0, 'cpu', checkpoint=ckpt, resume=True, accelerated=True)[0]
+            np.testing.assert_array_equal(out, expected)
+
+    def test_semi_implicit_Diff4th_CPU(self):
+        # time steps far above the explicit limit converge to the result of the explicit scheme
+        Im, input,ref = self.getPars()
+        img = np.ascontiguousarray(input[100:228, 100:228])
+        vol = np.stack([img[:48,:64]]*5)
+        for data in (img, vol):
+            explicit = Diff4th(data, 3.5, 0.1, 3000, 0.002, 0.0, 'cpu')[0]
+            self.assertFalse(np.all(np.abs(Diff4th(data, 3.5, 0.1, 100, 0.5, 0.0, 'cpu')[0]) < 10))
+            semi = Diff4th(data, 3.5, 0.1, 100, 0.5, 0.0, 'cpu', semi_implicit=True)[0]
+            self.assertLess(rmse(semi, explicit), 0.1*rmse(data, explicit))
+        view = np.zeros((140, 150), dtype='float32')[5:133, 10:138]
+        Diff4th(img, 3.5, 0.1, 100, 0.5, 0.0, 'cpu', out=view, semi_implicit=True)
+        np.testing.assert_array_equal(view, Diff4th(img, 3.5, 0.1, 100, 0.5, 0.0, 'cpu', semi_implicit=True)[0])
+        self.assertGreater(peak_memory('Diff4th', img.shape, semi_implicit=True), peak_memory('Diff4th', img.shape))
+
+    def test_primal_dual_LLT_ROF_CPU(self):
+        # the primal-dual solver gets below the energy of long explicit runs in a fraction of the iterations
+        def energy(u, f, lambdaROF, lambdaLLT):
+            u = u.astype('float64')
+            grad2 = np.zeros(u.shape)
+            second = 0.0
+            for axis in range(u.ndim):
+                d = np.diff(u, axis=axis)
+                grad2 += np.concatenate((d, np.zeros_like(np.take(d, [0], axis=axis))), axis=axis)**2
+                second += np.sum(np.abs(np.diff(np.concatenate((np.zeros_like(np.take(d, [0], axis=axis)), d,
+                                 np.zeros_like(np.take(d, [0], axis=axis))), axis=axis), axis=axis)))
+            return 0.5*np.sum((u - f)**2) + lambdaROF*np.sum(np.sqrt(grad2)) + lambdaLLT*second
+        Im, input,ref = self.getPars()
+        img = np.ascontiguousarray(input[100:228, 100:228])
+        vol = np.stack([img[:48,:64]]*5)
+        for data in (img, vol):
+            explicit = LLT_ROF(data, 0.01, 0.008, 2000, 0.001, 0.0, 'cpu')[0]
+            pd, info = LLT_ROF(data, 0.01, 0.008, 100, 0.001, 0.0, 'cpu', primal_dual=True)
+            self.assertLess(energy(pd, data, 0.01, 0.008), energy(explicit, data, 0.01, 0.008))
+            self.assertLess(rmse(pd, explicit), 0.01)
+            self.assertLess(LLT_ROF(data, 0.01, 0.008, 1000, 0.001, 1e-4, 'cpu', primal_dual=True)[1][0], 1000)
+        self.assertEqual(peak_memory('LLT_ROF', vol.shape, primal_dual=True) - peak_memory('LLT_ROF', vol.shape), vol.size*4)
+
+    def test_pipeline_CPU(self):
+        # the chained stages give the results of the separate calls, the work arrays fit into the workspace
+        Im, input,ref = self.getPars()
+        img = np.ascontiguousarray(input[100:228, 100:228])
+        vol = np.stack([img[:48,:64]]*5)
+        for data in (img, vol):
+            stages = [('NDF', 0.02, 0.015, 30, 0.025, 1, 0.0), ('FGP_TV', 0.02, 30, 0.0, 0, 0), ('clamp', 0.0, None), ('scale', 2.0, 0.5)]
+            expected = NDF(data, 0.02, 0.015, 30, 0.025, 1, 0.0, 'cpu')[0]
+            expected = 2.0*np.maximum(FGP_TV(expected, 0.02, 30, 0.0, 0, 0, 'cpu')[0], 0.0) + 0.5
+            (out, info) = pipeline(data, stages)
+            np.testing.assert_allclose(out, expected, rtol=1e-6, atol=1e-6)
+            self.assertEqual(info.shape[0], 2*len(stages) + 2)
+            self.assertGreater(info[-2], 0)
+            self.assertEqual(info[-1], 0)
+            # the largest stage and the scratch array of the ping-pong
+            self.assertLess(peak_memory('pipeline', data.shape, stages=stages) - peak_memory('FGP_TV', data.shape), 4*data.size + 4096)
+            # pointwise stages before the first solver and solver options
+            stages = [('clamp', 0.2, 0.8), ('TGV', 0.02, 1.0, 2.0, 20, 12, 0.0, {'accelerated': True}), ('ROF_TV', 0.02, 20, 0.001, 0.0)]
+            expected = TGV(np.clip(data, 0.2, 0.8), 0.02, 1.0, 2.0, 20, 12, 0.0, 'cpu', accelerated=True)[0]
+            expected = ROF_TV(expected, 0.02, 20, 0.001, 0.0, 'cpu')[0]
+            np.testing.assert_allclose(pipeline(data, stages)[0], expected, rtol=1e-6, atol=1e-6)
+            # pointwise stages applied by the last iteration of PD_TV, after ROF_TV stopped by the tolerance
+            stages = [('PD_TV', 0.02, 30, 0.0, 0, 0, 8.0), ('clamp', None, 0.6), ('ROF_TV', 0.02, 200, 0.001, 1e-3), ('scale', 0.5, 0.1)]
+            expected = np.minimum(PD_TV(data, 0.02, 30, 0.0, 0, 0, 8.0, 'cpu')[0], 0.6)
+            (expected, info) = ROF_TV(expected, 0.02, 200, 0.001, 1e-3, 'cpu')
+            self.assertLess(info[0], 200)
+            np.testing.assert_allclose(pipeline(data, stages)[0], 0.5*expected + 0.1, rtol=1e-6, atol=1e-6)
+        self.assertRaises(ValueError, pipeline, img, [('SB_TV', 0.02, 30, 0.0, 0)])
+
+    def test_submit_CPU(self):
+        Im, input,ref = self.getPars()
+        u0 = input[:128,:128].copy()
+        # the result of the blocking call, the progress ends at the iterations done
+        future = submit(FGP_TV, u0, 0.02, 300, 1e-6, 0, 0, 'cpu')
+        (output, info) = future.result()
+        np.testing.assert_array_equal(output, FGP_TV(u0, 0.02, 300, 1e-6, 0, 0, 'cpu')[0])
+        self.assertLess(abs(future.progress()[0] - info[0]), 2)
+        self.assertGreater(future.progress()[1], 0.0)
+        # a running core is not cancelled but stops at the end of an iteration on stop(), a
+        # pending call does not start
+        for (regulariser, args) in ((TGV, (u0, 0.02, 1.0, 2.0, 10**7, 12, 0.0, 'cpu')),
+                                    (ROF_TV, (u0, 0.02, 10**7, 0.001, 0.0, 'cpu'))):
+            running = submit(regulariser, *args)
+            pending = submit(ROF_TV, u0, 0.02, 10, 0.001, 0.0, 'cpu')
+            while running.progress()[0] == 0:
+                threading.Event().wait(0.001)
+            self.assertTrue(pending.cancel())
+            self.assertFalse(running.cancel())
+            self.assertFalse(running.cancelled())
+            self.assertTrue(running.stop())
+            self.assertRaises(concurrent.futures.CancelledError, running.result, 60)
+            self.assertTrue(running.cancelled())
+            self.assertLess(running.progress()[0], 10**7)
+            self.assertTrue(pending.cancelled())
+            self.assertEqual(pending.progress()[0], 0)
+
+    def test_result_cache_CPU(self):
+        Im, input,ref = self.getPars()
+        u0 = input[:128,:128].copy()
+        with tempfile.TemporaryDirectory() as spill:
+            result_cache(u0.nbytes + 64, spill=spill)
+            try:
+                # a hit returns a copy of the result of the call with the same input and parameters
+                (output, info) = FGP_TV(u0, 0.02, 100, 0.0, 0, 0, 'cpu')
+                (cached, cached_info) = FGP_TV(u0.copy(), 0.02, 100, 0.0, 0, 0)
+                np.testing.assert_array_equal(cached, output)
+                np.testing.assert_array_equal(cached_info, info)
+                self.assertEqual(result_cache()[:2], (1, 1))
+                cached[:] = 0.0
+                np.testing.assert_array_equal(FGP_TV(u0, 0.02, 100, 0.0, 0, 0)[0], output)
+                # other parameters or data miss, the evicted result comes back from the spill file
+                FGP_TV(u0, 0.03, 100, 0.0, 0, 0)
+                changed = u0.copy()
+                changed[64,64] += 1e-6
+                FGP_TV(changed, 0.02, 100, 0.0, 0, 0)
+                self.assertEqual(result_cache()[:2], (2, 3))
+                self.assertGreater(result_cache()[3], 0)
+                np.testing.assert_array_equal(FGP_TV(u0, 0.02, 100, 0.0, 0, 0)[0], output)
+                self.assertEqual(result_cache()[:2], (3, 3))
+                # the calls writing into out are not cached
+                ROF_TV(u0, 0.02, 50, 0.001, 0.0, out=np.zeros_like(u0))
+                self.assertEqual(result_cache()[:2], (3, 3))
+            finally:
+                self.assertEqual(result_cache(0), (0, 0, 0, 0))
+            self.assertEqual(os.listdir(spill), [])
+
+    def test_energy_CPU(self):
+        Im, input,ref = self.getPars()
+        u0 = input[:128,:128].copy()
+        # the joules (NaN without readable RAPL counters) extend the infovector, the output is unchanged
+        (output, info) = FGP_TV(u0, 0.02, 50, 0.0, 0, 0, 'cpu')
+        (measured, measured_info, stats) = FGP_TV(u0, 0.02, 50, 0.0, 0, 0, 'cpu', energy=True, stats=4)
+        np.testing.assert_array_equal(measured, output)
+        np.testing.assert_array_equal(measured_info[:-1], info)
+        self.assertFalse(measured_info[-1] < 0.0)
+        stages = [('FGP_TV', 0.02, 50, 0.0, 0, 0), ('clamp', 0.0, None), ('scale', 2.0, 0.0)]
+        (piped, piped_info) = pipeline(u0, stages, energy=True)
+        np.testing.assert_array_equal(piped, pipeline(u0, stages)[0])
+        self.assertEqual(piped_info.shape[0], 2*len(stages) + 2 + len(stages) + 1)
+        self.assertFalse(np.any(piped_info[-len(stages)-1:] < 0.0))
+        start = energy_counter()
+        if start is None:
+            self.assertTrue(np.all(np.isnan(piped_info[-len(stages)-1:])))
+        else:
+            self.assertGreaterEqual(energy_counter(), start)
+
+    def test_energy_wrap_CPU(self):
+        # a fake powercap tree: domain 0 with its wrap range, domain 1 without one
+        def write(folder, name, value):
+            with open(os.path.join(folder, name), 'w') as f:
+                f.write('{}\n'.format(value))
+        with tempfile.TemporaryDirectory() as root:
+            domains = [os.path.join(root, 'intel-rapl:{}'.format(d)) for d in range(2)]
+            for folder in domains:
+                os.mkdir(folder)
+            write(domains[0], 'energy_uj', 900000)
+            write(domains[0], 'max_energy_range_uj', 1000000)
+            write(domains[1], 'energy_uj', 500000)
+            try:
+                self.assertEqual(ENERGY_SOURCE_CPU(root), 2)
+                self.assertEqual(ENERGY_CPU(), 0.0)
+                # domain 0 wraps, its range is added
+                write(domains[0], 'energy_uj', 100000)
+                write(domains[1], 'energy_uj', 700000)
+                self.assertAlmostEqual(ENERGY_CPU(), 0.4, places=9)
+                # domain 1 wraps without a known range, that interval is left out
+                write(domains[0], 'energy_uj', 300000)
+                write(domains[1], 'energy_uj', 100000)
+                self.assertAlmostEqual(ENERGY_CPU(), 0.6, places=9)
+                write(domains[1], 'energy_uj', 400000)
+                self.assertAlmostEqual(ENERGY_CPU(), 0.9, places=9)
+            finally:
+                ENERGY_SOURCE_CPU()
+
+    def test_cost_model_CPU(self):
+        with tempfile.TemporaryDirectory() as folder:
+            calibration = os.path.join(folder, 'cost_model.txt')
+            model = calibrate_cost_model(calibration, methods=['ROF_TV'], shapes=((64,64), (128,128), (4,64,64)),
+                                         iterations=(4, 12), threads=2)
+            self.assertEqual(sorted(model), [('ROF_TV', 2), ('ROF_TV', 3)])
+            # the fitted parameters: a parallel fraction, non-negative costs at increasing sizes
+            (fraction, timed, points) = model[('ROF_TV', 2)]
+            self.assertEqual(len(points), 2)
+            self.assertEqual(timed, 2)
+            self.assertTrue(0.0 <= fraction <= 1.0)
+            self.assertTrue(np.all(np.isfinite(points)) and np.all(np.array(points) >= 0.0))
+            self.assertLess(points[0][0], points[1][0])
+            # the prediction at a calibrated size is its costs on the fitted Amdahl curve
+            (voxels, setup, per_iteration) = points[1]
+            for threads in (1, 2, 8):
+                np.testing.assert_allclose(predict_runtime(calibration, 'ROF_TV', (128,128), 200, threads=threads),
+                    voxels*(setup + 200*per_iteration)*((1.0 - fraction) + fraction/threads), rtol=1e-4)
+            # it does not shrink with the iterations or the size, nor grow with more threads
+            predicted = predict_runtime(calibration, 'ROF_TV', (128,128), 200, threads=1)
+            self.assertLessEqual(predict_runtime(calibration, 'ROF_TV', (128,128), 100, threads=1), predicted)
+            self.assertLessEqual(predicted, predict_runtime(calibration, 'ROF_TV', (256,256), 200, threads=1))
+            self.assertLessEqual(predict_runtime(calibration, 'ROF_TV', (128,128), 200, threads=8), predicted)
+            self.assertGreaterEqual(predict_runtime(calibration, 'ROF_TV', (8,64,64), 20), 0.0)
+            with self.assertRaises(ValueError):
+                predict_runtime(calibration, 'TGV', (128,128), 100)
+            with self.assertRaises(ValueError):
+                predict_runtime(os.path.join(folder, 'missing.txt'), 'ROF_TV', (128,128), 100)
+
+    def test_vec_math_CPU(self):
+        # the vectorised exp and rsqrt of the kernels against libm in double precision, within
+        # the relative errors of vec_math.h (VEXP_ERROR, VRSQRT_ERROR) for normal results
+        x = np.concatenate((np.linspace(-87.3, 88.7, 1000001), np.random.uniform(-5.0, 5.0, 100000))).astype('float32')
+        exact = np.exp(x.astype('float64'))
+        self.assertLess(np.max(np.abs(VEC_MATH_CPU('exp', x) - exact)/exact), 1.5e-7)
+        # subnormal results within a unit of the last place, 0 and inf beyond the range, NaN kept
+        x = np.linspace(-103.9, -87.4, 10001).astype('float32')
+        self.assertLessEqual(np.max(np.abs(VEC_MATH_CPU('exp', x) - np.exp(x.astype('float64')))), 2.0**-149)
+        edges = np.array([-np.inf, -200.0, 0.0, 100.0, np.inf, np.nan], dtype='float32')
+        np.testing.assert_array_equal(VEC_MATH_CPU('exp', edges), [0.0, 0.0, 1.0, np.inf, np.inf, np.nan])
+        y = np.exp(np.random.uniform(np.log(1.2e-38), np.log(3.0e38), 1000000)).astype('float32')
+        exact = 1.0/np.sqrt(y.astype('float64'))
+        self.assertLess(np.max(np.abs(VEC_MATH_CPU('rsqrt', y) - exact)/exact), 2.5e-7)
+        with self.assertRaises(ValueError):
+            VEC_MATH_CPU('log', y)
+
 if __name__ == '__main__':
     unittest.main()